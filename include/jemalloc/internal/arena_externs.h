@@ -44,6 +44,14 @@ void arena_stats_merge(tsdn_t *tsdn, arena_t *arena, unsigned *nthreads,
     size_t *nactive, size_t *ndirty, size_t *nmuzzy, arena_stats_t *astats,
     bin_stats_data_t *bstats, arena_stats_large_t *lstats,
     pac_estats_t *estats, hpa_shard_stats_t *hpastats, sec_stats_t *secstats);
+void arena_stats_tcache_bytes_read(tsdn_t *tsdn, arena_t *arena,
+    arena_stats_t *astats);
+void arena_stats_mapped_get(tsdn_t *tsdn, arena_t *arena, size_t *base,
+    size_t *mapped, size_t *retained);
+void arena_stats_summary_merge(tsdn_t *tsdn, arena_t *arena,
+    arena_stats_summary_t *summary);
+void arena_stats_mutex_prof_read(tsdn_t *tsdn, arena_t *arena,
+    mutex_prof_data_t mutex_prof_data[mutex_prof_num_arena_mutexes]);
 void arena_handle_deferred_work(tsdn_t *tsdn, arena_t *arena);
 edata_t *arena_extent_alloc_large(tsdn_t *tsdn, arena_t *arena,
     size_t usize, size_t alignment, bool zero);
@@ -24,4 +24,21 @@ arena_internal_get(arena_t *arena) {
 	return atomic_load_zu(&arena->stats.internal, ATOMIC_RELAXED);
 }
 
+/*
+ * Only ctl clears the flag, so between refreshes this is a load of a read-mostly
+ * cache line rather than a store.
+ */
+static inline void
+arena_stats_touch(arena_t *arena) {
+	if (config_stats && !atomic_load_b(&arena->stats_touched,
+	    ATOMIC_RELAXED)) {
+		atomic_store_b(&arena->stats_touched, true, ATOMIC_RELAXED);
+	}
+}
+
+static inline bool
+arena_stats_touched_reset(arena_t *arena) {
+	return atomic_exchange_b(&arena->stats_touched, false, ATOMIC_ACQ_REL);
+}
+
 #endif /* JEMALLOC_INTERNAL_ARENA_INLINES_A_H */
@@ -153,11 +153,11 @@ arena_prof_tctx_reset_sampled(tsd_t *tsd, const void *ptr) {
 
 JEMALLOC_ALWAYS_INLINE void
 arena_prof_info_set(tsd_t *tsd, edata_t *edata, prof_tctx_t *tctx,
-    size_t size) {
+    size_t size, unsigned sample_level, unsigned alloc_tag) {
 	cassert(config_prof);
 
 	assert(!edata_slab_get(edata));
-	large_prof_info_set(edata, tctx, size);
+	large_prof_info_set(edata, tctx, size, sample_level, alloc_tag);
 }
 
 JEMALLOC_ALWAYS_INLINE void
@@ -607,6 +607,7 @@ arena_dalloc_bin_locked_finish(tsdn_t *tsdn, arena_t *arena, bin_t *bin,
 		bin->stats.ndalloc += info->ndalloc;
 		assert(bin->stats.curregs >= (size_t)info->ndalloc);
 		bin->stats.curregs -= (size_t)info->ndalloc;
+		arena_stats_touch(arena);
 	}
 }
 
@@ -648,6 +649,7 @@ arena_bin_flush_batch_impl(tsdn_t *tsdn, arena_t *arena, bin_t *bin,
 	bin->stats.batch_pops++;
 	bin->stats.batch_pushes += npushes;
 	bin->stats.batch_pushed_elems += nelems_to_pop;
+	arena_stats_touch(arena);
 }
 
 typedef struct arena_bin_flush_batch_state_s arena_bin_flush_batch_state_t;
@@ -87,6 +87,23 @@ struct arena_stats_s {
 	nstime_t		uptime;
 };
 
+/*
+ * An arena's share of the summary stats (stats.allocated and friends), which
+ * take far less work and locking to gather than a full arena_stats_merge().
+ */
+typedef struct arena_stats_summary_s arena_stats_summary_t;
+struct arena_stats_summary_s {
+	size_t	allocated;
+	size_t	active;
+	size_t	metadata;
+	size_t	metadata_edata;
+	size_t	metadata_rtree;
+	size_t	metadata_thp;
+	size_t	resident;
+	size_t	mapped;
+	size_t	retained;
+};
+
 static inline bool
 arena_stats_init(tsdn_t *tsdn, arena_stats_t *arena_stats) {
 	if (config_debug) {
@@ -11,6 +11,7 @@
 #include "jemalloc/internal/edata_cache.h"
 #include "jemalloc/internal/extent_dss.h"
 #include "jemalloc/internal/jemalloc_internal_types.h"
+#include "jemalloc/internal/latency.h"
 #include "jemalloc/internal/mutex.h"
 #include "jemalloc/internal/nstime.h"
 #include "jemalloc/internal/pa.h"
@@ -47,6 +48,22 @@ struct arena_s {
 	/* Synchronization: internal. */
 	arena_stats_t		stats;
 
+	/*
+	 * Set whenever bin or large stats change; cleared by ctl when it
+	 * merges them, so that it can skip arenas nothing happened in.
+	 *
+	 * Synchronization: atomic.
+	 */
+	atomic_b_t		stats_touched;
+
+	/*
+	 * Latency histograms of the sampled calls of the threads assigned to
+	 * this arena; see latency.h.
+	 *
+	 * Synchronization: atomic.
+	 */
+	latency_hist_t		latency[latency_num_tiers];
+
 	/*
 	 * Lists of tcaches and cache_bin_array_descriptors for extant threads
 	 * associated with this arena.  Stats from these are merged
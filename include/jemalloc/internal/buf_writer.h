@@ -14,8 +14,14 @@
  * some "option like" content for the write_cb, so it doesn't matter.
  */
 
+/* Like write_cb_t, but for output that may contain NUL bytes. */
+typedef void (write_bytes_cb_t)(void *cbopaque, const void *bytes,
+    size_t len);
+
 typedef struct {
 	write_cb_t *write_cb;
+	/* If non-NULL, flushes go through here instead of write_cb. */
+	write_bytes_cb_t *write_bytes_cb;
 	void *cbopaque;
 	char *buf;
 	size_t buf_size;
@@ -27,6 +33,10 @@ bool buf_writer_init(tsdn_t *tsdn, buf_writer_t *buf_writer,
     write_cb_t *write_cb, void *cbopaque, char *buf, size_t buf_len);
 void buf_writer_flush(buf_writer_t *buf_writer);
 write_cb_t buf_writer_cb;
+void buf_writer_set_bytes_cb(buf_writer_t *buf_writer,
+    write_bytes_cb_t *write_bytes_cb);
+void buf_writer_bytes(buf_writer_t *buf_writer, const void *bytes,
+    size_t len);
 void buf_writer_terminate(tsdn_t *tsdn, buf_writer_t *buf_writer);
 
 typedef ssize_t (read_cb_t)(void *read_cbopaque, void *buf, size_t limit);
@@ -93,6 +93,17 @@ bool ckh_remove(tsd_t *tsd, ckh_t *ckh, const void *searchkey, void **key,
     void **data);
 bool ckh_search(ckh_t *ckh, const void *searchkey, void **key, void **data);
 
+/*
+ * As above, but with the key's hashes (as computed by the table's hash
+ * function) supplied by the caller, for callers that need them anyway.
+ */
+bool ckh_insert_hashed(tsd_t *tsd, ckh_t *ckh, const void *key,
+    const void *data, const size_t hashes[2]);
+bool ckh_remove_hashed(tsd_t *tsd, ckh_t *ckh, const void *searchkey,
+    void **key, void **data, const size_t hashes[2]);
+bool ckh_search_hashed(ckh_t *ckh, const void *searchkey, void **key,
+    void **data, const size_t hashes[2]);
+
 /* Some useful hash and comparison functions for strings and pointers. */
 void ckh_string_hash(const void *key, size_t r_hash[2]);
 bool ckh_string_keycomp(const void *k1, const void *k2);
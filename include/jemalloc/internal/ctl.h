@@ -6,6 +6,7 @@
 #include "jemalloc/internal/background_thread_structs.h"
 #include "jemalloc/internal/bin_stats.h"
 #include "jemalloc/internal/jemalloc_internal_types.h"
+#include "jemalloc/internal/latency.h"
 #include "jemalloc/internal/malloc_io.h"
 #include "jemalloc/internal/mutex_prof.h"
 #include "jemalloc/internal/ql.h"
@@ -67,6 +68,8 @@ typedef struct ctl_stats_s {
 
 	background_thread_stats_t background_thread;
 	mutex_prof_data_t mutex_prof_data[mutex_prof_num_global_mutexes];
+	/* The latency histograms of the destroyed arenas. */
+	latency_stats_t latency_destroyed[latency_num_tiers];
 } ctl_stats_t;
 
 typedef struct ctl_arena_s ctl_arena_t;
@@ -102,6 +105,158 @@ typedef struct ctl_arenas_s {
 	ctl_arena_t *arenas[2 + MALLOCX_ARENA_LIMIT];
 } ctl_arenas_t;
 
+/*
+ * Layout of the experimental.stats_snapshot blob (see ctl.c).  Every value is
+ * a uint64_t, emitted in the order listed below; each OP(name, expr) reads its
+ * value from the variable named in the comment above the list.  Fields may
+ * only be appended to a list, and doing so (or changing what one means)
+ * requires bumping CTL_SNAPSHOT_VERSION.
+ */
+#define CTL_SNAPSHOT_MAGIC	UINT64_C(0x6a656d736e617073) /* "jemsnaps". */
+#define CTL_SNAPSHOT_VERSION	1
+
+#define CTL_SNAPSHOT_HEADER_FIELDS					\
+    OP(magic)								\
+    OP(version)								\
+    OP(size)								\
+    OP(epoch)								\
+    OP(nglobal_fields)							\
+    OP(nmutex_fields)							\
+    OP(nglobal_mutexes)							\
+    OP(narena_fields)							\
+    OP(narena_mutexes)							\
+    OP(nbins)								\
+    OP(nbin_fields)							\
+    OP(nlextents)							\
+    OP(nlextent_fields)							\
+    OP(narenas)
+
+/* ctl_stats_t *s. */
+#define CTL_SNAPSHOT_GLOBAL_FIELDS					\
+    OP(allocated, s->allocated)						\
+    OP(active, s->active)						\
+    OP(metadata, s->metadata)						\
+    OP(metadata_edata, s->metadata_edata)				\
+    OP(metadata_rtree, s->metadata_rtree)				\
+    OP(metadata_thp, s->metadata_thp)					\
+    OP(resident, s->resident)						\
+    OP(mapped, s->mapped)						\
+    OP(retained, s->retained)						\
+    OP(background_thread_num_threads, s->background_thread.num_threads)	\
+    OP(background_thread_num_runs, s->background_thread.num_runs)	\
+    OP(background_thread_run_interval,					\
+        nstime_ns(&s->background_thread.run_interval))
+
+/* mutex_prof_data_t *m. */
+#define CTL_SNAPSHOT_MUTEX_FIELDS					\
+    OP(num_ops, m->n_lock_ops)						\
+    OP(num_wait, m->n_wait_times)					\
+    OP(num_spin_acq, m->n_spin_acquired)				\
+    OP(num_owner_switch, m->n_owner_switches)				\
+    OP(total_wait_time, nstime_ns(&m->tot_wait_time))			\
+    OP(max_wait_time, nstime_ns(&m->max_wait_time))			\
+    OP(max_num_thds, m->max_n_thds)
+
+/* ctl_arena_t *a, and ctl_arena_stats_t *as == a->astats. */
+#define CTL_SNAPSHOT_ARENA_FIELDS					\
+    OP(arena_ind, a->arena_ind)						\
+    OP(nthreads, a->nthreads)						\
+    OP(dirty_decay_ms, (int64_t)a->dirty_decay_ms)			\
+    OP(muzzy_decay_ms, (int64_t)a->muzzy_decay_ms)			\
+    OP(uptime, nstime_ns(&as->astats.uptime))				\
+    OP(pactive, a->pactive)						\
+    OP(pdirty, a->pdirty)						\
+    OP(pmuzzy, a->pmuzzy)						\
+    OP(mapped, as->astats.mapped)					\
+    OP(retained, as->astats.pa_shard_stats.pac_stats.retained)		\
+    OP(extent_avail, as->astats.pa_shard_stats.edata_avail)		\
+    OP(dirty_npurge, locked_read_u64_unsynchronized(			\
+        &as->astats.pa_shard_stats.pac_stats.decay_dirty.npurge))	\
+    OP(dirty_nmadvise, locked_read_u64_unsynchronized(			\
+        &as->astats.pa_shard_stats.pac_stats.decay_dirty.nmadvise))	\
+    OP(dirty_purged, locked_read_u64_unsynchronized(			\
+        &as->astats.pa_shard_stats.pac_stats.decay_dirty.purged))	\
+    OP(muzzy_npurge, locked_read_u64_unsynchronized(			\
+        &as->astats.pa_shard_stats.pac_stats.decay_muzzy.npurge))	\
+    OP(muzzy_nmadvise, locked_read_u64_unsynchronized(			\
+        &as->astats.pa_shard_stats.pac_stats.decay_muzzy.nmadvise))	\
+    OP(muzzy_purged, locked_read_u64_unsynchronized(			\
+        &as->astats.pa_shard_stats.pac_stats.decay_muzzy.purged))	\
+    OP(base, as->astats.base)						\
+    OP(internal, atomic_load_zu(&as->astats.internal, ATOMIC_RELAXED))	\
+    OP(metadata_edata, as->astats.metadata_edata)			\
+    OP(metadata_rtree, as->astats.metadata_rtree)			\
+    OP(metadata_thp, as->astats.metadata_thp)				\
+    OP(tcache_bytes, as->astats.tcache_bytes)				\
+    OP(tcache_stashed_bytes, as->astats.tcache_stashed_bytes)		\
+    OP(resident, as->astats.resident)					\
+    OP(abandoned_vm, atomic_load_zu(					\
+        &as->astats.pa_shard_stats.pac_stats.abandoned_vm, ATOMIC_RELAXED))\
+    OP(small_allocated, as->allocated_small)				\
+    OP(small_nmalloc, as->nmalloc_small)				\
+    OP(small_ndalloc, as->ndalloc_small)				\
+    OP(small_nrequests, as->nrequests_small)				\
+    OP(small_nfills, as->nfills_small)					\
+    OP(small_nflushes, as->nflushes_small)				\
+    OP(large_allocated, as->astats.allocated_large)			\
+    OP(large_nmalloc, as->astats.nmalloc_large)				\
+    OP(large_ndalloc, as->astats.ndalloc_large)				\
+    OP(large_nrequests, as->astats.nrequests_large)			\
+    OP(large_nflushes, as->astats.nflushes_large)			\
+    OP(hpa_sec_bytes, as->secstats.bytes)				\
+    OP(hpa_npurge_passes, as->hpastats.nonderived_stats.npurge_passes)	\
+    OP(hpa_npurges, as->hpastats.nonderived_stats.npurges)		\
+    OP(hpa_nhugifies, as->hpastats.nonderived_stats.nhugifies)		\
+    OP(hpa_ndehugifies, as->hpastats.nonderived_stats.ndehugifies)	\
+    OP(hpa_full_npageslabs_nonhuge,					\
+        as->hpastats.psset_stats.full_slabs[0].npageslabs)		\
+    OP(hpa_full_nactive_nonhuge,					\
+        as->hpastats.psset_stats.full_slabs[0].nactive)			\
+    OP(hpa_full_ndirty_nonhuge,						\
+        as->hpastats.psset_stats.full_slabs[0].ndirty)			\
+    OP(hpa_full_npageslabs_huge,					\
+        as->hpastats.psset_stats.full_slabs[1].npageslabs)		\
+    OP(hpa_full_nactive_huge,						\
+        as->hpastats.psset_stats.full_slabs[1].nactive)			\
+    OP(hpa_full_ndirty_huge,						\
+        as->hpastats.psset_stats.full_slabs[1].ndirty)			\
+    OP(hpa_empty_npageslabs_nonhuge,					\
+        as->hpastats.psset_stats.empty_slabs[0].npageslabs)		\
+    OP(hpa_empty_nactive_nonhuge,					\
+        as->hpastats.psset_stats.empty_slabs[0].nactive)		\
+    OP(hpa_empty_ndirty_nonhuge,					\
+        as->hpastats.psset_stats.empty_slabs[0].ndirty)			\
+    OP(hpa_empty_npageslabs_huge,					\
+        as->hpastats.psset_stats.empty_slabs[1].npageslabs)		\
+    OP(hpa_empty_nactive_huge,						\
+        as->hpastats.psset_stats.empty_slabs[1].nactive)		\
+    OP(hpa_empty_ndirty_huge,						\
+        as->hpastats.psset_stats.empty_slabs[1].ndirty)
+
+/* bin_stats_t *b; each bin is followed by its mutex fields. */
+#define CTL_SNAPSHOT_BIN_FIELDS						\
+    OP(nmalloc, b->nmalloc)						\
+    OP(ndalloc, b->ndalloc)						\
+    OP(nrequests, b->nrequests)						\
+    OP(curregs, b->curregs)						\
+    OP(nfills, b->nfills)						\
+    OP(nflushes, b->nflushes)						\
+    OP(nslabs, b->nslabs)						\
+    OP(nreslabs, b->reslabs)						\
+    OP(curslabs, b->curslabs)						\
+    OP(nonfull_slabs, b->nonfull_slabs)					\
+    OP(batch_pops, b->batch_pops)					\
+    OP(batch_failed_pushes, b->batch_failed_pushes)			\
+    OP(batch_pushes, b->batch_pushes)					\
+    OP(batch_pushed_elems, b->batch_pushed_elems)
+
+/* arena_stats_large_t *l. */
+#define CTL_SNAPSHOT_LEXTENT_FIELDS					\
+    OP(nmalloc, locked_read_u64_unsynchronized(&l->nmalloc))		\
+    OP(ndalloc, locked_read_u64_unsynchronized(&l->ndalloc))		\
+    OP(nrequests, locked_read_u64_unsynchronized(&l->nrequests))	\
+    OP(curlextents, l->curlextents)
+
 int ctl_byname(tsd_t *tsd, const char *name, void *oldp, size_t *oldlenp,
     void *newp, size_t newlen);
 int ctl_nametomib(tsd_t *tsd, const char *name, size_t *mibp, size_t *miblenp);
@@ -116,6 +271,17 @@ void ctl_prefork(tsdn_t *tsdn);
 void ctl_postfork_parent(tsdn_t *tsdn);
 void ctl_postfork_child(tsdn_t *tsdn);
 void ctl_mtx_assert_held(tsdn_t *tsdn);
+/*
+ * Acquires ctl_mtx if it is free, for a batch of mallctl() calls by the
+ * calling thread, which then don't lock it again.  Returns true on failure.
+ */
+bool ctl_batch_trylock(tsdn_t *tsdn);
+void ctl_batch_unlock(tsdn_t *tsdn);
+/*
+ * Fills in a stats_ts sample, read from the arenas without refreshing the
+ * stats, unless ctl_mtx is busy (in which case true is returned).
+ */
+bool ctl_stats_ts_sample(tsdn_t *tsdn, stats_ts_sample_t *sample);
 
 #define xmallctl(name, oldp, oldlenp, newp, newlen) do {		\
 	if (je_mallctl(name, oldp, oldlenp, newp, newlen)		\
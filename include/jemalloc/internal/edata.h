@@ -53,6 +53,10 @@ struct e_prof_info_s {
 	nstime_t	e_prof_alloc_time;
 	/* Allocation request size. */
 	size_t		e_prof_alloc_size;
+	/* Sampling level the allocation was sampled at. */
+	unsigned	e_prof_sample_level;
+	/* Allocation tag of the allocating thread. */
+	unsigned	e_prof_alloc_tag;
 	/* Points to a prof_tctx_t. */
 	atomic_p_t	e_prof_tctx;
 	/*
@@ -105,8 +109,12 @@ struct edata_s {
 	 * i: szind
 	 * f: nfree
 	 * s: bin_shard
+	 * h: is_head
+	 * r: nfresh
+	 * q: prefaulted
+	 * l: mlocked
 	 *
-	 * 00000000 ... 0000ssss ssffffff ffffiiii iiiitttg zpcbaaaa aaaaaaaa
+	 * 00000000 ... 0000000l qrrrrrrr rrrhssss ssffffff ffffiiii iiiitttg zpcbaaaa aaaaaaaa
 	 *
 	 * arena_ind: Arena from which this extent came, or all 1 bits if
 	 *            unassociated.
@@ -140,6 +148,22 @@ struct edata_s {
 	 * nfree: Number of free regions in slab.
 	 *
 	 * bin_shard: the shard of the bin from which this extent came.
+	 *
+	 * is_head: Whether the extent is the head of an ehooks allocation.
+	 *
+	 * nfresh: Number of regions at the end of a slab that haven't been
+	 *         handed out since the slab was created from zeroed memory.
+	 *         Regions are allocated lowest-first, so these are exactly
+	 *         the regions that are known to be zero-filled.
+	 *
+	 * prefaulted: Whether a retained extent was mapped and prefaulted
+	 *             ahead of demand (see pac_retained_deficit()).  Only
+	 *             retained extents have it set, and they only coalesce
+	 *             with extents that agree on it.
+	 *
+	 * mlocked: Whether (part of) the extent may be locked into memory by
+	 *          the mlock prefault mode, and so has to be unlocked before
+	 *          it can be purged.
 	 */
 	uint64_t		e_bits;
 #define MASK(CURRENT_FIELD_WIDTH, CURRENT_FIELD_SHIFT) ((((((uint64_t)0x1U) << (CURRENT_FIELD_WIDTH)) - 1)) << (CURRENT_FIELD_SHIFT))
@@ -188,6 +212,18 @@ struct edata_s {
 #define EDATA_BITS_IS_HEAD_SHIFT  (EDATA_BITS_BINSHARD_WIDTH + EDATA_BITS_BINSHARD_SHIFT)
 #define EDATA_BITS_IS_HEAD_MASK  MASK(EDATA_BITS_IS_HEAD_WIDTH, EDATA_BITS_IS_HEAD_SHIFT)
 
+#define EDATA_BITS_NFRESH_WIDTH  (SC_LG_SLAB_MAXREGS + 1)
+#define EDATA_BITS_NFRESH_SHIFT  (EDATA_BITS_IS_HEAD_WIDTH + EDATA_BITS_IS_HEAD_SHIFT)
+#define EDATA_BITS_NFRESH_MASK  MASK(EDATA_BITS_NFRESH_WIDTH, EDATA_BITS_NFRESH_SHIFT)
+
+#define EDATA_BITS_PREFAULTED_WIDTH  1
+#define EDATA_BITS_PREFAULTED_SHIFT  (EDATA_BITS_NFRESH_WIDTH + EDATA_BITS_NFRESH_SHIFT)
+#define EDATA_BITS_PREFAULTED_MASK  MASK(EDATA_BITS_PREFAULTED_WIDTH, EDATA_BITS_PREFAULTED_SHIFT)
+
+#define EDATA_BITS_MLOCKED_WIDTH  1
+#define EDATA_BITS_MLOCKED_SHIFT  (EDATA_BITS_PREFAULTED_WIDTH + EDATA_BITS_PREFAULTED_SHIFT)
+#define EDATA_BITS_MLOCKED_MASK  MASK(EDATA_BITS_MLOCKED_WIDTH, EDATA_BITS_MLOCKED_SHIFT)
+
 	/* Pointer to the extent that this structure is responsible for. */
 	void			*e_addr;
 
@@ -315,6 +351,18 @@ edata_zeroed_get(const edata_t *edata) {
 	    EDATA_BITS_ZEROED_SHIFT);
 }
 
+static inline bool
+edata_prefaulted_get(const edata_t *edata) {
+	return (bool)((edata->e_bits & EDATA_BITS_PREFAULTED_MASK) >>
+	    EDATA_BITS_PREFAULTED_SHIFT);
+}
+
+static inline bool
+edata_mlocked_get(const edata_t *edata) {
+	return (bool)((edata->e_bits & EDATA_BITS_MLOCKED_MASK) >>
+	    EDATA_BITS_MLOCKED_SHIFT);
+}
+
 static inline bool
 edata_committed_get(const edata_t *edata) {
 	return (bool)((edata->e_bits & EDATA_BITS_COMMITTED_MASK) >>
@@ -340,6 +388,13 @@ edata_nfree_get(const edata_t *edata) {
 	    EDATA_BITS_NFREE_SHIFT);
 }
 
+static inline unsigned
+edata_nfresh_get(const edata_t *edata) {
+	assert(edata_slab_get(edata));
+	return (unsigned)((edata->e_bits & EDATA_BITS_NFRESH_MASK) >>
+	    EDATA_BITS_NFRESH_SHIFT);
+}
+
 static inline void *
 edata_base_get(const edata_t *edata) {
 	assert(edata->e_addr == PAGE_ADDR2BASE(edata->e_addr) ||
@@ -420,6 +475,16 @@ edata_prof_alloc_size_get(const edata_t *edata) {
 	return edata->e_prof_info.e_prof_alloc_size;
 }
 
+static inline unsigned
+edata_prof_sample_level_get(const edata_t *edata) {
+	return edata->e_prof_info.e_prof_sample_level;
+}
+
+static inline unsigned
+edata_prof_alloc_tag_get(const edata_t *edata) {
+	return edata->e_prof_info.e_prof_alloc_tag;
+}
+
 static inline prof_recent_t *
 edata_prof_recent_alloc_get_dont_call_directly(const edata_t *edata) {
 	return (prof_recent_t *)atomic_load_p(
@@ -492,6 +557,13 @@ edata_nfree_binshard_set(edata_t *edata, unsigned nfree, unsigned binshard) {
 	    ((uint64_t)nfree << EDATA_BITS_NFREE_SHIFT);
 }
 
+static inline void
+edata_nfresh_set(edata_t *edata, unsigned nfresh) {
+	assert(edata_slab_get(edata));
+	edata->e_bits = (edata->e_bits & ~EDATA_BITS_NFRESH_MASK) |
+	    ((uint64_t)nfresh << EDATA_BITS_NFRESH_SHIFT);
+}
+
 static inline void
 edata_nfree_inc(edata_t *edata) {
 	assert(edata_slab_get(edata));
@@ -533,6 +605,18 @@ edata_zeroed_set(edata_t *edata, bool zeroed) {
 	    ((uint64_t)zeroed << EDATA_BITS_ZEROED_SHIFT);
 }
 
+static inline void
+edata_prefaulted_set(edata_t *edata, bool prefaulted) {
+	edata->e_bits = (edata->e_bits & ~EDATA_BITS_PREFAULTED_MASK) |
+	    ((uint64_t)prefaulted << EDATA_BITS_PREFAULTED_SHIFT);
+}
+
+static inline void
+edata_mlocked_set(edata_t *edata, bool mlocked) {
+	edata->e_bits = (edata->e_bits & ~EDATA_BITS_MLOCKED_MASK) |
+	    ((uint64_t)mlocked << EDATA_BITS_MLOCKED_SHIFT);
+}
+
 static inline void
 edata_committed_set(edata_t *edata, bool committed) {
 	edata->e_bits = (edata->e_bits & ~EDATA_BITS_COMMITTED_MASK) |
@@ -566,6 +650,16 @@ edata_prof_alloc_size_set(edata_t *edata, size_t size) {
 	edata->e_prof_info.e_prof_alloc_size = size;
 }
 
+static inline void
+edata_prof_sample_level_set(edata_t *edata, unsigned level) {
+	edata->e_prof_info.e_prof_sample_level = level;
+}
+
+static inline void
+edata_prof_alloc_tag_set(edata_t *edata, unsigned tag) {
+	edata->e_prof_info.e_prof_alloc_tag = tag;
+}
+
 static inline void
 edata_prof_recent_alloc_set_dont_call_directly(edata_t *edata,
     prof_recent_t *recent_alloc) {
@@ -613,6 +707,8 @@ edata_init(edata_t *edata, unsigned arena_ind, void *addr, size_t size,
 	edata_guarded_set(edata, false);
 	edata_zeroed_set(edata, zeroed);
 	edata_committed_set(edata, committed);
+	edata_prefaulted_set(edata, false);
+	edata_mlocked_set(edata, false);
 	edata_pai_set(edata, pai);
 	edata_is_head_set(edata, is_head == EXTENT_IS_HEAD);
 	if (config_prof) {
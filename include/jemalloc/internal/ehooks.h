@@ -4,6 +4,7 @@
 #include "jemalloc/internal/jemalloc_preamble.h"
 #include "jemalloc/internal/atomic.h"
 #include "jemalloc/internal/extent_mmap.h"
+#include "jemalloc/internal/nontemporal.h"
 #include "jemalloc/internal/tsd.h"
 #include "jemalloc/internal/tsd_types.h"
 
@@ -376,9 +377,10 @@ ehooks_zero(tsdn_t *tsdn, ehooks_t *ehooks, void *addr, size_t size) {
 		 * It would be correct to try using the user-provided purge
 		 * hooks (since they are required to have zeroed the extent if
 		 * they indicate success), but we don't necessarily know their
-		 * cost.  We'll be conservative and use memset.
+		 * cost.  We'll be conservative and zero the memory ourselves,
+		 * with non-temporal stores when it is large.
 		 */
-		memset(addr, 0, size);
+		nontemporal_zero(addr, size);
 	}
 }
 
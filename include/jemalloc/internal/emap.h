@@ -207,6 +207,7 @@ extent_assert_can_coalesce(const edata_t *inner, const edata_t *outer) {
 	assert(edata_arena_ind_get(inner) == edata_arena_ind_get(outer));
 	assert(edata_pai_get(inner) == edata_pai_get(outer));
 	assert(edata_committed_get(inner) == edata_committed_get(outer));
+	assert(edata_prefaulted_get(inner) == edata_prefaulted_get(outer));
 	assert(edata_state_get(inner) == extent_state_active);
 	assert(edata_state_get(outer) == extent_state_merging);
 	assert(!edata_guarded_get(inner) && !edata_guarded_get(outer));
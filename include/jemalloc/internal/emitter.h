@@ -11,7 +11,16 @@ typedef enum emitter_output_e emitter_output_t;
 enum emitter_output_e {
 	emitter_output_json,
 	emitter_output_json_compact,
-	emitter_output_table
+	emitter_output_table,
+	/*
+	 * OpenMetrics text exposition.  Follows the json structure: every
+	 * numeric or bool value becomes a sample, named after the json keys
+	 * leading to it (e.g. jemalloc_stats_allocated); strings are omitted.
+	 * See emitter_openmetrics_label() for labels.  Samples are buffered
+	 * until emitter_end(), which writes them family by family, each under
+	 * its TYPE line; see emitter_openmetrics_counter_set() for the types.
+	 */
+	emitter_output_openmetrics
 };
 
 typedef enum emitter_justify_e emitter_justify_t;
@@ -68,6 +77,51 @@ struct emitter_row_s {
 	ql_head(emitter_col_t) cols;
 };
 
+/* Maximum json nesting depth for OpenMetrics output. */
+#define EMITTER_OPENMETRICS_DEPTH_MAX 10
+#define EMITTER_OPENMETRICS_NAME_MAX 256
+#define EMITTER_OPENMETRICS_LABELS_MAX 64
+
+/* An object or array enclosing the values emitted in OpenMetrics mode. */
+typedef struct emitter_om_frame_s emitter_om_frame_t;
+struct emitter_om_frame_s {
+	/* The key it was emitted under, or NULL (e.g. for array elements). */
+	const char *key;
+	/* Its labels, e.g. arena="0"; empty if none. */
+	char labels[EMITTER_OPENMETRICS_LABELS_MAX];
+};
+
+/* Returns true if the given OpenMetrics family is a counter, not a gauge. */
+typedef bool (emitter_openmetrics_counter_t)(const char *family);
+
+typedef struct emitter_om_family_s emitter_om_family_t;
+struct emitter_om_family_s {
+	/* Offset of the name in the sample buffer. */
+	size_t name;
+	bool counter;
+	/* Offsets of the first and last samples, chained in the buffer. */
+	size_t head;
+	size_t tail;
+};
+
+/* The OpenMetrics samples buffered so far, grouped by family. */
+typedef struct emitter_om_s emitter_om_t;
+struct emitter_om_s {
+	emitter_openmetrics_counter_t *counter;
+	/* Family names and samples, allocated internally. */
+	char *buf;
+	size_t buf_size;
+	size_t buf_used;
+	/* The families, in order of first appearance. */
+	emitter_om_family_t *families;
+	size_t nfamilies;
+	size_t families_size;
+	/* Where the family lookup starts; usually the next sample's family. */
+	size_t last_family;
+	/* Set when buffering failed; the samples are then dropped. */
+	bool oom;
+};
+
 typedef struct emitter_s emitter_t;
 struct emitter_s {
 	emitter_output_t output;
@@ -79,8 +133,16 @@ struct emitter_s {
 	bool item_at_depth;
 	/* True if we emitted a key and will emit corresponding value next. */
 	bool emitted_key;
+	/* OpenMetrics only: the pending key, and the enclosing frames. */
+	const char *om_key;
+	emitter_om_frame_t om_frames[EMITTER_OPENMETRICS_DEPTH_MAX];
+	emitter_om_t om;
 };
 
+void emitter_om_sample(emitter_t *emitter, emitter_type_t value_type,
+    const void *value);
+void emitter_om_flush(emitter_t *emitter);
+
 static inline bool
 emitter_outputs_json(emitter_t *emitter) {
 	return emitter->output == emitter_output_json ||
@@ -239,6 +301,17 @@ emitter_json_key_prefix(emitter_t *emitter) {
 	}
 }
 
+/* Internal.  In OpenMetrics mode, enters an object or array. */
+static inline void
+emitter_om_push(emitter_t *emitter) {
+	assert(emitter->nesting_depth < EMITTER_OPENMETRICS_DEPTH_MAX - 1);
+	emitter_nest_inc(emitter);
+	emitter_om_frame_t *frame = &emitter->om_frames[emitter->nesting_depth];
+	frame->key = emitter->om_key;
+	frame->labels[0] = '\0';
+	emitter->om_key = NULL;
+}
+
 /******************************************************************************/
 /* Public functions for emitter_t. */
 
@@ -251,6 +324,18 @@ emitter_init(emitter_t *emitter, emitter_output_t emitter_output,
 	emitter->item_at_depth = false;
 	emitter->emitted_key = false;
 	emitter->nesting_depth = 0;
+	emitter->om_key = NULL;
+	memset(&emitter->om, 0, sizeof(emitter->om));
+}
+
+/*
+ * OpenMetrics only: sets the predicate telling which families are counters;
+ * their samples get the _total suffix.  The others are gauges.
+ */
+static inline void
+emitter_openmetrics_counter_set(emitter_t *emitter,
+    emitter_openmetrics_counter_t *counter) {
+	emitter->om.counter = counter;
 }
 
 /******************************************************************************/
@@ -267,6 +352,8 @@ emitter_json_key(emitter_t *emitter, const char *json_key) {
 		emitter_printf(emitter, "\"%s\":%s", json_key,
 		    emitter->output == emitter_output_json_compact ? "" : " ");
 		emitter->emitted_key = true;
+	} else if (emitter->output == emitter_output_openmetrics) {
+		emitter->om_key = json_key;
 	}
 }
 
@@ -278,6 +365,8 @@ emitter_json_value(emitter_t *emitter, emitter_type_t value_type,
 		emitter_print_value(emitter, emitter_justify_none, -1,
 		    value_type, value);
 		emitter->item_at_depth = true;
+	} else if (emitter->output == emitter_output_openmetrics) {
+		emitter_om_sample(emitter, value_type, value);
 	}
 }
 
@@ -295,6 +384,8 @@ emitter_json_array_begin(emitter_t *emitter) {
 		emitter_json_key_prefix(emitter);
 		emitter_printf(emitter, "[");
 		emitter_nest_inc(emitter);
+	} else if (emitter->output == emitter_output_openmetrics) {
+		emitter_om_push(emitter);
 	}
 }
 
@@ -315,6 +406,9 @@ emitter_json_array_end(emitter_t *emitter) {
 			emitter_indent(emitter);
 		}
 		emitter_printf(emitter, "]");
+	} else if (emitter->output == emitter_output_openmetrics) {
+		assert(emitter->nesting_depth > 0);
+		emitter_nest_dec(emitter);
 	}
 }
 
@@ -324,6 +418,8 @@ emitter_json_object_begin(emitter_t *emitter) {
 		emitter_json_key_prefix(emitter);
 		emitter_printf(emitter, "{");
 		emitter_nest_inc(emitter);
+	} else if (emitter->output == emitter_output_openmetrics) {
+		emitter_om_push(emitter);
 	}
 }
 
@@ -344,9 +440,51 @@ emitter_json_object_end(emitter_t *emitter) {
 			emitter_indent(emitter);
 		}
 		emitter_printf(emitter, "}");
+	} else if (emitter->output == emitter_output_openmetrics) {
+		assert(emitter->nesting_depth > 0);
+		emitter_nest_dec(emitter);
 	}
 }
 
+/*
+ * Labels the OpenMetrics samples emitted within the current object or array
+ * label_name="value".  Such an object is identified by its labels rather than
+ * by its key, which is then left out of the sample names; e.g. the per arena
+ * stats objects, keyed by arena index, carry arena="<index>".  Does nothing for
+ * the other outputs.
+ */
+static inline void
+emitter_openmetrics_label(emitter_t *emitter, const char *label_name,
+    emitter_type_t value_type, const void *value) {
+	if (emitter->output != emitter_output_openmetrics) {
+		return;
+	}
+	assert(emitter->nesting_depth > 0);
+	char *labels = emitter->om_frames[emitter->nesting_depth].labels;
+	size_t len = strlen(labels);
+	size_t size = EMITTER_OPENMETRICS_LABELS_MAX - len;
+	const char *sep = (len == 0) ? "" : ",";
+	size_t written;
+	switch (value_type) {
+	case emitter_type_string:
+		written = malloc_snprintf(&labels[len], size, "%s%s=\"%s\"",
+		    sep, label_name, *(const char *const *)value);
+		break;
+	case emitter_type_unsigned:
+		written = malloc_snprintf(&labels[len], size, "%s%s=\"%u\"",
+		    sep, label_name, *(const unsigned *)value);
+		break;
+	case emitter_type_size:
+		written = malloc_snprintf(&labels[len], size, "%s%s=\"%zu\"",
+		    sep, label_name, *(const size_t *)value);
+		break;
+	default:
+		unreachable();
+	}
+	/* We control the labels; they shouldn't come near the limit. */
+	assert(written < size);
+}
+
 
 /******************************************************************************/
 /* Table public API. */
@@ -438,6 +576,15 @@ emitter_col_init(emitter_col_t *col, emitter_row_t *row) {
  * Generalized public API. Emits using either JSON or table, according to
  * settings in the emitter_t. */
 
+/*
+ * The json and OpenMetrics outputs follow the json keys, the table output the
+ * table keys.
+ */
+static inline bool
+emitter_outputs_json_keys(emitter_t *emitter) {
+	return emitter->output != emitter_output_table;
+}
+
 /*
  * Note emits a different kv pair as well, but only in table mode.  Omits the
  * note if table_note_key is NULL.
@@ -447,7 +594,7 @@ emitter_kv_note(emitter_t *emitter, const char *json_key, const char *table_key,
     emitter_type_t value_type, const void *value,
     const char *table_note_key, emitter_type_t table_note_value_type,
     const void *table_note_value) {
-	if (emitter_outputs_json(emitter)) {
+	if (emitter_outputs_json_keys(emitter)) {
 		emitter_json_key(emitter, json_key);
 		emitter_json_value(emitter, value_type, value);
 	} else {
@@ -467,7 +614,7 @@ emitter_kv(emitter_t *emitter, const char *json_key, const char *table_key,
 static inline void
 emitter_dict_begin(emitter_t *emitter, const char *json_key,
     const char *table_header) {
-	if (emitter_outputs_json(emitter)) {
+	if (emitter_outputs_json_keys(emitter)) {
 		emitter_json_key(emitter, json_key);
 		emitter_json_object_begin(emitter);
 	} else {
@@ -477,7 +624,7 @@ emitter_dict_begin(emitter_t *emitter, const char *json_key,
 
 static inline void
 emitter_dict_end(emitter_t *emitter) {
-	if (emitter_outputs_json(emitter)) {
+	if (emitter_outputs_json_keys(emitter)) {
 		emitter_json_object_end(emitter);
 	} else {
 		emitter_table_dict_end(emitter);
@@ -491,6 +638,10 @@ emitter_begin(emitter_t *emitter) {
 		emitter_printf(emitter, "{");
 		emitter_nest_inc(emitter);
 	} else {
+		if (emitter->output == emitter_output_openmetrics) {
+			assert(emitter->nesting_depth == 0);
+			emitter_om_push(emitter);
+		}
 		/*
 		 * This guarantees that we always call write_cb at least once.
 		 * This is useful if some invariant is established by each call
@@ -508,6 +659,11 @@ emitter_end(emitter_t *emitter) {
 		emitter_nest_dec(emitter);
 		emitter_printf(emitter, "%s", emitter->output ==
 		    emitter_output_json_compact ? "}" : "\n}\n");
+	} else if (emitter->output == emitter_output_openmetrics) {
+		assert(emitter->nesting_depth == 1);
+		emitter_nest_dec(emitter);
+		emitter_om_flush(emitter);
+		emitter_printf(emitter, "# EOF\n");
 	}
 }
 
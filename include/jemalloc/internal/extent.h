@@ -40,6 +40,13 @@ void extent_dalloc_gap(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
 edata_t *extent_alloc_wrapper(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
     void *new_addr, size_t size, size_t alignment, bool zero, bool *commit,
     bool growing_retained);
+/*
+ * Maps (at least) size bytes of new memory, prefaults it according to the
+ * pac's prefault mode, and puts it into the retained ecache ahead of demand.
+ * Returns true on failure.
+ */
+bool extent_grow_retained_ahead(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
+    size_t size);
 void extent_dalloc_wrapper(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
     edata_t *edata);
 void extent_destroy_wrapper(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
@@ -109,6 +116,14 @@ extent_can_acquire_neighbor(edata_t *edata, rtree_contents_t contents,
 			 */
 			return false;
 		}
+		if (!expanding && (edata_prefaulted_get(edata) !=
+		    edata_prefaulted_get(neighbor))) {
+			/*
+			 * Keep the prefaulted reserve separate from purged
+			 * retained memory.
+			 */
+			return false;
+		}
 	} else {
 		if (neighbor_state == extent_state_active) {
 			return false;
@@ -0,0 +1,48 @@
+#ifndef JEMALLOC_INTERNAL_EXTENT_HUGETLB_H
+#define JEMALLOC_INTERNAL_EXTENT_HUGETLB_H
+
+#include "jemalloc/internal/jemalloc_preamble.h"
+
+/*
+ * Built-in extent hooks that back extents with explicit (hugetlb) huge pages,
+ * either anonymously via MAP_HUGETLB or through a file on a hugetlbfs mount.
+ * Requests that can't be satisfied from the huge page pool (or whose geometry
+ * doesn't fit the huge page size) fall back to normal pages.
+ */
+
+typedef enum {
+	hugetlb_mode_disabled = 0,
+	hugetlb_mode_2m       = 1,
+	hugetlb_mode_1g       = 2,
+
+	hugetlb_mode_limit    = 3
+} hugetlb_mode_t;
+#define HUGETLB_MODE_DEFAULT hugetlb_mode_disabled
+
+#define LG_HUGETLB_2M 21
+#define LG_HUGETLB_1G 30
+
+extern const char *const hugetlb_mode_names[];
+
+extern hugetlb_mode_t opt_hugetlb;
+extern char opt_hugetlb_path[PATH_MAX + 1];
+
+/*
+ * Returns the hooks implementing the given mode (the default hooks for
+ * hugetlb_mode_disabled), or NULL if the mode isn't supported on this system.
+ */
+extent_hooks_t *extent_hugetlb_hooks_get(hugetlb_mode_t mode);
+/*
+ * Returns the mode implemented by extent_hooks, or hugetlb_mode_limit if they
+ * are neither the default nor the built-in hugetlb hooks.
+ */
+hugetlb_mode_t extent_hugetlb_mode_get(const extent_hooks_t *extent_hooks);
+/*
+ * Returns the size that extents allocated through extent_hooks should be
+ * multiples of in order to be backed by huge pages (PAGE for anything but the
+ * built-in hugetlb hooks).
+ */
+size_t extent_hugetlb_granularity(const extent_hooks_t *extent_hooks);
+void extent_hugetlb_boot(void);
+
+#endif /* JEMALLOC_INTERNAL_EXTENT_HUGETLB_H */
@@ -2,11 +2,12 @@
 #define JEMALLOC_INTERNAL_EXTENT_MMAP_EXTERNS_H
 
 #include "jemalloc/internal/jemalloc_preamble.h"
+#include "jemalloc/internal/pages.h"
 
 extern bool opt_retain;
 
-void *extent_alloc_mmap(void *new_addr, size_t size, size_t alignment,
-    bool *zero, bool *commit);
-bool extent_dalloc_mmap(void *addr, size_t size);
+void *extent_alloc_mmap(pages_caller_t caller, void *new_addr, size_t size,
+    size_t alignment, bool *zero, bool *commit);
+bool extent_dalloc_mmap(pages_caller_t caller, void *addr, size_t size);
 
 #endif /* JEMALLOC_INTERNAL_EXTENT_MMAP_EXTERNS_H */
@@ -157,6 +157,9 @@ bool hpa_shard_init(hpa_shard_t *shard, hpa_central_t *central, emap_t *emap,
 void hpa_shard_stats_accum(hpa_shard_stats_t *dst, hpa_shard_stats_t *src);
 void hpa_shard_stats_merge(tsdn_t *tsdn, hpa_shard_t *shard,
     hpa_shard_stats_t *dst);
+/* As above, but only the (much cheaper to read) nonderived stats. */
+void hpa_shard_nonderived_stats_merge(tsdn_t *tsdn, hpa_shard_t *shard,
+    hpa_shard_nonderived_stats_t *dst);
 
 /*
  * Notify the shard that we won't use it for allocations much longer.  Due to
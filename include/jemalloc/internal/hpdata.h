@@ -118,6 +118,14 @@ struct hpdata_s {
 
 	/* The touched pages (using the same definition as above). */
 	fb_group_t touched_pages[FB_NGROUPS(HUGEPAGE_PAGES)];
+
+	/*
+	 * The pages known to read back as zeros: those that haven't been handed
+	 * out since the hugepage was mapped or since they were last purged.
+	 * Only meaningful for inactive pages; bits are cleared once an
+	 * allocation covering them is freed.
+	 */
+	fb_group_t zeroed_pages[FB_NGROUPS(HUGEPAGE_PAGES)];
 };
 
 TYPED_LIST(hpdata_empty_list, hpdata_t, ql_link_empty)
@@ -363,6 +371,11 @@ void hpdata_init(hpdata_t *hpdata, void *addr, uint64_t age);
  */
 void *hpdata_reserve_alloc(hpdata_t *hpdata, size_t sz);
 void hpdata_unreserve(hpdata_t *hpdata, void *addr, size_t sz);
+/*
+ * Returns whether every page of the (just reserved) range is known to be
+ * zero-filled.
+ */
+bool hpdata_range_zeroed(hpdata_t *hpdata, void *addr, size_t sz);
 
 /*
  * The hpdata_purge_prepare_t allows grabbing the metadata required to purge
@@ -375,6 +388,12 @@ struct hpdata_purge_state_s {
 	size_t ndirty_to_purge;
 	fb_group_t to_purge[FB_NGROUPS(HUGEPAGE_PAGES)];
 	size_t next_purge_search_begin;
+	/*
+	 * Whether all the purges zeroed their ranges.  The caller clears this
+	 * if one of them fails, in which case the purged pages aren't marked
+	 * as known-zero.
+	 */
+	bool purged_zeroed;
 };
 
 /*
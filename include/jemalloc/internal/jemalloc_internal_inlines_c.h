@@ -8,6 +8,7 @@
 #include "jemalloc/internal/hook.h"
 #include "jemalloc/internal/jemalloc_internal_types.h"
 #include "jemalloc/internal/log.h"
+#include "jemalloc/internal/nontemporal.h"
 #include "jemalloc/internal/sz.h"
 #include "jemalloc/internal/thread_event.h"
 #include "jemalloc/internal/witness.h"
@@ -194,7 +195,7 @@ iralloct_realign(tsdn_t *tsdn, void *ptr, size_t oldsize, size_t size,
 	 * expectation that the extra bytes will be reliably preserved.
 	 */
 	copysize = (size < oldsize) ? size : oldsize;
-	memcpy(p, ptr, copysize);
+	nontemporal_copy(p, ptr, copysize);
 	hook_invoke_alloc(hook_args->is_realloc
 	    ? hook_alloc_realloc : hook_alloc_rallocx, p, (uintptr_t)p,
 	    hook_args->args);
@@ -0,0 +1,139 @@
+#ifndef JEMALLOC_INTERNAL_LATENCY_H
+#define JEMALLOC_INTERNAL_LATENCY_H
+
+#include "jemalloc/internal/jemalloc_preamble.h"
+#include "jemalloc/internal/atomic.h"
+#include "jemalloc/internal/bit_util.h"
+#include "jemalloc/internal/nstime.h"
+#include "jemalloc/internal/stat_u64.h"
+#include "jemalloc/internal/tsd_types.h"
+
+/*
+ * Latency histograms for the tiers of the allocation and deallocation paths,
+ * enabled by opt.stats_latency and read through stats.latency.<tier>.*.
+ *
+ * The malloc() / free() tiers are split by whether the call was served by the
+ * fast path, and are timed for one call in 2^opt.lg_stats_latency_sample per
+ * thread, so that the clock reads stay off of most fast path calls.  The inner
+ * tiers are timed only within those sampled calls (see tsd latency_sampled),
+ * so that they are sampled at the same rate, and nest consistently; e.g.
+ * arena_cache_bin_fill_small time is also counted in tcache_alloc_small_hard
+ * and malloc_slowpath.
+ *
+ * The histograms are kept per arena, in that of the sampled thread, and summed
+ * up by ctl when read.
+ */
+#define LATENCY_TIERS							\
+    OP(malloc_fastpath)							\
+    OP(malloc_slowpath)							\
+    OP(tcache_alloc_small_hard)						\
+    OP(arena_cache_bin_fill_small)					\
+    OP(large_alloc)							\
+    OP(extent_grow_retained)						\
+    OP(free_fastpath)							\
+    OP(free_slowpath)							\
+    OP(tcache_bin_flush_small)						\
+    OP(large_dalloc)							\
+    OP(extent_dalloc)
+
+typedef enum {
+#define OP(tier) latency_tier_##tier,
+	LATENCY_TIERS
+#undef OP
+	latency_num_tiers
+} latency_tier_t;
+
+extern const char *const latency_tier_names[latency_num_tiers];
+
+/*
+ * Bucket i counts latencies in [2^i, 2^(i+1)) ns, except that the first bucket
+ * starts at 0, and the last one is unbounded.
+ */
+#define LATENCY_NBUCKETS 32
+
+typedef struct latency_hist_s latency_hist_t;
+struct latency_hist_s {
+	/*
+	 * Tiers are updated concurrently by the threads of an arena; keep them
+	 * on separate cachelines.
+	 */
+	JEMALLOC_ALIGNED(CACHELINE)
+	stat_u64_t nsamples;
+	stat_u64_t total_ns;
+	stat_u64_t buckets[LATENCY_NBUCKETS];
+};
+
+/* A sum of latency_hist_t copies, as read by latency_hist_merge(). */
+typedef struct latency_stats_s latency_stats_t;
+struct latency_stats_s {
+	uint64_t nsamples;
+	uint64_t total_ns;
+	uint64_t buckets[LATENCY_NBUCKETS];
+};
+
+extern bool opt_stats_latency;
+extern size_t opt_lg_stats_latency_sample;
+
+#define LG_STATS_LATENCY_SAMPLE_DEFAULT 10
+
+uint64_t latency_begin_sampled(tsdn_t *tsdn);
+void latency_record(tsdn_t *tsdn, latency_tier_t tier, uint64_t ns);
+/* Adds hist to stats; not a consistent snapshot of hist. */
+void latency_hist_merge(latency_hist_t *hist, latency_stats_t *stats);
+void latency_stats_merge(latency_stats_t *dst, const latency_stats_t *src);
+/*
+ * Returns the upper bound of the bucket containing the q quantile (or the lower
+ * bound, for the last, unbounded bucket).
+ */
+uint64_t latency_quantile(const latency_stats_t *stats, double q);
+
+/*
+ * nstime_update() may be backed by a coarse clock (with ms resolution), which
+ * is useless here; read the precise one directly where possible.  On Linux it
+ * is a vDSO read of the TSC, with the scaling to ns already done.
+ */
+JEMALLOC_ALWAYS_INLINE uint64_t
+latency_now(void) {
+#if defined(JEMALLOC_HAVE_CLOCK_MONOTONIC) && !defined(_WIN32)
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) +
+	    (uint64_t)ts.tv_nsec;
+#else
+	nstime_t now;
+	nstime_init_update(&now);
+	return nstime_ns(&now);
+#endif
+}
+
+/*
+ * Starts timing an inner tier; returns 0 if latency stats are disabled, or if
+ * the thread isn't in a sampled malloc() / free() call.
+ */
+JEMALLOC_ALWAYS_INLINE uint64_t
+latency_begin(tsdn_t *tsdn) {
+	if (!config_stats || likely(!opt_stats_latency)) {
+		return 0;
+	}
+	return latency_begin_sampled(tsdn);
+}
+
+JEMALLOC_ALWAYS_INLINE void
+latency_end(tsdn_t *tsdn, latency_tier_t tier, uint64_t start) {
+	if (start == 0) {
+		return;
+	}
+	uint64_t now = latency_now();
+	latency_record(tsdn, tier, (now > start) ? now - start : 0);
+}
+
+JEMALLOC_ALWAYS_INLINE unsigned
+latency_bucket(uint64_t ns) {
+	if (ns >= (UINT64_C(1) << (LATENCY_NBUCKETS - 1))) {
+		return LATENCY_NBUCKETS - 1;
+	}
+	return (ns <= 1) ? 0 : lg_floor((size_t)ns);
+}
+
+#endif /* JEMALLOC_INTERNAL_LATENCY_H */
@@ -92,8 +92,8 @@ struct malloc_mutex_s {
 #endif
 
 #define LOCK_PROF_DATA_INITIALIZER					\
-    {NSTIME_ZERO_INITIALIZER, NSTIME_ZERO_INITIALIZER, 0, 0, 0,		\
-	    ATOMIC_INIT(0), 0, NULL, 0}
+    {NSTIME_ZERO_INITIALIZER, NSTIME_ZERO_INITIALIZER, 0, 0, {0}, 0,	\
+	    ATOMIC_INIT(0), 0, NULL, 0, ATOMIC_INIT(NULL)}
 
 #ifdef _WIN32
 #  define MALLOC_MUTEX_INITIALIZER
@@ -160,7 +160,8 @@ malloc_mutex_trylock_final(malloc_mutex_t *mutex) {
 }
 
 static inline void
-mutex_owner_stats_update(tsdn_t *tsdn, malloc_mutex_t *mutex) {
+mutex_owner_stats_update(tsdn_t *tsdn, malloc_mutex_t *mutex,
+    const char *site) {
 	if (config_stats) {
 		mutex_prof_data_t *data = &mutex->prof_data;
 		data->n_lock_ops++;
@@ -168,18 +169,32 @@ mutex_owner_stats_update(tsdn_t *tsdn, malloc_mutex_t *mutex) {
 			data->prev_owner = tsdn;
 			data->n_owner_switches++;
 		}
+		if (unlikely(opt_mutex_prof_holders)) {
+			atomic_store_p(&data->holder_site, (void *)site,
+			    ATOMIC_RELAXED);
+		}
 	}
 }
 
+/*
+ * The lock / trylock wrappers pass the calling function's name along, to
+ * identify mutex holders for opt_mutex_prof_holders.
+ */
+#define malloc_mutex_trylock(tsdn, mutex)				\
+    malloc_mutex_trylock_impl(tsdn, mutex, __func__)
+#define malloc_mutex_lock(tsdn, mutex)					\
+    malloc_mutex_lock_impl(tsdn, mutex, __func__)
+
 /* Trylock: return false if the lock is successfully acquired. */
 static inline bool
-malloc_mutex_trylock(tsdn_t *tsdn, malloc_mutex_t *mutex) {
+malloc_mutex_trylock_impl(tsdn_t *tsdn, malloc_mutex_t *mutex,
+    const char *site) {
 	witness_assert_not_owner(tsdn_witness_tsdp_get(tsdn), &mutex->witness);
 	if (isthreaded) {
 		if (malloc_mutex_trylock_final(mutex)) {
 			return true;
 		}
-		mutex_owner_stats_update(tsdn, mutex);
+		mutex_owner_stats_update(tsdn, mutex, site);
 	}
 	witness_lock(tsdn_witness_tsdp_get(tsdn), &mutex->witness);
 
@@ -196,6 +211,9 @@ malloc_mutex_prof_merge(mutex_prof_data_t *sum, mutex_prof_data_t *data) {
 
 	sum->n_wait_times += data->n_wait_times;
 	sum->n_spin_acquired += data->n_spin_acquired;
+	for (unsigned i = 0; i < MUTEX_PROF_WAIT_NBUCKETS; i++) {
+		sum->wait_hist[i] += data->wait_hist[i];
+	}
 
 	if (sum->max_n_thds < data->max_n_thds) {
 		sum->max_n_thds = data->max_n_thds;
@@ -211,14 +229,14 @@ malloc_mutex_prof_merge(mutex_prof_data_t *sum, mutex_prof_data_t *data) {
 }
 
 static inline void
-malloc_mutex_lock(tsdn_t *tsdn, malloc_mutex_t *mutex) {
+malloc_mutex_lock_impl(tsdn_t *tsdn, malloc_mutex_t *mutex, const char *site) {
 	witness_assert_not_owner(tsdn_witness_tsdp_get(tsdn), &mutex->witness);
 	if (isthreaded) {
 		if (malloc_mutex_trylock_final(mutex)) {
 			malloc_mutex_lock_slow(mutex);
 			atomic_store_b(&mutex->locked, true, ATOMIC_RELAXED);
 		}
-		mutex_owner_stats_update(tsdn, mutex);
+		mutex_owner_stats_update(tsdn, mutex, site);
 	}
 	witness_lock(tsdn_witness_tsdp_get(tsdn), &mutex->witness);
 }
@@ -276,6 +294,9 @@ malloc_mutex_prof_accum(tsdn_t *tsdn, mutex_prof_data_t *data,
 	}
 	data->n_wait_times += source->n_wait_times;
 	data->n_spin_acquired += source->n_spin_acquired;
+	for (unsigned i = 0; i < MUTEX_PROF_WAIT_NBUCKETS; i++) {
+		data->wait_hist[i] += source->wait_hist[i];
+	}
 	if (data->max_n_thds < source->max_n_thds) {
 		data->max_n_thds = source->max_n_thds;
 	}
@@ -305,6 +326,11 @@ malloc_mutex_prof_max_update(tsdn_t *tsdn, mutex_prof_data_t *data,
 	if (source->n_spin_acquired > data->n_spin_acquired) {
 		data->n_spin_acquired = source->n_spin_acquired;
 	}
+	for (unsigned i = 0; i < MUTEX_PROF_WAIT_NBUCKETS; i++) {
+		if (source->wait_hist[i] > data->wait_hist[i]) {
+			data->wait_hist[i] = source->wait_hist[i];
+		}
+	}
 	if (source->max_n_thds > data->max_n_thds) {
 		data->max_n_thds = source->max_n_thds;
 	}
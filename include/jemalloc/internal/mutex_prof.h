@@ -83,6 +83,23 @@ COUNTER_ENUM(MUTEX_PROF_UINT32_COUNTERS, uint32_t)
 #undef COUNTER_ENUM
 #undef OP
 
+/*
+ * Wait times are also kept in a log2 histogram.  With min = 2^LG_MIN_NS ns,
+ * bucket 0 counts waits shorter than min, bucket i > 0 counts waits in
+ * [min * 2^(i-1), min * 2^i), and the last bucket is unbounded; i.e. the
+ * buckets span ~1us to ~16ms.
+ *
+ * The histogram lives in mutex_prof_data_t, i.e. in every malloc_mutex_t, which
+ * it makes 128 bytes larger (320 rather than 192 bytes on x86-64 Linux).  Each
+ * arena has a few dozen mutexes (one per bin, with the default 36 bins and no
+ * bin sharding), so this costs some 6 KiB of metadata per arena.  Keeping it
+ * inline, rather than allocated separately, lets mutexes be initialized
+ * without an allocator; the buckets sit with the other slow path counters,
+ * away from the fields touched on every lock.
+ */
+#define MUTEX_PROF_WAIT_LG_MIN_NS 10
+#define MUTEX_PROF_WAIT_NBUCKETS 16
+
 typedef struct {
 	/*
 	 * Counters touched on the slow path, i.e. when there is lock
@@ -96,6 +113,8 @@ typedef struct {
 	uint64_t		n_wait_times;
 	/* # of times acquired the mutex through local spinning. */
 	uint64_t		n_spin_acquired;
+	/* Histogram of the n_wait_times wait times; see above. */
+	uint64_t		wait_hist[MUTEX_PROF_WAIT_NBUCKETS];
 	/* Max # of threads waiting for the mutex at the same time. */
 	uint32_t		max_n_thds;
 	/* Current # of threads waiting on the lock.  Atomic synced. */
@@ -113,6 +132,46 @@ typedef struct {
 	tsdn_t			*prev_owner;
 	/* # of lock() operations in total. */
 	uint64_t		n_lock_ops;
+	/*
+	 * Where the mutex was last acquired, if opt_mutex_prof_holders.  Read
+	 * by waiters without holding the mutex.
+	 */
+	atomic_p_t		holder_site;
 } mutex_prof_data_t;
 
+/*
+ * Wait times attributed to the code holding the mutex, if
+ * opt_mutex_prof_holders.  Sites are the names of the functions that acquired
+ * the mutexes, e.g. arena_cache_bin_fill_small for a bin lock; they are kept
+ * across all mutexes, since a site mostly implies the mutex type.
+ */
+#define MUTEX_PROF_NHOLDERS 64
+
+typedef struct mutex_prof_holder_s mutex_prof_holder_t;
+struct mutex_prof_holder_s {
+	/* NULL for unused slots. */
+	const char		*site;
+	/* # of waits while the mutex was held from site. */
+	uint64_t		n_wait_times;
+	/* Total time (in nano seconds) of those waits. */
+	uint64_t		tot_wait_time;
+};
+
+extern bool opt_mutex_prof_holders;
+
+void mutex_prof_holder_record(const char *site, uint64_t wait_ns);
+void mutex_prof_holder_read(size_t ind, mutex_prof_holder_t *holder);
+void mutex_prof_holders_reset(void);
+
+static inline unsigned
+mutex_prof_wait_bucket(uint64_t wait_ns) {
+	unsigned bucket = 0;
+	uint64_t bound = UINT64_C(1) << MUTEX_PROF_WAIT_LG_MIN_NS;
+	while (wait_ns >= bound && bucket < MUTEX_PROF_WAIT_NBUCKETS - 1) {
+		bucket++;
+		bound <<= 1;
+	}
+	return bucket;
+}
+
 #endif /* JEMALLOC_INTERNAL_MUTEX_PROF_H */
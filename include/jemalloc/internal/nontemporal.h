@@ -0,0 +1,55 @@
+#ifndef JEMALLOC_INTERNAL_NONTEMPORAL_H
+#define JEMALLOC_INTERNAL_NONTEMPORAL_H
+
+#include "jemalloc/internal/jemalloc_preamble.h"
+
+/*
+ * Copy and zeroing kernels built on non-temporal (streaming) stores, which
+ * write around the cache hierarchy.  Moving or clearing a multi-megabyte
+ * buffer through the caches evicts the working sets of every thread sharing
+ * the LLC, for data the caller usually won't touch again right away.
+ */
+
+typedef enum {
+	nontemporal_kernel_none = 0,
+	nontemporal_kernel_sse2 = 1,
+	nontemporal_kernel_avx2 = 2
+} nontemporal_kernel_t;
+
+/* Sizes at or above which the kernels are used; 0 means never. */
+#define NONTEMPORAL_THRESHOLD_DEFAULT 0
+
+extern size_t opt_nontemporal_threshold;
+/* The best kernel supported by the CPU; chosen at boot. */
+extern nontemporal_kernel_t nontemporal_kernel;
+
+void nontemporal_copy_impl(void *dst, const void *src, size_t size);
+void nontemporal_zero_impl(void *dst, size_t size);
+void nontemporal_boot(void);
+
+static inline bool
+nontemporal_use(size_t size) {
+	return opt_nontemporal_threshold != 0 &&
+	    size >= opt_nontemporal_threshold &&
+	    nontemporal_kernel != nontemporal_kernel_none;
+}
+
+static inline void
+nontemporal_copy(void *dst, const void *src, size_t size) {
+	if (nontemporal_use(size)) {
+		nontemporal_copy_impl(dst, src, size);
+	} else {
+		memcpy(dst, src, size);
+	}
+}
+
+static inline void
+nontemporal_zero(void *dst, size_t size) {
+	if (nontemporal_use(size)) {
+		nontemporal_zero_impl(dst, size);
+	} else {
+		memset(dst, 0, size);
+	}
+}
+
+#endif /* JEMALLOC_INTERNAL_NONTEMPORAL_H */
@@ -236,6 +236,16 @@ void pa_shard_stats_merge(tsdn_t *tsdn, pa_shard_t *shard,
     hpa_shard_stats_t *hpa_stats_out, sec_stats_t *sec_stats_out,
     size_t *resident);
 
+/*
+ * A sum of the shard's purging and hugification counters, which only changes
+ * when one of them does.  Background decay and HPA work move these without
+ * necessarily changing any page counts.  The first form reads the shard, the
+ * second stats previously merged out of it by pa_shard_stats_merge().
+ */
+uint64_t pa_shard_nwork_get(tsdn_t *tsdn, pa_shard_t *shard);
+uint64_t pa_shard_stats_nwork(pa_shard_stats_t *pa_shard_stats,
+    hpa_shard_stats_t *hpa_stats);
+
 /*
  * Reads the PA-owned mutex stats into the output stats array, at the
  * appropriate positions.  Morally, these stats should really live in
@@ -26,6 +26,32 @@ enum pac_purge_eagerness_e {
 };
 typedef enum pac_purge_eagerness_e pac_purge_eagerness_t;
 
+/* Whether (and how) newly mapped or recycled memory gets faulted in early. */
+typedef enum {
+	prefault_mode_disabled = 0,
+	/* Populate page tables before handing memory out. */
+	prefault_mode_populate = 1,
+	/* As above, and also mlock() the memory. */
+	prefault_mode_mlock    = 2,
+
+	prefault_mode_limit    = 3
+} prefault_mode_t;
+#define PREFAULT_MODE_DEFAULT prefault_mode_disabled
+#define PREFAULT_RESERVE_DEFAULT 0
+
+extern const char *const prefault_mode_names[];
+extern prefault_mode_t opt_prefault;
+extern size_t opt_prefault_reserve;
+
+/*
+ * How often the background thread samples the rate at which retained memory
+ * is consumed, for predictive growth (see retain_lookahead_ms below).
+ */
+#define PAC_RETAIN_LOOKAHEAD_INTERVAL_MS 100
+#define RETAIN_LOOKAHEAD_MS_DEFAULT 0
+
+extern unsigned opt_retain_lookahead_ms;
+
 typedef struct pac_decay_stats_s pac_decay_stats_t;
 struct pac_decay_stats_s {
 	/* Total number of purge sweeps. */
@@ -109,6 +135,28 @@ struct pac_s {
 	/* How large extents should be before getting auto-purged. */
 	atomic_zu_t oversize_threshold;
 
+	/*
+	 * The prefault_mode_t applied to memory taken out of the retained
+	 * ecache or freshly mapped, and the number of bytes of retained memory
+	 * that deferred work keeps mapped and prefaulted ahead of demand.
+	 */
+	atomic_u_t prefault;
+	atomic_zu_t prefault_reserve;
+
+	/*
+	 * Predictive growth of the retained ecache.  retained_consumed counts
+	 * all bytes allocated out of retained memory (recycled or freshly
+	 * grown).  The background thread samples it, and keeps enough retained
+	 * memory mapped (retained_lookahead bytes) to cover the next
+	 * retain_lookahead_ms worth of growth at the recent rate.
+	 */
+	atomic_u_t retain_lookahead_ms;
+	atomic_zu_t retained_consumed;
+	atomic_zu_t retained_lookahead;
+	/* Last sample of retained_consumed; time protected by grow_mtx. */
+	nstime_t lookahead_sample_time;
+	atomic_zu_t lookahead_sample_consumed;
+
 	/*
 	 * Decay-based purging state, responsible for scheduling extent state
 	 * transitions.
@@ -140,6 +188,84 @@ pac_ehooks_get(pac_t *pac) {
 	return base_ehooks_get(pac->base);
 }
 
+static inline prefault_mode_t
+pac_prefault_get(pac_t *pac) {
+	return (prefault_mode_t)atomic_load_u(&pac->prefault, ATOMIC_RELAXED);
+}
+
+static inline void
+pac_prefault_set(pac_t *pac, prefault_mode_t prefault) {
+	assert(prefault < prefault_mode_limit);
+	atomic_store_u(&pac->prefault, (unsigned)prefault, ATOMIC_RELAXED);
+}
+
+static inline size_t
+pac_prefault_reserve_get(pac_t *pac) {
+	return atomic_load_zu(&pac->prefault_reserve, ATOMIC_RELAXED);
+}
+
+static inline void
+pac_prefault_reserve_set(pac_t *pac, size_t prefault_reserve) {
+	atomic_store_zu(&pac->prefault_reserve, prefault_reserve,
+	    ATOMIC_RELAXED);
+}
+
+static inline unsigned
+pac_retain_lookahead_ms_get(pac_t *pac) {
+	return atomic_load_u(&pac->retain_lookahead_ms, ATOMIC_RELAXED);
+}
+
+static inline void
+pac_retain_lookahead_ms_set(pac_t *pac, unsigned retain_lookahead_ms) {
+	atomic_store_u(&pac->retain_lookahead_ms, retain_lookahead_ms,
+	    ATOMIC_RELAXED);
+}
+
+/*
+ * Returns the number of bytes the retained ecache falls short of what deferred
+ * work keeps mapped ahead of demand by: the larger of the shortfall of
+ * prefaulted retained memory against the prefault reserve (if prefaulting is
+ * enabled), and of all retained memory against the predicted growth.  Only
+ * applies when virtual memory is retained.
+ */
+static inline size_t
+pac_retained_deficit(pac_t *pac) {
+	if (!opt_retain) {
+		return 0;
+	}
+	size_t deficit = 0;
+	size_t lookahead = atomic_load_zu(&pac->retained_lookahead,
+	    ATOMIC_RELAXED);
+	if (lookahead != 0) {
+		size_t retained = ecache_npages_get(&pac->ecache_retained) <<
+		    LG_PAGE;
+		if (retained < lookahead) {
+			deficit = lookahead - retained;
+		}
+	}
+	size_t reserve = pac_prefault_reserve_get(pac);
+	if (reserve != 0 && pac_prefault_get(pac) != prefault_mode_disabled) {
+		/* Purged retained memory doesn't count towards the reserve. */
+		size_t prefaulted = ecache_npages_prefaulted_get(
+		    &pac->ecache_retained) << LG_PAGE;
+		if (prefaulted < reserve && reserve - prefaulted > deficit) {
+			deficit = reserve - prefaulted;
+		}
+	}
+	return deficit;
+}
+
+/*
+ * Whether retained memory was consumed since the background thread last
+ * sampled the consumption rate.
+ */
+static inline bool
+pac_retain_lookahead_pending(pac_t *pac) {
+	return pac_retain_lookahead_ms_get(pac) != 0 &&
+	    atomic_load_zu(&pac->retained_consumed, ATOMIC_RELAXED) !=
+	    atomic_load_zu(&pac->lookahead_sample_consumed, ATOMIC_RELAXED);
+}
+
 /*
  * All purging functions require holding decay->mtx.  This is one of the few
  * places external modules are allowed to peek inside pa_shard_t internals.
@@ -177,6 +303,12 @@ bool pac_decay_ms_set(tsdn_t *tsdn, pac_t *pac, extent_state_t state,
     ssize_t decay_ms, pac_purge_eagerness_t eagerness);
 ssize_t pac_decay_ms_get(pac_t *pac, extent_state_t state);
 
+/*
+ * Updates the predicted growth, and tops up retained memory accordingly;
+ * called from the background thread.
+ */
+void pac_do_deferred_work(tsdn_t *tsdn, pac_t *pac);
+
 void pac_reset(tsdn_t *tsdn, pac_t *pac);
 void pac_destroy(tsdn_t *tsdn, pac_t *pac);
 
@@ -107,19 +107,84 @@ extern thp_mode_t opt_thp;
 extern thp_mode_t init_system_thp_mode; /* Initial system wide state. */
 extern const char *const thp_mode_names[];
 
-void *pages_map(void *addr, size_t size, size_t alignment, bool *commit);
-void pages_unmap(void *addr, size_t size);
-bool pages_commit(void *addr, size_t size);
-bool pages_decommit(void *addr, size_t size);
-bool pages_purge_lazy(void *addr, size_t size);
-bool pages_purge_forced(void *addr, size_t size);
-bool pages_huge(void *addr, size_t size);
-bool pages_nohuge(void *addr, size_t size);
+/*
+ * The page allocators that the pages_*() calls are made on behalf of, for
+ * stats.pages.<caller>.*: extents (PAC, including dss and hugetlb extents),
+ * HPA, and base.
+ */
+#define PAGES_CALLERS							\
+    OP(pac)								\
+    OP(hpa)								\
+    OP(base)
+
+typedef enum {
+#define OP(caller) pages_caller_##caller,
+	PAGES_CALLERS
+#undef OP
+	pages_num_callers
+} pages_caller_t;
+
+/* The operations accounted for, one per pages_*() call. */
+#define PAGES_OPS							\
+    OP(map)								\
+    OP(unmap)								\
+    OP(commit)								\
+    OP(decommit)							\
+    OP(purge_lazy)							\
+    OP(purge_forced)							\
+    OP(huge)								\
+    OP(nohuge)								\
+    OP(populate)							\
+    OP(mlock)								\
+    OP(munlock)								\
+    OP(mark_guards)							\
+    OP(unmark_guards)
+
+typedef enum {
+#define OP(op) pages_op_##op,
+	PAGES_OPS
+#undef OP
+	pages_num_ops
+} pages_op_t;
+
+extern const char *const pages_caller_names[pages_num_callers];
+extern const char *const pages_op_names[pages_num_ops];
+
+typedef struct pages_stats_s pages_stats_t;
+struct pages_stats_s {
+	/* # of calls, whether or not they succeeded. */
+	uint64_t ncalls;
+	/* Total size of the ranges operated on. */
+	uint64_t bytes;
+	/* Cumulative time (in nano seconds) spent in the calls. */
+	uint64_t total_ns;
+};
+
+void pages_stats_read(pages_caller_t caller, pages_op_t op,
+    pages_stats_t *stats);
+
+void *pages_map(pages_caller_t caller, void *addr, size_t size,
+    size_t alignment, bool *commit);
+void pages_unmap(pages_caller_t caller, void *addr, size_t size);
+bool pages_commit(pages_caller_t caller, void *addr, size_t size);
+bool pages_decommit(pages_caller_t caller, void *addr, size_t size);
+bool pages_purge_lazy(pages_caller_t caller, void *addr, size_t size);
+bool pages_purge_forced(pages_caller_t caller, void *addr, size_t size);
+bool pages_huge(pages_caller_t caller, void *addr, size_t size);
+bool pages_nohuge(pages_caller_t caller, void *addr, size_t size);
 bool pages_dontdump(void *addr, size_t size);
 bool pages_dodump(void *addr, size_t size);
+/*
+ * Fault in (and so back with physical memory) every page of a committed range,
+ * preserving its contents.  pages_mlock() additionally locks the range into
+ * memory, and pages_munlock() unlocks it again.  All return true on failure.
+ */
+bool pages_populate(pages_caller_t caller, void *addr, size_t size);
+bool pages_mlock(pages_caller_t caller, void *addr, size_t size);
+bool pages_munlock(pages_caller_t caller, void *addr, size_t size);
 bool pages_boot(void);
-void pages_set_thp_state (void *ptr, size_t size);
-void pages_mark_guards(void *head, void *tail);
-void pages_unmark_guards(void *head, void *tail);
+void pages_set_thp_state(pages_caller_t caller, void *ptr, size_t size);
+void pages_mark_guards(pages_caller_t caller, void *head, void *tail);
+void pages_unmark_guards(pages_caller_t caller, void *head, void *tail);
 
 #endif /* JEMALLOC_INTERNAL_PAGES_EXTERNS_H */
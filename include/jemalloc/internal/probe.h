@@ -0,0 +1,55 @@
+#ifndef JEMALLOC_INTERNAL_PROBE_H
+#define JEMALLOC_INTERNAL_PROBE_H
+
+#include "jemalloc/internal/jemalloc_preamble.h"
+
+/*
+ * USDT (statically defined tracing) probes at the boundaries of the allocator
+ * slow paths, under the "jemalloc" provider; e.g. with bpftrace:
+ *
+ *   usdt:/path/to/libjemalloc.so:jemalloc:slab_alloc { @[arg1] = count(); }
+ *
+ * With --enable-sdt, a probe is a single nop until a tracer attaches to it,
+ * though its arguments are still computed; keep them to values at hand, or
+ * cheap loads.  Otherwise, probes and their arguments compile out entirely.
+ *
+ * Probe names go through macro expansion, so they must not be the names of
+ * internal functions, which private_namespace.h maps to je_-prefixed ones.
+ *
+ * The probes and their arguments are:
+ *   tcache_fill(arena_ind, binind, nfill, nfilled)
+ *   tcache_bin_flush(binind, nflush, nremaining)
+ *   slab_alloc(arena_ind, binind, size)
+ *   slab_dalloc(arena_ind, binind, size)
+ *   extent_grow(arena_ind, size, alloc_size)
+ *   extent_purge(arena_ind, extent_state, nextents, bytes)
+ *   hpa_purge(shard_ind, addr, bytes)
+ *   hpa_hugify(shard_ind, addr)
+ *   hpa_dehugify(shard_ind, addr)
+ *   decay_epoch(arena_ind, extent_state, npages_current, npages_limit)
+ *   mutex_contend_begin(mutex)
+ *   mutex_contend_end(mutex)
+ */
+
+#ifdef JEMALLOC_SDT
+#include <sys/sdt.h>
+
+#define JE_PROBE(name)							\
+	DTRACE_PROBE(jemalloc, name)
+#define JE_PROBE1(name, a1)						\
+	DTRACE_PROBE1(jemalloc, name, a1)
+#define JE_PROBE2(name, a1, a2)						\
+	DTRACE_PROBE2(jemalloc, name, a1, a2)
+#define JE_PROBE3(name, a1, a2, a3)					\
+	DTRACE_PROBE3(jemalloc, name, a1, a2, a3)
+#define JE_PROBE4(name, a1, a2, a3, a4)					\
+	DTRACE_PROBE4(jemalloc, name, a1, a2, a3, a4)
+#else
+#define JE_PROBE(name)
+#define JE_PROBE1(name, a1)
+#define JE_PROBE2(name, a1, a2)
+#define JE_PROBE3(name, a1, a2, a3)
+#define JE_PROBE4(name, a1, a2, a3, a4)
+#endif
+
+#endif /* JEMALLOC_INTERNAL_PROBE_H */
@@ -2,26 +2,35 @@
 #define JEMALLOC_INTERNAL_PROF_DATA_H
 
 #include "jemalloc/internal/jemalloc_preamble.h"
+#include "jemalloc/internal/base.h"
+#include "jemalloc/internal/buf_writer.h"
 #include "jemalloc/internal/mutex.h"
 
-extern malloc_mutex_t bt2gctx_mtx;
 extern malloc_mutex_t tdatas_mtx;
 extern malloc_mutex_t prof_dump_mtx;
 
 extern malloc_mutex_t *gctx_locks;
 extern malloc_mutex_t *tdata_locks;
 
-extern size_t prof_unbiased_sz[PROF_SC_NSIZES];
-extern size_t prof_shifted_unbiased_cnt[PROF_SC_NSIZES];
+/* Indexed by sampling level, then by size class. */
+extern size_t prof_unbiased_sz[PROF_SAMPLE_NLEVELS][PROF_SC_NSIZES];
+extern size_t prof_shifted_unbiased_cnt[PROF_SAMPLE_NLEVELS][PROF_SC_NSIZES];
 
 void prof_bt_hash(const void *key, size_t r_hash[2]);
 bool prof_bt_keycomp(const void *k1, const void *k2);
 
-bool prof_data_init(tsd_t *tsd);
+bool prof_data_init(tsd_t *tsd, base_t *base);
+void prof_bt2gctx_mutex_prof_read(tsdn_t *tsdn, mutex_prof_data_t *data);
+void prof_bt2gctx_mutex_prof_reset(tsdn_t *tsdn);
+void prof_bt2gctx_prefork(tsdn_t *tsdn);
+void prof_bt2gctx_postfork_parent(tsdn_t *tsdn);
+void prof_bt2gctx_postfork_child(tsdn_t *tsdn);
 prof_tctx_t *prof_lookup(tsd_t *tsd, prof_bt_t *bt);
 int prof_thread_name_set_impl(tsd_t *tsd, const char *thread_name);
 void prof_unbias_map_init(void);
-void prof_dump_impl(tsd_t *tsd, write_cb_t *prof_dump_write, void *cbopaque,
+bool prof_dump_impl(tsd_t *tsd, write_cb_t *prof_dump_write, void *cbopaque,
+    prof_tdata_t *tdata, bool leakcheck);
+bool prof_dump_pprof_impl(tsd_t *tsd, buf_writer_t *buf_writer,
     prof_tdata_t *tdata, bool leakcheck);
 prof_tdata_t * prof_tdata_init_impl(tsd_t *tsd, uint64_t thr_uid,
     uint64_t thr_discrim, char *thread_name, bool active);
@@ -25,6 +25,20 @@ extern char opt_prof_prefix[
 #endif
     1];
 extern bool opt_prof_unbias;
+/* Target samples per second for adaptive sampling; 0 means fixed. */
+extern size_t opt_prof_sample_target;
+
+/*
+ * Heap growth watermarks: stats.allocated / stats.resident levels (0 means
+ * unwatched) that trigger a dump, the further growth in percent that triggers
+ * the next one, how far in percent a metric has to drop before it re-arms, and
+ * the minimum time between two such dumps.
+ */
+extern size_t opt_prof_watermark_allocated;
+extern size_t opt_prof_watermark_resident;
+extern unsigned opt_prof_watermark_growth;
+extern unsigned opt_prof_watermark_hysteresis;
+extern unsigned opt_prof_watermark_interval_ms;
 
 /* Include pid namespace in profile file names. */
 extern bool opt_prof_pid_namespace;
@@ -35,6 +49,15 @@ extern ssize_t opt_prof_recent_alloc_max;
 /* Whether to use thread name provided by the system or by mallctl. */
 extern bool opt_prof_sys_thread_name;
 
+extern prof_format_t opt_prof_format;
+extern const char *const prof_format_names[];
+
+extern prof_backtrace_method_t opt_prof_backtrace_method;
+extern const char *const prof_backtrace_method_names[];
+
+/* Whether to keep per-context histograms of sampled object lifetimes. */
+extern bool opt_prof_lifetime;
+
 /* Whether to record per size class counts and request size totals. */
 extern bool opt_prof_stats;
 
@@ -53,6 +76,9 @@ extern uint64_t prof_interval;
  */
 extern size_t lg_prof_sample;
 
+/* Current adaptive sampling level; see PROF_SAMPLE_NLEVELS. */
+extern atomic_u_t prof_sample_level;
+
 extern bool prof_booted;
 
 void prof_backtrace_hook_set(prof_backtrace_hook_t hook);
@@ -79,7 +105,12 @@ void prof_free_sampled_object(tsd_t *tsd, const void *ptr, size_t usize,
 prof_tctx_t *prof_tctx_create(tsd_t *tsd);
 void prof_idump(tsdn_t *tsdn);
 bool prof_mdump(tsd_t *tsd, const char *filename);
+bool prof_mdump_cb(tsd_t *tsd, prof_dump_write_cb_t *write_cb,
+    void *cbopaque);
 void prof_gdump(tsdn_t *tsdn);
+bool prof_watermark_enabled(void);
+void prof_watermark_evaluate(tsdn_t *tsdn);
+uint64_t prof_watermark_deferred_work(tsdn_t *tsdn);
 
 void prof_tdata_cleanup(tsd_t *tsd);
 bool prof_active_get(tsdn_t *tsdn);
@@ -88,6 +119,8 @@ const char *prof_thread_name_get(tsd_t *tsd);
 int prof_thread_name_set(tsd_t *tsd, const char *thread_name);
 bool prof_thread_active_get(tsd_t *tsd);
 bool prof_thread_active_set(tsd_t *tsd, bool active);
+unsigned prof_thread_alloc_tag_get(tsd_t *tsd);
+bool prof_thread_alloc_tag_set(tsd_t *tsd, unsigned tag);
 bool prof_thread_active_init_get(tsdn_t *tsdn);
 bool prof_thread_active_init_set(tsdn_t *tsdn, bool active_init);
 bool prof_gdump_get(tsdn_t *tsdn);
@@ -99,6 +132,11 @@ void prof_prefork0(tsdn_t *tsdn);
 void prof_prefork1(tsdn_t *tsdn);
 void prof_postfork_parent(tsdn_t *tsdn);
 void prof_postfork_child(tsdn_t *tsdn);
+unsigned prof_sample_max_level(void);
+
+/* Used in unit tests. */
+unsigned prof_sample_level_next(unsigned level, unsigned max_level,
+    uint64_t nsamples, uint64_t elapsed_ns, size_t target);
 
 /* Only accessed by thread event. */
 uint64_t prof_sample_new_event_wait(tsd_t *tsd);
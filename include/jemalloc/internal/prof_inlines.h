@@ -111,6 +111,17 @@ prof_tctx_is_valid(const prof_tctx_t *tctx) {
 	return tctx != NULL && tctx != PROF_TCTX_SENTINEL;
 }
 
+/* Maps an object lifetime to its histogram bucket; see PROF_LIFETIME_*. */
+static inline unsigned
+prof_lifetime_bucket(uint64_t lifetime_ns) {
+	if (lifetime_ns < ((uint64_t)1 << PROF_LIFETIME_LG_MIN_NS)) {
+		return 0;
+	}
+	unsigned ind = (fls_u64(lifetime_ns) - PROF_LIFETIME_LG_MIN_NS) /
+	    PROF_LIFETIME_LG_STEP + 1;
+	return ind < PROF_LIFETIME_NBUCKETS ? ind : PROF_LIFETIME_NBUCKETS - 1;
+}
+
 JEMALLOC_ALWAYS_INLINE void
 prof_tctx_reset(tsd_t *tsd, const void *ptr, emap_alloc_ctx_t *alloc_ctx) {
 	cassert(config_prof);
@@ -128,12 +139,13 @@ prof_tctx_reset_sampled(tsd_t *tsd, const void *ptr) {
 }
 
 JEMALLOC_ALWAYS_INLINE void
-prof_info_set(tsd_t *tsd, edata_t *edata, prof_tctx_t *tctx, size_t size) {
+prof_info_set(tsd_t *tsd, edata_t *edata, prof_tctx_t *tctx, size_t size,
+    unsigned sample_level, unsigned alloc_tag) {
 	cassert(config_prof);
 	assert(edata != NULL);
 	assert(prof_tctx_is_valid(tctx));
 
-	arena_prof_info_set(tsd, edata, tctx, size);
+	arena_prof_info_set(tsd, edata, tctx, size, sample_level, alloc_tag);
 }
 
 JEMALLOC_ALWAYS_INLINE bool
@@ -0,0 +1,47 @@
+#ifndef JEMALLOC_INTERNAL_PROF_PPROF_H
+#define JEMALLOC_INTERNAL_PROF_PPROF_H
+
+#include "jemalloc/internal/jemalloc_preamble.h"
+#include "jemalloc/internal/buf_writer.h"
+#include "jemalloc/internal/ckh.h"
+
+/*
+ * Streaming encoder for the pprof profile.proto format (uncompressed).
+ * Protobuf lets the repeated top-level fields of a Profile message appear in
+ * any order and interleaved, so each string, mapping, location and sample is
+ * written out as soon as it is known; nothing beyond one sample is buffered.
+ */
+
+typedef struct prof_pprof_mapping_s prof_pprof_mapping_t;
+struct prof_pprof_mapping_s {
+	uintptr_t	start;
+	uintptr_t	limit;
+};
+
+typedef struct prof_pprof_s prof_pprof_t;
+struct prof_pprof_s {
+	buf_writer_t		*buf_writer;
+
+	/* Number of string_table entries written so far. */
+	uint64_t		nstrings;
+
+	/* Executable mappings, sorted by address; a mapping's id is index+1. */
+	prof_pprof_mapping_t	*mappings;
+	size_t			nmappings;
+	size_t			mappings_cap;
+
+	/* Address --> location id, for every location written so far. */
+	ckh_t			locations;
+	uint64_t		nlocations;
+
+	/* Scratch space for the location ids of one sample. */
+	uint64_t		*location_ids;
+};
+
+bool prof_pprof_begin(tsd_t *tsd, prof_pprof_t *pprof,
+    buf_writer_t *buf_writer);
+void prof_pprof_sample(tsd_t *tsd, prof_pprof_t *pprof, const prof_bt_t *bt,
+    const prof_cnt_t *cnts);
+void prof_pprof_end(tsd_t *tsd, prof_pprof_t *pprof);
+
+#endif /* JEMALLOC_INTERNAL_PROF_PPROF_H */
@@ -12,9 +12,13 @@ struct prof_stats_s {
 
 extern malloc_mutex_t prof_stats_mtx;
 
-void prof_stats_inc(tsd_t *tsd, szind_t ind, size_t size);
-void prof_stats_dec(tsd_t *tsd, szind_t ind, size_t size);
+void prof_stats_inc(tsd_t *tsd, szind_t ind, size_t size, unsigned tag,
+    size_t shifted_unbiased_cnt);
+void prof_stats_dec(tsd_t *tsd, szind_t ind, size_t size, unsigned tag,
+    size_t shifted_unbiased_cnt);
 void prof_stats_get_live(tsd_t *tsd, szind_t ind, prof_stats_t *stats);
 void prof_stats_get_accum(tsd_t *tsd, szind_t ind, prof_stats_t *stats);
+void prof_stats_tag_get_live(tsd_t *tsd, unsigned tag, prof_stats_t *stats);
+void prof_stats_tag_get_accum(tsd_t *tsd, unsigned tag, prof_stats_t *stats);
 
 #endif /* JEMALLOC_INTERNAL_PROF_STATS_H */
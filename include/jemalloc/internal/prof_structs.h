@@ -107,6 +107,10 @@ struct prof_info_s {
 	prof_tctx_t		*alloc_tctx;
 	/* Allocation request size. */
 	size_t			alloc_size;
+	/* Sampling level the allocation was sampled at. */
+	unsigned		alloc_sample_level;
+	/* Allocation tag of the allocating thread. */
+	unsigned		alloc_tag;
 };
 
 struct prof_gctx_s {
@@ -137,6 +141,12 @@ struct prof_gctx_s {
 	/* Temporary storage for summation during dump. */
 	prof_cnt_t		cnt_summed;
 
+	/*
+	 * Lifetimes of the sampled objects freed so far, bucketed as described
+	 * by PROF_LIFETIME_*.  Only updated if opt_prof_lifetime.
+	 */
+	atomic_zu_t		lifetimes[PROF_LIFETIME_NBUCKETS];
+
 	/* Associated backtrace. */
 	prof_bt_t		bt;
 
@@ -145,6 +155,17 @@ struct prof_gctx_s {
 };
 typedef rb_tree(prof_gctx_t) prof_gctx_tree_t;
 
+/*
+ * One shard of the global (prof_bt_t *)-->(prof_gctx_t *) hash.  Shards are
+ * cacheline aligned, so that threads working on different shards don't
+ * false-share.
+ */
+struct prof_bt2gctx_shard_s {
+	JEMALLOC_ALIGNED(CACHELINE)
+	malloc_mutex_t		mtx;
+	ckh_t			bt2gctx;
+};
+
 struct prof_tdata_s {
 	malloc_mutex_t		*lock;
 
@@ -177,6 +198,15 @@ struct prof_tdata_s {
 	/* Included in heap profile dumps if has content. */
 	char			thread_name[PROF_THREAD_NAME_MAX_LEN];
 
+	/*
+	 * Sampling level that this thread's current sample wait was drawn at,
+	 * and so the level its next sampled allocation is weighted by.
+	 */
+	unsigned		sample_level;
+
+	/* Tag attached to this thread's sampled allocations. */
+	unsigned		alloc_tag;
+
 	/* State used to avoid dumping while operating on prof internals. */
 	bool			enq;
 	bool			enq_idump;
@@ -202,6 +232,15 @@ struct prof_tdata_s {
 	/* Temporary storage for summation during dump. */
 	prof_cnt_t		cnt_summed;
 
+	/*
+	 * Bounds of the thread's stack, used to validate frame records when
+	 * opt.prof_backtrace_method is fp.  Looked up on first use; an empty
+	 * range if the lookup failed.
+	 */
+	bool			stack_bounds_fetched;
+	uintptr_t		stack_lo;
+	uintptr_t		stack_hi;
+
 	/* Backtrace vector, used for calls to prof_backtrace(). */
 	void 			**vec;
 };
@@ -211,7 +250,11 @@ struct prof_recent_s {
 	nstime_t alloc_time;
 	nstime_t dalloc_time;
 
-	ql_elm(prof_recent_t) link;
+	/*
+	 * Encodes the ticket of the record held in this slot; odd while the
+	 * slot is being written.  See prof_recent.c.
+	 */
+	atomic_zu_t seq;
 	size_t size;
 	size_t usize;
 	atomic_p_t alloc_edata; /* NULL means allocation has been freed. */
@@ -219,4 +262,14 @@ struct prof_recent_s {
 	prof_tctx_t *dalloc_tctx;
 };
 
+struct prof_recent_ring_s {
+	/* Next ticket to hand out; ticket t goes to slots[t % cap]. */
+	atomic_zu_t next;
+	/* Number of slots. */
+	size_t cap;
+	/* prof_recent_alloc_max at the time the ring was built. */
+	ssize_t limit;
+	prof_recent_t *slots;
+};
+
 #endif /* JEMALLOC_INTERNAL_PROF_STRUCTS_H */
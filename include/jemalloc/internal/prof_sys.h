@@ -19,9 +19,14 @@ bool prof_prefix_set(tsdn_t *tsdn, const char *prefix);
 void prof_fdump_impl(tsd_t *tsd);
 void prof_idump_impl(tsd_t *tsd);
 bool prof_mdump_impl(tsd_t *tsd, const char *filename);
+bool prof_mdump_cb_impl(tsd_t *tsd, prof_dump_write_cb_t *write_cb,
+    void *cbopaque);
 void prof_gdump_impl(tsd_t *tsd);
+void prof_wdump_impl(tsd_t *tsd);
 
 /* Used in unit tests. */
+bool prof_backtrace_fp_walk(void **vec, unsigned *len, unsigned max_len,
+    uintptr_t fp, uintptr_t stack_lo, uintptr_t stack_hi);
 typedef int (prof_sys_thread_name_read_t)(char *buf, size_t limit);
 extern prof_sys_thread_name_read_t *JET_MUTABLE prof_sys_thread_name_read;
 typedef int (prof_dump_open_file_t)(const char *, int);
@@ -6,8 +6,14 @@ typedef struct prof_cnt_s prof_cnt_t;
 typedef struct prof_tctx_s prof_tctx_t;
 typedef struct prof_info_s prof_info_t;
 typedef struct prof_gctx_s prof_gctx_t;
+typedef struct prof_bt2gctx_shard_s prof_bt2gctx_shard_t;
 typedef struct prof_tdata_s prof_tdata_t;
 typedef struct prof_recent_s prof_recent_t;
+typedef struct prof_recent_ring_s prof_recent_ring_t;
+
+/* Receives heap profile dump output in place of the dump file. */
+typedef void (prof_dump_write_cb_t)(void *cbopaque, const void *bytes,
+    size_t len);
 
 /* Option defaults. */
 #ifdef JEMALLOC_PROF
@@ -30,6 +36,32 @@ typedef struct prof_recent_s prof_recent_t;
 #endif
 #define PROF_BT_MAX_DEFAULT			128
 
+/* Heap profile dump formats. */
+typedef enum {
+	/* Text format understood by jeprof. */
+	prof_format_heap_v2 = 0,
+	/* Uncompressed pprof profile.proto. */
+	prof_format_pprof = 1
+} prof_format_t;
+
+/* How prof_backtrace() collects a backtrace. */
+typedef enum {
+	/* Whichever unwinder was selected at configure time. */
+	prof_backtrace_method_default = 0,
+	/* Frame pointer walk, falling back to the default on bad frames. */
+	prof_backtrace_method_fp = 1
+} prof_backtrace_method_t;
+
+/*
+ * The frame pointer walk assumes the x86-64/AArch64 frame record layout (saved
+ * frame pointer, then return address), and validates records against the
+ * thread's stack bounds.
+ */
+#if defined(JEMALLOC_HAVE_PTHREAD_GETATTR_NP) && \
+    (defined(__x86_64__) || defined(__aarch64__))
+#  define JEMALLOC_PROF_FRAME_POINTER
+#endif
+
 /* Initial hash table size. */
 #define PROF_CKH_MINITEMS		64
 
@@ -52,6 +84,26 @@ typedef struct prof_recent_s prof_recent_t;
 #  define PROF_SC_NSIZES		1
 #endif
 
+/*
+ * Number of sampling intervals that adaptive sampling (opt_prof_sample_target)
+ * steps through: level i samples every 2^(lg_prof_sample + i) bytes on
+ * average.  Each level has its own unbiasing tables.
+ */
+#ifdef JEMALLOC_PROF
+#  define PROF_SAMPLE_NLEVELS		8
+#else
+#  define PROF_SAMPLE_NLEVELS		1
+#endif
+/* Adaptive sampling re-evaluates its level at most this often... */
+#define PROF_SAMPLE_ADAPT_INTERVAL_NS	UINT64_C(100000000)
+/* ... and only checks the clock once per this many samples. */
+#define PROF_SAMPLE_ADAPT_NSAMPLES	32
+
+/* The background thread checks the heap watermarks at most this often. */
+#define PROF_WATERMARK_CHECK_INTERVAL_NS	UINT64_C(1000000000)
+/* Default minimum time between two watermark triggered dumps. */
+#define PROF_WATERMARK_INTERVAL_MS_DEFAULT	60000
+
 /* Size of stack-allocated buffer used by prof_printf(). */
 #define PROF_PRINTF_BUFSIZE		128
 
@@ -61,6 +113,13 @@ typedef struct prof_recent_s prof_recent_t;
  */
 #define PROF_NCTX_LOCKS			1024
 
+/*
+ * Number of independently locked shards of the backtrace-->gctx hash.  Like
+ * the lock tables, only allocated when profiling is enabled.
+ */
+#define LG_PROF_BT2GCTX_NSHARDS		6
+#define PROF_BT2GCTX_NSHARDS		(1U << LG_PROF_BT2GCTX_NSHARDS)
+
 /*
  * Number of mutexes shared among all tdata's.  No space is allocated for these
  * unless profiling is enabled, so it's okay to over-provision.
@@ -74,12 +133,32 @@ typedef struct prof_recent_s prof_recent_t;
 #define PROF_DUMP_FILENAME_LEN 1
 #endif
 
+/*
+ * Allocation lifetime histogram buckets.  Bucket 0 counts lifetimes below
+ * 2^PROF_LIFETIME_LG_MIN_NS ns, and each following bucket is
+ * 2^PROF_LIFETIME_LG_STEP times as wide as the previous one; the last bucket
+ * is unbounded.
+ */
+#define PROF_LIFETIME_LG_MIN_NS		10
+#define PROF_LIFETIME_LG_STEP		2
+#define PROF_LIFETIME_NBUCKETS		20
+
 /* Default number of recent allocations to record. */
 #define PROF_RECENT_ALLOC_MAX_DEFAULT 0
 
 /* Thread name storage size limit. */
 #define PROF_THREAD_NAME_MAX_LEN 16
 
+/*
+ * Number of allocation tags (thread.prof.alloc_tag); tag 0 stands for
+ * untagged allocations.
+ */
+#ifdef JEMALLOC_PROF
+#  define PROF_ALLOC_NTAGS		256
+#else
+#  define PROF_ALLOC_NTAGS		1
+#endif
+
 /*
  * Minimum required alignment for sampled allocations. Over-aligning sampled
  * allocations allows us to quickly identify them on the dalloc path without
@@ -0,0 +1,65 @@
+#ifndef JEMALLOC_INTERNAL_STAT_U64_H
+#define JEMALLOC_INTERNAL_STAT_U64_H
+
+#include "jemalloc/internal/jemalloc_preamble.h"
+#include "jemalloc/internal/atomic.h"
+
+/*
+ * A 64-bit statistics counter, for the stats updated with no mutex to
+ * synchronize on (unlike locked_u64_t); e.g. the pages and latency stats.
+ * Without 64-bit atomics, it is kept as two 32-bit halves, the carry out of the
+ * low half being added to the high half separately; a read racing with such a
+ * carry may come out 2^32 short.
+ */
+typedef struct stat_u64_s stat_u64_t;
+struct stat_u64_s {
+#ifdef JEMALLOC_ATOMIC_U64
+	atomic_u64_t val;
+#else
+	atomic_u32_t lo;
+	atomic_u32_t hi;
+#endif
+};
+
+static inline uint64_t
+stat_u64_read(stat_u64_t *p) {
+#ifdef JEMALLOC_ATOMIC_U64
+	return atomic_load_u64(&p->val, ATOMIC_RELAXED);
+#else
+	uint32_t hi, lo;
+	do {
+		hi = atomic_load_u32(&p->hi, ATOMIC_RELAXED);
+		lo = atomic_load_u32(&p->lo, ATOMIC_RELAXED);
+	} while (hi != atomic_load_u32(&p->hi, ATOMIC_RELAXED));
+	return ((uint64_t)hi << 32) | lo;
+#endif
+}
+
+static inline void
+stat_u64_add(stat_u64_t *p, uint64_t x) {
+#ifdef JEMALLOC_ATOMIC_U64
+	atomic_fetch_add_u64(&p->val, x, ATOMIC_RELAXED);
+#else
+	uint32_t lo = (uint32_t)x;
+	uint32_t hi = (uint32_t)(x >> 32);
+	uint32_t old = atomic_fetch_add_u32(&p->lo, lo, ATOMIC_RELAXED);
+	if ((uint32_t)(old + lo) < old) {
+		hi++;
+	}
+	if (hi != 0) {
+		atomic_fetch_add_u32(&p->hi, hi, ATOMIC_RELAXED);
+	}
+#endif
+}
+
+static inline void
+stat_u64_reset(stat_u64_t *p) {
+#ifdef JEMALLOC_ATOMIC_U64
+	atomic_store_u64(&p->val, 0, ATOMIC_RELAXED);
+#else
+	atomic_store_u32(&p->hi, 0, ATOMIC_RELAXED);
+	atomic_store_u32(&p->lo, 0, ATOMIC_RELAXED);
+#endif
+}
+
+#endif /* JEMALLOC_INTERNAL_STAT_U64_H */
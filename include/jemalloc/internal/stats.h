@@ -8,6 +8,7 @@
 /*  OPTION(opt,		var_name,	default,	set_value_to) */
 #define STATS_PRINT_OPTIONS						\
     OPTION('J',		json,		false,		true)		\
+    OPTION('O',		openmetrics,	false,		true)		\
     OPTION('g',		general,	true,		false)		\
     OPTION('m',		merged,		config_stats,	false)		\
     OPTION('d',		destroyed,	config_stats,	false)		\
@@ -47,6 +48,82 @@ uint64_t stats_interval_new_event_wait(tsd_t *tsd);
 uint64_t stats_interval_postponed_event_wait(tsd_t *tsd);
 void stats_interval_event_handler(tsd_t *tsd, uint64_t elapsed);
 
+/* Utilities for stats_bg_*, the background thread driven stats output. */
+extern int64_t opt_stats_bg_interval_ms;
+extern char opt_stats_bg_opts[stats_print_tot_num_options+1];
+extern bool opt_stats_bg_delta;
+extern int opt_stats_bg_fd;
+
+#define STATS_BG_INTERVAL_MS_DEFAULT -1
+
+/*
+ * Where the reports go instead of opt.stats_bg_fd, if write_cb is non-NULL;
+ * see experimental.hooks.stats_bg in ctl.c.
+ */
+typedef struct stats_bg_hook_s stats_bg_hook_t;
+struct stats_bg_hook_s {
+	write_cb_t *write_cb;
+	void *cbopaque;
+};
+
+void stats_bg_hook_get(tsdn_t *tsdn, stats_bg_hook_t *hook);
+void stats_bg_hook_set(tsdn_t *tsdn, const stats_bg_hook_t *hook);
+
+/* Utilities for stats_ts, the background thread sampled time series. */
+extern int64_t opt_stats_ts_interval_ms;
+extern size_t opt_stats_ts_nsamples;
+
+#define STATS_TS_INTERVAL_MS_DEFAULT -1
+#define STATS_TS_NSAMPLES_DEFAULT 600
+
+/*
+ * The fields of a time series sample, in order; see experimental.stats_ts in
+ * ctl.c.  Counters (n*, *_purged and mutex_*) are cumulative and include
+ * destroyed arenas; the other fields are gauges over the extant arenas.
+ * Fields may only be appended.
+ */
+#define STATS_TS_FIELDS							\
+    OP(time_ns)								\
+    OP(allocated)							\
+    OP(active)								\
+    OP(metadata)							\
+    OP(resident)							\
+    OP(mapped)								\
+    OP(retained)							\
+    OP(pdirty)								\
+    OP(pmuzzy)								\
+    OP(hpa_huge_bytes)							\
+    OP(hpa_nhugifies)							\
+    OP(hpa_ndehugifies)							\
+    OP(dirty_npurge)							\
+    OP(dirty_purged)							\
+    OP(muzzy_npurge)							\
+    OP(muzzy_purged)							\
+    OP(hpa_npurges)							\
+    OP(mutex_num_wait)							\
+    OP(mutex_wait_time)
+
+typedef struct stats_ts_sample_s stats_ts_sample_t;
+struct stats_ts_sample_s {
+#define OP(name) uint64_t name;
+	STATS_TS_FIELDS
+#undef OP
+};
+
+/*
+ * Copies up to max of the most recent samples, oldest first, and returns how
+ * many were copied; with samples NULL, just returns how many there are.
+ */
+size_t stats_ts_read(tsdn_t *tsdn, stats_ts_sample_t *samples, size_t max);
+
+/*
+ * Background thread driven stats work (stats_bg and stats_ts).  Only called by
+ * background thread 0, without any locks held; returns the time until more
+ * work is due.
+ */
+bool stats_deferred_work_enabled(void);
+uint64_t stats_deferred_work(tsdn_t *tsdn);
+
 /* Implements je_malloc_stats_print. */
 void stats_print(write_cb_t *write_cb, void *cbopaque, const char *opts);
 
@@ -76,6 +76,9 @@ typedef ql_elm(tsd_t) tsd_link_t;
     O(stats_interval_last_event,	uint64_t,	uint64_t)	\
     O(peak_alloc_event_wait,	uint64_t,		uint64_t)	\
     O(peak_dalloc_event_wait,	uint64_t,	uint64_t)		\
+    O(latency_malloc_countdown,	uint64_t,		uint64_t)	\
+    O(latency_free_countdown,	uint64_t,		uint64_t)	\
+    O(latency_sampled,		bool,			bool)		\
     O(prof_tdata,		prof_tdata_t *,		prof_tdata_t *)	\
     O(prng_state,		uint64_t,		uint64_t)	\
     O(san_extents_until_guard_small,	uint64_t,	uint64_t)	\
@@ -109,6 +112,9 @@ typedef ql_elm(tsd_t) tsd_link_t;
     /* stats_interval_last_event */	0,				\
     /* peak_alloc_event_wait */		0,				\
     /* peak_dalloc_event_wait */	0,				\
+    /* latency_malloc_countdown */	0,				\
+    /* latency_free_countdown */	0,				\
+    /* latency_sampled */	false,					\
     /* prof_tdata */		NULL,					\
     /* prng_state */		0,					\
     /* san_extents_until_guard_small */	0,				\
@@ -76,8 +76,12 @@ enum witness_rank_e {
 	WITNESS_RANK_PROF_GDUMP = WITNESS_RANK_LEAF,
 	WITNESS_RANK_PROF_NEXT_THR_UID = WITNESS_RANK_LEAF,
 	WITNESS_RANK_PROF_RECENT_ALLOC = WITNESS_RANK_LEAF,
+	WITNESS_RANK_PROF_SAMPLE_ADAPT = WITNESS_RANK_LEAF,
 	WITNESS_RANK_PROF_STATS = WITNESS_RANK_LEAF,
 	WITNESS_RANK_PROF_THREAD_ACTIVE_INIT = WITNESS_RANK_LEAF,
+	WITNESS_RANK_PROF_WATERMARK = WITNESS_RANK_LEAF,
+	WITNESS_RANK_STATS_BG_HOOK = WITNESS_RANK_LEAF,
+	WITNESS_RANK_STATS_TS = WITNESS_RANK_LEAF,
 };
 typedef enum witness_rank_e witness_rank_t;
 
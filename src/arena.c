@@ -5,9 +5,12 @@
 #include "jemalloc/internal/decay.h"
 #include "jemalloc/internal/ehooks.h"
 #include "jemalloc/internal/extent_dss.h"
+#include "jemalloc/internal/extent_hugetlb.h"
 #include "jemalloc/internal/extent_mmap.h"
 #include "jemalloc/internal/san.h"
 #include "jemalloc/internal/mutex.h"
+#include "jemalloc/internal/nontemporal.h"
+#include "jemalloc/internal/probe.h"
 #include "jemalloc/internal/rtree.h"
 #include "jemalloc/internal/safety_check.h"
 #include "jemalloc/internal/util.h"
@@ -80,6 +83,82 @@ arena_basic_stats_merge(tsdn_t *tsdn, arena_t *arena, unsigned *nthreads,
 	pa_shard_basic_stats_merge(&arena->pa_shard, nactive, ndirty, nmuzzy);
 }
 
+/* Currently cached bytes and sanitizer-stashed bytes in tcache. */
+static void
+arena_stats_tcache_bytes_read_locked(tsdn_t *tsdn, arena_t *arena,
+    arena_stats_t *astats) {
+	malloc_mutex_assert_owner(tsdn, &arena->tcache_ql_mtx);
+
+	astats->tcache_bytes = 0;
+	astats->tcache_stashed_bytes = 0;
+	cache_bin_array_descriptor_t *descriptor;
+	ql_foreach(descriptor, &arena->cache_bin_array_descriptor_ql, link) {
+		for (szind_t i = 0; i < TCACHE_NBINS_MAX; i++) {
+			cache_bin_t *cache_bin = &descriptor->bins[i];
+			if (cache_bin_disabled(cache_bin)) {
+				continue;
+			}
+
+			cache_bin_sz_t ncached, nstashed;
+			cache_bin_nitems_get_remote(cache_bin, &ncached, &nstashed);
+			astats->tcache_bytes += ncached * sz_index2size(i);
+			astats->tcache_stashed_bytes += nstashed *
+			    sz_index2size(i);
+		}
+	}
+}
+
+/*
+ * Tcache contents change without the arena being involved, so they can't be
+ * carried over between refreshes like the rest of the arena's stats.
+ */
+void
+arena_stats_tcache_bytes_read(tsdn_t *tsdn, arena_t *arena,
+    arena_stats_t *astats) {
+	cassert(config_stats);
+
+	malloc_mutex_lock(tsdn, &arena->tcache_ql_mtx);
+	arena_stats_tcache_bytes_read_locked(tsdn, arena, astats);
+	malloc_mutex_unlock(tsdn, &arena->tcache_ql_mtx);
+}
+
+/*
+ * Base allocated, mapped and retained bytes, as arena_stats_merge() reports
+ * them.  These too can change without the arena's stats being touched, e.g. as
+ * the retained reserve is grown.
+ */
+void
+arena_stats_mapped_get(tsdn_t *tsdn, arena_t *arena, size_t *base,
+    size_t *mapped, size_t *retained) {
+	cassert(config_stats);
+
+	size_t base_edata_allocated, base_rtree_allocated, base_resident,
+	    base_mapped, metadata_thp;
+	base_stats_get(tsdn, arena->base, base, &base_edata_allocated,
+	    &base_rtree_allocated, &base_resident, &base_mapped, &metadata_thp);
+	*mapped = base_mapped + pac_mapped(&arena->pa_shard.pac);
+	*retained = ecache_npages_get(&arena->pa_shard.pac.ecache_retained) <<
+	    LG_PAGE;
+}
+
+/* Gathers the per arena mutex profiling data. */
+void
+arena_stats_mutex_prof_read(tsdn_t *tsdn, arena_t *arena,
+    mutex_prof_data_t mutex_prof_data[mutex_prof_num_arena_mutexes]) {
+	cassert(config_stats);
+
+#define READ_ARENA_MUTEX_PROF_DATA(mtx, ind)				\
+    malloc_mutex_lock(tsdn, &arena->mtx);				\
+    malloc_mutex_prof_read(tsdn, &mutex_prof_data[ind], &arena->mtx);	\
+    malloc_mutex_unlock(tsdn, &arena->mtx);
+
+	READ_ARENA_MUTEX_PROF_DATA(tcache_ql_mtx, arena_prof_mutex_tcache_list);
+	READ_ARENA_MUTEX_PROF_DATA(large_mtx, arena_prof_mutex_large);
+	READ_ARENA_MUTEX_PROF_DATA(base->mtx, arena_prof_mutex_base);
+#undef READ_ARENA_MUTEX_PROF_DATA
+	pa_shard_mtx_stats_read(tsdn, &arena->pa_shard, mutex_prof_data);
+}
+
 void
 arena_stats_merge(tsdn_t *tsdn, arena_t *arena, unsigned *nthreads,
     const char **dss, ssize_t *dirty_decay_ms, ssize_t *muzzy_decay_ms,
@@ -154,43 +233,8 @@ arena_stats_merge(tsdn_t *tsdn, arena_t *arena, unsigned *nthreads,
 
 	LOCKEDINT_MTX_UNLOCK(tsdn, arena->stats.mtx);
 
-	/* Currently cached bytes and sanitizer-stashed bytes in tcache. */
-	astats->tcache_bytes = 0;
-	astats->tcache_stashed_bytes = 0;
-	malloc_mutex_lock(tsdn, &arena->tcache_ql_mtx);
-	cache_bin_array_descriptor_t *descriptor;
-	ql_foreach(descriptor, &arena->cache_bin_array_descriptor_ql, link) {
-		for (szind_t i = 0; i < TCACHE_NBINS_MAX; i++) {
-			cache_bin_t *cache_bin = &descriptor->bins[i];
-			if (cache_bin_disabled(cache_bin)) {
-				continue;
-			}
-
-			cache_bin_sz_t ncached, nstashed;
-			cache_bin_nitems_get_remote(cache_bin, &ncached, &nstashed);
-			astats->tcache_bytes += ncached * sz_index2size(i);
-			astats->tcache_stashed_bytes += nstashed *
-			    sz_index2size(i);
-		}
-	}
-	malloc_mutex_prof_read(tsdn,
-	    &astats->mutex_prof_data[arena_prof_mutex_tcache_list],
-	    &arena->tcache_ql_mtx);
-	malloc_mutex_unlock(tsdn, &arena->tcache_ql_mtx);
-
-#define READ_ARENA_MUTEX_PROF_DATA(mtx, ind)				\
-    malloc_mutex_lock(tsdn, &arena->mtx);				\
-    malloc_mutex_prof_read(tsdn, &astats->mutex_prof_data[ind],		\
-        &arena->mtx);							\
-    malloc_mutex_unlock(tsdn, &arena->mtx);
-
-	/* Gather per arena mutex profiling data. */
-	READ_ARENA_MUTEX_PROF_DATA(large_mtx, arena_prof_mutex_large);
-	READ_ARENA_MUTEX_PROF_DATA(base->mtx,
-	    arena_prof_mutex_base);
-#undef READ_ARENA_MUTEX_PROF_DATA
-	pa_shard_mtx_stats_read(tsdn, &arena->pa_shard,
-	    astats->mutex_prof_data);
+	arena_stats_tcache_bytes_read(tsdn, arena, astats);
+	arena_stats_mutex_prof_read(tsdn, arena, astats->mutex_prof_data);
 
 	nstime_copy(&astats->uptime, &arena->create_time);
 	nstime_update(&astats->uptime);
@@ -204,6 +248,54 @@ arena_stats_merge(tsdn_t *tsdn, arena_t *arena, unsigned *nthreads,
 	}
 }
 
+void
+arena_stats_summary_merge(tsdn_t *tsdn, arena_t *arena,
+    arena_stats_summary_t *summary) {
+	cassert(config_stats);
+
+	size_t base_allocated, base_edata_allocated, base_rtree_allocated,
+	    base_resident, base_mapped, metadata_thp;
+	base_stats_get(tsdn, arena->base, &base_allocated,
+	    &base_edata_allocated, &base_rtree_allocated, &base_resident,
+	    &base_mapped, &metadata_thp);
+	pa_shard_t *shard = &arena->pa_shard;
+	summary->active += pa_shard_nactive(shard) << LG_PAGE;
+	summary->metadata += base_allocated + arena_internal_get(arena);
+	summary->metadata_edata += base_edata_allocated;
+	summary->metadata_rtree += base_rtree_allocated;
+	summary->metadata_thp += metadata_thp;
+	summary->resident += base_resident + ((pa_shard_nactive(shard) +
+	    pa_shard_ndirty(shard)) << LG_PAGE);
+	summary->mapped += base_mapped + pac_mapped(&shard->pac);
+	summary->retained += ecache_npages_get(&shard->pac.ecache_retained)
+	    << LG_PAGE;
+
+	LOCKEDINT_MTX_LOCK(tsdn, arena->stats.mtx);
+	for (szind_t i = 0; i < SC_NSIZES - SC_NBINS; i++) {
+		/* Read ndalloc first; see arena_stats_merge(). */
+		uint64_t ndalloc = locked_read_u64(tsdn,
+		    LOCKEDINT_MTX(arena->stats.mtx),
+		    &arena->stats.lstats[i].ndalloc);
+		uint64_t nmalloc = locked_read_u64(tsdn,
+		    LOCKEDINT_MTX(arena->stats.mtx),
+		    &arena->stats.lstats[i].nmalloc);
+		assert(nmalloc >= ndalloc);
+		summary->allocated += (size_t)(nmalloc - ndalloc) *
+		    sz_index2size(SC_NBINS + i);
+	}
+	LOCKEDINT_MTX_UNLOCK(tsdn, arena->stats.mtx);
+
+	for (szind_t i = 0; i < SC_NBINS; i++) {
+		for (unsigned j = 0; j < bin_infos[i].n_shards; j++) {
+			bin_t *bin = arena_get_bin(arena, i, j);
+			malloc_mutex_lock(tsdn, &bin->lock);
+			summary->allocated += bin->stats.curregs *
+			    sz_index2size(i);
+			malloc_mutex_unlock(tsdn, &bin->lock);
+		}
+	}
+}
+
 static void
 arena_background_thread_inactivity_check(tsdn_t *tsdn, arena_t *arena,
     bool is_background_thread) {
@@ -218,6 +310,39 @@ arena_background_thread_inactivity_check(tsdn_t *tsdn, arena_t *arena,
 	}
 }
 
+/*
+ * Growing retained memory ahead of demand can't wait for a background thread
+ * that is scheduled far out (e.g. for decay); wake it early if so.
+ */
+static void
+arena_background_thread_retained_check(tsdn_t *tsdn, arena_t *arena) {
+	pac_t *pac = &arena->pa_shard.pac;
+	if (!background_thread_enabled() || (pac_retained_deficit(pac) == 0 &&
+	    !pac_retain_lookahead_pending(pac))) {
+		return;
+	}
+	background_thread_info_t *info =
+	    arena_background_thread_info_get(arena);
+	if (malloc_mutex_trylock(tsdn, &info->mtx)) {
+		return;
+	}
+	if (background_thread_is_started(info) &&
+	    !background_thread_indefinite_sleep(info)) {
+		nstime_t remaining_sleep, now;
+		nstime_init(&remaining_sleep,
+		    background_thread_wakeup_time_get(info));
+		nstime_init_update(&now);
+		if (nstime_compare(&remaining_sleep, &now) > 0) {
+			nstime_subtract(&remaining_sleep, &now);
+			if (nstime_msec(&remaining_sleep) >
+			    PAC_RETAIN_LOOKAHEAD_INTERVAL_MS) {
+				background_thread_wakeup_early(info, NULL);
+			}
+		}
+	}
+	malloc_mutex_unlock(tsdn, &info->mtx);
+}
+
 /*
  * React to deferred work generated by a PAI function.
  */
@@ -229,10 +354,25 @@ void arena_handle_deferred_work(tsdn_t *tsdn, arena_t *arena) {
 		arena_decay_dirty(tsdn, arena, false, true);
 	}
 	arena_background_thread_inactivity_check(tsdn, arena, false);
+	arena_background_thread_retained_check(tsdn, arena);
+}
+
+/*
+ * Regions are handed out lowest-first, so once the region at regind has been
+ * allocated, the fresh (known-zero) ones are those above it.
+ */
+static inline void
+arena_slab_nfresh_update(edata_t *slab, const bin_info_t *bin_info,
+    size_t regind) {
+	if (regind + edata_nfresh_get(slab) >= bin_info->nregs) {
+		edata_nfresh_set(slab, (unsigned)(bin_info->nregs - regind -
+		    1));
+	}
 }
 
 static void *
-arena_slab_reg_alloc(edata_t *slab, const bin_info_t *bin_info) {
+arena_slab_reg_alloc(edata_t *slab, const bin_info_t *bin_info,
+    bool *zeroed) {
 	void *ret;
 	slab_data_t *slab_data = edata_slab_data_get(slab);
 	size_t regind;
@@ -243,6 +383,8 @@ arena_slab_reg_alloc(edata_t *slab, const bin_info_t *bin_info) {
 	regind = bitmap_sfu(slab_data->bitmap, &bin_info->bitmap_info);
 	ret = (void *)((byte_t *)edata_addr_get(slab) +
 	    (uintptr_t)(bin_info->reg_size * regind));
+	*zeroed = (regind + edata_nfresh_get(slab) >= bin_info->nregs);
+	arena_slab_nfresh_update(slab, bin_info, regind);
 	edata_nfree_dec(slab);
 	return ret;
 }
@@ -293,6 +435,10 @@ arena_slab_reg_alloc_batch(edata_t *slab, const bin_info_t *bin_info,
 		slab_data->bitmap[group] = g;
 	}
 #endif
+	/* The last region handed out is the highest one. */
+	arena_slab_nfresh_update(slab, bin_info,
+	    ((uintptr_t)ptrs[cnt - 1] - (uintptr_t)edata_addr_get(slab)) /
+	    bin_info->reg_size);
 	edata_nfree_sub(slab, cnt);
 }
 
@@ -317,6 +463,7 @@ arena_large_malloc_stats_update(tsdn_t *tsdn, arena_t *arena, size_t usize) {
 			&arena->stats.lstats[hindex].nmalloc, 1);
 		LOCKEDINT_MTX_UNLOCK(tsdn, arena->stats.mtx);
 	}
+	arena_stats_touch(arena);
 }
 
 static void
@@ -340,6 +487,7 @@ arena_large_dalloc_stats_update(tsdn_t *tsdn, arena_t *arena, size_t usize) {
 			&arena->stats.lstats[hindex].ndalloc, 1);
 		LOCKEDINT_MTX_UNLOCK(tsdn, arena->stats.mtx);
 	}
+	arena_stats_touch(arena);
 }
 
 static void
@@ -389,7 +537,7 @@ arena_extent_alloc_large(tsdn_t *tsdn, arena_t *arena, size_t usize,
 	if (zero && !zero_override && !edata_zeroed_get(edata)) {
 		void *addr = edata_addr_get(edata);
 		size_t usize = edata_usize_get(edata);
-		memset(addr, 0, usize);
+		nontemporal_zero(addr, usize);
 	}
 
 	return edata;
@@ -601,6 +749,8 @@ arena_do_deferred_work(tsdn_t *tsdn, arena_t *arena) {
 
 void
 arena_slab_dalloc(tsdn_t *tsdn, arena_t *arena, edata_t *slab) {
+	JE_PROBE3(slab_dalloc, arena_ind_get(arena), edata_szind_get(slab),
+	    edata_size_get(slab));
 	bool deferred_work_generated = false;
 	pa_dalloc(tsdn, &arena->pa_shard, slab, &deferred_work_generated);
 	if (deferred_work_generated) {
@@ -694,6 +844,7 @@ arena_bin_reset(tsd_t *tsd, arena_t *arena, bin_t *bin, unsigned binind) {
 	if (config_stats) {
 		bin->stats.curregs = 0;
 		bin->stats.curslabs = 0;
+		arena_stats_touch(arena);
 	}
 	malloc_mutex_unlock(tsd_tsdn(tsd), &bin->lock);
 }
@@ -969,10 +1120,13 @@ arena_slab_alloc(tsdn_t *tsdn, arena_t *arena, szind_t binind, unsigned binshard
 		return NULL;
 	}
 	assert(edata_slab_get(slab));
+	JE_PROBE3(slab_alloc, arena_ind_get(arena), binind,
+	    bin_info->slab_size);
 
 	/* Initialize slab internals. */
 	slab_data_t *slab_data = edata_slab_data_get(slab);
 	edata_nfree_binshard_set(slab, bin_info->nregs, binshard);
+	edata_nfresh_set(slab, edata_zeroed_get(slab) ? bin_info->nregs : 0);
 	bitmap_init(slab_data->bitmap, &bin_info->bitmap_info, false);
 
 	return slab;
@@ -1003,12 +1157,12 @@ arena_bin_refill_slabcur_with_fresh_slab(tsdn_t *tsdn, arena_t *arena,
 /* Refill slabcur and then alloc using the fresh slab */
 static void *
 arena_bin_malloc_with_fresh_slab(tsdn_t *tsdn, arena_t *arena, bin_t *bin,
-    szind_t binind, edata_t *fresh_slab) {
+    szind_t binind, edata_t *fresh_slab, bool *zeroed) {
 	malloc_mutex_assert_owner(tsdn, &bin->lock);
 	arena_bin_refill_slabcur_with_fresh_slab(tsdn, arena, bin, binind,
 	    fresh_slab);
 
-	return arena_slab_reg_alloc(bin->slabcur, &bin_infos[binind]);
+	return arena_slab_reg_alloc(bin->slabcur, &bin_infos[binind], zeroed);
 }
 
 static bool
@@ -1152,6 +1306,7 @@ label_refill:
 		bin->stats.curregs += filled;
 		bin->stats.nfills++;
 		cache_bin->tstats.nrequests = 0;
+		arena_stats_touch(arena);
 	}
 
 	arena_bin_flush_batch_before_unlock(tsdn, arena, bin, binind,
@@ -1182,6 +1337,7 @@ label_refill:
 		fresh_slab = NULL;
 	}
 
+	JE_PROBE4(tcache_fill, arena_ind_get(arena), binind, nfill, filled);
 	cache_bin_finish_fill(cache_bin, &ptrs, filled);
 	arena_decay_tick(tsdn, arena);
 }
@@ -1214,10 +1370,11 @@ arena_fill_small_fresh(tsdn_t *tsdn, arena_t *arena, szind_t binind,
 			batch = nregs;
 		}
 		assert(batch > 0);
+		bool zeroed = (edata_nfresh_get(slab) == nregs);
 		arena_slab_reg_alloc_batch(slab, bin_info, (unsigned)batch,
 		    &ptrs[filled]);
 		assert(edata_addr_get(slab) == ptrs[filled]);
-		if (zero) {
+		if (zero && !zeroed) {
 			memset(ptrs[filled], 0, batch * usize);
 		}
 		filled += batch;
@@ -1247,6 +1404,7 @@ arena_fill_small_fresh(tsdn_t *tsdn, arena_t *arena, szind_t binind,
 		bin->stats.nmalloc += filled;
 		bin->stats.nrequests += filled;
 		bin->stats.curregs += filled;
+		arena_stats_touch(arena);
 	}
 	malloc_mutex_unlock(tsdn, &bin->lock);
 
@@ -1260,7 +1418,7 @@ arena_fill_small_fresh(tsdn_t *tsdn, arena_t *arena, szind_t binind,
  */
 static void *
 arena_bin_malloc_no_fresh_slab(tsdn_t *tsdn, arena_t *arena, bin_t *bin,
-    szind_t binind) {
+    szind_t binind, bool *zeroed) {
 	malloc_mutex_assert_owner(tsdn, &bin->lock);
 	if (bin->slabcur == NULL || edata_nfree_get(bin->slabcur) == 0) {
 		if (arena_bin_refill_slabcur_no_fresh_slab(tsdn, arena, bin)) {
@@ -1269,7 +1427,7 @@ arena_bin_malloc_no_fresh_slab(tsdn_t *tsdn, arena_t *arena, bin_t *bin,
 	}
 
 	assert(bin->slabcur != NULL && edata_nfree_get(bin->slabcur) > 0);
-	return arena_slab_reg_alloc(bin->slabcur, &bin_infos[binind]);
+	return arena_slab_reg_alloc(bin->slabcur, &bin_infos[binind], zeroed);
 }
 
 static void *
@@ -1282,7 +1440,9 @@ arena_malloc_small(tsdn_t *tsdn, arena_t *arena, szind_t binind, bool zero) {
 
 	malloc_mutex_lock(tsdn, &bin->lock);
 	edata_t *fresh_slab = NULL;
-	void *ret = arena_bin_malloc_no_fresh_slab(tsdn, arena, bin, binind);
+	bool zeroed;
+	void *ret = arena_bin_malloc_no_fresh_slab(tsdn, arena, bin, binind,
+	    &zeroed);
 	if (ret == NULL) {
 		malloc_mutex_unlock(tsdn, &bin->lock);
 		/******************************/
@@ -1291,7 +1451,8 @@ arena_malloc_small(tsdn_t *tsdn, arena_t *arena, szind_t binind, bool zero) {
 		/********************************/
 		malloc_mutex_lock(tsdn, &bin->lock);
 		/* Retry since the lock was dropped. */
-		ret = arena_bin_malloc_no_fresh_slab(tsdn, arena, bin, binind);
+		ret = arena_bin_malloc_no_fresh_slab(tsdn, arena, bin, binind,
+		    &zeroed);
 		if (ret == NULL) {
 			if (fresh_slab == NULL) {
 				/* OOM */
@@ -1299,7 +1460,7 @@ arena_malloc_small(tsdn_t *tsdn, arena_t *arena, szind_t binind, bool zero) {
 				return NULL;
 			}
 			ret = arena_bin_malloc_with_fresh_slab(tsdn, arena, bin,
-			    binind, fresh_slab);
+			    binind, fresh_slab, &zeroed);
 			fresh_slab = NULL;
 		}
 	}
@@ -1307,13 +1468,14 @@ arena_malloc_small(tsdn_t *tsdn, arena_t *arena, szind_t binind, bool zero) {
 		bin->stats.nmalloc++;
 		bin->stats.nrequests++;
 		bin->stats.curregs++;
+		arena_stats_touch(arena);
 	}
 	malloc_mutex_unlock(tsdn, &bin->lock);
 
 	if (fresh_slab != NULL) {
 		arena_slab_dalloc(tsdn, arena, fresh_slab);
 	}
-	if (zero) {
+	if (zero && !zeroed) {
 		memset(ret, 0, usize);
 	}
 	arena_decay_tick(tsdn, arena);
@@ -1584,7 +1746,7 @@ arena_ralloc(tsdn_t *tsdn, arena_t *arena, void *ptr, size_t oldsize,
 	 * ipalloc()/arena_malloc().
 	 */
 	size_t copysize = (usize < oldsize) ? usize : oldsize;
-	memcpy(ret, ptr, copysize);
+	nontemporal_copy(ret, ptr, copysize);
 	isdalloct(tsdn, ptr, oldsize, tcache, NULL, true);
 	return ret;
 }
@@ -1701,7 +1863,15 @@ arena_new(tsdn_t *tsdn, unsigned ind, const arena_config_t *config) {
 	if (ind == 0) {
 		base = b0get();
 	} else {
-		base = base_new(tsdn, ind, config->extent_hooks,
+		/*
+		 * opt.hugetlb substitutes for the default hooks; arena 0 shares
+		 * b0 and is bootstrapped before it could take effect.
+		 */
+		extent_hooks_t *extent_hooks = config->extent_hooks;
+		if (extent_hooks == &ehooks_default_extent_hooks) {
+			extent_hooks = extent_hugetlb_hooks_get(opt_hugetlb);
+		}
+		base = base_new(tsdn, ind, extent_hooks,
 		    config->metadata_use_hooks);
 		if (base == NULL) {
 			return NULL;
@@ -1724,6 +1894,7 @@ arena_new(tsdn_t *tsdn, unsigned ind, const arena_config_t *config) {
 		if (arena_stats_init(tsdn, &arena->stats)) {
 			goto label_error;
 		}
+		atomic_store_b(&arena->stats_touched, true, ATOMIC_RELAXED);
 
 		ql_new(&arena->tcache_ql);
 		ql_new(&arena->cache_bin_array_descriptor_ql);
@@ -2,6 +2,7 @@
 #include "jemalloc/internal/jemalloc_internal_includes.h"
 
 #include "jemalloc/internal/assert.h"
+#include "jemalloc/internal/spin.h"
 
 JEMALLOC_DIAGNOSTIC_DISABLE_SPURIOUS
 
@@ -211,8 +212,21 @@ static bool
 background_thread_pause_check(tsdn_t *tsdn, background_thread_info_t *info) {
 	if (unlikely(info->state == background_thread_paused)) {
 		malloc_mutex_unlock(tsdn, &info->mtx);
-		/* Wait on global lock to update status. */
-		malloc_mutex_lock(tsdn, &background_thread_lock);
+		/*
+		 * Wait on global lock to update status.  Don't block on it
+		 * though: disabling the background threads holds the global
+		 * lock while thread 0 stops (and joins) the other threads,
+		 * which only changes info->state.
+		 */
+		spin_t spinner = SPIN_INITIALIZER;
+		while (malloc_mutex_trylock(tsdn, &background_thread_lock)) {
+			malloc_mutex_lock(tsdn, &info->mtx);
+			if (info->state != background_thread_paused) {
+				return true;
+			}
+			malloc_mutex_unlock(tsdn, &info->mtx);
+			spin_adaptive(&spinner);
+		}
 		malloc_mutex_unlock(tsdn, &background_thread_lock);
 		malloc_mutex_lock(tsdn, &info->mtx);
 		return true;
@@ -252,6 +266,43 @@ background_work_sleep_once(tsdn_t *tsdn, background_thread_info_t *info,
 		}
 	}
 
+	if (config_prof && ind == 0 && prof_watermark_enabled()) {
+		/*
+		 * Thread 0 also checks the heap profiling watermarks.  A check
+		 * only merges the arena stats and flags a pending dump (taken
+		 * by the next sampled allocation), but the merge takes every
+		 * arena's stats mutex, so drop ours for the duration.
+		 */
+		malloc_mutex_unlock(tsdn, &info->mtx);
+		uint64_t ns_watermark = prof_watermark_deferred_work(tsdn);
+		malloc_mutex_lock(tsdn, &info->mtx);
+		if (info->state != background_thread_started) {
+			/* Stopped or paused meanwhile; let the caller see. */
+			return;
+		}
+		if (ns_watermark < ns_until_deferred) {
+			ns_until_deferred = ns_watermark;
+		}
+	}
+
+	if (config_stats && ind == 0 && stats_deferred_work_enabled()) {
+		/*
+		 * Periodic stats output and sampling.  Formatting a report can
+		 * take long, and refreshing the stats reads the background
+		 * thread stats, so drop our mutex for the duration.
+		 */
+		malloc_mutex_unlock(tsdn, &info->mtx);
+		uint64_t ns_stats = stats_deferred_work(tsdn);
+		malloc_mutex_lock(tsdn, &info->mtx);
+		if (info->state != background_thread_started) {
+			/* Stopped or paused meanwhile; let the caller see. */
+			return;
+		}
+		if (ns_stats < ns_until_deferred) {
+			ns_until_deferred = ns_stats;
+		}
+	}
+
 	uint64_t sleep_ns;
 	if (ns_until_deferred == BACKGROUND_THREAD_DEFERRED_MAX) {
 		sleep_ns = BACKGROUND_THREAD_INDEFINITE_SLEEP;
@@ -46,9 +46,10 @@ base_map(tsdn_t *tsdn, ehooks_t *ehooks, unsigned ind, size_t size) {
 	assert(size == HUGEPAGE_CEILING(size));
 	size_t alignment = HUGEPAGE;
 	if (ehooks_are_default(ehooks)) {
-		addr = extent_alloc_mmap(NULL, size, alignment, &zero, &commit);
+		addr = extent_alloc_mmap(pages_caller_base, NULL, size,
+		    alignment, &zero, &commit);
 		if (have_madvise_huge && addr) {
-			pages_set_thp_state(addr, size);
+			pages_set_thp_state(pages_caller_base, addr, size);
 		}
 	} else {
 		addr = ehooks_alloc(tsdn, ehooks, NULL, size, alignment, &zero,
@@ -72,16 +73,16 @@ base_unmap(tsdn_t *tsdn, ehooks_t *ehooks, unsigned ind, void *addr,
 	 * in some consistent-but-allocated state.
 	 */
 	if (ehooks_are_default(ehooks)) {
-		if (!extent_dalloc_mmap(addr, size)) {
+		if (!extent_dalloc_mmap(pages_caller_base, addr, size)) {
 			goto label_done;
 		}
-		if (!pages_decommit(addr, size)) {
+		if (!pages_decommit(pages_caller_base, addr, size)) {
 			goto label_done;
 		}
-		if (!pages_purge_forced(addr, size)) {
+		if (!pages_purge_forced(pages_caller_base, addr, size)) {
 			goto label_done;
 		}
-		if (!pages_purge_lazy(addr, size)) {
+		if (!pages_purge_lazy(pages_caller_base, addr, size)) {
 			goto label_done;
 		}
 		/* Nothing worked.  This should never happen. */
@@ -106,7 +107,7 @@ label_done:
 		/* Set NOHUGEPAGE after unmap to avoid kernel defrag. */
 		assert(((uintptr_t)addr & HUGEPAGE_MASK) == 0 &&
 		    (size & HUGEPAGE_MASK) == 0);
-		pages_nohuge(addr, size);
+		pages_nohuge(pages_caller_base, addr, size);
 	}
 }
 
@@ -171,7 +172,7 @@ base_auto_thp_switch(tsdn_t *tsdn, base_t *base) {
 	base_block_t *block = base->blocks;
 	while (block != NULL) {
 		assert((block->size & HUGEPAGE_MASK) == 0);
-		pages_huge(block, block->size);
+		pages_huge(pages_caller_base, block, block->size);
 		if (config_stats) {
 			base->n_thp += HUGEPAGE_CEILING(block->size -
 			    edata_bsize_get(&block->edata)) >> LG_HUGEPAGE;
@@ -316,14 +317,14 @@ base_block_alloc(tsdn_t *tsdn, base_t *base, ehooks_t *ehooks, unsigned ind,
 		assert(((uintptr_t)addr & HUGEPAGE_MASK) == 0 &&
 		    (block_size & HUGEPAGE_MASK) == 0);
 		if (opt_metadata_thp == metadata_thp_always) {
-			pages_huge(addr, block_size);
+			pages_huge(pages_caller_base, addr, block_size);
 		} else if (opt_metadata_thp == metadata_thp_auto &&
 		    base != NULL) {
 			/* base != NULL indicates this is not a new base. */
 			malloc_mutex_lock(tsdn, &base->mtx);
 			base_auto_thp_switch(tsdn, base);
 			if (base->auto_thp_switched) {
-				pages_huge(addr, block_size);
+				pages_huge(pages_caller_base, addr, block_size);
 			}
 			malloc_mutex_unlock(tsdn, &base->mtx);
 		}
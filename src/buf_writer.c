@@ -46,6 +46,7 @@ buf_writer_init(tsdn_t *tsdn, buf_writer_t *buf_writer, write_cb_t *write_cb,
 		buf_writer->write_cb = je_malloc_message != NULL ?
 		    je_malloc_message : wrtmessage;
 	}
+	buf_writer->write_bytes_cb = NULL;
 	buf_writer->cbopaque = cbopaque;
 	assert(buf_len >= 2);
 	if (buf != NULL) {
@@ -72,8 +73,15 @@ buf_writer_flush(buf_writer_t *buf_writer) {
 	if (buf_writer->buf == NULL) {
 		return;
 	}
-	buf_writer->buf[buf_writer->buf_end] = '\0';
-	buf_writer->write_cb(buf_writer->cbopaque, buf_writer->buf);
+	if (buf_writer->write_bytes_cb != NULL) {
+		if (buf_writer->buf_end != 0) {
+			buf_writer->write_bytes_cb(buf_writer->cbopaque,
+			    buf_writer->buf, buf_writer->buf_end);
+		}
+	} else {
+		buf_writer->buf[buf_writer->buf_end] = '\0';
+		buf_writer->write_cb(buf_writer->cbopaque, buf_writer->buf);
+	}
 	buf_writer->buf_end = 0;
 	buf_writer_assert(buf_writer);
 }
@@ -83,7 +91,12 @@ buf_writer_cb(void *buf_writer_arg, const char *s) {
 	buf_writer_t *buf_writer = (buf_writer_t *)buf_writer_arg;
 	buf_writer_assert(buf_writer);
 	if (buf_writer->buf == NULL) {
-		buf_writer->write_cb(buf_writer->cbopaque, s);
+		if (buf_writer->write_bytes_cb != NULL) {
+			buf_writer->write_bytes_cb(buf_writer->cbopaque, s,
+			    strlen(s));
+		} else {
+			buf_writer->write_cb(buf_writer->cbopaque, s);
+		}
 		return;
 	}
 	size_t i, slen, n;
@@ -101,6 +114,44 @@ buf_writer_cb(void *buf_writer_arg, const char *s) {
 	assert(i == slen);
 }
 
+/*
+ * Switches the writer to binary output: buffered data is handed to
+ * write_bytes_cb with an explicit length, so that buf_writer_bytes() may be
+ * used to append arbitrary data.  String writes remain usable.
+ */
+void
+buf_writer_set_bytes_cb(buf_writer_t *buf_writer,
+    write_bytes_cb_t *write_bytes_cb) {
+	buf_writer_assert(buf_writer);
+	assert(write_bytes_cb != NULL);
+	buf_writer_flush(buf_writer);
+	buf_writer->write_bytes_cb = write_bytes_cb;
+}
+
+void
+buf_writer_bytes(buf_writer_t *buf_writer, const void *bytes, size_t len) {
+	buf_writer_assert(buf_writer);
+	assert(buf_writer->write_bytes_cb != NULL);
+	if (buf_writer->buf == NULL) {
+		buf_writer->write_bytes_cb(buf_writer->cbopaque, bytes, len);
+		return;
+	}
+	const char *b = (const char *)bytes;
+	size_t i, n;
+	for (i = 0; i < len; i += n) {
+		if (buf_writer->buf_end == buf_writer->buf_size) {
+			buf_writer_flush(buf_writer);
+		}
+		size_t remain = len - i;
+		size_t buf_remain = buf_writer->buf_size - buf_writer->buf_end;
+		n = remain < buf_remain ? remain : buf_remain;
+		memcpy(buf_writer->buf + buf_writer->buf_end, b + i, n);
+		buf_writer->buf_end += n;
+		buf_writer_assert(buf_writer);
+	}
+	assert(i == len);
+}
+
 void
 buf_writer_terminate(tsdn_t *tsdn, buf_writer_t *buf_writer) {
 	buf_writer_assert(buf_writer);
@@ -126,6 +177,7 @@ buf_writer_pipe(buf_writer_t *buf_writer, read_cb_t *read_cb,
 		buf_writer_init(TSDN_NULL, &backup_buf_writer,
 		    buf_writer->write_cb, buf_writer->cbopaque, backup_buf,
 		    sizeof(backup_buf));
+		backup_buf_writer.write_bytes_cb = buf_writer->write_bytes_cb;
 		buf_writer = &backup_buf_writer;
 	}
 	assert(buf_writer->buf != NULL);
@@ -74,16 +74,15 @@ ckh_bucket_search(ckh_t *ckh, size_t bucket, const void *key) {
 }
 
 /*
- * Search table for key and return cell number if found; SIZE_T_MAX otherwise.
+ * Search table for key, whose hashes are given, and return cell number if
+ * found; SIZE_T_MAX otherwise.
  */
 static size_t
-ckh_isearch(ckh_t *ckh, const void *key) {
-	size_t hashes[2], bucket, cell;
+ckh_isearch(ckh_t *ckh, const void *key, const size_t hashes[2]) {
+	size_t bucket, cell;
 
 	assert(ckh != NULL);
 
-	ckh->hash(key, hashes);
-
 	/* Search primary bucket. */
 	bucket = hashes[0] & ((ZU(1) << ckh->lg_curbuckets) - 1);
 	cell = ckh_bucket_search(ckh, bucket, key);
@@ -201,13 +200,12 @@ ckh_evict_reloc_insert(ckh_t *ckh, size_t argbucket, void const **argkey,
 }
 
 static bool
-ckh_try_insert(ckh_t *ckh, void const**argkey, void const**argdata) {
-	size_t hashes[2], bucket;
+ckh_try_insert(ckh_t *ckh, void const**argkey, void const**argdata,
+    const size_t hashes[2]) {
+	size_t bucket;
 	const void *key = *argkey;
 	const void *data = *argdata;
 
-	ckh->hash(key, hashes);
-
 	/* Try to insert in primary bucket. */
 	bucket = hashes[0] & ((ZU(1) << ckh->lg_curbuckets) - 1);
 	if (!ckh_try_bucket_insert(ckh, bucket, key, data)) {
@@ -234,6 +232,7 @@ static bool
 ckh_rebuild(ckh_t *ckh, ckhc_t *aTab) {
 	size_t count, i, nins;
 	const void *key, *data;
+	size_t hashes[2];
 
 	count = ckh->count;
 	ckh->count = 0;
@@ -241,7 +240,8 @@ ckh_rebuild(ckh_t *ckh, ckhc_t *aTab) {
 		if (aTab[i].key != NULL) {
 			key = aTab[i].key;
 			data = aTab[i].data;
-			if (ckh_try_insert(ckh, &key, &data)) {
+			ckh->hash(key, hashes);
+			if (ckh_try_insert(ckh, &key, &data, hashes)) {
 				ckh->count = count;
 				return true;
 			}
@@ -464,20 +464,38 @@ ckh_iter(ckh_t *ckh, size_t *tabind, void **key, void **data) {
 
 bool
 ckh_insert(tsd_t *tsd, ckh_t *ckh, const void *key, const void *data) {
+	size_t hashes[2];
+
+	assert(ckh != NULL);
+
+	ckh->hash(key, hashes);
+	return ckh_insert_hashed(tsd, ckh, key, data, hashes);
+}
+
+bool
+ckh_insert_hashed(tsd_t *tsd, ckh_t *ckh, const void *key, const void *data,
+    const size_t hashes[2]) {
 	bool ret;
+	size_t rehashes[2];
 
 	assert(ckh != NULL);
-	assert(ckh_search(ckh, key, NULL, NULL));
+	assert(ckh_search_hashed(ckh, key, NULL, NULL, hashes));
 
 #ifdef CKH_COUNT
 	ckh->ninserts++;
 #endif
 
-	while (ckh_try_insert(ckh, &key, &data)) {
+	while (ckh_try_insert(ckh, &key, &data, hashes)) {
 		if (ckh_grow(tsd, ckh)) {
 			ret = true;
 			goto label_return;
 		}
+		/*
+		 * A failed insertion leaves some other evicted item in
+		 * key/data, so the given hashes no longer apply.
+		 */
+		ckh->hash(key, rehashes);
+		hashes = rehashes;
 	}
 
 	ret = false;
@@ -488,11 +506,22 @@ label_return:
 bool
 ckh_remove(tsd_t *tsd, ckh_t *ckh, const void *searchkey, void **key,
     void **data) {
+	size_t hashes[2];
+
+	assert(ckh != NULL);
+
+	ckh->hash(searchkey, hashes);
+	return ckh_remove_hashed(tsd, ckh, searchkey, key, data, hashes);
+}
+
+bool
+ckh_remove_hashed(tsd_t *tsd, ckh_t *ckh, const void *searchkey, void **key,
+    void **data, const size_t hashes[2]) {
 	size_t cell;
 
 	assert(ckh != NULL);
 
-	cell = ckh_isearch(ckh, searchkey);
+	cell = ckh_isearch(ckh, searchkey, hashes);
 	if (cell != SIZE_T_MAX) {
 		if (key != NULL) {
 			*key = (void *)ckh->tab[cell].key;
@@ -520,11 +549,22 @@ ckh_remove(tsd_t *tsd, ckh_t *ckh, const void *searchkey, void **key,
 
 bool
 ckh_search(ckh_t *ckh, const void *searchkey, void **key, void **data) {
+	size_t hashes[2];
+
+	assert(ckh != NULL);
+
+	ckh->hash(searchkey, hashes);
+	return ckh_search_hashed(ckh, searchkey, key, data, hashes);
+}
+
+bool
+ckh_search_hashed(ckh_t *ckh, const void *searchkey, void **key, void **data,
+    const size_t hashes[2]) {
 	size_t cell;
 
 	assert(ckh != NULL);
 
-	cell = ckh_isearch(ckh, searchkey);
+	cell = ckh_isearch(ckh, searchkey, hashes);
 	if (cell != SIZE_T_MAX) {
 		if (key != NULL) {
 			*key = (void *)ckh->tab[cell].key;
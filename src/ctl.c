@@ -4,8 +4,10 @@
 #include "jemalloc/internal/assert.h"
 #include "jemalloc/internal/ctl.h"
 #include "jemalloc/internal/extent_dss.h"
+#include "jemalloc/internal/extent_hugetlb.h"
 #include "jemalloc/internal/extent_mmap.h"
 #include "jemalloc/internal/inspect.h"
+#include "jemalloc/internal/latency.h"
 #include "jemalloc/internal/mutex.h"
 #include "jemalloc/internal/nstime.h"
 #include "jemalloc/internal/peak_event.h"
@@ -30,6 +32,64 @@ static bool		ctl_initialized;
 static ctl_stats_t	*ctl_stats;
 static ctl_arenas_t	*ctl_arenas;
 
+/*
+ * The thread holding ctl_mtx across a batch of reads (see
+ * experimental_batch_read_ctl() and ctl_batch_trylock()), if any; the ctl
+ * functions it calls must not acquire ctl_mtx again.  Other threads never see
+ * their own tsd here, however stale their view.
+ */
+static atomic_p_t	ctl_mtx_batch_owner;
+
+/******************************************************************************/
+/* ctl_mtx helpers. */
+
+static bool
+ctl_mtx_batched(tsdn_t *tsdn) {
+	return !tsdn_null(tsdn) && atomic_load_p(&ctl_mtx_batch_owner,
+	    ATOMIC_RELAXED) == (void *)tsdn;
+}
+
+static void
+ctl_mtx_lock(tsdn_t *tsdn) {
+	if (!ctl_mtx_batched(tsdn)) {
+		malloc_mutex_lock(tsdn, &ctl_mtx);
+	}
+}
+
+static void
+ctl_mtx_unlock(tsdn_t *tsdn) {
+	if (!ctl_mtx_batched(tsdn)) {
+		malloc_mutex_unlock(tsdn, &ctl_mtx);
+	}
+}
+
+static void
+ctl_batch_begin(tsdn_t *tsdn) {
+	malloc_mutex_assert_owner(tsdn, &ctl_mtx);
+	atomic_store_p(&ctl_mtx_batch_owner, tsdn, ATOMIC_RELAXED);
+}
+
+static void
+ctl_batch_end(tsdn_t *tsdn) {
+	assert(ctl_mtx_batched(tsdn));
+	atomic_store_p(&ctl_mtx_batch_owner, NULL, ATOMIC_RELAXED);
+}
+
+bool
+ctl_batch_trylock(tsdn_t *tsdn) {
+	if (malloc_mutex_trylock(tsdn, &ctl_mtx)) {
+		return true;
+	}
+	ctl_batch_begin(tsdn);
+	return false;
+}
+
+void
+ctl_batch_unlock(tsdn_t *tsdn) {
+	ctl_batch_end(tsdn);
+	malloc_mutex_unlock(tsdn, &ctl_mtx);
+}
+
 /******************************************************************************/
 /* Helpers for named and indexed nodes. */
 
@@ -63,6 +123,7 @@ static const ctl_named_node_t	*n##_index(tsdn_t *tsdn,		\
 
 CTL_PROTO(version)
 CTL_PROTO(epoch)
+CTL_PROTO(epoch_summary)
 CTL_PROTO(background_thread)
 CTL_PROTO(max_background_threads)
 CTL_PROTO(thread_tcache_enabled)
@@ -74,6 +135,7 @@ CTL_PROTO(thread_peak_read)
 CTL_PROTO(thread_peak_reset)
 CTL_PROTO(thread_prof_name)
 CTL_PROTO(thread_prof_active)
+CTL_PROTO(thread_prof_alloc_tag)
 CTL_PROTO(thread_arena)
 CTL_PROTO(thread_allocated)
 CTL_PROTO(thread_allocatedp)
@@ -111,12 +173,19 @@ CTL_PROTO(opt_hpa_sec_bytes_after_flush)
 CTL_PROTO(opt_hpa_sec_batch_fill_extra)
 CTL_PROTO(opt_metadata_thp)
 CTL_PROTO(opt_retain)
+CTL_PROTO(opt_retain_lookahead_ms)
 CTL_PROTO(opt_dss)
+CTL_PROTO(opt_hugetlb)
+CTL_PROTO(opt_hugetlb_path)
+CTL_PROTO(opt_prefault)
+CTL_PROTO(opt_prefault_reserve)
 CTL_PROTO(opt_narenas)
 CTL_PROTO(opt_percpu_arena)
 CTL_PROTO(opt_oversize_threshold)
+CTL_PROTO(opt_nontemporal_threshold)
 CTL_PROTO(opt_background_thread)
 CTL_PROTO(opt_mutex_max_spin)
+CTL_PROTO(opt_mutex_prof_holders)
 CTL_PROTO(opt_max_background_threads)
 CTL_PROTO(opt_dirty_decay_ms)
 CTL_PROTO(opt_muzzy_decay_ms)
@@ -124,6 +193,14 @@ CTL_PROTO(opt_stats_print)
 CTL_PROTO(opt_stats_print_opts)
 CTL_PROTO(opt_stats_interval)
 CTL_PROTO(opt_stats_interval_opts)
+CTL_PROTO(opt_stats_bg_interval_ms)
+CTL_PROTO(opt_stats_bg_opts)
+CTL_PROTO(opt_stats_bg_delta)
+CTL_PROTO(opt_stats_bg_fd)
+CTL_PROTO(opt_stats_ts_interval_ms)
+CTL_PROTO(opt_stats_ts_nsamples)
+CTL_PROTO(opt_stats_latency)
+CTL_PROTO(opt_lg_stats_latency_sample)
 CTL_PROTO(opt_junk)
 CTL_PROTO(opt_zero)
 CTL_PROTO(opt_utrace)
@@ -150,17 +227,26 @@ CTL_PROTO(opt_prof_active)
 CTL_PROTO(opt_prof_thread_active_init)
 CTL_PROTO(opt_prof_bt_max)
 CTL_PROTO(opt_lg_prof_sample)
+CTL_PROTO(opt_prof_sample_target)
 CTL_PROTO(opt_lg_prof_interval)
 CTL_PROTO(opt_prof_gdump)
+CTL_PROTO(opt_prof_watermark_allocated)
+CTL_PROTO(opt_prof_watermark_resident)
+CTL_PROTO(opt_prof_watermark_growth)
+CTL_PROTO(opt_prof_watermark_hysteresis)
+CTL_PROTO(opt_prof_watermark_interval_ms)
 CTL_PROTO(opt_prof_final)
 CTL_PROTO(opt_prof_leak)
 CTL_PROTO(opt_prof_leak_error)
 CTL_PROTO(opt_prof_accum)
+CTL_PROTO(opt_prof_lifetime)
 CTL_PROTO(opt_prof_pid_namespace)
 CTL_PROTO(opt_prof_recent_alloc_max)
 CTL_PROTO(opt_prof_stats)
 CTL_PROTO(opt_prof_sys_thread_name)
 CTL_PROTO(opt_prof_time_res)
+CTL_PROTO(opt_prof_backtrace_method)
+CTL_PROTO(opt_prof_format)
 CTL_PROTO(opt_lg_san_uaf_align)
 CTL_PROTO(opt_zero_realloc)
 CTL_PROTO(opt_malloc_conf_symlink)
@@ -180,7 +266,11 @@ CTL_PROTO(arena_i_oversize_threshold)
 CTL_PROTO(arena_i_dirty_decay_ms)
 CTL_PROTO(arena_i_muzzy_decay_ms)
 CTL_PROTO(arena_i_extent_hooks)
+CTL_PROTO(arena_i_hugetlb)
+CTL_PROTO(arena_i_prefault)
+CTL_PROTO(arena_i_prefault_reserve)
 CTL_PROTO(arena_i_retain_grow_limit)
+CTL_PROTO(arena_i_retain_lookahead_ms)
 CTL_PROTO(arena_i_name)
 INDEX_PROTO(arena_i)
 CTL_PROTO(arenas_bin_i_size)
@@ -217,6 +307,9 @@ INDEX_PROTO(prof_stats_bins_i)
 CTL_PROTO(prof_stats_lextents_i_live)
 CTL_PROTO(prof_stats_lextents_i_accum)
 INDEX_PROTO(prof_stats_lextents_i)
+CTL_PROTO(prof_stats_tags_i_live)
+CTL_PROTO(prof_stats_tags_i_accum)
+INDEX_PROTO(prof_stats_tags_i)
 CTL_PROTO(stats_arenas_i_small_allocated)
 CTL_PROTO(stats_arenas_i_small_nmalloc)
 CTL_PROTO(stats_arenas_i_small_ndalloc)
@@ -337,6 +430,7 @@ CTL_PROTO(experimental_hooks_prof_dump)
 CTL_PROTO(experimental_hooks_prof_sample)
 CTL_PROTO(experimental_hooks_prof_sample_free)
 CTL_PROTO(experimental_hooks_safety_check_abort)
+CTL_PROTO(experimental_hooks_stats_bg)
 CTL_PROTO(experimental_thread_activity_callback)
 CTL_PROTO(experimental_utilization_query)
 CTL_PROTO(experimental_utilization_batch_query)
@@ -344,7 +438,11 @@ CTL_PROTO(experimental_arenas_i_pactivep)
 INDEX_PROTO(experimental_arenas_i)
 CTL_PROTO(experimental_prof_recent_alloc_max)
 CTL_PROTO(experimental_prof_recent_alloc_dump)
+CTL_PROTO(experimental_prof_dump)
 CTL_PROTO(experimental_batch_alloc)
+CTL_PROTO(experimental_batch_read)
+CTL_PROTO(experimental_stats_snapshot)
+CTL_PROTO(experimental_stats_ts)
 CTL_PROTO(experimental_arenas_create_ext)
 
 #define MUTEX_STATS_CTL_PROTO_GEN(n)					\
@@ -354,7 +452,8 @@ CTL_PROTO(stats_##n##_num_spin_acq)					\
 CTL_PROTO(stats_##n##_num_owner_switch)					\
 CTL_PROTO(stats_##n##_total_wait_time)					\
 CTL_PROTO(stats_##n##_max_wait_time)					\
-CTL_PROTO(stats_##n##_max_num_thds)
+CTL_PROTO(stats_##n##_max_num_thds)					\
+CTL_PROTO(stats_##n##_wait_histogram)
 
 /* Global mutexes. */
 #define OP(mtx) MUTEX_STATS_CTL_PROTO_GEN(mutexes_##mtx)
@@ -371,6 +470,21 @@ MUTEX_STATS_CTL_PROTO_GEN(arenas_i_bins_j_mutex)
 #undef MUTEX_STATS_CTL_PROTO_GEN
 
 CTL_PROTO(stats_mutexes_reset)
+CTL_PROTO(stats_mutexes_holders_i_site)
+CTL_PROTO(stats_mutexes_holders_i_num_wait)
+CTL_PROTO(stats_mutexes_holders_i_total_wait_time)
+INDEX_PROTO(stats_mutexes_holders_i)
+
+#define OP(tier)							\
+CTL_PROTO(stats_latency_##tier##_nsamples)				\
+CTL_PROTO(stats_latency_##tier##_total_ns)				\
+CTL_PROTO(stats_latency_##tier##_histogram)
+LATENCY_TIERS
+#undef OP
+
+CTL_PROTO(stats_pages_caller_op_ncalls)
+CTL_PROTO(stats_pages_caller_op_bytes)
+CTL_PROTO(stats_pages_caller_op_total_ns)
 
 /******************************************************************************/
 /* mallctl tree. */
@@ -408,7 +522,8 @@ static const ctl_named_node_t	thread_peak_node[] = {
 
 static const ctl_named_node_t	thread_prof_node[] = {
 	{NAME("name"),		CTL(thread_prof_name)},
-	{NAME("active"),	CTL(thread_prof_active)}
+	{NAME("active"),	CTL(thread_prof_active)},
+	{NAME("alloc_tag"),	CTL(thread_prof_alloc_tag)}
 };
 
 static const ctl_named_node_t	thread_node[] = {
@@ -468,11 +583,18 @@ static const ctl_named_node_t opt_node[] = {
 		CTL(opt_hpa_sec_batch_fill_extra)},
 	{NAME("metadata_thp"),	CTL(opt_metadata_thp)},
 	{NAME("retain"),	CTL(opt_retain)},
+	{NAME("retain_lookahead_ms"),	CTL(opt_retain_lookahead_ms)},
 	{NAME("dss"),		CTL(opt_dss)},
+	{NAME("hugetlb"),	CTL(opt_hugetlb)},
+	{NAME("hugetlb_path"),	CTL(opt_hugetlb_path)},
+	{NAME("prefault"),	CTL(opt_prefault)},
+	{NAME("prefault_reserve"),	CTL(opt_prefault_reserve)},
 	{NAME("narenas"),	CTL(opt_narenas)},
 	{NAME("percpu_arena"),	CTL(opt_percpu_arena)},
 	{NAME("oversize_threshold"),	CTL(opt_oversize_threshold)},
+	{NAME("nontemporal_threshold"),	CTL(opt_nontemporal_threshold)},
 	{NAME("mutex_max_spin"),	CTL(opt_mutex_max_spin)},
+	{NAME("mutex_prof_holders"),	CTL(opt_mutex_prof_holders)},
 	{NAME("background_thread"),	CTL(opt_background_thread)},
 	{NAME("max_background_threads"),	CTL(opt_max_background_threads)},
 	{NAME("dirty_decay_ms"), CTL(opt_dirty_decay_ms)},
@@ -481,6 +603,14 @@ static const ctl_named_node_t opt_node[] = {
 	{NAME("stats_print_opts"),	CTL(opt_stats_print_opts)},
 	{NAME("stats_interval"),	CTL(opt_stats_interval)},
 	{NAME("stats_interval_opts"),	CTL(opt_stats_interval_opts)},
+	{NAME("stats_bg_interval_ms"),	CTL(opt_stats_bg_interval_ms)},
+	{NAME("stats_bg_opts"),	CTL(opt_stats_bg_opts)},
+	{NAME("stats_bg_delta"),	CTL(opt_stats_bg_delta)},
+	{NAME("stats_bg_fd"),	CTL(opt_stats_bg_fd)},
+	{NAME("stats_ts_interval_ms"),	CTL(opt_stats_ts_interval_ms)},
+	{NAME("stats_ts_nsamples"),	CTL(opt_stats_ts_nsamples)},
+	{NAME("stats_latency"),	CTL(opt_stats_latency)},
+	{NAME("lg_stats_latency_sample"),	CTL(opt_lg_stats_latency_sample)},
 	{NAME("junk"),		CTL(opt_junk)},
 	{NAME("zero"),		CTL(opt_zero)},
 	{NAME("utrace"),	CTL(opt_utrace)},
@@ -512,17 +642,28 @@ static const ctl_named_node_t opt_node[] = {
 	{NAME("prof_thread_active_init"), CTL(opt_prof_thread_active_init)},
 	{NAME("prof_bt_max"), CTL(opt_prof_bt_max)},
 	{NAME("lg_prof_sample"), CTL(opt_lg_prof_sample)},
+	{NAME("prof_sample_target"), CTL(opt_prof_sample_target)},
 	{NAME("lg_prof_interval"), CTL(opt_lg_prof_interval)},
 	{NAME("prof_gdump"),	CTL(opt_prof_gdump)},
+	{NAME("prof_watermark_allocated"), CTL(opt_prof_watermark_allocated)},
+	{NAME("prof_watermark_resident"), CTL(opt_prof_watermark_resident)},
+	{NAME("prof_watermark_growth"),	CTL(opt_prof_watermark_growth)},
+	{NAME("prof_watermark_hysteresis"),
+		CTL(opt_prof_watermark_hysteresis)},
+	{NAME("prof_watermark_interval_ms"),
+		CTL(opt_prof_watermark_interval_ms)},
 	{NAME("prof_final"),	CTL(opt_prof_final)},
 	{NAME("prof_leak"),	CTL(opt_prof_leak)},
 	{NAME("prof_leak_error"),	CTL(opt_prof_leak_error)},
 	{NAME("prof_accum"),	CTL(opt_prof_accum)},
+	{NAME("prof_lifetime"),	CTL(opt_prof_lifetime)},
 	{NAME("prof_pid_namespace"),	CTL(opt_prof_pid_namespace)},
 	{NAME("prof_recent_alloc_max"),	CTL(opt_prof_recent_alloc_max)},
 	{NAME("prof_stats"),	CTL(opt_prof_stats)},
 	{NAME("prof_sys_thread_name"),	CTL(opt_prof_sys_thread_name)},
 	{NAME("prof_time_resolution"),	CTL(opt_prof_time_res)},
+	{NAME("prof_backtrace_method"),	CTL(opt_prof_backtrace_method)},
+	{NAME("prof_format"),	CTL(opt_prof_format)},
 	{NAME("lg_san_uaf_align"),	CTL(opt_lg_san_uaf_align)},
 	{NAME("zero_realloc"),	CTL(opt_zero_realloc)},
 	{NAME("debug_double_free_max_scan"),
@@ -551,7 +692,11 @@ static const ctl_named_node_t arena_i_node[] = {
 	{NAME("dirty_decay_ms"),	CTL(arena_i_dirty_decay_ms)},
 	{NAME("muzzy_decay_ms"),	CTL(arena_i_muzzy_decay_ms)},
 	{NAME("extent_hooks"),		CTL(arena_i_extent_hooks)},
+	{NAME("hugetlb"),		CTL(arena_i_hugetlb)},
+	{NAME("prefault"),		CTL(arena_i_prefault)},
+	{NAME("prefault_reserve"),	CTL(arena_i_prefault_reserve)},
 	{NAME("retain_grow_limit"),	CTL(arena_i_retain_grow_limit)},
+	{NAME("retain_lookahead_ms"),	CTL(arena_i_retain_lookahead_ms)},
 	{NAME("name"),			CTL(arena_i_name)}
 };
 static const ctl_named_node_t super_arena_i_node[] = {
@@ -629,9 +774,23 @@ static const ctl_indexed_node_t prof_stats_lextents_node[] = {
 	{INDEX(prof_stats_lextents_i)}
 };
 
+static const ctl_named_node_t prof_stats_tags_i_node[] = {
+	{NAME("live"),		CTL(prof_stats_tags_i_live)},
+	{NAME("accum"),		CTL(prof_stats_tags_i_accum)}
+};
+
+static const ctl_named_node_t super_prof_stats_tags_i_node[] = {
+	{NAME(""),		CHILD(named, prof_stats_tags_i)}
+};
+
+static const ctl_indexed_node_t prof_stats_tags_node[] = {
+	{INDEX(prof_stats_tags_i)}
+};
+
 static const ctl_named_node_t	prof_stats_node[] = {
 	{NAME("bins"),		CHILD(indexed, prof_stats_bins)},
 	{NAME("lextents"),	CHILD(indexed, prof_stats_lextents)},
+	{NAME("tags"),		CHILD(indexed, prof_stats_tags)},
 };
 
 static const ctl_named_node_t	prof_node[] = {
@@ -681,7 +840,9 @@ static const ctl_named_node_t stats_##prefix##_node[] = {		\
 	{NAME("max_wait_time"),						\
 	 CTL(stats_##prefix##_max_wait_time)},				\
 	{NAME("max_num_thds"),						\
-	 CTL(stats_##prefix##_max_num_thds)}				\
+	 CTL(stats_##prefix##_max_num_thds)},				\
+	{NAME("wait_histogram"),					\
+	 CTL(stats_##prefix##_wait_histogram)}				\
 	/* Note that # of current waiting thread not provided. */	\
 };
 
@@ -882,14 +1043,67 @@ static const ctl_named_node_t stats_background_thread_node[] = {
 MUTEX_PROF_GLOBAL_MUTEXES
 #undef OP
 
+static const ctl_named_node_t stats_mutexes_holders_i_node[] = {
+	{NAME("site"),		CTL(stats_mutexes_holders_i_site)},
+	{NAME("num_wait"),	CTL(stats_mutexes_holders_i_num_wait)},
+	{NAME("total_wait_time"),
+	 CTL(stats_mutexes_holders_i_total_wait_time)}
+};
+
+static const ctl_named_node_t super_stats_mutexes_holders_i_node[] = {
+	{NAME(""),		CHILD(named, stats_mutexes_holders_i)}
+};
+
+static const ctl_indexed_node_t stats_mutexes_holders_node[] = {
+	{INDEX(stats_mutexes_holders_i)}
+};
+
 static const ctl_named_node_t stats_mutexes_node[] = {
 #define OP(mtx) {NAME(#mtx), CHILD(named, stats_mutexes_##mtx)},
 MUTEX_PROF_GLOBAL_MUTEXES
 #undef OP
-	{NAME("reset"),		CTL(stats_mutexes_reset)}
+	{NAME("reset"),		CTL(stats_mutexes_reset)},
+	{NAME("holders"),	CHILD(indexed, stats_mutexes_holders)}
 };
 #undef MUTEX_PROF_DATA_NODE
 
+#define OP(tier)							\
+static const ctl_named_node_t stats_latency_##tier##_node[] = {		\
+	{NAME("nsamples"),	CTL(stats_latency_##tier##_nsamples)},	\
+	{NAME("total_ns"),	CTL(stats_latency_##tier##_total_ns)},	\
+	{NAME("histogram"),	CTL(stats_latency_##tier##_histogram)}	\
+};
+LATENCY_TIERS
+#undef OP
+
+static const ctl_named_node_t stats_latency_node[] = {
+#define OP(tier) {NAME(#tier), CHILD(named, stats_latency_##tier)},
+LATENCY_TIERS
+#undef OP
+};
+
+/*
+ * stats.pages.<caller>.<op>.*; all callers and ops share their children, and
+ * the handlers find the caller and op in mib[2] and mib[3].
+ */
+static const ctl_named_node_t stats_pages_caller_op_node[] = {
+	{NAME("ncalls"),	CTL(stats_pages_caller_op_ncalls)},
+	{NAME("bytes"),		CTL(stats_pages_caller_op_bytes)},
+	{NAME("total_ns"),	CTL(stats_pages_caller_op_total_ns)}
+};
+
+static const ctl_named_node_t stats_pages_caller_node[] = {
+#define OP(op) {NAME(#op), CHILD(named, stats_pages_caller_op)},
+PAGES_OPS
+#undef OP
+};
+
+static const ctl_named_node_t stats_pages_node[] = {
+#define OP(caller) {NAME(#caller), CHILD(named, stats_pages_caller)},
+PAGES_CALLERS
+#undef OP
+};
+
 static const ctl_named_node_t stats_node[] = {
 	{NAME("allocated"),	CTL(stats_allocated)},
 	{NAME("active"),	CTL(stats_active)},
@@ -905,6 +1119,8 @@ static const ctl_named_node_t stats_node[] = {
 	{NAME("mutexes"),	CHILD(named, stats_mutexes)},
 	{NAME("arenas"),	CHILD(indexed, stats_arenas)},
 	{NAME("zero_reallocs"),	CTL(stats_zero_reallocs)},
+	{NAME("latency"),	CHILD(named, stats_latency)},
+	{NAME("pages"),		CHILD(named, stats_pages)},
 };
 
 static const ctl_named_node_t experimental_hooks_node[] = {
@@ -915,6 +1131,7 @@ static const ctl_named_node_t experimental_hooks_node[] = {
 	{NAME("prof_sample"),	CTL(experimental_hooks_prof_sample)},
 	{NAME("prof_sample_free"),	CTL(experimental_hooks_prof_sample_free)},
 	{NAME("safety_check_abort"),	CTL(experimental_hooks_safety_check_abort)},
+	{NAME("stats_bg"),	CTL(experimental_hooks_stats_bg)},
 };
 
 static const ctl_named_node_t experimental_thread_node[] = {
@@ -949,13 +1166,18 @@ static const ctl_named_node_t experimental_node[] = {
 	{NAME("arenas"),	CHILD(indexed, experimental_arenas)},
 	{NAME("arenas_create_ext"),	CTL(experimental_arenas_create_ext)},
 	{NAME("prof_recent"),	CHILD(named, experimental_prof_recent)},
+	{NAME("prof_dump"),	CTL(experimental_prof_dump)},
 	{NAME("batch_alloc"),	CTL(experimental_batch_alloc)},
+	{NAME("batch_read"),	CTL(experimental_batch_read)},
+	{NAME("stats_snapshot"),	CTL(experimental_stats_snapshot)},
+	{NAME("stats_ts"),	CTL(experimental_stats_ts)},
 	{NAME("thread"),	CHILD(named, experimental_thread)}
 };
 
 static const ctl_named_node_t	root_node[] = {
 	{NAME("version"),	CTL(version)},
 	{NAME("epoch"),		CTL(epoch)},
+	{NAME("epoch_summary"),	CTL(epoch_summary)},
 	{NAME("background_thread"),	CTL(background_thread)},
 	{NAME("max_background_threads"),	CTL(max_background_threads)},
 	{NAME("thread"),	CHILD(named, thread)},
@@ -1319,6 +1541,55 @@ ctl_arena_refresh(tsdn_t *tsdn, arena_t *arena, ctl_arena_t *ctl_sdarena,
 	ctl_arena_stats_sdmerge(ctl_sdarena, ctl_arena, destroyed);
 }
 
+/*
+ * Whether nothing ctl reports about an untouched arena may have changed since
+ * it was last merged; in that case, refreshes the few values that change
+ * regardless.  Bin and large stats changes set arena->stats_touched, page level
+ * activity (including retained growth) shows in the page and mapping counts,
+ * and purging and hugification in the decay and HPA counters.  Mutex profiling
+ * counters are the exception: they are left as of the last merge.  Tcache
+ * contents are always re-read.
+ */
+static bool
+ctl_arena_unchanged(tsdn_t *tsdn, ctl_arena_t *ctl_arena, arena_t *arena) {
+	if (!config_stats) {
+		return false;
+	}
+	unsigned nthreads = 0;
+	const char *dss;
+	ssize_t dirty_decay_ms, muzzy_decay_ms;
+	size_t pactive = 0;
+	size_t pdirty = 0;
+	size_t pmuzzy = 0;
+	arena_basic_stats_merge(tsdn, arena, &nthreads, &dss, &dirty_decay_ms,
+	    &muzzy_decay_ms, &pactive, &pdirty, &pmuzzy);
+	if (nthreads != ctl_arena->nthreads || pactive != ctl_arena->pactive ||
+	    pdirty != ctl_arena->pdirty || pmuzzy != ctl_arena->pmuzzy) {
+		return false;
+	}
+	arena_stats_t *astats = &ctl_arena->astats->astats;
+	size_t base, mapped, retained;
+	arena_stats_mapped_get(tsdn, arena, &base, &mapped, &retained);
+	if (base != astats->base || mapped != astats->mapped ||
+	    retained != astats->pa_shard_stats.pac_stats.retained) {
+		return false;
+	}
+	if (pa_shard_nwork_get(tsdn, &arena->pa_shard) != pa_shard_stats_nwork(
+	    &astats->pa_shard_stats, &ctl_arena->astats->hpastats)) {
+		return false;
+	}
+	ctl_arena->dss = dss;
+	ctl_arena->dirty_decay_ms = dirty_decay_ms;
+	ctl_arena->muzzy_decay_ms = muzzy_decay_ms;
+	arena_stats_tcache_bytes_read(tsdn, arena, astats);
+
+	nstime_t *uptime = &astats->uptime;
+	nstime_copy(uptime, &arena->create_time);
+	nstime_update(uptime);
+	nstime_subtract(uptime, &arena->create_time);
+	return true;
+}
+
 static unsigned
 ctl_arena_init(tsd_t *tsd, const arena_config_t *config) {
 	unsigned arena_ind;
@@ -1362,6 +1633,47 @@ ctl_background_thread_stats_read(tsdn_t *tsdn) {
 	    &stats->max_counter_per_bg_thd);
 }
 
+/*
+ * Reads the profiling data of the global mutexes, all but max_per_bg_thd (see
+ * ctl_background_thread_stats_read()).
+ */
+static void
+ctl_global_mutex_prof_read(tsdn_t *tsdn,
+    mutex_prof_data_t mutex_prof_data[mutex_prof_num_global_mutexes]) {
+	malloc_mutex_assert_owner(tsdn, &ctl_mtx);
+
+#define READ_GLOBAL_MUTEX_PROF_DATA(i, mtx)				\
+    malloc_mutex_lock(tsdn, &mtx);					\
+    malloc_mutex_prof_read(tsdn, &mutex_prof_data[i], &mtx);		\
+    malloc_mutex_unlock(tsdn, &mtx);
+
+	if (config_prof && opt_prof) {
+		prof_bt2gctx_mutex_prof_read(tsdn,
+		    &mutex_prof_data[global_prof_mutex_prof]);
+		READ_GLOBAL_MUTEX_PROF_DATA(global_prof_mutex_prof_thds_data,
+		    tdatas_mtx);
+		READ_GLOBAL_MUTEX_PROF_DATA(global_prof_mutex_prof_dump,
+		    prof_dump_mtx);
+		READ_GLOBAL_MUTEX_PROF_DATA(
+		    global_prof_mutex_prof_recent_alloc, prof_recent_alloc_mtx);
+		READ_GLOBAL_MUTEX_PROF_DATA(global_prof_mutex_prof_recent_dump,
+		    prof_recent_dump_mtx);
+		READ_GLOBAL_MUTEX_PROF_DATA(global_prof_mutex_prof_stats,
+		    prof_stats_mtx);
+	}
+	if (have_background_thread) {
+		READ_GLOBAL_MUTEX_PROF_DATA(global_prof_mutex_background_thread,
+		    background_thread_lock);
+	} else {
+		memset(&mutex_prof_data[global_prof_mutex_background_thread], 0,
+		    sizeof(mutex_prof_data_t));
+	}
+	/* We own ctl mutex already. */
+	malloc_mutex_prof_read(tsdn, &mutex_prof_data[global_prof_mutex_ctl],
+	    &ctl_mtx);
+#undef READ_GLOBAL_MUTEX_PROF_DATA
+}
+
 static void
 ctl_refresh(tsdn_t *tsdn) {
 	malloc_mutex_assert_owner(tsdn, &ctl_mtx);
@@ -1390,9 +1702,22 @@ ctl_refresh(tsdn_t *tsdn) {
 	for (unsigned i = 0; i < narenas; i++) {
 		ctl_arena_t *ctl_arena = arenas_i(i);
 		bool initialized = (tarenas[i] != NULL);
+		bool merged = ctl_arena->initialized;
 
 		ctl_arena->initialized = initialized;
-		if (initialized) {
+		if (!initialized) {
+			continue;
+		}
+		/*
+		 * Only re-merge arenas that changed since the last refresh.  The
+		 * flag is cleared ahead of the merge, so that changes racing with
+		 * it get picked up next time.
+		 */
+		bool touched = arena_stats_touched_reset(tarenas[i]);
+		if (merged && !touched && ctl_arena_unchanged(tsdn, ctl_arena,
+		    tarenas[i])) {
+			ctl_arena_stats_sdmerge(ctl_sarena, ctl_arena, false);
+		} else {
 			ctl_arena_refresh(tsdn, tarenas[i], ctl_sarena, i,
 			    false);
 		}
@@ -1417,42 +1742,39 @@ ctl_refresh(tsdn_t *tsdn) {
 		    .pa_shard_stats.pac_stats.retained;
 
 		ctl_background_thread_stats_read(tsdn);
+		ctl_global_mutex_prof_read(tsdn, ctl_stats->mutex_prof_data);
+	}
+	ctl_arenas->epoch++;
+}
 
-#define READ_GLOBAL_MUTEX_PROF_DATA(i, mtx)				\
-    malloc_mutex_lock(tsdn, &mtx);					\
-    malloc_mutex_prof_read(tsdn, &ctl_stats->mutex_prof_data[i], &mtx);	\
-    malloc_mutex_unlock(tsdn, &mtx);
+/*
+ * Refreshes only the summary stats (stats.allocated and friends), computed
+ * straight from the arenas; per arena stats keep their values from the last
+ * full refresh.
+ */
+static void
+ctl_refresh_summary(tsdn_t *tsdn) {
+	malloc_mutex_assert_owner(tsdn, &ctl_mtx);
 
-		if (config_prof && opt_prof) {
-			READ_GLOBAL_MUTEX_PROF_DATA(
-			    global_prof_mutex_prof, bt2gctx_mtx);
-			READ_GLOBAL_MUTEX_PROF_DATA(
-			    global_prof_mutex_prof_thds_data, tdatas_mtx);
-			READ_GLOBAL_MUTEX_PROF_DATA(
-			    global_prof_mutex_prof_dump, prof_dump_mtx);
-			READ_GLOBAL_MUTEX_PROF_DATA(
-			    global_prof_mutex_prof_recent_alloc,
-			    prof_recent_alloc_mtx);
-			READ_GLOBAL_MUTEX_PROF_DATA(
-			    global_prof_mutex_prof_recent_dump,
-			    prof_recent_dump_mtx);
-			READ_GLOBAL_MUTEX_PROF_DATA(
-			    global_prof_mutex_prof_stats, prof_stats_mtx);
-		}
-		if (have_background_thread) {
-			READ_GLOBAL_MUTEX_PROF_DATA(
-			    global_prof_mutex_background_thread,
-			    background_thread_lock);
-		} else {
-			memset(&ctl_stats->mutex_prof_data[
-			    global_prof_mutex_background_thread], 0,
-			    sizeof(mutex_prof_data_t));
+	if (config_stats) {
+		arena_stats_summary_t summary = {0};
+		const unsigned narenas = ctl_arenas->narenas;
+		for (unsigned i = 0; i < narenas; i++) {
+			arena_t *arena = arena_get(tsdn, i, false);
+			if (arena != NULL) {
+				arena_stats_summary_merge(tsdn, arena,
+				    &summary);
+			}
 		}
-		/* We own ctl mutex already. */
-		malloc_mutex_prof_read(tsdn,
-		    &ctl_stats->mutex_prof_data[global_prof_mutex_ctl],
-		    &ctl_mtx);
-#undef READ_GLOBAL_MUTEX_PROF_DATA
+		ctl_stats->allocated = summary.allocated;
+		ctl_stats->active = summary.active;
+		ctl_stats->metadata = summary.metadata;
+		ctl_stats->metadata_edata = summary.metadata_edata;
+		ctl_stats->metadata_rtree = summary.metadata_rtree;
+		ctl_stats->metadata_thp = summary.metadata_thp;
+		ctl_stats->resident = summary.resident;
+		ctl_stats->mapped = summary.mapped;
+		ctl_stats->retained = summary.retained;
 	}
 	ctl_arenas->epoch++;
 }
@@ -1462,7 +1784,7 @@ ctl_init(tsd_t *tsd) {
 	bool ret;
 	tsdn_t *tsdn = tsd_tsdn(tsd);
 
-	malloc_mutex_lock(tsdn, &ctl_mtx);
+	ctl_mtx_lock(tsdn);
 	if (!ctl_initialized) {
 		ctl_arena_t *ctl_sarena, *ctl_darena;
 		unsigned i;
@@ -1529,7 +1851,7 @@ ctl_init(tsd_t *tsd) {
 
 	ret = false;
 label_return:
-	malloc_mutex_unlock(tsdn, &ctl_mtx);
+	ctl_mtx_unlock(tsdn);
 	return ret;
 }
 
@@ -1901,6 +2223,26 @@ ctl_mtx_assert_held(tsdn_t *tsdn) {
 	}								\
 } while (0)
 
+/*
+ * Reads a whole array.  Unlike with READ(), a size mismatch is an error with
+ * nothing copied, and *oldlenp is always set to the array size, so that it can
+ * be queried with oldp == NULL.
+ */
+#define READ_ARRAY(v)	do {						\
+	if (oldlenp == NULL) {						\
+		ret = EINVAL;						\
+		goto label_return;					\
+	}								\
+	if (oldp != NULL) {						\
+		if (*oldlenp != sizeof(v)) {				\
+			ret = EINVAL;					\
+			goto label_return;				\
+		}							\
+		memcpy(oldp, (void *)(v), sizeof(v));			\
+	}								\
+	*oldlenp = sizeof(v);						\
+} while (0)
+
 #define WRITE(v, t)	do {						\
 	if (newp != NULL) {						\
 		if (newlen != sizeof(t)) {				\
@@ -1941,14 +2283,14 @@ n##_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,			\
 	if (!(c)) {							\
 		return ENOENT;						\
 	}								\
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);			\
+	ctl_mtx_lock(tsd_tsdn(tsd));					\
 	READONLY();							\
 	oldval = (v);							\
 	READ(oldval, t);						\
 									\
 	ret = 0;							\
 label_return:								\
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);			\
+	ctl_mtx_unlock(tsd_tsdn(tsd));					\
 	return ret;							\
 }
 
@@ -1959,14 +2301,14 @@ n##_ctl(tsd_t *tsd, const size_t *mib, size_t miblen, void *oldp,	\
 	int ret;							\
 	t oldval;							\
 									\
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);			\
+	ctl_mtx_lock(tsd_tsdn(tsd));					\
 	READONLY();							\
 	oldval = (v);							\
 	READ(oldval, t);						\
 									\
 	ret = 0;							\
 label_return:								\
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);			\
+	ctl_mtx_unlock(tsd_tsdn(tsd));					\
 	return ret;							\
 }
 
@@ -2035,7 +2377,7 @@ epoch_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
 	int ret;
 	UNUSED uint64_t newval;
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_lock(tsd_tsdn(tsd));
 	WRITE(newval, uint64_t);
 	if (newp != NULL) {
 		ctl_refresh(tsd_tsdn(tsd));
@@ -2044,7 +2386,26 @@ epoch_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
 
 	ret = 0;
 label_return:
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_unlock(tsd_tsdn(tsd));
+	return ret;
+}
+
+static int
+epoch_summary_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
+    void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	int ret;
+	UNUSED uint64_t newval;
+
+	ctl_mtx_lock(tsd_tsdn(tsd));
+	WRITE(newval, uint64_t);
+	if (newp != NULL) {
+		ctl_refresh_summary(tsd_tsdn(tsd));
+	}
+	READ(ctl_arenas->epoch, uint64_t);
+
+	ret = 0;
+label_return:
+	ctl_mtx_unlock(tsd_tsdn(tsd));
 	return ret;
 }
 
@@ -2060,7 +2421,7 @@ background_thread_ctl(tsd_t *tsd, const size_t *mib,
 	}
 	background_thread_ctl_init(tsd_tsdn(tsd));
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_lock(tsd_tsdn(tsd));
 	malloc_mutex_lock(tsd_tsdn(tsd), &background_thread_lock);
 	if (newp == NULL) {
 		oldval = background_thread_enabled();
@@ -2095,7 +2456,7 @@ background_thread_ctl(tsd_t *tsd, const size_t *mib,
 	ret = 0;
 label_return:
 	malloc_mutex_unlock(tsd_tsdn(tsd), &background_thread_lock);
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_unlock(tsd_tsdn(tsd));
 
 	return ret;
 }
@@ -2112,7 +2473,7 @@ max_background_threads_ctl(tsd_t *tsd, const size_t *mib,
 	}
 	background_thread_ctl_init(tsd_tsdn(tsd));
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_lock(tsd_tsdn(tsd));
 	malloc_mutex_lock(tsd_tsdn(tsd), &background_thread_lock);
 	if (newp == NULL) {
 		oldval = max_background_threads;
@@ -2154,7 +2515,7 @@ max_background_threads_ctl(tsd_t *tsd, const size_t *mib,
 	ret = 0;
 label_return:
 	malloc_mutex_unlock(tsd_tsdn(tsd), &background_thread_lock);
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_unlock(tsd_tsdn(tsd));
 
 	return ret;
 }
@@ -2211,12 +2572,20 @@ CTL_RO_NL_GEN(opt_hpa_sec_batch_fill_extra, opt_hpa_sec_opts.batch_fill_extra,
 CTL_RO_NL_GEN(opt_metadata_thp, metadata_thp_mode_names[opt_metadata_thp],
     const char *)
 CTL_RO_NL_GEN(opt_retain, opt_retain, bool)
+CTL_RO_NL_GEN(opt_retain_lookahead_ms, opt_retain_lookahead_ms, unsigned)
 CTL_RO_NL_GEN(opt_dss, opt_dss, const char *)
+CTL_RO_NL_GEN(opt_hugetlb, hugetlb_mode_names[opt_hugetlb], const char *)
+CTL_RO_NL_GEN(opt_hugetlb_path, opt_hugetlb_path, const char *)
+CTL_RO_NL_GEN(opt_prefault, prefault_mode_names[opt_prefault], const char *)
+CTL_RO_NL_GEN(opt_prefault_reserve, opt_prefault_reserve, size_t)
 CTL_RO_NL_GEN(opt_narenas, opt_narenas, unsigned)
 CTL_RO_NL_GEN(opt_percpu_arena, percpu_arena_mode_names[opt_percpu_arena],
     const char *)
 CTL_RO_NL_GEN(opt_mutex_max_spin, opt_mutex_max_spin, int64_t)
+CTL_RO_NL_CGEN(config_stats, opt_mutex_prof_holders, opt_mutex_prof_holders,
+    bool)
 CTL_RO_NL_GEN(opt_oversize_threshold, opt_oversize_threshold, size_t)
+CTL_RO_NL_GEN(opt_nontemporal_threshold, opt_nontemporal_threshold, size_t)
 CTL_RO_NL_GEN(opt_background_thread, opt_background_thread, bool)
 CTL_RO_NL_GEN(opt_max_background_threads, opt_max_background_threads, size_t)
 CTL_RO_NL_GEN(opt_dirty_decay_ms, opt_dirty_decay_ms, ssize_t)
@@ -2225,6 +2594,19 @@ CTL_RO_NL_GEN(opt_stats_print, opt_stats_print, bool)
 CTL_RO_NL_GEN(opt_stats_print_opts, opt_stats_print_opts, const char *)
 CTL_RO_NL_GEN(opt_stats_interval, opt_stats_interval, int64_t)
 CTL_RO_NL_GEN(opt_stats_interval_opts, opt_stats_interval_opts, const char *)
+CTL_RO_NL_CGEN(config_stats, opt_stats_bg_interval_ms,
+    opt_stats_bg_interval_ms, int64_t)
+CTL_RO_NL_CGEN(config_stats, opt_stats_bg_opts, opt_stats_bg_opts,
+    const char *)
+CTL_RO_NL_CGEN(config_stats, opt_stats_bg_delta, opt_stats_bg_delta, bool)
+CTL_RO_NL_CGEN(config_stats, opt_stats_bg_fd, opt_stats_bg_fd, int)
+CTL_RO_NL_CGEN(config_stats, opt_stats_ts_interval_ms,
+    opt_stats_ts_interval_ms, int64_t)
+CTL_RO_NL_CGEN(config_stats, opt_stats_ts_nsamples, opt_stats_ts_nsamples,
+    size_t)
+CTL_RO_NL_CGEN(config_stats, opt_stats_latency, opt_stats_latency, bool)
+CTL_RO_NL_CGEN(config_stats, opt_lg_stats_latency_sample,
+    opt_lg_stats_latency_sample, size_t)
 CTL_RO_NL_CGEN(config_fill, opt_junk, opt_junk, const char *)
 CTL_RO_NL_CGEN(config_fill, opt_zero, opt_zero, bool)
 CTL_RO_NL_CGEN(config_utrace, opt_utrace, opt_utrace, bool)
@@ -2260,11 +2642,24 @@ CTL_RO_NL_CGEN(config_prof, opt_prof_thread_active_init,
     opt_prof_thread_active_init, bool)
 CTL_RO_NL_CGEN(config_prof, opt_prof_bt_max, opt_prof_bt_max, unsigned)
 CTL_RO_NL_CGEN(config_prof, opt_lg_prof_sample, opt_lg_prof_sample, size_t)
+CTL_RO_NL_CGEN(config_prof, opt_prof_sample_target, opt_prof_sample_target,
+    size_t)
 CTL_RO_NL_CGEN(config_prof, opt_prof_accum, opt_prof_accum, bool)
+CTL_RO_NL_CGEN(config_prof, opt_prof_lifetime, opt_prof_lifetime, bool)
 CTL_RO_NL_CGEN(config_prof, opt_prof_pid_namespace, opt_prof_pid_namespace,
     bool)
 CTL_RO_NL_CGEN(config_prof, opt_lg_prof_interval, opt_lg_prof_interval, ssize_t)
 CTL_RO_NL_CGEN(config_prof, opt_prof_gdump, opt_prof_gdump, bool)
+CTL_RO_NL_CGEN(config_prof, opt_prof_watermark_allocated,
+    opt_prof_watermark_allocated, size_t)
+CTL_RO_NL_CGEN(config_prof, opt_prof_watermark_resident,
+    opt_prof_watermark_resident, size_t)
+CTL_RO_NL_CGEN(config_prof, opt_prof_watermark_growth,
+    opt_prof_watermark_growth, unsigned)
+CTL_RO_NL_CGEN(config_prof, opt_prof_watermark_hysteresis,
+    opt_prof_watermark_hysteresis, unsigned)
+CTL_RO_NL_CGEN(config_prof, opt_prof_watermark_interval_ms,
+    opt_prof_watermark_interval_ms, unsigned)
 CTL_RO_NL_CGEN(config_prof, opt_prof_final, opt_prof_final, bool)
 CTL_RO_NL_CGEN(config_prof, opt_prof_leak, opt_prof_leak, bool)
 CTL_RO_NL_CGEN(config_prof, opt_prof_leak_error, opt_prof_leak_error, bool)
@@ -2275,6 +2670,10 @@ CTL_RO_NL_CGEN(config_prof, opt_prof_sys_thread_name, opt_prof_sys_thread_name,
     bool)
 CTL_RO_NL_CGEN(config_prof, opt_prof_time_res,
     prof_time_res_mode_names[opt_prof_time_res], const char *)
+CTL_RO_NL_CGEN(config_prof, opt_prof_backtrace_method,
+    prof_backtrace_method_names[opt_prof_backtrace_method], const char *)
+CTL_RO_NL_CGEN(config_prof, opt_prof_format,
+    prof_format_names[opt_prof_format], const char *)
 CTL_RO_NL_CGEN(config_uaf_detection, opt_lg_san_uaf_align,
     opt_lg_san_uaf_align, ssize_t)
 CTL_RO_NL_GEN(opt_zero_realloc,
@@ -2600,6 +2999,40 @@ label_return:
 	return ret;
 }
 
+static int
+thread_prof_alloc_tag_ctl(tsd_t *tsd, const size_t *mib,
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp,
+    size_t newlen) {
+	int ret;
+	unsigned oldval;
+
+	if (!config_prof || !opt_prof) {
+		return ENOENT;
+	}
+
+	oldval = prof_thread_alloc_tag_get(tsd);
+	if (newp != NULL) {
+		if (newlen != sizeof(unsigned)) {
+			ret = EINVAL;
+			goto label_return;
+		}
+		unsigned newval = *(unsigned *)newp;
+		if (newval >= PROF_ALLOC_NTAGS) {
+			ret = EINVAL;
+			goto label_return;
+		}
+		if (prof_thread_alloc_tag_set(tsd, newval)) {
+			ret = EAGAIN;
+			goto label_return;
+		}
+	}
+	READ(oldval, unsigned);
+
+	ret = 0;
+label_return:
+	return ret;
+}
+
 static int
 thread_idle_ctl(tsd_t *tsd, const size_t *mib,
     size_t miblen, void *oldp, size_t *oldlenp, void *newp,
@@ -2697,9 +3130,9 @@ arena_i_initialized_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
 	READONLY();
 	MIB_UNSIGNED(arena_ind, 1);
 
-	malloc_mutex_lock(tsdn, &ctl_mtx);
+	ctl_mtx_lock(tsdn);
 	initialized = arenas_i(arena_ind)->initialized;
-	malloc_mutex_unlock(tsdn, &ctl_mtx);
+	ctl_mtx_unlock(tsdn);
 
 	READ(initialized, bool);
 
@@ -2710,7 +3143,7 @@ label_return:
 
 static void
 arena_i_decay(tsdn_t *tsdn, unsigned arena_ind, bool all) {
-	malloc_mutex_lock(tsdn, &ctl_mtx);
+	ctl_mtx_lock(tsdn);
 	{
 		unsigned narenas = ctl_arenas->narenas;
 
@@ -2730,7 +3163,7 @@ arena_i_decay(tsdn_t *tsdn, unsigned arena_ind, bool all) {
 			 * No further need to hold ctl_mtx, since narenas and
 			 * tarenas contain everything needed below.
 			 */
-			malloc_mutex_unlock(tsdn, &ctl_mtx);
+			ctl_mtx_unlock(tsdn);
 
 			for (i = 0; i < narenas; i++) {
 				if (tarenas[i] != NULL) {
@@ -2746,7 +3179,7 @@ arena_i_decay(tsdn_t *tsdn, unsigned arena_ind, bool all) {
 			tarena = arena_get(tsdn, arena_ind, false);
 
 			/* No further need to hold ctl_mtx. */
-			malloc_mutex_unlock(tsdn, &ctl_mtx);
+			ctl_mtx_unlock(tsdn);
 
 			if (tarena != NULL) {
 				arena_decay(tsdn, tarena, false, all);
@@ -2864,7 +3297,7 @@ arena_i_destroy_ctl(tsd_t *tsd, const size_t *mib, size_t miblen, void *oldp,
 	arena_t *arena;
 	ctl_arena_t *ctl_darena, *ctl_arena;
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_lock(tsd_tsdn(tsd));
 
 	ret = arena_i_reset_destroy_helper(tsd, mib, miblen, oldp, oldlenp,
 	    newp, newlen, &arena_ind, &arena);
@@ -2885,6 +3318,12 @@ arena_i_destroy_ctl(tsd_t *tsd, const size_t *mib, size_t miblen, void *oldp,
 	ctl_darena = arenas_i(MALLCTL_ARENAS_DESTROYED);
 	ctl_darena->initialized = true;
 	ctl_arena_refresh(tsd_tsdn(tsd), arena, ctl_darena, arena_ind, true);
+	if (config_stats) {
+		for (unsigned i = 0; i < latency_num_tiers; i++) {
+			latency_hist_merge(&arena->latency[i],
+			    &ctl_stats->latency_destroyed[i]);
+		}
+	}
 	/* Destroy arena. */
 	arena_destroy(tsd, arena);
 	ctl_arena = arenas_i(arena_ind);
@@ -2896,7 +3335,7 @@ arena_i_destroy_ctl(tsd_t *tsd, const size_t *mib, size_t miblen, void *oldp,
 
 	assert(ret == 0);
 label_return:
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_unlock(tsd_tsdn(tsd));
 
 	return ret;
 }
@@ -2909,7 +3348,7 @@ arena_i_dss_ctl(tsd_t *tsd, const size_t *mib, size_t miblen, void *oldp,
 	unsigned arena_ind;
 	dss_prec_t dss_prec = dss_prec_limit;
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_lock(tsd_tsdn(tsd));
 	WRITE(dss, const char *);
 	MIB_UNSIGNED(arena_ind, 1);
 	if (dss != NULL) {
@@ -2958,7 +3397,7 @@ arena_i_dss_ctl(tsd_t *tsd, const size_t *mib, size_t miblen, void *oldp,
 
 	ret = 0;
 label_return:
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_unlock(tsd_tsdn(tsd));
 	return ret;
 }
 
@@ -3052,7 +3491,7 @@ arena_i_extent_hooks_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
 	unsigned arena_ind;
 	arena_t *arena;
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_lock(tsd_tsdn(tsd));
 	MIB_UNSIGNED(arena_ind, 1);
 	if (arena_ind < narenas_total_get()) {
 		extent_hooks_t *old_extent_hooks;
@@ -3101,77 +3540,242 @@ arena_i_extent_hooks_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
 	}
 	ret = 0;
 label_return:
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_unlock(tsd_tsdn(tsd));
 	return ret;
 }
 
 static int
-arena_i_retain_grow_limit_ctl(tsd_t *tsd, const size_t *mib,
-    size_t miblen, void *oldp, size_t *oldlenp, void *newp,
-    size_t newlen) {
+arena_i_hugetlb_ctl(tsd_t *tsd, const size_t *mib, size_t miblen, void *oldp,
+    size_t *oldlenp, void *newp, size_t newlen) {
 	int ret;
+	const char *hugetlb = NULL;
+	extent_hooks_t *new_extent_hooks = NULL;
 	unsigned arena_ind;
-	arena_t *arena;
 
-	if (!opt_retain) {
-		/* Only relevant when retain is enabled. */
-		return ENOENT;
+	ctl_mtx_lock(tsd_tsdn(tsd));
+	WRITE(hugetlb, const char *);
+	MIB_UNSIGNED(arena_ind, 1);
+	if (hugetlb != NULL) {
+		int i;
+		for (i = 0; i < hugetlb_mode_limit; i++) {
+			if (strcmp(hugetlb_mode_names[i], hugetlb) == 0) {
+				new_extent_hooks = extent_hugetlb_hooks_get(i);
+				break;
+			}
+		}
+		/* Unknown, or not supported on this system. */
+		if (new_extent_hooks == NULL) {
+			ret = EINVAL;
+			goto label_return;
+		}
 	}
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);
+	arena_t *arena = NULL;
+	if (arena_ind < narenas_total_get()) {
+		arena = arena_get(tsd_tsdn(tsd), arena_ind, false);
+	}
+	if (arena == NULL) {
+		ret = EFAULT;
+		goto label_return;
+	}
+	hugetlb = hugetlb_mode_names[extent_hugetlb_mode_get(
+	    ehooks_get_extent_hooks_ptr(arena_get_ehooks(arena)))];
+	if (new_extent_hooks != NULL) {
+		arena_set_extent_hooks(tsd, arena, new_extent_hooks);
+	}
+	READ(hugetlb, const char *);
+
+	ret = 0;
+label_return:
+	ctl_mtx_unlock(tsd_tsdn(tsd));
+	return ret;
+}
+
+static int
+arena_i_prefault_ctl(tsd_t *tsd, const size_t *mib, size_t miblen, void *oldp,
+    size_t *oldlenp, void *newp, size_t newlen) {
+	int ret;
+	const char *prefault = NULL;
+	prefault_mode_t new_prefault = prefault_mode_limit;
+	unsigned arena_ind;
+
+	ctl_mtx_lock(tsd_tsdn(tsd));
+	WRITE(prefault, const char *);
 	MIB_UNSIGNED(arena_ind, 1);
-	if (arena_ind < narenas_total_get() && (arena =
-	    arena_get(tsd_tsdn(tsd), arena_ind, false)) != NULL) {
-		size_t old_limit, new_limit;
-		if (newp != NULL) {
-			WRITE(new_limit, size_t);
+	if (prefault != NULL) {
+		int i;
+		for (i = 0; i < prefault_mode_limit; i++) {
+			if (strcmp(prefault_mode_names[i], prefault) == 0) {
+				new_prefault = i;
+				break;
+			}
 		}
-		bool err = arena_retain_grow_limit_get_set(tsd, arena,
-		    &old_limit, newp != NULL ? &new_limit : NULL);
-		if (!err) {
-			READ(old_limit, size_t);
-			ret = 0;
-		} else {
-			ret = EFAULT;
+		if (new_prefault == prefault_mode_limit) {
+			ret = EINVAL;
+			goto label_return;
 		}
-	} else {
+	}
+
+	arena_t *arena = NULL;
+	if (arena_ind < narenas_total_get()) {
+		arena = arena_get(tsd_tsdn(tsd), arena_ind, false);
+	}
+	if (arena == NULL) {
 		ret = EFAULT;
+		goto label_return;
 	}
+	prefault = prefault_mode_names[pac_prefault_get(
+	    &arena->pa_shard.pac)];
+	if (new_prefault != prefault_mode_limit) {
+		pac_prefault_set(&arena->pa_shard.pac, new_prefault);
+		/* Enabling prefaulting may have armed the reserve. */
+		arena_handle_deferred_work(tsd_tsdn(tsd), arena);
+	}
+	READ(prefault, const char *);
+
+	ret = 0;
 label_return:
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_unlock(tsd_tsdn(tsd));
 	return ret;
 }
 
-/*
- * When writing, newp should point to a char array storing the name to be set.
- * A name longer than ARENA_NAME_LEN will be arbitrarily cut. When reading,
- * oldp should point to a char array whose length is no shorter than
- * ARENA_NAME_LEN or the length of the name when it was set.
- */
 static int
-arena_i_name_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
+arena_i_prefault_reserve_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
     void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
 	int ret;
 	unsigned arena_ind;
-	char *name;
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_lock(tsd_tsdn(tsd));
 	MIB_UNSIGNED(arena_ind, 1);
-	if (arena_ind == MALLCTL_ARENAS_ALL || arena_ind >=
-	    ctl_arenas->narenas) {
-		ret = EINVAL;
-		goto label_return;
+	arena_t *arena = NULL;
+	if (arena_ind < narenas_total_get()) {
+		arena = arena_get(tsd_tsdn(tsd), arena_ind, false);
 	}
-	arena_t *arena = arena_get(tsd_tsdn(tsd), arena_ind, false);
 	if (arena == NULL) {
 		ret = EFAULT;
 		goto label_return;
 	}
 
 	if (oldp != NULL && oldlenp != NULL) {
-		/*
-		 * Read the arena name.  When reading, the input oldp should
-		 * point to an array with a length no shorter than
+		size_t oldval = pac_prefault_reserve_get(&arena->pa_shard.pac);
+		READ(oldval, size_t);
+	}
+	if (newp != NULL) {
+		if (newlen != sizeof(size_t)) {
+			ret = EINVAL;
+			goto label_return;
+		}
+		pac_prefault_reserve_set(&arena->pa_shard.pac,
+		    *(size_t *)newp);
+		/* Wake up the background thread to fill the reserve. */
+		arena_handle_deferred_work(tsd_tsdn(tsd), arena);
+	}
+	ret = 0;
+label_return:
+	ctl_mtx_unlock(tsd_tsdn(tsd));
+	return ret;
+}
+
+static int
+arena_i_retain_grow_limit_ctl(tsd_t *tsd, const size_t *mib,
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp,
+    size_t newlen) {
+	int ret;
+	unsigned arena_ind;
+	arena_t *arena;
+
+	if (!opt_retain) {
+		/* Only relevant when retain is enabled. */
+		return ENOENT;
+	}
+
+	ctl_mtx_lock(tsd_tsdn(tsd));
+	MIB_UNSIGNED(arena_ind, 1);
+	if (arena_ind < narenas_total_get() && (arena =
+	    arena_get(tsd_tsdn(tsd), arena_ind, false)) != NULL) {
+		size_t old_limit, new_limit;
+		if (newp != NULL) {
+			WRITE(new_limit, size_t);
+		}
+		bool err = arena_retain_grow_limit_get_set(tsd, arena,
+		    &old_limit, newp != NULL ? &new_limit : NULL);
+		if (!err) {
+			READ(old_limit, size_t);
+			ret = 0;
+		} else {
+			ret = EFAULT;
+		}
+	} else {
+		ret = EFAULT;
+	}
+label_return:
+	ctl_mtx_unlock(tsd_tsdn(tsd));
+	return ret;
+}
+
+static int
+arena_i_retain_lookahead_ms_ctl(tsd_t *tsd, const size_t *mib,
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp,
+    size_t newlen) {
+	int ret;
+	unsigned arena_ind;
+	arena_t *arena;
+
+	if (!opt_retain) {
+		/* Only relevant when retain is enabled. */
+		return ENOENT;
+	}
+
+	MIB_UNSIGNED(arena_ind, 1);
+	if (arena_ind < narenas_total_get() && (arena =
+	    arena_get(tsd_tsdn(tsd), arena_ind, false)) != NULL) {
+		unsigned old_lookahead_ms = pac_retain_lookahead_ms_get(
+		    &arena->pa_shard.pac);
+		if (newp != NULL) {
+			unsigned new_lookahead_ms;
+			WRITE(new_lookahead_ms, unsigned);
+			pac_retain_lookahead_ms_set(&arena->pa_shard.pac,
+			    new_lookahead_ms);
+		}
+		READ(old_lookahead_ms, unsigned);
+		ret = 0;
+	} else {
+		ret = EFAULT;
+	}
+label_return:
+	return ret;
+}
+
+/*
+ * When writing, newp should point to a char array storing the name to be set.
+ * A name longer than ARENA_NAME_LEN will be arbitrarily cut. When reading,
+ * oldp should point to a char array whose length is no shorter than
+ * ARENA_NAME_LEN or the length of the name when it was set.
+ */
+static int
+arena_i_name_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
+    void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	int ret;
+	unsigned arena_ind;
+	char *name;
+
+	ctl_mtx_lock(tsd_tsdn(tsd));
+	MIB_UNSIGNED(arena_ind, 1);
+	if (arena_ind == MALLCTL_ARENAS_ALL || arena_ind >=
+	    ctl_arenas->narenas) {
+		ret = EINVAL;
+		goto label_return;
+	}
+	arena_t *arena = arena_get(tsd_tsdn(tsd), arena_ind, false);
+	if (arena == NULL) {
+		ret = EFAULT;
+		goto label_return;
+	}
+
+	if (oldp != NULL && oldlenp != NULL) {
+		/*
+		 * Read the arena name.  When reading, the input oldp should
+		 * point to an array with a length no shorter than
 		 * ARENA_NAME_LEN or the length when it was set.
 		 */
 		if (*oldlenp != sizeof(char *)) {
@@ -3193,7 +3797,7 @@ arena_i_name_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
 	}
 	ret = 0;
 label_return:
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_unlock(tsd_tsdn(tsd));
 	return ret;
 }
 
@@ -3202,7 +3806,7 @@ arena_i_index(tsdn_t *tsdn, const size_t *mib, size_t miblen,
     size_t i) {
 	const ctl_named_node_t *ret;
 
-	malloc_mutex_lock(tsdn, &ctl_mtx);
+	ctl_mtx_lock(tsdn);
 	switch (i) {
 	case MALLCTL_ARENAS_ALL:
 	case MALLCTL_ARENAS_DESTROYED:
@@ -3217,7 +3821,7 @@ arena_i_index(tsdn_t *tsdn, const size_t *mib, size_t miblen,
 
 	ret = super_arena_i_node;
 label_return:
-	malloc_mutex_unlock(tsdn, &ctl_mtx);
+	ctl_mtx_unlock(tsdn);
 	return ret;
 }
 
@@ -3229,14 +3833,14 @@ arenas_narenas_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
 	int ret;
 	unsigned narenas;
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_lock(tsd_tsdn(tsd));
 	READONLY();
 	narenas = ctl_arenas->narenas;
 	READ(narenas, unsigned);
 
 	ret = 0;
 label_return:
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_unlock(tsd_tsdn(tsd));
 	return ret;
 }
 
@@ -3318,7 +3922,7 @@ arenas_create_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
 	int ret;
 	unsigned arena_ind;
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_lock(tsd_tsdn(tsd));
 
 	VERIFY_READ(unsigned);
 	arena_config_t config = arena_config_default;
@@ -3331,7 +3935,7 @@ arenas_create_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
 
 	ret = 0;
 label_return:
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_unlock(tsd_tsdn(tsd));
 	return ret;
 }
 
@@ -3342,7 +3946,7 @@ experimental_arenas_create_ext_ctl(tsd_t *tsd,
 	int ret;
 	unsigned arena_ind;
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_lock(tsd_tsdn(tsd));
 
 	arena_config_t config = arena_config_default;
 	VERIFY_READ(unsigned);
@@ -3355,7 +3959,7 @@ experimental_arenas_create_ext_ctl(tsd_t *tsd,
 	READ(arena_ind, unsigned);
 	ret = 0;
 label_return:
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_unlock(tsd_tsdn(tsd));
 	return ret;
 }
 
@@ -3372,7 +3976,7 @@ arenas_lookup_ctl(tsd_t *tsd, const size_t *mib,
 
 	ptr = NULL;
 	ret = EINVAL;
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_lock(tsd_tsdn(tsd));
 	WRITE(ptr, void *);
 	ptr_not_present = emap_full_alloc_ctx_try_lookup(tsd_tsdn(tsd), &arena_emap_global, ptr,
 		&alloc_ctx);
@@ -3390,7 +3994,7 @@ arenas_lookup_ctl(tsd_t *tsd, const size_t *mib,
 
 	ret = 0;
 label_return:
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_unlock(tsd_tsdn(tsd));
 	return ret;
 }
 
@@ -3530,13 +4134,13 @@ prof_prefix_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
 		return ENOENT;
 	}
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_lock(tsd_tsdn(tsd));
 	WRITEONLY();
 	WRITE(prefix, const char *);
 
 	ret = prof_prefix_set(tsd_tsdn(tsd), prefix) ? EFAULT : 0;
 label_return:
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_unlock(tsd_tsdn(tsd));
 	return ret;
 }
 
@@ -3741,6 +4345,40 @@ label_return:
 	return ret;
 }
 
+/*
+ * The stats_bg_hook_t whose write_cb background thread driven stats reports
+ * (see opt.stats_bg_interval_ms) go to, each in a single call with its
+ * cbopaque; a NULL write_cb restores the default of writing to
+ * opt.stats_bg_fd.  A report already being written may still go to the hook
+ * being replaced.
+ */
+static int
+experimental_hooks_stats_bg_ctl(tsd_t *tsd, const size_t *mib,
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	int ret;
+
+	if (!config_stats) {
+		return ENOENT;
+	}
+	if (oldp == NULL && newp == NULL) {
+		ret = EINVAL;
+		goto label_return;
+	}
+	if (oldp != NULL) {
+		stats_bg_hook_t old_hook;
+		stats_bg_hook_get(tsd_tsdn(tsd), &old_hook);
+		READ(old_hook, stats_bg_hook_t);
+	}
+	if (newp != NULL) {
+		stats_bg_hook_t new_hook = {NULL, NULL};
+		WRITE(new_hook, stats_bg_hook_t);
+		stats_bg_hook_set(tsd_tsdn(tsd), &new_hook);
+	}
+	ret = 0;
+label_return:
+	return ret;
+}
+
 /******************************************************************************/
 
 CTL_RO_CGEN(config_stats, stats_allocated, ctl_stats->allocated, size_t)
@@ -3880,7 +4518,25 @@ CTL_RO_CGEN(config_stats, stats_##n##_total_wait_time,			\
 CTL_RO_CGEN(config_stats, stats_##n##_max_wait_time,			\
     nstime_ns(&l.max_wait_time), uint64_t)				\
 CTL_RO_CGEN(config_stats, stats_##n##_max_num_thds,			\
-    l.max_n_thds, uint32_t)
+    l.max_n_thds, uint32_t)						\
+static int								\
+stats_##n##_wait_histogram_ctl(tsd_t *tsd, const size_t *mib,		\
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp,		\
+    size_t newlen) {							\
+	int ret;							\
+									\
+	if (!config_stats) {						\
+		return ENOENT;						\
+	}								\
+	ctl_mtx_lock(tsd_tsdn(tsd));					\
+	READONLY();							\
+	READ_ARRAY(l.wait_hist);					\
+									\
+	ret = 0;							\
+label_return:								\
+	ctl_mtx_unlock(tsd_tsdn(tsd));					\
+	return ret;							\
+}
 
 /* Global mutexes. */
 #define OP(mtx)								\
@@ -3900,14 +4556,126 @@ RO_MUTEX_CTL_GEN(arenas_i_bins_j_mutex,
     arenas_i(mib[2])->astats->bstats[mib[4]].mutex_data)
 #undef RO_MUTEX_CTL_GEN
 
+/*
+ * stats.latency.<tier>.* read the live histograms (see latency.h), rather than
+ * values cached by epoch.
+ */
+typedef enum {
+	stats_latency_field_nsamples,
+	stats_latency_field_total_ns,
+	stats_latency_field_histogram
+} stats_latency_field_t;
+
+/* Sums up the histograms of the extant and of the destroyed arenas. */
+static int
+stats_latency_tier_ctl(tsd_t *tsd, latency_tier_t tier,
+    stats_latency_field_t field, void *oldp, size_t *oldlenp, void *newp,
+    size_t newlen) {
+	int ret;
+	latency_stats_t stats = {0};
+	tsdn_t *tsdn = tsd_tsdn(tsd);
+
+	if (!config_stats || !opt_stats_latency) {
+		return ENOENT;
+	}
+
+	ctl_mtx_lock(tsdn);
+	READONLY();
+	unsigned narenas = narenas_total_get();
+	for (unsigned i = 0; i < narenas; i++) {
+		arena_t *arena = arena_get(tsdn, i, false);
+		if (arena != NULL) {
+			latency_hist_merge(&arena->latency[tier], &stats);
+		}
+	}
+	if (ctl_stats != NULL) {
+		latency_stats_merge(&stats,
+		    &ctl_stats->latency_destroyed[tier]);
+	}
+	switch (field) {
+	case stats_latency_field_nsamples:
+		READ(stats.nsamples, uint64_t);
+		break;
+	case stats_latency_field_total_ns:
+		READ(stats.total_ns, uint64_t);
+		break;
+	case stats_latency_field_histogram:
+		READ_ARRAY(stats.buckets);
+		break;
+	default:
+		not_reached();
+	}
+
+	ret = 0;
+label_return:
+	ctl_mtx_unlock(tsdn);
+	return ret;
+}
+
+#define OP(tier)							\
+static int								\
+stats_latency_##tier##_nsamples_ctl(tsd_t *tsd, const size_t *mib,	\
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp,		\
+    size_t newlen) {							\
+	return stats_latency_tier_ctl(tsd, latency_tier_##tier,		\
+	    stats_latency_field_nsamples, oldp, oldlenp, newp, newlen);	\
+}									\
+static int								\
+stats_latency_##tier##_total_ns_ctl(tsd_t *tsd, const size_t *mib,	\
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp,		\
+    size_t newlen) {							\
+	return stats_latency_tier_ctl(tsd, latency_tier_##tier,		\
+	    stats_latency_field_total_ns, oldp, oldlenp, newp, newlen);	\
+}									\
+static int								\
+stats_latency_##tier##_histogram_ctl(tsd_t *tsd, const size_t *mib,	\
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp,		\
+    size_t newlen) {							\
+	return stats_latency_tier_ctl(tsd, latency_tier_##tier,		\
+	    stats_latency_field_histogram, oldp, oldlenp, newp, newlen);	\
+}
+LATENCY_TIERS
+#undef OP
+
+/* stats.pages.* read the live counters, like stats.latency.*. */
+#define STATS_PAGES_CTL_GEN(field)					\
+static int								\
+stats_pages_caller_op_##field##_ctl(tsd_t *tsd, const size_t *mib,	\
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp,		\
+    size_t newlen) {							\
+	int ret;							\
+	pages_stats_t stats;						\
+									\
+	if (!config_stats) {						\
+		return ENOENT;						\
+	}								\
+	READONLY();							\
+	assert(miblen == 5);						\
+	assert(mib[2] < pages_num_callers && mib[3] < pages_num_ops);	\
+	pages_stats_read((pages_caller_t)mib[2], (pages_op_t)mib[3],	\
+	    &stats);							\
+	READ(stats.field, uint64_t);					\
+									\
+	ret = 0;							\
+label_return:								\
+	return ret;							\
+}
+STATS_PAGES_CTL_GEN(ncalls)
+STATS_PAGES_CTL_GEN(bytes)
+STATS_PAGES_CTL_GEN(total_ns)
+#undef STATS_PAGES_CTL_GEN
+
 /* Resets all mutex stats, including global, arena and bin mutexes. */
 static int
 stats_mutexes_reset_ctl(tsd_t *tsd, const size_t *mib,
     size_t miblen, void *oldp, size_t *oldlenp,
     void *newp, size_t newlen) {
+	int ret;
+
 	if (!config_stats) {
 		return ENOENT;
 	}
+	NEITHER_READ_NOR_WRITE();
 
 	tsdn_t *tsdn = tsd_tsdn(tsd);
 
@@ -3917,12 +4685,14 @@ stats_mutexes_reset_ctl(tsd_t *tsd, const size_t *mib,
     malloc_mutex_unlock(tsdn, &mtx);
 
 	/* Global mutexes: ctl and prof. */
-	MUTEX_PROF_RESET(ctl_mtx);
+	ctl_mtx_lock(tsdn);
+	malloc_mutex_prof_data_reset(tsdn, &ctl_mtx);
+	ctl_mtx_unlock(tsdn);
 	if (have_background_thread) {
 		MUTEX_PROF_RESET(background_thread_lock);
 	}
 	if (config_prof && opt_prof) {
-		MUTEX_PROF_RESET(bt2gctx_mtx);
+		prof_bt2gctx_mutex_prof_reset(tsdn);
 		MUTEX_PROF_RESET(tdatas_mtx);
 		MUTEX_PROF_RESET(prof_dump_mtx);
 		MUTEX_PROF_RESET(prof_recent_alloc_mtx);
@@ -3956,7 +4726,81 @@ stats_mutexes_reset_ctl(tsd_t *tsd, const size_t *mib,
 		}
 	}
 #undef MUTEX_PROF_RESET
-	return 0;
+	mutex_prof_holders_reset();
+	ret = 0;
+
+label_return:
+	return ret;
+}
+
+/*
+ * stats.mutexes.holders.<i>.* read the live holder table (see mutex_prof.h),
+ * rather than values cached by epoch.
+ */
+typedef enum {
+	stats_mutexes_holders_field_site,
+	stats_mutexes_holders_field_num_wait,
+	stats_mutexes_holders_field_total_wait_time
+} stats_mutexes_holders_field_t;
+
+static int
+stats_mutexes_holders_i_field_ctl(size_t i,
+    stats_mutexes_holders_field_t field, void *oldp, size_t *oldlenp,
+    void *newp, size_t newlen) {
+	int ret;
+	mutex_prof_holder_t holder;
+
+	READONLY();
+	mutex_prof_holder_read(i, &holder);
+	switch (field) {
+	case stats_mutexes_holders_field_site:
+		READ(holder.site, const char *);
+		break;
+	case stats_mutexes_holders_field_num_wait:
+		READ(holder.n_wait_times, uint64_t);
+		break;
+	case stats_mutexes_holders_field_total_wait_time:
+		READ(holder.tot_wait_time, uint64_t);
+		break;
+	default:
+		not_reached();
+	}
+
+	ret = 0;
+label_return:
+	return ret;
+}
+
+static int
+stats_mutexes_holders_i_site_ctl(tsd_t *tsd, const size_t *mib,
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	return stats_mutexes_holders_i_field_ctl(mib[3],
+	    stats_mutexes_holders_field_site, oldp, oldlenp, newp, newlen);
+}
+
+static int
+stats_mutexes_holders_i_num_wait_ctl(tsd_t *tsd, const size_t *mib,
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	return stats_mutexes_holders_i_field_ctl(mib[3],
+	    stats_mutexes_holders_field_num_wait, oldp, oldlenp, newp, newlen);
+}
+
+static int
+stats_mutexes_holders_i_total_wait_time_ctl(tsd_t *tsd, const size_t *mib,
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	return stats_mutexes_holders_i_field_ctl(mib[3],
+	    stats_mutexes_holders_field_total_wait_time, oldp, oldlenp, newp,
+	    newlen);
+}
+
+static const ctl_named_node_t *
+stats_mutexes_holders_i_index(tsdn_t *tsdn, const size_t *mib,
+    size_t miblen, size_t i) {
+	if (!config_stats || !opt_mutex_prof_holders
+	    || i >= MUTEX_PROF_NHOLDERS) {
+		return NULL;
+	}
+	return super_stats_mutexes_holders_i_node;
 }
 
 CTL_RO_CGEN(config_stats, stats_arenas_i_bins_j_nmalloc,
@@ -4131,7 +4975,7 @@ stats_arenas_i_index(tsdn_t *tsdn, const size_t *mib,
     size_t miblen, size_t i) {
 	const ctl_named_node_t *ret;
 
-	malloc_mutex_lock(tsdn, &ctl_mtx);
+	ctl_mtx_lock(tsdn);
 	if (ctl_arenas_i_verify(i)) {
 		ret = NULL;
 		goto label_return;
@@ -4139,7 +4983,7 @@ stats_arenas_i_index(tsdn_t *tsdn, const size_t *mib,
 
 	ret = super_stats_arenas_i_node;
 label_return:
-	malloc_mutex_unlock(tsdn, &ctl_mtx);
+	ctl_mtx_unlock(tsdn);
 	return ret;
 }
 
@@ -4441,14 +5285,14 @@ experimental_arenas_i_index(tsdn_t *tsdn, const size_t *mib,
     size_t miblen, size_t i) {
 	const ctl_named_node_t *ret;
 
-	malloc_mutex_lock(tsdn, &ctl_mtx);
+	ctl_mtx_lock(tsdn);
 	if (ctl_arenas_i_verify(i)) {
 		ret = NULL;
 		goto label_return;
 	}
 	ret = super_experimental_arenas_i_node;
 label_return:
-	malloc_mutex_unlock(tsdn, &ctl_mtx);
+	ctl_mtx_unlock(tsdn);
 	return ret;
 }
 
@@ -4467,7 +5311,7 @@ experimental_arenas_i_pactivep_ctl(tsd_t *tsd, const size_t *mib,
 	int ret;
 	size_t *pactivep;
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_lock(tsd_tsdn(tsd));
 	READONLY();
 	MIB_UNSIGNED(arena_ind, 2);
 	if (arena_ind < narenas_total_get() && (arena =
@@ -4485,7 +5329,7 @@ experimental_arenas_i_pactivep_ctl(tsd_t *tsd, const size_t *mib,
 		ret = EFAULT;
 	}
 label_return:
-	malloc_mutex_unlock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_mtx_unlock(tsd_tsdn(tsd));
 	return ret;
 }
 
@@ -4553,6 +5397,45 @@ label_return:
 	return ret;
 }
 
+typedef struct prof_dump_cb_packet_s prof_dump_cb_packet_t;
+struct prof_dump_cb_packet_s {
+	prof_dump_write_cb_t *write_cb;
+	void *cbopaque;
+};
+
+/*
+ * Like prof.dump, but hands the profile to write_cb piece by piece instead of
+ * writing a file, e.g. to send it elsewhere from a read-only container.  The
+ * callback runs with the dump lock held, so it must not dump in turn.
+ */
+static int
+experimental_prof_dump_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
+    void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	int ret;
+
+	if (!(config_prof && opt_prof)) {
+		ret = ENOENT;
+		goto label_return;
+	}
+
+	WRITEONLY();
+	prof_dump_cb_packet_t packet;
+	ASSURED_WRITE(packet, prof_dump_cb_packet_t);
+	if (packet.write_cb == NULL) {
+		ret = EINVAL;
+		goto label_return;
+	}
+
+	if (prof_mdump_cb(tsd, packet.write_cb, packet.cbopaque)) {
+		ret = EFAULT;
+		goto label_return;
+	}
+
+	ret = 0;
+label_return:
+	return ret;
+}
+
 typedef struct batch_alloc_packet_s batch_alloc_packet_t;
 struct batch_alloc_packet_s {
 	void **ptrs;
@@ -4581,6 +5464,475 @@ label_return:
 	return ret;
 }
 
+typedef struct batch_read_entry_s batch_read_entry_t;
+struct batch_read_entry_s {
+	const size_t *mib;
+	size_t miblen;
+	void *oldp;
+	size_t *oldlenp;
+};
+
+/*
+ * Whether reading the mallctl acts rather than just reads, e.g. arenas.create
+ * creating an arena.
+ */
+static bool
+batch_read_acts(const ctl_named_node_t *node) {
+	return node->ctl == tcache_create_ctl || node->ctl == arenas_create_ctl
+	    || node->ctl == experimental_arenas_create_ext_ctl
+	    || node->ctl == prof_log_stop_ctl;
+}
+
+static int
+batch_read_entry(tsd_t *tsd, const batch_read_entry_t *entry) {
+	/* Batches are for reading; mallctls that act aren't meant for them. */
+	if (entry->oldp == NULL || entry->oldlenp == NULL) {
+		return EINVAL;
+	}
+	const ctl_named_node_t *node;
+	int ret = ctl_lookupbymib(tsd_tsdn(tsd), &node, entry->mib,
+	    entry->miblen);
+	if (ret != 0) {
+		return ret;
+	}
+	if (node == NULL || node->ctl == NULL) {
+		/* Partial MIB. */
+		return ENOENT;
+	}
+	if (batch_read_acts(node)) {
+		return EPERM;
+	}
+	return node->ctl(tsd, entry->mib, entry->miblen, entry->oldp,
+	    entry->oldlenp, NULL, 0);
+}
+
+/*
+ * Reads a batch of mallctls by MIB: the equivalent of one mallctlbymib() read
+ * per entry, except that ctl_mtx is acquired once and held throughout, so that
+ * all values come from the same stats snapshot (no "epoch" refresh can happen
+ * in between).
+ *
+ * newp points to an array of entries of the following layout (newlen being
+ * its size in bytes):
+ *
+ *   struct {
+ *       const size_t *mib;
+ *       size_t miblen;
+ *       void *oldp;
+ *       size_t *oldlenp;
+ *   };
+ *
+ * and oldp to an array of as many ints (*oldlenp being its size in bytes),
+ * each of which receives the result of the corresponding read: 0, or the error
+ * mallctlbymib() would have returned.  Entries without oldp or oldlenp fail
+ * with EINVAL, and those naming mallctls that act even when only read (e.g.
+ * arenas.create, tcache.create) with EPERM, as do those that can't be read at
+ * all (e.g. stats.mutexes.reset).  The call itself only fails, with EINVAL, if
+ * the arrays are malformed.
+ */
+static int
+experimental_batch_read_ctl(tsd_t *tsd, const size_t *mib,
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	int ret;
+
+	const size_t len = newlen / sizeof(batch_read_entry_t);
+	if (oldp == NULL || oldlenp == NULL || newp == NULL || newlen == 0
+	    || newlen != len * sizeof(batch_read_entry_t)
+	    || *oldlenp != len * sizeof(int)) {
+		ret = EINVAL;
+		goto label_return;
+	}
+
+	const batch_read_entry_t *entries = (const batch_read_entry_t *)newp;
+	int *rets = (int *)oldp;
+	malloc_mutex_lock(tsd_tsdn(tsd), &ctl_mtx);
+	ctl_batch_begin(tsd_tsdn(tsd));
+	for (size_t i = 0; i < len; i++) {
+		rets[i] = batch_read_entry(tsd, &entries[i]);
+	}
+	ctl_batch_unlock(tsd_tsdn(tsd));
+	ret = 0;
+
+label_return:
+	return ret;
+}
+
+static void
+stats_snapshot_put(char *buf, size_t *pos, uint64_t v) {
+	if (buf != NULL) {
+		memcpy(&buf[*pos * sizeof(uint64_t)], &v, sizeof(uint64_t));
+	}
+	(*pos)++;
+}
+
+static void
+stats_snapshot_mutex_put(char *buf, size_t *pos, mutex_prof_data_t *m) {
+#define OP(name, expr) stats_snapshot_put(buf, pos, (uint64_t)(expr));
+	CTL_SNAPSHOT_MUTEX_FIELDS
+#undef OP
+}
+
+static void
+stats_snapshot_arena_put(char *buf, size_t *pos, ctl_arena_t *a) {
+	ctl_arena_stats_t *as = a->astats;
+
+#define OP(name, expr) stats_snapshot_put(buf, pos, (uint64_t)(expr));
+	CTL_SNAPSHOT_ARENA_FIELDS
+#undef OP
+	for (unsigned i = 0; i < mutex_prof_num_arena_mutexes; i++) {
+		stats_snapshot_mutex_put(buf, pos,
+		    &as->astats.mutex_prof_data[i]);
+	}
+	for (unsigned i = 0; i < SC_NBINS; i++) {
+		bin_stats_t *b = &as->bstats[i].stats_data;
+#define OP(name, expr) stats_snapshot_put(buf, pos, (uint64_t)(expr));
+		CTL_SNAPSHOT_BIN_FIELDS
+#undef OP
+		stats_snapshot_mutex_put(buf, pos, &as->bstats[i].mutex_data);
+	}
+	for (unsigned i = 0; i < SC_NSIZES - SC_NBINS; i++) {
+		arena_stats_large_t *l = &as->lstats[i];
+#define OP(name, expr) stats_snapshot_put(buf, pos, (uint64_t)(expr));
+		CTL_SNAPSHOT_LEXTENT_FIELDS
+#undef OP
+	}
+}
+
+#define OP(...) + 1
+static const size_t stats_snapshot_nglobal_fields =
+    0 CTL_SNAPSHOT_GLOBAL_FIELDS;
+static const size_t stats_snapshot_nmutex_fields = 0 CTL_SNAPSHOT_MUTEX_FIELDS;
+static const size_t stats_snapshot_narena_fields = 0 CTL_SNAPSHOT_ARENA_FIELDS;
+static const size_t stats_snapshot_nbin_fields = 0 CTL_SNAPSHOT_BIN_FIELDS;
+static const size_t stats_snapshot_nlextent_fields =
+    0 CTL_SNAPSHOT_LEXTENT_FIELDS;
+static const size_t stats_snapshot_nheader_fields =
+    0 CTL_SNAPSHOT_HEADER_FIELDS;
+#undef OP
+
+/* Number of arena records: the initialized arenas, plus destroyed ones. */
+static unsigned
+stats_snapshot_narenas(void) {
+	unsigned n = 0;
+	for (unsigned i = 0; i < ctl_arenas->narenas; i++) {
+		if (arenas_i(i)->initialized) {
+			n++;
+		}
+	}
+	if (arenas_i(MALLCTL_ARENAS_DESTROYED)->initialized) {
+		n++;
+	}
+	return n;
+}
+
+static size_t
+stats_snapshot_size(unsigned narenas) {
+	size_t arena_words = stats_snapshot_narena_fields
+	    + mutex_prof_num_arena_mutexes * stats_snapshot_nmutex_fields
+	    + SC_NBINS * (stats_snapshot_nbin_fields
+	    + stats_snapshot_nmutex_fields)
+	    + (SC_NSIZES - SC_NBINS) * stats_snapshot_nlextent_fields;
+	size_t words = stats_snapshot_nheader_fields
+	    + stats_snapshot_nglobal_fields
+	    + mutex_prof_num_global_mutexes * stats_snapshot_nmutex_fields
+	    + narenas * arena_words;
+	return words * sizeof(uint64_t);
+}
+
+static void
+stats_snapshot_write(char *buf, unsigned narenas, size_t size) {
+	size_t pos = 0;
+
+	/* Header, in CTL_SNAPSHOT_HEADER_FIELDS order. */
+	stats_snapshot_put(buf, &pos, CTL_SNAPSHOT_MAGIC);
+	stats_snapshot_put(buf, &pos, CTL_SNAPSHOT_VERSION);
+	stats_snapshot_put(buf, &pos, size);
+	stats_snapshot_put(buf, &pos, ctl_arenas->epoch);
+	stats_snapshot_put(buf, &pos, stats_snapshot_nglobal_fields);
+	stats_snapshot_put(buf, &pos, stats_snapshot_nmutex_fields);
+	stats_snapshot_put(buf, &pos, mutex_prof_num_global_mutexes);
+	stats_snapshot_put(buf, &pos, stats_snapshot_narena_fields);
+	stats_snapshot_put(buf, &pos, mutex_prof_num_arena_mutexes);
+	stats_snapshot_put(buf, &pos, SC_NBINS);
+	stats_snapshot_put(buf, &pos, stats_snapshot_nbin_fields);
+	stats_snapshot_put(buf, &pos, SC_NSIZES - SC_NBINS);
+	stats_snapshot_put(buf, &pos, stats_snapshot_nlextent_fields);
+	stats_snapshot_put(buf, &pos, narenas);
+	assert(pos == stats_snapshot_nheader_fields);
+
+	ctl_stats_t *s = ctl_stats;
+#define OP(name, expr) stats_snapshot_put(buf, &pos, (uint64_t)(expr));
+	CTL_SNAPSHOT_GLOBAL_FIELDS
+#undef OP
+	for (unsigned i = 0; i < mutex_prof_num_global_mutexes; i++) {
+		stats_snapshot_mutex_put(buf, &pos, &s->mutex_prof_data[i]);
+	}
+
+	for (unsigned i = 0; i < ctl_arenas->narenas; i++) {
+		ctl_arena_t *a = arenas_i(i);
+		if (a->initialized) {
+			stats_snapshot_arena_put(buf, &pos, a);
+		}
+	}
+	ctl_arena_t *darena = arenas_i(MALLCTL_ARENAS_DESTROYED);
+	if (darena->initialized) {
+		stats_snapshot_arena_put(buf, &pos, darena);
+	}
+	assert(pos * sizeof(uint64_t) == size);
+}
+
+/*
+ * Serializes the stats of the current epoch into a compact binary blob, for
+ * telemetry that samples the full allocator state at a high rate: one call
+ * and one memcpy-sized copy, instead of thousands of mallctl() reads or a
+ * malloc_stats_print() JSON dump.
+ *
+ * The blob is an array of uint64_t in native byte order: a header, the global
+ * stats and mutexes, then one record per initialized arena (in index order)
+ * followed by one for the merged destroyed arenas, if any.  The exact layout
+ * is described by the CTL_SNAPSHOT_*_FIELDS lists in ctl.h; the header carries
+ * the magic, the layout version, the blob size, the epoch and the length of
+ * every variable-sized part, so that decoders can skip over fields appended by
+ * later versions.  An arena record is:
+ *
+ *   arena fields, arena mutexes x mutex fields,
+ *   bins x (bin fields + mutex fields), lextents x lextent fields.
+ *
+ * Merged (MALLCTL_ARENAS_ALL) stats are omitted, since they are the sum of
+ * the records; so are the per page size extent and HPA slab breakdowns, which
+ * remain available through stats.arenas.<i>.*.
+ *
+ * With oldp NULL, the required size is returned in *oldlenp; if *oldlenp is
+ * too small for the blob, it is set to the required size and EINVAL is
+ * returned.  Writing true refreshes the stats first (as epoch does), under
+ * the same ctl_mtx hold, so that the blob is always self-consistent.
+ */
+static int
+experimental_stats_snapshot_ctl(tsd_t *tsd, const size_t *mib,
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	int ret;
+	bool refresh = false;
+
+	if (!config_stats) {
+		return ENOENT;
+	}
+
+	tsdn_t *tsdn = tsd_tsdn(tsd);
+	ctl_mtx_lock(tsdn);
+	WRITE(refresh, bool);
+	if (oldlenp == NULL) {
+		ret = EINVAL;
+		goto label_return;
+	}
+	if (refresh) {
+		ctl_refresh(tsdn);
+	}
+
+	unsigned narenas = stats_snapshot_narenas();
+	size_t size = stats_snapshot_size(narenas);
+	if (oldp == NULL) {
+		*oldlenp = size;
+		ret = 0;
+		goto label_return;
+	}
+	if (*oldlenp < size) {
+		*oldlenp = size;
+		ret = EINVAL;
+		goto label_return;
+	}
+	stats_snapshot_write((char *)oldp, narenas, size);
+	*oldlenp = size;
+
+	ret = 0;
+label_return:
+	ctl_mtx_unlock(tsdn);
+	return ret;
+}
+
+static void
+stats_ts_sample_mutex_add(stats_ts_sample_t *sample,
+    const mutex_prof_data_t *data) {
+	sample->mutex_num_wait += data->n_wait_times;
+	sample->mutex_wait_time += nstime_ns(&data->tot_wait_time);
+}
+
+/* Adds the counters of a live arena to the sample, read straight from it. */
+static void
+stats_ts_sample_arena_read(tsdn_t *tsdn, stats_ts_sample_t *sample,
+    arena_t *arena) {
+	pa_shard_t *shard = &arena->pa_shard;
+	sample->pdirty += pa_shard_ndirty(shard);
+	sample->pmuzzy += pa_shard_nmuzzy(shard);
+
+	malloc_mutex_t *mtx = LOCKEDINT_MTX(*shard->stats_mtx);
+	pac_stats_t *pac_stats = shard->pac.stats;
+	LOCKEDINT_MTX_LOCK(tsdn, *shard->stats_mtx);
+	sample->dirty_npurge += locked_read_u64(tsdn, mtx,
+	    &pac_stats->decay_dirty.npurge);
+	sample->dirty_purged += locked_read_u64(tsdn, mtx,
+	    &pac_stats->decay_dirty.purged);
+	sample->muzzy_npurge += locked_read_u64(tsdn, mtx,
+	    &pac_stats->decay_muzzy.npurge);
+	sample->muzzy_purged += locked_read_u64(tsdn, mtx,
+	    &pac_stats->decay_muzzy.purged);
+	LOCKEDINT_MTX_UNLOCK(tsdn, *shard->stats_mtx);
+
+	if (shard->ever_used_hpa) {
+		hpa_shard_stats_t hpastats;
+		memset(&hpastats, 0, sizeof(hpastats));
+		hpa_shard_stats_merge(tsdn, &shard->hpa_shard, &hpastats);
+		psset_stats_t *psset_stats = &hpastats.psset_stats;
+		uint64_t nhuge = psset_stats->full_slabs[1].npageslabs
+		    + psset_stats->empty_slabs[1].npageslabs;
+		for (unsigned i = 0; i < PSSET_NPSIZES; i++) {
+			nhuge += psset_stats->nonfull_slabs[i][1].npageslabs;
+		}
+		sample->hpa_huge_bytes += nhuge * HUGEPAGE;
+		sample->hpa_nhugifies += hpastats.nonderived_stats.nhugifies;
+		sample->hpa_ndehugifies +=
+		    hpastats.nonderived_stats.ndehugifies;
+		sample->hpa_npurges += hpastats.nonderived_stats.npurges;
+	}
+
+	mutex_prof_data_t mutex_prof_data[mutex_prof_num_arena_mutexes];
+	memset(mutex_prof_data, 0, sizeof(mutex_prof_data));
+	arena_stats_mutex_prof_read(tsdn, arena, mutex_prof_data);
+	for (unsigned i = 0; i < mutex_prof_num_arena_mutexes; i++) {
+		stats_ts_sample_mutex_add(sample, &mutex_prof_data[i]);
+	}
+	for (unsigned i = 0; i < SC_NBINS; i++) {
+		for (unsigned j = 0; j < bin_infos[i].n_shards; j++) {
+			bin_t *bin = arena_get_bin(arena, i, j);
+			mutex_prof_data_t bin_data;
+			malloc_mutex_lock(tsdn, &bin->lock);
+			malloc_mutex_prof_read(tsdn, &bin_data, &bin->lock);
+			malloc_mutex_unlock(tsdn, &bin->lock);
+			stats_ts_sample_mutex_add(sample, &bin_data);
+		}
+	}
+}
+
+/* Adds the cumulative counters of the destroyed arenas to the sample. */
+static void
+stats_ts_sample_destroyed_add(stats_ts_sample_t *sample, ctl_arena_t *a) {
+	ctl_arena_stats_t *as = a->astats;
+	pac_stats_t *pac_stats = &as->astats.pa_shard_stats.pac_stats;
+
+	sample->hpa_nhugifies += as->hpastats.nonderived_stats.nhugifies;
+	sample->hpa_ndehugifies += as->hpastats.nonderived_stats.ndehugifies;
+	sample->hpa_npurges += as->hpastats.nonderived_stats.npurges;
+	sample->dirty_npurge += locked_read_u64_unsynchronized(
+	    &pac_stats->decay_dirty.npurge);
+	sample->dirty_purged += locked_read_u64_unsynchronized(
+	    &pac_stats->decay_dirty.purged);
+	sample->muzzy_npurge += locked_read_u64_unsynchronized(
+	    &pac_stats->decay_muzzy.npurge);
+	sample->muzzy_purged += locked_read_u64_unsynchronized(
+	    &pac_stats->decay_muzzy.purged);
+	for (unsigned i = 0; i < mutex_prof_num_arena_mutexes; i++) {
+		stats_ts_sample_mutex_add(sample,
+		    &as->astats.mutex_prof_data[i]);
+	}
+	for (unsigned i = 0; i < SC_NBINS; i++) {
+		stats_ts_sample_mutex_add(sample, &as->bstats[i].mutex_data);
+	}
+}
+
+/*
+ * Like epoch_summary, reads the arenas directly rather than through
+ * ctl_refresh(), so that sampling neither advances the epoch nor changes what
+ * the stats.* mallctls report.  ctl_mtx is still held, to keep arenas from
+ * being destroyed under the reads.
+ */
+bool
+ctl_stats_ts_sample(tsdn_t *tsdn, stats_ts_sample_t *sample) {
+	assert(config_stats);
+
+	if (ctl_batch_trylock(tsdn)) {
+		return true;
+	}
+
+	memset(sample, 0, sizeof(*sample));
+	nstime_t now;
+	nstime_init_update(&now);
+	sample->time_ns = nstime_ns(&now);
+
+	arena_stats_summary_t summary = {0};
+	unsigned narenas = narenas_total_get();
+	for (unsigned i = 0; i < narenas; i++) {
+		arena_t *arena = arena_get(tsdn, i, false);
+		if (arena != NULL) {
+			arena_stats_summary_merge(tsdn, arena, &summary);
+			stats_ts_sample_arena_read(tsdn, sample, arena);
+		}
+	}
+	sample->allocated = summary.allocated;
+	sample->active = summary.active;
+	sample->metadata = summary.metadata;
+	sample->resident = summary.resident;
+	sample->mapped = summary.mapped;
+	sample->retained = summary.retained;
+
+	mutex_prof_data_t mutex_prof_data[mutex_prof_num_global_mutexes];
+	memset(mutex_prof_data, 0, sizeof(mutex_prof_data));
+	ctl_global_mutex_prof_read(tsdn, mutex_prof_data);
+	for (unsigned i = 0; i < mutex_prof_num_global_mutexes; i++) {
+		stats_ts_sample_mutex_add(sample, &mutex_prof_data[i]);
+	}
+	/* Arenas are only ever destroyed through ctl, once initialized. */
+	if (ctl_initialized) {
+		ctl_arena_t *darena = arenas_i(MALLCTL_ARENAS_DESTROYED);
+		if (darena->initialized) {
+			stats_ts_sample_destroyed_add(sample, darena);
+		}
+	}
+
+	ctl_batch_unlock(tsdn);
+	return false;
+}
+
+/*
+ * experimental.stats_ts (stats_ts_sample_t[]) r-
+ *
+ * The time series of summary stats sampled by the background thread every
+ * opt.stats_ts_interval_ms, oldest first; see STATS_TS_FIELDS in stats.h for
+ * the layout of a sample.  Only the last opt.stats_ts_nsamples samples are
+ * kept.
+ *
+ * With oldp NULL, the size of the samples available is returned in *oldlenp.
+ * Otherwise the most recent samples that fit in *oldlenp bytes are copied,
+ * and *oldlenp is set to the number of bytes copied.  ENOENT is returned if
+ * sampling is disabled.
+ */
+static int
+experimental_stats_ts_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
+    void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	int ret;
+
+	if (!config_stats || opt_stats_ts_interval_ms < 0) {
+		return ENOENT;
+	}
+
+	READONLY();
+	if (oldlenp == NULL) {
+		ret = EINVAL;
+		goto label_return;
+	}
+	tsdn_t *tsdn = tsd_tsdn(tsd);
+	if (oldp == NULL) {
+		*oldlenp = stats_ts_read(tsdn, NULL, 0)
+		    * sizeof(stats_ts_sample_t);
+	} else {
+		*oldlenp = stats_ts_read(tsdn, (stats_ts_sample_t *)oldp,
+		    *oldlenp / sizeof(stats_ts_sample_t))
+		    * sizeof(stats_ts_sample_t);
+	}
+
+	ret = 0;
+label_return:
+	return ret;
+}
+
 static int
 prof_stats_bins_i_live_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
     void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
@@ -4708,3 +6060,67 @@ prof_stats_lextents_i_index(tsdn_t *tsdn, const size_t *mib, size_t miblen,
 	}
 	return super_prof_stats_lextents_i_node;
 }
+
+static int
+prof_stats_tags_i_live_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
+    void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	int ret;
+	unsigned tag;
+	prof_stats_t stats;
+
+	if (!(config_prof && opt_prof && opt_prof_stats)) {
+		ret = ENOENT;
+		goto label_return;
+	}
+
+	READONLY();
+	MIB_UNSIGNED(tag, 3);
+	if (tag >= PROF_ALLOC_NTAGS) {
+		ret = EINVAL;
+		goto label_return;
+	}
+	prof_stats_tag_get_live(tsd, tag, &stats);
+	READ(stats, prof_stats_t);
+
+	ret = 0;
+label_return:
+	return ret;
+}
+
+static int
+prof_stats_tags_i_accum_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
+    void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	int ret;
+	unsigned tag;
+	prof_stats_t stats;
+
+	if (!(config_prof && opt_prof && opt_prof_stats)) {
+		ret = ENOENT;
+		goto label_return;
+	}
+
+	READONLY();
+	MIB_UNSIGNED(tag, 3);
+	if (tag >= PROF_ALLOC_NTAGS) {
+		ret = EINVAL;
+		goto label_return;
+	}
+	prof_stats_tag_get_accum(tsd, tag, &stats);
+	READ(stats, prof_stats_t);
+
+	ret = 0;
+label_return:
+	return ret;
+}
+
+static const ctl_named_node_t *
+prof_stats_tags_i_index(tsdn_t *tsdn, const size_t *mib, size_t miblen,
+    size_t i) {
+	if (!(config_prof && opt_prof && opt_prof_stats)) {
+		return NULL;
+	}
+	if (i >= PROF_ALLOC_NTAGS) {
+		return NULL;
+	}
+	return super_prof_stats_tags_i_node;
+}
@@ -33,8 +33,8 @@ extent_alloc_core(tsdn_t *tsdn, arena_t *arena, void *new_addr, size_t size,
 		return ret;
 	}
 	/* mmap. */
-	if ((ret = extent_alloc_mmap(new_addr, size, alignment, zero, commit))
-	    != NULL) {
+	if ((ret = extent_alloc_mmap(pages_caller_pac, new_addr, size,
+	    alignment, zero, commit)) != NULL) {
 		return ret;
 	}
 	/* "secondary" dss. */
@@ -59,7 +59,7 @@ ehooks_default_alloc_impl(tsdn_t *tsdn, void *new_addr, size_t size,
 	void *ret = extent_alloc_core(tsdn, arena, new_addr, size, alignment,
 	    zero, commit, dss);
 	if (have_madvise_huge && ret) {
-		pages_set_thp_state(ret, size);
+		pages_set_thp_state(pages_caller_pac, ret, size);
 	}
 	return ret;
 }
@@ -74,7 +74,7 @@ ehooks_default_alloc(extent_hooks_t *extent_hooks, void *new_addr, size_t size,
 bool
 ehooks_default_dalloc_impl(void *addr, size_t size) {
 	if (!have_dss || !extent_in_dss(addr)) {
-		return extent_dalloc_mmap(addr, size);
+		return extent_dalloc_mmap(pages_caller_pac, addr, size);
 	}
 	return true;
 }
@@ -88,7 +88,7 @@ ehooks_default_dalloc(extent_hooks_t *extent_hooks, void *addr, size_t size,
 void
 ehooks_default_destroy_impl(void *addr, size_t size) {
 	if (!have_dss || !extent_in_dss(addr)) {
-		pages_unmap(addr, size);
+		pages_unmap(pages_caller_pac, addr, size);
 	}
 }
 
@@ -100,8 +100,8 @@ ehooks_default_destroy(extent_hooks_t *extent_hooks, void *addr, size_t size,
 
 bool
 ehooks_default_commit_impl(void *addr, size_t offset, size_t length) {
-	return pages_commit((void *)((byte_t *)addr + (uintptr_t)offset),
-	    length);
+	return pages_commit(pages_caller_pac,
+	    (void *)((byte_t *)addr + (uintptr_t)offset), length);
 }
 
 static bool
@@ -112,8 +112,8 @@ ehooks_default_commit(extent_hooks_t *extent_hooks, void *addr, size_t size,
 
 bool
 ehooks_default_decommit_impl(void *addr, size_t offset, size_t length) {
-	return pages_decommit((void *)((byte_t *)addr + (uintptr_t)offset),
-	    length);
+	return pages_decommit(pages_caller_pac,
+	    (void *)((byte_t *)addr + (uintptr_t)offset), length);
 }
 
 static bool
@@ -125,8 +125,8 @@ ehooks_default_decommit(extent_hooks_t *extent_hooks, void *addr, size_t size,
 #ifdef PAGES_CAN_PURGE_LAZY
 bool
 ehooks_default_purge_lazy_impl(void *addr, size_t offset, size_t length) {
-	return pages_purge_lazy((void *)((byte_t *)addr + (uintptr_t)offset),
-	    length);
+	return pages_purge_lazy(pages_caller_pac,
+	    (void *)((byte_t *)addr + (uintptr_t)offset), length);
 }
 
 static bool
@@ -143,8 +143,8 @@ ehooks_default_purge_lazy(extent_hooks_t *extent_hooks, void *addr, size_t size,
 #ifdef PAGES_CAN_PURGE_FORCED
 bool
 ehooks_default_purge_forced_impl(void *addr, size_t offset, size_t length) {
-	return pages_purge_forced((void *)((byte_t *)addr +
-	    (uintptr_t)offset), length);
+	return pages_purge_forced(pages_caller_pac,
+	    (void *)((byte_t *)addr + (uintptr_t)offset), length);
 }
 
 static bool
@@ -233,25 +233,27 @@ ehooks_default_zero_impl(void *addr, size_t size) {
 	 * By default, we try to zero out memory using OS-provided demand-zeroed
 	 * pages.  If the user has specifically requested hugepages, though, we
 	 * don't want to purge in the middle of a hugepage (which would break it
-	 * up), so we act conservatively and use memset.
+	 * up), so we act conservatively and zero the memory by hand (using
+	 * non-temporal stores for large extents).
 	 */
-	bool needs_memset = true;
+	bool needs_zeroing = true;
 	if (opt_thp != thp_mode_always) {
-		needs_memset = pages_purge_forced(addr, size);
+		needs_zeroing = pages_purge_forced(pages_caller_pac, addr,
+		    size);
 	}
-	if (needs_memset) {
-		memset(addr, 0, size);
+	if (needs_zeroing) {
+		nontemporal_zero(addr, size);
 	}
 }
 
 void
 ehooks_default_guard_impl(void *guard1, void *guard2) {
-	pages_mark_guards(guard1, guard2);
+	pages_mark_guards(pages_caller_pac, guard1, guard2);
 }
 
 void
 ehooks_default_unguard_impl(void *guard1, void *guard2) {
-	pages_unmark_guards(guard1, guard2);
+	pages_unmark_guards(pages_caller_pac, guard1, guard2);
 }
 
 const extent_hooks_t ehooks_default_extent_hooks = {
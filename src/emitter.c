@@ -0,0 +1,259 @@
+#include "jemalloc/internal/jemalloc_preamble.h"
+#include "jemalloc/internal/jemalloc_internal_includes.h"
+
+#include "jemalloc/internal/emitter.h"
+
+/*
+ * OpenMetrics wants the samples of a family to be contiguous, but the json
+ * structure the emitter follows interleaves them (e.g. each arena emits one
+ * sample of every per arena family).  So the samples are buffered and chained
+ * per family, and written out only at the end.  A sample is stored as the
+ * offset of the next one in its family, followed by its labels and value, e.g.
+ * {arena="0"} 42.
+ */
+
+#define EMITTER_OM_NONE SIZE_T_MAX
+#define EMITTER_OM_BUF_SIZE_MIN 4096
+/* The labels of all the frames, the braces and separators, and the value. */
+#define EMITTER_OM_SERIES_MAX						\
+    (EMITTER_OPENMETRICS_DEPTH_MAX * EMITTER_OPENMETRICS_LABELS_MAX + 64)
+
+/* Makes room for needed more bytes in *buf, of which used are in use. */
+static bool
+emitter_om_reserve(void **buf, size_t *size, size_t used, size_t needed) {
+	if (used + needed <= *size) {
+		return false;
+	}
+	size_t new_size = (*size == 0) ? EMITTER_OM_BUF_SIZE_MIN : *size;
+	while (new_size < used + needed) {
+		new_size <<= 1;
+	}
+	if (new_size > SC_LARGE_MAXCLASS) {
+		return true;
+	}
+	tsdn_t *tsdn = tsdn_fetch();
+	void *new_buf = iallocztm(tsdn, new_size, sz_size2index(new_size),
+	    false, NULL, true, arena_get(tsdn, 0, false), true);
+	if (new_buf == NULL) {
+		return true;
+	}
+	if (*buf != NULL) {
+		memcpy(new_buf, *buf, used);
+		idalloctm(tsdn, *buf, NULL, NULL, true, true);
+	}
+	*buf = new_buf;
+	*size = new_size;
+	return false;
+}
+
+/*
+ * Copies str into the buffer, preceded by an unlinked next offset if linked.
+ * Returns the offset of the copy, or EMITTER_OM_NONE on OOM.
+ */
+static size_t
+emitter_om_append(emitter_om_t *om, const char *str, bool linked) {
+	size_t header = linked ? sizeof(size_t) : 0;
+	size_t len = strlen(str) + 1;
+	size_t size = ALIGNMENT_CEILING(header + len, sizeof(size_t));
+	if (emitter_om_reserve((void **)&om->buf, &om->buf_size, om->buf_used,
+	    size)) {
+		return EMITTER_OM_NONE;
+	}
+	size_t offset = om->buf_used;
+	if (linked) {
+		*(size_t *)&om->buf[offset] = EMITTER_OM_NONE;
+	}
+	memcpy(&om->buf[offset + header], str, len);
+	om->buf_used += size;
+	return offset;
+}
+
+/* Returns the index of the named family, adding it if new. */
+static size_t
+emitter_om_family_get(emitter_om_t *om, const char *name) {
+	/* Consecutive samples are mostly in the same or in the next family. */
+	for (size_t i = 0; i < om->nfamilies; i++) {
+		size_t ind = (om->last_family + i) % om->nfamilies;
+		if (strcmp(&om->buf[om->families[ind].name], name) == 0) {
+			om->last_family = ind;
+			return ind;
+		}
+	}
+
+	if (emitter_om_reserve((void **)&om->families, &om->families_size,
+	    om->nfamilies * sizeof(emitter_om_family_t),
+	    sizeof(emitter_om_family_t))) {
+		return EMITTER_OM_NONE;
+	}
+	size_t name_offset = emitter_om_append(om, name, false);
+	if (name_offset == EMITTER_OM_NONE) {
+		return EMITTER_OM_NONE;
+	}
+	emitter_om_family_t *family = &om->families[om->nfamilies];
+	family->name = name_offset;
+	family->counter = (om->counter != NULL && om->counter(name));
+	family->head = EMITTER_OM_NONE;
+	family->tail = EMITTER_OM_NONE;
+	om->last_family = om->nfamilies;
+	return om->nfamilies++;
+}
+
+/*
+ * Appends a component to an OpenMetrics name, mapping the characters names
+ * can't contain (e.g. the '.' in "stats.arenas") to '_'.
+ */
+static size_t
+emitter_om_name_append(char *name, size_t len, const char *component) {
+	if (len != 0 && len < EMITTER_OPENMETRICS_NAME_MAX - 1) {
+		name[len++] = '_';
+	}
+	for (const char *c = component; *c != '\0' &&
+	    len < EMITTER_OPENMETRICS_NAME_MAX - 1; c++) {
+		bool valid = (*c >= 'a' && *c <= 'z') || (*c >= 'A' &&
+		    *c <= 'Z') || (*c >= '0' && *c <= '9') || *c == '_';
+		name[len++] = valid ? *c : '_';
+	}
+	name[len] = '\0';
+	return len;
+}
+
+/* Formats the labels of the enclosing frames and the value of a sample. */
+static void
+emitter_om_series(emitter_t *emitter, char *series, emitter_type_t value_type,
+    const void *value) {
+	size_t len = 0;
+	const char *sep = "{";
+	for (int i = 1; i <= emitter->nesting_depth; i++) {
+		emitter_om_frame_t *frame = &emitter->om_frames[i];
+		if (frame->labels[0] != '\0') {
+			len += malloc_snprintf(&series[len],
+			    EMITTER_OM_SERIES_MAX - len, "%s%s", sep,
+			    frame->labels);
+			sep = ",";
+		}
+	}
+	if (len != 0) {
+		len += malloc_snprintf(&series[len],
+		    EMITTER_OM_SERIES_MAX - len, "}");
+	}
+
+	char *val = &series[len];
+	size_t size = EMITTER_OM_SERIES_MAX - len;
+	switch (value_type) {
+	case emitter_type_bool:
+		malloc_snprintf(val, size, " %d", *(const bool *)value ? 1 : 0);
+		break;
+	case emitter_type_int:
+		malloc_snprintf(val, size, " %d", *(const int *)value);
+		break;
+	case emitter_type_int64:
+		malloc_snprintf(val, size, " %"FMTd64,
+		    *(const int64_t *)value);
+		break;
+	case emitter_type_unsigned:
+		malloc_snprintf(val, size, " %u", *(const unsigned *)value);
+		break;
+	case emitter_type_uint32:
+		malloc_snprintf(val, size, " %"FMTu32,
+		    *(const uint32_t *)value);
+		break;
+	case emitter_type_uint64:
+		malloc_snprintf(val, size, " %"FMTu64,
+		    *(const uint64_t *)value);
+		break;
+	case emitter_type_size:
+		malloc_snprintf(val, size, " %zu", *(const size_t *)value);
+		break;
+	case emitter_type_ssize:
+		malloc_snprintf(val, size, " %zd", *(const ssize_t *)value);
+		break;
+	default:
+		unreachable();
+	}
+}
+
+/*
+ * Buffers a value as an OpenMetrics sample.  The frames that carry labels are
+ * identified by them, so their keys are left out of the name.
+ */
+void
+emitter_om_sample(emitter_t *emitter, emitter_type_t value_type,
+    const void *value) {
+	emitter_om_t *om = &emitter->om;
+	const char *key = emitter->om_key;
+	emitter->om_key = NULL;
+	if (value_type == emitter_type_string ||
+	    value_type == emitter_type_title || om->oom) {
+		return;
+	}
+
+	char name[EMITTER_OPENMETRICS_NAME_MAX];
+	size_t len = 0;
+	name[0] = '\0';
+	for (int i = 1; i <= emitter->nesting_depth; i++) {
+		emitter_om_frame_t *frame = &emitter->om_frames[i];
+		if (frame->labels[0] == '\0' && frame->key != NULL) {
+			len = emitter_om_name_append(name, len, frame->key);
+		}
+	}
+	if (key != NULL) {
+		len = emitter_om_name_append(name, len, key);
+	}
+	/* Values without any key have nothing to be named after. */
+	if (len == 0) {
+		return;
+	}
+
+	char series[EMITTER_OM_SERIES_MAX];
+	emitter_om_series(emitter, series, value_type, value);
+
+	size_t ind = emitter_om_family_get(om, name);
+	size_t offset = (ind == EMITTER_OM_NONE) ? EMITTER_OM_NONE :
+	    emitter_om_append(om, series, true);
+	if (offset == EMITTER_OM_NONE) {
+		om->oom = true;
+		return;
+	}
+	emitter_om_family_t *family = &om->families[ind];
+	if (family->tail == EMITTER_OM_NONE) {
+		family->head = offset;
+	} else {
+		*(size_t *)&om->buf[family->tail] = offset;
+	}
+	family->tail = offset;
+}
+
+/* Writes out the buffered samples, family by family, and frees them. */
+void
+emitter_om_flush(emitter_t *emitter) {
+	emitter_om_t *om = &emitter->om;
+	if (om->oom) {
+		malloc_write("<jemalloc>: Out of memory in OpenMetrics stats "
+		    "output; samples dropped\n");
+	} else {
+		for (size_t i = 0; i < om->nfamilies; i++) {
+			emitter_om_family_t *family = &om->families[i];
+			const char *name = &om->buf[family->name];
+			emitter_printf(emitter, "# TYPE %s %s\n", name,
+			    family->counter ? "counter" : "gauge");
+			for (size_t offset = family->head;
+			    offset != EMITTER_OM_NONE;
+			    offset = *(size_t *)&om->buf[offset]) {
+				emitter_printf(emitter, "%s%s%s\n", name,
+				    family->counter ? "_total" : "",
+				    &om->buf[offset + sizeof(size_t)]);
+			}
+		}
+	}
+
+	tsdn_t *tsdn = tsdn_fetch();
+	if (om->buf != NULL) {
+		idalloctm(tsdn, om->buf, NULL, NULL, true, true);
+	}
+	if (om->families != NULL) {
+		idalloctm(tsdn, om->families, NULL, NULL, true, true);
+	}
+	emitter_openmetrics_counter_t *counter = om->counter;
+	memset(om, 0, sizeof(*om));
+	om->counter = counter;
+}
@@ -4,8 +4,11 @@
 #include "jemalloc/internal/assert.h"
 #include "jemalloc/internal/emap.h"
 #include "jemalloc/internal/extent_dss.h"
+#include "jemalloc/internal/extent_hugetlb.h"
 #include "jemalloc/internal/extent_mmap.h"
+#include "jemalloc/internal/latency.h"
 #include "jemalloc/internal/ph.h"
+#include "jemalloc/internal/probe.h"
 #include "jemalloc/internal/mutex.h"
 
 /******************************************************************************/
@@ -45,6 +48,7 @@ static edata_t *extent_alloc_retained(tsdn_t *tsdn, pac_t *pac,
     bool zero, bool *commit, bool guarded);
 static bool extent_decommit_wrapper(tsdn_t *tsdn, ehooks_t *ehooks,
     edata_t *edata, size_t offset, size_t length);
+static bool extent_prefault(pac_t *pac, edata_t *edata);
 
 /******************************************************************************/
 
@@ -59,6 +63,19 @@ extent_may_force_decay(pac_t *pac) {
 	    || pac_decay_ms_get(pac, extent_state_muzzy) == -1);
 }
 
+/* Returns the eset of ecache that edata belongs in. */
+static inline eset_t *
+extent_eset_get(ecache_t *ecache, const edata_t *edata) {
+	if (edata_guarded_get(edata)) {
+		return &ecache->guarded_eset;
+	}
+	if (edata_prefaulted_get(edata)) {
+		assert(ecache->state == extent_state_retained);
+		return &ecache->prefaulted_eset;
+	}
+	return &ecache->eset;
+}
+
 static bool
 extent_try_delayed_coalesce(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
     ecache_t *ecache, edata_t *edata) {
@@ -72,7 +89,7 @@ extent_try_delayed_coalesce(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
 	if (!coalesced) {
 		return true;
 	}
-	eset_insert(&ecache->eset, edata);
+	eset_insert(extent_eset_get(ecache, edata), edata);
 	return false;
 }
 
@@ -129,6 +146,19 @@ ecache_alloc_grow(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks, ecache_t *ecache,
 		    size, alignment, zero, &commit,
 		    /* growing_retained */ false);
 	}
+	if (edata != NULL) {
+		/*
+		 * Unless it comes from the prefaulted reserve, the memory
+		 * either comes straight from the extent hooks or was purged on
+		 * its way into the retained ecache; either way it may not be
+		 * backed yet.
+		 */
+		if (edata_prefaulted_get(edata)) {
+			edata_prefaulted_set(edata, false);
+		} else {
+			extent_prefault(pac, edata);
+		}
+	}
 
 	assert(edata == NULL || edata_pai_get(edata) == EXTENT_PAI_PAC);
 	return edata;
@@ -163,6 +193,11 @@ ecache_evict(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
 		/* Get the LRU extent, if any. */
 		eset_t *eset = &ecache->eset;
 		edata = edata_list_inactive_first(&eset->lru);
+		if (edata == NULL) {
+			/* Prefaulted extents are the last to be given up. */
+			eset = &ecache->prefaulted_eset;
+			edata = edata_list_inactive_first(&eset->lru);
+		}
 		if (edata == NULL) {
 			/*
 			 * Next check if there are guarded extents.  They are
@@ -254,9 +289,7 @@ extent_deactivate_locked_impl(tsdn_t *tsdn, pac_t *pac, ecache_t *ecache,
 	assert(edata_arena_ind_get(edata) == ecache_ind_get(ecache));
 
 	emap_update_edata_state(tsdn, pac->emap, edata, ecache->state);
-	eset_t *eset = edata_guarded_get(edata) ? &ecache->guarded_eset :
-	    &ecache->eset;
-	eset_insert(eset, edata);
+	eset_insert(extent_eset_get(ecache, edata), edata);
 }
 
 static void
@@ -274,13 +307,13 @@ extent_deactivate_check_state_locked(tsdn_t *tsdn, pac_t *pac, ecache_t *ecache,
 }
 
 static void
-extent_activate_locked(tsdn_t *tsdn, pac_t *pac, ecache_t *ecache, eset_t *eset,
+extent_activate_locked(tsdn_t *tsdn, pac_t *pac, ecache_t *ecache,
     edata_t *edata) {
 	assert(edata_arena_ind_get(edata) == ecache_ind_get(ecache));
 	assert(edata_state_get(edata) == ecache->state ||
 	    edata_state_get(edata) == extent_state_merging);
 
-	eset_remove(eset, edata);
+	eset_remove(extent_eset_get(ecache, edata), edata);
 	emap_update_edata_state(tsdn, pac->emap, edata, extent_state_active);
 }
 
@@ -438,14 +471,22 @@ extent_recycle_extract(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
 		 * allocations.
 		 */
 		bool exact_only = (!maps_coalesce && !opt_retain) || guarded;
-		edata = eset_fit(eset, size, alignment, exact_only,
-		    lg_max_fit);
+		edata = NULL;
+		if (!guarded && ecache->state == extent_state_retained) {
+			/* Hand out the prefaulted reserve first. */
+			edata = eset_fit(&ecache->prefaulted_eset, size,
+			    alignment, exact_only, lg_max_fit);
+		}
+		if (edata == NULL) {
+			edata = eset_fit(eset, size, alignment, exact_only,
+			    lg_max_fit);
+		}
 	}
 	if (edata == NULL) {
 		return NULL;
 	}
 	assert(!guarded || edata_guarded_get(edata));
-	extent_activate_locked(tsdn, pac, ecache, eset, edata);
+	extent_activate_locked(tsdn, pac, ecache, edata);
 
 	return edata;
 }
@@ -639,6 +680,85 @@ extent_recycle(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks, ecache_t *ecache,
 	return edata;
 }
 
+/*
+ * Faults in a committed extent according to the pac's prefault mode, so that
+ * the application doesn't take the page faults on first touch.  mlock()
+ * failures (e.g. due to RLIMIT_MEMLOCK) degrade to populating the pages.
+ * Returns true if the extent was not prefaulted.
+ */
+static bool
+extent_prefault(pac_t *pac, edata_t *edata) {
+	prefault_mode_t mode = pac_prefault_get(pac);
+	if (mode == prefault_mode_disabled || !edata_committed_get(edata)) {
+		return true;
+	}
+	void *addr = edata_base_get(edata);
+	size_t size = edata_size_get(edata);
+	if (mode == prefault_mode_mlock &&
+	    !pages_mlock(pages_caller_pac, addr, size)) {
+		edata_mlocked_set(edata, true);
+		return false;
+	}
+	return pages_populate(pages_caller_pac, addr, size);
+}
+
+/*
+ * Locked pages can't be purged (madvise() fails on them) or decommitted, so
+ * unlock extents before handing them back to the extent hooks.
+ */
+static void
+extent_munlock(edata_t *edata) {
+	if (!edata_mlocked_get(edata)) {
+		return;
+	}
+	pages_munlock(pages_caller_pac, edata_base_get(edata),
+	    edata_size_get(edata));
+	edata_mlocked_set(edata, false);
+}
+
+bool
+extent_grow_retained_ahead(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
+    size_t size) {
+	witness_assert_depth_to_rank(tsdn_witness_tsdp_get(tsdn),
+	    WITNESS_RANK_CORE, 0);
+	assert(opt_retain);
+	assert(size != 0 && PAGE_CEILING(size) == size);
+
+	size_t alloc_granularity = extent_hugetlb_granularity(
+	    ehooks_get_extent_hooks_ptr(ehooks));
+	size_t alloc_size = ALIGNMENT_CEILING(size, alloc_granularity);
+	if (alloc_size < size) {
+		return true;
+	}
+	edata_t *edata = edata_cache_get(tsdn, pac->edata_cache);
+	if (edata == NULL) {
+		return true;
+	}
+	/* Only memory that is to be prefaulted needs to be committed. */
+	bool zeroed = false;
+	bool committed = (pac_prefault_get(pac) != prefault_mode_disabled);
+	void *ptr = ehooks_alloc(tsdn, ehooks, NULL, alloc_size, PAGE, &zeroed,
+	    &committed);
+	if (ptr == NULL) {
+		edata_cache_put(tsdn, pac->edata_cache, edata);
+		return true;
+	}
+	edata_init(edata, ecache_ind_get(&pac->ecache_retained), ptr,
+	    alloc_size, false, SC_NSIZES, extent_sn_next(pac),
+	    extent_state_active, zeroed, committed, EXTENT_PAI_PAC,
+	    EXTENT_IS_HEAD);
+	if (extent_register_no_gdump_add(tsdn, pac, edata)) {
+		edata_cache_put(tsdn, pac->edata_cache, edata);
+		return true;
+	}
+	if (!extent_prefault(pac, edata)) {
+		edata_prefaulted_set(edata, true);
+	}
+	extent_record(tsdn, pac, ehooks, &pac->ecache_retained, edata);
+
+	return false;
+}
+
 /*
  * If virtual memory is retained, create increasingly larger extents from which
  * to split requested extents in order to limit the total number of disjoint
@@ -665,6 +785,13 @@ extent_grow_retained(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
 	if (err) {
 		goto label_err;
 	}
+	/* The built-in hugetlb hooks can only map whole huge pages. */
+	size_t alloc_granularity = extent_hugetlb_granularity(
+	    ehooks_get_extent_hooks_ptr(ehooks));
+	alloc_size = ALIGNMENT_CEILING(alloc_size, alloc_granularity);
+	if (alloc_size < alloc_size_min) {
+		goto label_err;
+	}
 
 	edata_t *edata = edata_cache_get(tsdn, pac->edata_cache);
 	if (edata == NULL) {
@@ -680,6 +807,8 @@ extent_grow_retained(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
 		edata_cache_put(tsdn, pac->edata_cache, edata);
 		goto label_err;
 	}
+	JE_PROBE3(extent_grow, ecache_ind_get(&pac->ecache_retained), size,
+	    alloc_size);
 
 	edata_init(edata, ecache_ind_get(&pac->ecache_retained), ptr,
 	    alloc_size, false, SC_NSIZES, extent_sn_next(pac),
@@ -792,13 +921,20 @@ extent_alloc_retained(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
 			extent_gdump_add(tsdn, edata);
 		}
 	} else if (opt_retain && expand_edata == NULL && !guarded) {
+		uint64_t start = latency_begin(tsdn);
 		edata = extent_grow_retained(tsdn, pac, ehooks, size,
 		    alignment, zero, commit);
 		/* extent_grow_retained() always releases pac->grow_mtx. */
+		latency_end(tsdn, latency_tier_extent_grow_retained, start);
 	} else {
 		malloc_mutex_unlock(tsdn, &pac->grow_mtx);
 	}
 	malloc_mutex_assert_not_owner(tsdn, &pac->grow_mtx);
+	if (edata != NULL) {
+		/* Feeds the background thread's growth prediction. */
+		atomic_fetch_add_zu(&pac->retained_consumed, size,
+		    ATOMIC_RELAXED);
+	}
 
 	return edata;
 }
@@ -807,7 +943,7 @@ static bool
 extent_coalesce(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks, ecache_t *ecache,
     edata_t *inner, edata_t *outer, bool forward) {
 	extent_assert_can_coalesce(inner, outer);
-	eset_remove(&ecache->eset, outer);
+	eset_remove(extent_eset_get(ecache, outer), outer);
 
 	bool err = extent_merge_impl(tsdn, pac, ehooks,
 	    forward ? inner : outer, forward ? outer : inner,
@@ -1037,7 +1173,9 @@ extent_dalloc_wrapper(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
 	assert(edata_pai_get(edata) == EXTENT_PAI_PAC);
 	witness_assert_depth_to_rank(tsdn_witness_tsdp_get(tsdn),
 	    WITNESS_RANK_CORE, 0);
+	uint64_t start = latency_begin(tsdn);
 
+	extent_munlock(edata);
 	/* Avoid calling the default extent_dalloc unless have to. */
 	if (!ehooks_dalloc_will_fail(ehooks)) {
 		/* Remove guard pages for dalloc / unmap. */
@@ -1052,6 +1190,7 @@ extent_dalloc_wrapper(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
 		 */
 		extent_deregister(tsdn, pac, edata);
 		if (!extent_dalloc_wrapper_try(tsdn, pac, ehooks, edata)) {
+			latency_end(tsdn, latency_tier_extent_dalloc, start);
 			return;
 		}
 		extent_reregister(tsdn, pac, edata);
@@ -1081,6 +1220,7 @@ extent_dalloc_wrapper(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
 	}
 
 	extent_record(tsdn, pac, ehooks, &pac->ecache_retained, edata);
+	latency_end(tsdn, latency_tier_extent_dalloc, start);
 }
 
 void
@@ -1099,6 +1239,7 @@ extent_destroy_wrapper(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
 		san_unguard_pages_pre_destroy(tsdn, ehooks, edata, pac->emap);
 	}
 	edata_addr_set(edata, edata_base_get(edata));
+	extent_munlock(edata);
 
 	/* Try to destroy; silently fail otherwise. */
 	ehooks_destroy(tsdn, ehooks, edata_base_get(edata),
@@ -1130,6 +1271,7 @@ extent_decommit_wrapper(tsdn_t *tsdn, ehooks_t *ehooks, edata_t *edata,
     size_t offset, size_t length) {
 	witness_assert_depth_to_rank(tsdn_witness_tsdp_get(tsdn),
 	    WITNESS_RANK_CORE, 0);
+	extent_munlock(edata);
 	bool err = ehooks_decommit(tsdn, ehooks, edata_base_get(edata),
 	    edata_size_get(edata), offset, length);
 	edata_committed_set(edata, edata_committed_get(edata) && err);
@@ -1141,6 +1283,7 @@ extent_purge_lazy_impl(tsdn_t *tsdn, ehooks_t *ehooks, edata_t *edata,
     size_t offset, size_t length, bool growing_retained) {
 	witness_assert_depth_to_rank(tsdn_witness_tsdp_get(tsdn),
 	    WITNESS_RANK_CORE, growing_retained ? 1 : 0);
+	extent_munlock(edata);
 	bool err = ehooks_purge_lazy(tsdn, ehooks, edata_base_get(edata),
 	    edata_size_get(edata), offset, length);
 	return err;
@@ -1158,6 +1301,7 @@ extent_purge_forced_impl(tsdn_t *tsdn, ehooks_t *ehooks, edata_t *edata,
     size_t offset, size_t length, bool growing_retained) {
 	witness_assert_depth_to_rank(tsdn_witness_tsdp_get(tsdn),
 	    WITNESS_RANK_CORE, growing_retained ? 1 : 0);
+	extent_munlock(edata);
 	bool err = ehooks_purge_forced(tsdn, ehooks, edata_base_get(edata),
 	    edata_size_get(edata), offset, length);
 	return err;
@@ -1204,6 +1348,8 @@ extent_split_impl(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks,
 	    /* slab */ false, SC_NSIZES, edata_sn_get(edata),
 	    edata_state_get(edata), edata_zeroed_get(edata),
 	    edata_committed_get(edata), EXTENT_PAI_PAC, EXTENT_NOT_HEAD);
+	edata_prefaulted_set(trail, edata_prefaulted_get(edata));
+	edata_mlocked_set(trail, edata_mlocked_get(edata));
 	emap_prepare_t prepare;
 	bool err = emap_split_prepare(tsdn, pac->emap, &prepare, edata,
 	    size_a, trail, size_b);
@@ -1286,6 +1432,9 @@ extent_merge_impl(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks, edata_t *a,
 	edata_sn_set(a, (edata_sn_get(a) < edata_sn_get(b)) ?
 	    edata_sn_get(a) : edata_sn_get(b));
 	edata_zeroed_set(a, edata_zeroed_get(a) && edata_zeroed_get(b));
+	edata_prefaulted_set(a, edata_prefaulted_get(a) &&
+	    edata_prefaulted_get(b));
+	edata_mlocked_set(a, edata_mlocked_get(a) || edata_mlocked_get(b));
 
 	emap_merge_commit(tsdn, pac->emap, &prepare, a, b);
 
@@ -200,7 +200,8 @@ extent_alloc_dss(tsdn_t *tsdn, arena_t *arena, void *new_addr, size_t size,
 					    &arena->pa_shard.edata_cache, gap);
 				}
 				if (!*commit) {
-					*commit = pages_decommit(ret, size);
+					*commit = pages_decommit(
+					    pages_caller_pac, ret, size);
 				}
 				if (*zero && *commit) {
 					edata_t edata = {0};
@@ -0,0 +1,340 @@
+#include "jemalloc/internal/jemalloc_preamble.h"
+#include "jemalloc/internal/jemalloc_internal_includes.h"
+
+#include "jemalloc/internal/assert.h"
+#include "jemalloc/internal/ehooks.h"
+#include "jemalloc/internal/extent_hugetlb.h"
+#include "jemalloc/internal/extent_mmap.h"
+#include "jemalloc/internal/malloc_io.h"
+
+#ifdef JEMALLOC_HAVE_MAP_HUGETLB
+#include <sys/vfs.h>
+#endif
+
+/******************************************************************************/
+/* Data. */
+
+const char *const hugetlb_mode_names[] = {
+	"disabled",
+	"2m",
+	"1g",
+	"N/A"
+};
+
+hugetlb_mode_t opt_hugetlb = HUGETLB_MODE_DEFAULT;
+char opt_hugetlb_path[PATH_MAX + 1];
+
+#ifdef JEMALLOC_HAVE_MAP_HUGETLB
+/* From linux/magic.h. */
+#define HUGETLBFS_MAGIC 0x958458f6
+
+/*
+ * lg of the page size of the hugetlbfs mount at opt_hugetlb_path, or 0 if no
+ * usable mount was configured.  Only hooks of the matching mode back their
+ * extents with files there; the others use anonymous mappings.
+ */
+static unsigned hugetlb_file_lg_page;
+
+static const extent_hooks_t extent_hugetlb_2m_hooks;
+static const extent_hooks_t extent_hugetlb_1g_hooks;
+
+/******************************************************************************/
+
+static unsigned
+extent_hugetlb_lg_page(extent_hooks_t *extent_hooks) {
+	assert(extent_hooks == &extent_hugetlb_2m_hooks ||
+	    extent_hooks == &extent_hugetlb_1g_hooks);
+	return (extent_hooks == &extent_hugetlb_1g_hooks) ? LG_HUGETLB_1G :
+	    LG_HUGETLB_2M;
+}
+
+/*
+ * The kernel only operates on hugetlb mappings in whole huge pages; partial
+ * munmap()/madvise() calls either fail or, on some kernels, get rounded out to
+ * the surrounding huge page (taking neighboring extents with them).  We can't
+ * tell a hugetlb range from a fallback range of normal pages without tracking
+ * them, so every operation that gives memory back is limited to ranges that
+ * cover whole huge pages.
+ */
+static bool
+extent_hugetlb_aligned(void *addr, size_t size, unsigned lg_page) {
+	size_t mask = (ZU(1) << lg_page) - 1;
+	return ((uintptr_t)addr & mask) == 0 && (size & mask) == 0;
+}
+
+static int
+extent_hugetlb_file_open(void) {
+	char path[PATH_MAX + 1];
+	if (malloc_snprintf(path, sizeof(path), "%s/jemalloc.XXXXXX",
+	    opt_hugetlb_path) >= sizeof(path)) {
+		return -1;
+	}
+	int fd = mkstemp(path);
+	if (fd != -1) {
+		unlink(path);
+	}
+	return fd;
+}
+
+static void *
+extent_hugetlb_mmap(void *addr, size_t size, unsigned lg_page) {
+	void *ret = MAP_FAILED;
+	if (hugetlb_file_lg_page == lg_page) {
+		/*
+		 * Each mapping gets its own unlinked file, so that the pages
+		 * are released once the mapping (and any hole punched into it)
+		 * goes away.
+		 */
+		int fd = extent_hugetlb_file_open();
+		if (fd != -1) {
+			if (ftruncate(fd, (off_t)size) == 0) {
+				ret = mmap(addr, size, PROT_READ | PROT_WRITE,
+				    MAP_SHARED, fd, 0);
+			}
+			close(fd);
+		}
+	}
+	if (ret == MAP_FAILED) {
+		ret = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE |
+		    MAP_ANONYMOUS | MAP_HUGETLB | (lg_page << MAP_HUGE_SHIFT),
+		    -1, 0);
+	}
+	return ret == MAP_FAILED ? NULL : ret;
+}
+
+static void *
+extent_hugetlb_map(void *new_addr, size_t size, size_t alignment,
+    unsigned lg_page) {
+	size_t hugetlb_page = ZU(1) << lg_page;
+	if (!extent_hugetlb_aligned(new_addr, size, lg_page)) {
+		return NULL;
+	}
+	/* Mappings come back aligned to the huge page size. */
+	size_t alloc_size = size + ((alignment > hugetlb_page) ? alignment -
+	    hugetlb_page : 0);
+	/* Beware size_t wrap-around. */
+	if (alloc_size < size) {
+		return NULL;
+	}
+	void *pages = extent_hugetlb_mmap(new_addr, alloc_size, lg_page);
+	if (pages == NULL) {
+		return NULL;
+	}
+	if (new_addr != NULL && pages != new_addr) {
+		munmap(pages, alloc_size);
+		return NULL;
+	}
+	size_t leadsize = ALIGNMENT_CEILING((uintptr_t)pages, alignment) -
+	    (uintptr_t)pages;
+	size_t trailsize = alloc_size - leadsize - size;
+	void *ret = (void *)((byte_t *)pages + leadsize);
+	if (leadsize != 0) {
+		munmap(pages, leadsize);
+	}
+	if (trailsize != 0) {
+		munmap((void *)((byte_t *)ret + size), trailsize);
+	}
+	return ret;
+}
+
+static void *
+extent_hugetlb_alloc(extent_hooks_t *extent_hooks, void *new_addr,
+    size_t size, size_t alignment, bool *zero, bool *commit,
+    unsigned arena_ind) {
+	alignment = ALIGNMENT_CEILING(alignment, PAGE);
+	void *ret = extent_hugetlb_map(new_addr, size, alignment,
+	    extent_hugetlb_lg_page(extent_hooks));
+	if (ret != NULL) {
+		*zero = true;
+		*commit = true;
+		return ret;
+	}
+	/*
+	 * Either the pool is exhausted or the request can't be expressed in
+	 * huge pages.  Fall back to normal pages; these are committed up front
+	 * since the hooks can't decommit (or later commit) anything.
+	 */
+	bool fallback_commit = true;
+	ret = extent_alloc_mmap(pages_caller_pac, new_addr, size, alignment,
+	    zero, &fallback_commit);
+	if (ret == NULL) {
+		return NULL;
+	}
+	if (have_madvise_huge) {
+		pages_set_thp_state(pages_caller_pac, ret, size);
+	}
+	*commit = true;
+	return ret;
+}
+
+static bool
+extent_hugetlb_unmap(void *addr, size_t size, unsigned lg_page) {
+	if (!extent_hugetlb_aligned(addr, size, lg_page)) {
+		return true;
+	}
+	if (hugetlb_file_lg_page == lg_page) {
+		/*
+		 * File-backed pages outlive partial unmaps; punch them out
+		 * first.  This fails harmlessly on anonymous mappings.
+		 */
+		madvise(addr, size, MADV_REMOVE);
+	}
+	return munmap(addr, size) != 0;
+}
+
+static bool
+extent_hugetlb_dalloc(extent_hooks_t *extent_hooks, void *addr, size_t size,
+    bool committed, unsigned arena_ind) {
+	if (opt_retain) {
+		return true;
+	}
+	return extent_hugetlb_unmap(addr, size,
+	    extent_hugetlb_lg_page(extent_hooks));
+}
+
+static void
+extent_hugetlb_destroy(extent_hooks_t *extent_hooks, void *addr, size_t size,
+    bool committed, unsigned arena_ind) {
+	/*
+	 * Ranges that don't cover whole huge pages can't be unmapped on their
+	 * own; they stay mapped (and are leaked) rather than risk taking live
+	 * neighbors down with them.
+	 */
+	extent_hugetlb_unmap(addr, size, extent_hugetlb_lg_page(extent_hooks));
+}
+
+static bool
+extent_hugetlb_purge_forced(extent_hooks_t *extent_hooks, void *addr,
+    size_t size, size_t offset, size_t length, unsigned arena_ind) {
+	unsigned lg_page = extent_hugetlb_lg_page(extent_hooks);
+	void *purge_addr = (void *)((byte_t *)addr + (uintptr_t)offset);
+	if (!extent_hugetlb_aligned(purge_addr, length, lg_page)) {
+		return true;
+	}
+	/*
+	 * MADV_REMOVE frees the pages of shared (file-backed) mappings, and
+	 * MADV_DONTNEED those of private ones.  Either way the range reads back
+	 * as zeros.
+	 */
+	if (hugetlb_file_lg_page == lg_page && madvise(purge_addr, length,
+	    MADV_REMOVE) == 0) {
+		return false;
+	}
+	return madvise(purge_addr, length, MADV_DONTNEED) != 0;
+}
+
+static bool
+extent_hugetlb_split(extent_hooks_t *extent_hooks, void *addr, size_t size,
+    size_t size_a, size_t size_b, bool committed, unsigned arena_ind) {
+	/*
+	 * Splitting and merging only affect jemalloc's bookkeeping; the
+	 * granularity constraints are enforced when memory is handed back to
+	 * the kernel.
+	 */
+	return false;
+}
+
+static bool
+extent_hugetlb_merge(extent_hooks_t *extent_hooks, void *addr_a,
+    size_t size_a, void *addr_b, size_t size_b, bool committed,
+    unsigned arena_ind) {
+	return false;
+}
+
+/*
+ * Huge pages can't be decommitted or lazily purged, so those hooks are left
+ * NULL; extents from these hooks are always committed.
+ */
+static const extent_hooks_t extent_hugetlb_2m_hooks = {
+	extent_hugetlb_alloc,
+	extent_hugetlb_dalloc,
+	extent_hugetlb_destroy,
+	NULL,
+	NULL,
+	NULL,
+	extent_hugetlb_purge_forced,
+	extent_hugetlb_split,
+	extent_hugetlb_merge
+};
+
+static const extent_hooks_t extent_hugetlb_1g_hooks = {
+	extent_hugetlb_alloc,
+	extent_hugetlb_dalloc,
+	extent_hugetlb_destroy,
+	NULL,
+	NULL,
+	NULL,
+	extent_hugetlb_purge_forced,
+	extent_hugetlb_split,
+	extent_hugetlb_merge
+};
+#endif /* JEMALLOC_HAVE_MAP_HUGETLB */
+
+/******************************************************************************/
+
+extent_hooks_t *
+extent_hugetlb_hooks_get(hugetlb_mode_t mode) {
+	switch (mode) {
+	case hugetlb_mode_disabled:
+		return (extent_hooks_t *)&ehooks_default_extent_hooks;
+#ifdef JEMALLOC_HAVE_MAP_HUGETLB
+	case hugetlb_mode_2m:
+		return (extent_hooks_t *)&extent_hugetlb_2m_hooks;
+	case hugetlb_mode_1g:
+		return (extent_hooks_t *)&extent_hugetlb_1g_hooks;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+hugetlb_mode_t
+extent_hugetlb_mode_get(const extent_hooks_t *extent_hooks) {
+	if (extent_hooks == &ehooks_default_extent_hooks) {
+		return hugetlb_mode_disabled;
+	}
+#ifdef JEMALLOC_HAVE_MAP_HUGETLB
+	if (extent_hooks == &extent_hugetlb_2m_hooks) {
+		return hugetlb_mode_2m;
+	}
+	if (extent_hooks == &extent_hugetlb_1g_hooks) {
+		return hugetlb_mode_1g;
+	}
+#endif
+	return hugetlb_mode_limit;
+}
+
+size_t
+extent_hugetlb_granularity(const extent_hooks_t *extent_hooks) {
+	switch (extent_hugetlb_mode_get(extent_hooks)) {
+	case hugetlb_mode_2m:
+		return ZU(1) << LG_HUGETLB_2M;
+	case hugetlb_mode_1g:
+		return ZU(1) << LG_HUGETLB_1G;
+	default:
+		return PAGE;
+	}
+}
+
+void
+extent_hugetlb_boot(void) {
+#ifdef JEMALLOC_HAVE_MAP_HUGETLB
+	if (opt_hugetlb_path[0] == '\0') {
+		return;
+	}
+	struct statfs sfs;
+	if (statfs(opt_hugetlb_path, &sfs) != 0 ||
+	    sfs.f_type != HUGETLBFS_MAGIC) {
+		malloc_printf("<jemalloc>: %s is not a hugetlbfs mount; using "
+		    "anonymous huge pages\n", opt_hugetlb_path);
+		return;
+	}
+	unsigned lg_page = lg_floor((size_t)sfs.f_bsize);
+	if (lg_page != LG_HUGETLB_2M && lg_page != LG_HUGETLB_1G) {
+		malloc_printf("<jemalloc>: Unsupported page size on hugetlbfs "
+		    "mount %s; using anonymous huge pages\n", opt_hugetlb_path);
+		return;
+	}
+	hugetlb_file_lg_page = lg_page;
+#endif
+}
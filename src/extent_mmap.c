@@ -18,10 +18,10 @@ bool	opt_retain =
 /******************************************************************************/
 
 void *
-extent_alloc_mmap(void *new_addr, size_t size, size_t alignment, bool *zero,
-    bool *commit) {
+extent_alloc_mmap(pages_caller_t caller, void *new_addr, size_t size,
+    size_t alignment, bool *zero, bool *commit) {
 	assert(alignment == ALIGNMENT_CEILING(alignment, PAGE));
-	void *ret = pages_map(new_addr, size, alignment, commit);
+	void *ret = pages_map(caller, new_addr, size, alignment, commit);
 	if (ret == NULL) {
 		return NULL;
 	}
@@ -33,9 +33,9 @@ extent_alloc_mmap(void *new_addr, size_t size, size_t alignment, bool *zero,
 }
 
 bool
-extent_dalloc_mmap(void *addr, size_t size) {
+extent_dalloc_mmap(pages_caller_t caller, void *addr, size_t size) {
 	if (!opt_retain) {
-		pages_unmap(addr, size);
+		pages_unmap(caller, addr, size);
 	}
 	return opt_retain;
 }
@@ -4,6 +4,8 @@
 #include "jemalloc/internal/hpa.h"
 
 #include "jemalloc/internal/fb.h"
+#include "jemalloc/internal/nontemporal.h"
+#include "jemalloc/internal/probe.h"
 #include "jemalloc/internal/witness.h"
 
 #define HPA_EDEN_SIZE (128 * HUGEPAGE)
@@ -128,8 +130,8 @@ hpa_central_extract(tsdn_t *tsdn, hpa_central_t *central, size_t size,
 		 */
 		bool commit = true;
 		/* Allocate address space, bailing if we fail. */
-		void *new_eden = pages_map(NULL, HPA_EDEN_SIZE, HUGEPAGE,
-		    &commit);
+		void *new_eden = pages_map(pages_caller_hpa, NULL,
+		    HPA_EDEN_SIZE, HUGEPAGE, &commit);
 		if (new_eden == NULL) {
 			*oom = true;
 			malloc_mutex_unlock(tsdn, &central->grow_mtx);
@@ -137,7 +139,7 @@ hpa_central_extract(tsdn_t *tsdn, hpa_central_t *central, size_t size,
 		}
 		ps = hpa_alloc_ps(tsdn, central);
 		if (ps == NULL) {
-			pages_unmap(new_eden, HPA_EDEN_SIZE);
+			pages_unmap(pages_caller_hpa, new_eden, HPA_EDEN_SIZE);
 			*oom = true;
 			malloc_mutex_unlock(tsdn, &central->grow_mtx);
 			return NULL;
@@ -261,6 +263,14 @@ hpa_shard_stats_merge(tsdn_t *tsdn, hpa_shard_t *shard,
 	malloc_mutex_unlock(tsdn, &shard->grow_mtx);
 }
 
+void
+hpa_shard_nonderived_stats_merge(tsdn_t *tsdn, hpa_shard_t *shard,
+    hpa_shard_nonderived_stats_t *dst) {
+	malloc_mutex_lock(tsdn, &shard->mtx);
+	hpa_shard_nonderived_stats_accum(dst, &shard->stats);
+	malloc_mutex_unlock(tsdn, &shard->mtx);
+}
+
 static bool
 hpa_good_hugification_candidate(hpa_shard_t *shard, hpdata_t *ps) {
 	/*
@@ -416,6 +426,7 @@ hpa_try_purge(tsdn_t *tsdn, hpa_shard_t *shard) {
 
 	/* Actually do the purging, now that the lock is dropped. */
 	if (dehugify) {
+		JE_PROBE2(hpa_dehugify, shard->ind, hpdata_addr_get(to_purge));
 		shard->central->hooks.dehugify(hpdata_addr_get(to_purge),
 		    HUGEPAGE);
 	}
@@ -428,8 +439,12 @@ hpa_try_purge(tsdn_t *tsdn, hpa_shard_t *shard) {
 		total_purged += purge_size;
 		assert(total_purged <= HUGEPAGE);
 		purges_this_pass++;
-		shard->central->hooks.purge(purge_addr, purge_size);
+		if (shard->central->hooks.purge(purge_addr, purge_size)) {
+			purge_state.purged_zeroed = false;
+		}
 	}
+	JE_PROBE3(hpa_purge, shard->ind, hpdata_addr_get(to_purge),
+	    total_purged);
 
 	malloc_mutex_lock(tsdn, &shard->mtx);
 	/* The shard updates */
@@ -495,6 +510,7 @@ hpa_try_hugify(tsdn_t *tsdn, hpa_shard_t *shard) {
 
 	malloc_mutex_unlock(tsdn, &shard->mtx);
 
+	JE_PROBE2(hpa_hugify, shard->ind, hpdata_addr_get(to_hugify));
 	shard->central->hooks.hugify(hpdata_addr_get(to_hugify), HUGEPAGE);
 
 	malloc_mutex_lock(tsdn, &shard->mtx);
@@ -589,8 +605,8 @@ hpa_try_alloc_one_no_grow(tsdn_t *tsdn, hpa_shard_t *shard, size_t size,
 	void *addr = hpdata_reserve_alloc(ps, size);
 	edata_init(edata, shard->ind, addr, size, /* slab */ false,
 	    SC_NSIZES, /* sn */ hpdata_age_get(ps), extent_state_active,
-	    /* zeroed */ false, /* committed */ true, EXTENT_PAI_HPA,
-	    EXTENT_NOT_HEAD);
+	    hpdata_range_zeroed(ps, addr, size), /* committed */ true,
+	    EXTENT_PAI_HPA, EXTENT_NOT_HEAD);
 	edata_ps_set(edata, ps);
 
 	/*
@@ -782,13 +798,13 @@ hpa_alloc(tsdn_t *tsdn, pai_t *self, size_t size, size_t alignment, bool zero,
 	witness_assert_depth_to_rank(tsdn_witness_tsdp_get(tsdn),
 	    WITNESS_RANK_CORE, 0);
 
-	/* We don't handle alignment or zeroing for now. */
-	if (alignment > PAGE || zero) {
+	/* We don't handle alignment for now. */
+	if (alignment > PAGE) {
 		return NULL;
 	}
 	/*
-	 * An alloc with alignment == PAGE and zero == false is equivalent to a
-	 * batch alloc of 1.  Just do that, so we can share code.
+	 * An alloc with alignment == PAGE is equivalent to a batch alloc of 1.
+	 * Just do that, so we can share code.
 	 */
 	edata_list_active_t results;
 	edata_list_active_init(&results);
@@ -796,6 +812,14 @@ hpa_alloc(tsdn_t *tsdn, pai_t *self, size_t size, size_t alignment, bool zero,
 	    &results, frequent_reuse, deferred_work_generated);
 	assert(nallocs == 0 || nallocs == 1);
 	edata_t *edata = edata_list_active_first(&results);
+	/*
+	 * Pages that are fresh or were purged since they were last used are
+	 * already zero; only the rest needs clearing.
+	 */
+	if (edata != NULL && zero && !edata_zeroed_get(edata)) {
+		nontemporal_zero(edata_base_get(edata), edata_size_get(edata));
+		edata_zeroed_set(edata, true);
+	}
 	return edata;
 }
 
@@ -5,7 +5,7 @@
 
 static void *hpa_hooks_map(size_t size);
 static void hpa_hooks_unmap(void *ptr, size_t size);
-static void hpa_hooks_purge(void *ptr, size_t size);
+static bool hpa_hooks_purge(void *ptr, size_t size);
 static void hpa_hooks_hugify(void *ptr, size_t size);
 static void hpa_hooks_dehugify(void *ptr, size_t size);
 static void hpa_hooks_curtime(nstime_t *r_nstime, bool first_reading);
@@ -24,28 +24,28 @@ const hpa_hooks_t hpa_hooks_default = {
 static void *
 hpa_hooks_map(size_t size) {
 	bool commit = true;
-	return pages_map(NULL, size, HUGEPAGE, &commit);
+	return pages_map(pages_caller_hpa, NULL, size, HUGEPAGE, &commit);
 }
 
 static void
 hpa_hooks_unmap(void *ptr, size_t size) {
-	pages_unmap(ptr, size);
+	pages_unmap(pages_caller_hpa, ptr, size);
 }
 
-static void
+static bool
 hpa_hooks_purge(void *ptr, size_t size) {
-	pages_purge_forced(ptr, size);
+	return pages_purge_forced(pages_caller_hpa, ptr, size);
 }
 
 static void
 hpa_hooks_hugify(void *ptr, size_t size) {
-	bool err = pages_huge(ptr, size);
+	bool err = pages_huge(pages_caller_hpa, ptr, size);
 	(void)err;
 }
 
 static void
 hpa_hooks_dehugify(void *ptr, size_t size) {
-	bool err = pages_nohuge(ptr, size);
+	bool err = pages_nohuge(pages_caller_hpa, ptr, size);
 	(void)err;
 }
 
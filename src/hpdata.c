@@ -36,6 +36,9 @@ hpdata_init(hpdata_t *hpdata, void *addr, uint64_t age) {
 	fb_init(hpdata->active_pages, HUGEPAGE_PAGES);
 	hpdata->h_ntouched = 0;
 	fb_init(hpdata->touched_pages, HUGEPAGE_PAGES);
+	/* Pageslabs are always carved out of freshly mapped memory. */
+	fb_init(hpdata->zeroed_pages, HUGEPAGE_PAGES);
+	fb_set_range(hpdata->zeroed_pages, HUGEPAGE_PAGES, 0, HUGEPAGE_PAGES);
 
 	hpdata_assert_consistent(hpdata);
 }
@@ -147,6 +150,8 @@ hpdata_unreserve(hpdata_t *hpdata, void *addr, size_t sz) {
 	size_t old_longest_range = hpdata_longest_free_range_get(hpdata);
 
 	fb_unset_range(hpdata->active_pages, HUGEPAGE_PAGES, begin, npages);
+	/* The range may have been written to while it was allocated. */
+	fb_unset_range(hpdata->zeroed_pages, HUGEPAGE_PAGES, begin, npages);
 	/* We might have just created a new, larger range. */
 	size_t new_begin = (fb_fls(hpdata->active_pages, HUGEPAGE_PAGES,
 	    begin) + 1);
@@ -163,6 +168,18 @@ hpdata_unreserve(hpdata_t *hpdata, void *addr, size_t sz) {
 	hpdata_assert_consistent(hpdata);
 }
 
+bool
+hpdata_range_zeroed(hpdata_t *hpdata, void *addr, size_t sz) {
+	assert(((uintptr_t)addr & PAGE_MASK) == 0);
+	assert((sz & PAGE_MASK) == 0);
+	size_t begin = ((uintptr_t)addr - (uintptr_t)hpdata_addr_get(hpdata))
+	    >> LG_PAGE;
+	size_t npages = sz >> LG_PAGE;
+	assert(begin + npages <= HUGEPAGE_PAGES);
+	return fb_ucount(hpdata->zeroed_pages, HUGEPAGE_PAGES,
+	    begin, npages) == 0;
+}
+
 size_t
 hpdata_purge_begin(hpdata_t *hpdata, hpdata_purge_state_t *purge_state) {
 	hpdata_assert_consistent(hpdata);
@@ -175,6 +192,7 @@ hpdata_purge_begin(hpdata_t *hpdata, hpdata_purge_state_t *purge_state) {
 
 	purge_state->npurged = 0;
 	purge_state->next_purge_search_begin = 0;
+	purge_state->purged_zeroed = true;
 
 	/*
 	 * Initialize to_purge.
@@ -298,6 +316,10 @@ hpdata_purge_end(hpdata_t *hpdata, hpdata_purge_state_t *purge_state) {
 	    HUGEPAGE_PAGES, 0, HUGEPAGE_PAGES));
 	assert(purge_state->npurged >= purge_state->ndirty_to_purge);
 
+	if (purge_state->purged_zeroed) {
+		fb_bit_or(hpdata->zeroed_pages, hpdata->zeroed_pages,
+		    purge_state->to_purge, HUGEPAGE_PAGES);
+	}
 	fb_bit_not(purge_state->to_purge, purge_state->to_purge,
 	    HUGEPAGE_PAGES);
 	fb_bit_and(hpdata->touched_pages, hpdata->touched_pages,
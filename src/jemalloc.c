@@ -7,14 +7,17 @@
 #include "jemalloc/internal/ctl.h"
 #include "jemalloc/internal/emap.h"
 #include "jemalloc/internal/extent_dss.h"
+#include "jemalloc/internal/extent_hugetlb.h"
 #include "jemalloc/internal/extent_mmap.h"
 #include "jemalloc/internal/fxp.h"
 #include "jemalloc/internal/san.h"
 #include "jemalloc/internal/hook.h"
 #include "jemalloc/internal/jemalloc_internal_types.h"
+#include "jemalloc/internal/latency.h"
 #include "jemalloc/internal/log.h"
 #include "jemalloc/internal/malloc_io.h"
 #include "jemalloc/internal/mutex.h"
+#include "jemalloc/internal/nontemporal.h"
 #include "jemalloc/internal/nstime.h"
 #include "jemalloc/internal/rtree.h"
 #include "jemalloc/internal/safety_check.h"
@@ -1258,6 +1261,10 @@ malloc_conf_init_helper(sc_data_t *sc_data, unsigned bin_shard_sizes[SC_NBINS],
 				CONF_CONTINUE;
 			}
 			CONF_HANDLE_BOOL(opt_retain, "retain")
+			CONF_HANDLE_UNSIGNED(opt_retain_lookahead_ms,
+			    "retain_lookahead_ms", 0, UINT_MAX,
+			    CONF_DONT_CHECK_MIN, CONF_DONT_CHECK_MAX,
+			    /* clip */ false)
 			if (strncmp("dss", k, klen) == 0) {
 				int m;
 				bool match = false;
@@ -1282,6 +1289,53 @@ malloc_conf_init_helper(sc_data_t *sc_data, unsigned bin_shard_sizes[SC_NBINS],
 				}
 				CONF_CONTINUE;
 			}
+			if (CONF_MATCH("hugetlb")) {
+				int m;
+				bool match = false;
+				for (m = 0; m < hugetlb_mode_limit; m++) {
+					if (strncmp(hugetlb_mode_names[m], v,
+					    vlen) == 0) {
+						if (extent_hugetlb_hooks_get(m)
+						    == NULL) {
+							CONF_ERROR(
+							    "hugetlb not "
+							    "supported",
+							    k, klen, v, vlen);
+						} else {
+							opt_hugetlb = m;
+						}
+						match = true;
+						break;
+					}
+				}
+				if (!match) {
+					CONF_ERROR("Invalid conf value",
+					    k, klen, v, vlen);
+				}
+				CONF_CONTINUE;
+			}
+			CONF_HANDLE_CHAR_P(opt_hugetlb_path, "hugetlb_path", "")
+			if (CONF_MATCH("prefault")) {
+				int m;
+				bool match = false;
+				for (m = 0; m < prefault_mode_limit; m++) {
+					if (strncmp(prefault_mode_names[m], v,
+					    vlen) == 0) {
+						opt_prefault = m;
+						match = true;
+						break;
+					}
+				}
+				if (!match) {
+					CONF_ERROR("Invalid conf value",
+					    k, klen, v, vlen);
+				}
+				CONF_CONTINUE;
+			}
+			CONF_HANDLE_SIZE_T(opt_prefault_reserve,
+			    "prefault_reserve", 0, SIZE_T_MAX,
+			    CONF_DONT_CHECK_MIN, CONF_DONT_CHECK_MAX,
+			    /* clip */ false)
 			if (CONF_MATCH("narenas")) {
 				if (CONF_MATCH_VALUE("default")) {
 					opt_narenas = 0;
@@ -1353,6 +1407,8 @@ malloc_conf_init_helper(sc_data_t *sc_data, unsigned bin_shard_sizes[SC_NBINS],
 			CONF_HANDLE_INT64_T(opt_mutex_max_spin,
 			    "mutex_max_spin", -1, INT64_MAX, CONF_CHECK_MIN,
 			    CONF_DONT_CHECK_MAX, false);
+			CONF_HANDLE_BOOL(opt_mutex_prof_holders,
+			    "mutex_prof_holders")
 			CONF_HANDLE_SSIZE_T(opt_dirty_decay_ms,
 			    "dirty_decay_ms", -1, NSTIME_SEC_MAX * KQU(1000) <
 			    QU(SSIZE_MAX) ? NSTIME_SEC_MAX * KQU(1000) :
@@ -1375,6 +1431,28 @@ malloc_conf_init_helper(sc_data_t *sc_data, unsigned bin_shard_sizes[SC_NBINS],
 				    opt_stats_interval_opts);
 				CONF_CONTINUE;
 			}
+			CONF_HANDLE_INT64_T(opt_stats_bg_interval_ms,
+			    "stats_bg_interval_ms", -1, INT64_MAX / 1000000,
+			    CONF_CHECK_MIN, CONF_CHECK_MAX, true)
+			if (CONF_MATCH("stats_bg_opts")) {
+				init_opt_stats_opts(v, vlen,
+				    opt_stats_bg_opts);
+				CONF_CONTINUE;
+			}
+			CONF_HANDLE_BOOL(opt_stats_bg_delta, "stats_bg_delta")
+			CONF_HANDLE_T_SIGNED(int, opt_stats_bg_fd, "stats_bg_fd",
+			    -1, INT_MAX, CONF_CHECK_MIN, CONF_CHECK_MAX, false)
+			CONF_HANDLE_BOOL(opt_stats_latency, "stats_latency")
+			CONF_HANDLE_SIZE_T(opt_lg_stats_latency_sample,
+			    "lg_stats_latency_sample", 0, 63, CONF_DONT_CHECK_MIN,
+			    CONF_CHECK_MAX, true)
+			CONF_HANDLE_INT64_T(opt_stats_ts_interval_ms,
+			    "stats_ts_interval_ms", -1, INT64_MAX / 1000000,
+			    CONF_CHECK_MIN, CONF_CHECK_MAX, true)
+			CONF_HANDLE_SIZE_T(opt_stats_ts_nsamples,
+			    "stats_ts_nsamples", 1, SIZE_T_MAX
+			    / sizeof(stats_ts_sample_t), CONF_CHECK_MIN,
+			    CONF_CHECK_MAX, true)
 			if (config_fill) {
 				if (CONF_MATCH("junk")) {
 					if (CONF_MATCH_VALUE("true")) {
@@ -1482,6 +1560,9 @@ malloc_conf_init_helper(sc_data_t *sc_data, unsigned bin_shard_sizes[SC_NBINS],
 			CONF_HANDLE_SIZE_T(opt_oversize_threshold,
 			    "oversize_threshold", 0, SC_LARGE_MAXCLASS,
 			    CONF_DONT_CHECK_MIN, CONF_CHECK_MAX, false)
+			CONF_HANDLE_SIZE_T(opt_nontemporal_threshold,
+			    "nontemporal_threshold", 0, SIZE_T_MAX,
+			    CONF_DONT_CHECK_MIN, CONF_DONT_CHECK_MAX, false)
 			CONF_HANDLE_SIZE_T(opt_lg_extent_max_active_fit,
 			    "lg_extent_max_active_fit", 0,
 			    (sizeof(size_t) << 3), CONF_DONT_CHECK_MIN,
@@ -1627,7 +1708,13 @@ malloc_conf_init_helper(sc_data_t *sc_data, unsigned bin_shard_sizes[SC_NBINS],
 				    "lg_prof_sample", 0, (sizeof(uint64_t) << 3)
 				    - 1, CONF_DONT_CHECK_MIN, CONF_CHECK_MAX,
 				    true)
+				CONF_HANDLE_SIZE_T(opt_prof_sample_target,
+				    "prof_sample_target", 0, SIZE_T_MAX,
+				    CONF_DONT_CHECK_MIN, CONF_DONT_CHECK_MAX,
+				    false)
 				CONF_HANDLE_BOOL(opt_prof_accum, "prof_accum")
+				CONF_HANDLE_BOOL(opt_prof_lifetime,
+				    "prof_lifetime")
 				CONF_HANDLE_UNSIGNED(opt_prof_bt_max, "prof_bt_max",
 				    1, PROF_BT_MAX_LIMIT, CONF_CHECK_MIN, CONF_CHECK_MAX,
 				    /* clip */ true)
@@ -1635,6 +1722,26 @@ malloc_conf_init_helper(sc_data_t *sc_data, unsigned bin_shard_sizes[SC_NBINS],
 				    "lg_prof_interval", -1,
 				    (sizeof(uint64_t) << 3) - 1)
 				CONF_HANDLE_BOOL(opt_prof_gdump, "prof_gdump")
+				CONF_HANDLE_SIZE_T(opt_prof_watermark_allocated,
+				    "prof_watermark_allocated", 0, SIZE_T_MAX,
+				    CONF_DONT_CHECK_MIN, CONF_DONT_CHECK_MAX,
+				    false)
+				CONF_HANDLE_SIZE_T(opt_prof_watermark_resident,
+				    "prof_watermark_resident", 0, SIZE_T_MAX,
+				    CONF_DONT_CHECK_MIN, CONF_DONT_CHECK_MAX,
+				    false)
+				CONF_HANDLE_UNSIGNED(opt_prof_watermark_growth,
+				    "prof_watermark_growth", 0, UINT_MAX,
+				    CONF_DONT_CHECK_MIN, CONF_DONT_CHECK_MAX,
+				    false)
+				CONF_HANDLE_UNSIGNED(opt_prof_watermark_hysteresis,
+				    "prof_watermark_hysteresis", 0, 100,
+				    CONF_DONT_CHECK_MIN, CONF_CHECK_MAX, true)
+				CONF_HANDLE_UNSIGNED(
+				    opt_prof_watermark_interval_ms,
+				    "prof_watermark_interval_ms", 0, UINT_MAX,
+				    CONF_DONT_CHECK_MIN, CONF_DONT_CHECK_MAX,
+				    false)
 				CONF_HANDLE_BOOL(opt_prof_final, "prof_final")
 				CONF_HANDLE_BOOL(opt_prof_leak, "prof_leak")
 				CONF_HANDLE_BOOL(opt_prof_leak_error,
@@ -1666,6 +1773,38 @@ malloc_conf_init_helper(sc_data_t *sc_data, unsigned bin_shard_sizes[SC_NBINS],
 					}
 					CONF_CONTINUE;
 				}
+				if (CONF_MATCH("prof_format")) {
+					if (CONF_MATCH_VALUE("heap_v2")) {
+						opt_prof_format =
+						    prof_format_heap_v2;
+					} else if (CONF_MATCH_VALUE("pprof")) {
+						opt_prof_format =
+						    prof_format_pprof;
+					} else {
+						CONF_ERROR("Invalid conf value",
+						    k, klen, v, vlen);
+					}
+					CONF_CONTINUE;
+				}
+				if (CONF_MATCH("prof_backtrace_method")) {
+					if (CONF_MATCH_VALUE("default")) {
+						opt_prof_backtrace_method =
+						    prof_backtrace_method_default;
+					} else if (CONF_MATCH_VALUE("fp")) {
+#ifdef JEMALLOC_PROF_FRAME_POINTER
+						opt_prof_backtrace_method =
+						    prof_backtrace_method_fp;
+#else
+						CONF_ERROR("Frame pointer "
+						    "backtraces not supported",
+						    k, klen, v, vlen);
+#endif
+					} else {
+						CONF_ERROR("Invalid conf value",
+						    k, klen, v, vlen);
+					}
+					CONF_CONTINUE;
+				}
 				/*
 				 * Undocumented.  When set to false, don't
 				 * correct for an unbiasing bug in jeprof
@@ -1896,6 +2035,7 @@ malloc_init_hard_a0_locked(void) {
 	if (pages_boot()) {
 		return true;
 	}
+	nontemporal_boot();
 	if (base_boot(TSDN_NULL)) {
 		return true;
 	}
@@ -1906,6 +2046,7 @@ malloc_init_hard_a0_locked(void) {
 	if (extent_boot()) {
 		return true;
 	}
+	extent_hugetlb_boot();
 	if (ctl_boot()) {
 		return true;
 	}
@@ -2762,6 +2903,66 @@ malloc_default(size_t size) {
 	return ret;
 }
 
+/*
+ * Latency stats sampling for malloc() and free(); see latency.h.  Returns the
+ * tsd if the current call is to be timed, which is one in
+ * 2^opt_lg_stats_latency_sample per thread, and NULL otherwise.  The two are
+ * counted separately, so that alternating calls don't alias with the sampling
+ * period.
+ */
+static tsd_t *
+latency_sample_call(bool dalloc) {
+	tsd_t *tsd = tsd_get(false);
+	/* Skip threads that are still being set up or are torn down. */
+	if (tsd == NULL || tsd_state_get(tsd) > tsd_state_nominal_max) {
+		return NULL;
+	}
+	uint64_t *countdown = dalloc ? tsd_latency_free_countdownp_get(tsd) :
+	    tsd_latency_malloc_countdownp_get(tsd);
+	if (*countdown > 0) {
+		(*countdown)--;
+		return NULL;
+	}
+	*countdown = (UINT64_C(1) << opt_lg_stats_latency_sample) - 1;
+	return tsd;
+}
+
+/*
+ * The fallback for imalloc_fastpath() when timing it; just tells the caller
+ * that the fast path missed, so that the slow path can be timed separately.
+ */
+static char malloc_latency_miss_sentinel;
+#define MALLOC_LATENCY_MISS ((void *)&malloc_latency_miss_sentinel)
+
+static void *
+malloc_latency_miss(size_t size) {
+	return MALLOC_LATENCY_MISS;
+}
+
+JEMALLOC_NOINLINE
+static void *
+malloc_latency(size_t size) {
+	tsd_t *tsd = latency_sample_call(false);
+	if (tsd == NULL) {
+		return imalloc_fastpath(size, &malloc_default);
+	}
+
+	/* Lets the inner tiers know to time themselves too. */
+	bool sampled = tsd_latency_sampled_get(tsd);
+	tsd_latency_sampled_set(tsd, true);
+	uint64_t start = latency_now();
+	void *ret = imalloc_fastpath(size, &malloc_latency_miss);
+	if (ret != MALLOC_LATENCY_MISS) {
+		latency_end(tsd_tsdn(tsd), latency_tier_malloc_fastpath, start);
+	} else {
+		start = latency_now();
+		ret = malloc_default(size);
+		latency_end(tsd_tsdn(tsd), latency_tier_malloc_slowpath, start);
+	}
+	tsd_latency_sampled_set(tsd, sampled);
+	return ret;
+}
+
 /******************************************************************************/
 /*
  * Begin malloc(3)-compatible functions.
@@ -2773,7 +2974,12 @@ JEMALLOC_ATTR(malloc) JEMALLOC_ALLOC_SIZE(1)
 je_malloc(size_t size) {
 	LOG("core.malloc.entry", "size: %zu", size);
 
-	void * ret = imalloc_fastpath(size, &malloc_default);
+	void *ret;
+	if (config_stats && unlikely(opt_stats_latency)) {
+		ret = malloc_latency(size);
+	} else {
+		ret = imalloc_fastpath(size, &malloc_default);
+	}
 
 	LOG("core.malloc.exit", "result: %p", ret);
 	return ret;
@@ -3035,11 +3241,38 @@ free_default(void *ptr) {
 	}
 }
 
+JEMALLOC_NOINLINE
+static void
+free_latency(void *ptr) {
+	tsd_t *tsd = latency_sample_call(true);
+	if (tsd == NULL) {
+		je_free_impl(ptr);
+		return;
+	}
+
+	/* As for malloc_latency(). */
+	bool sampled = tsd_latency_sampled_get(tsd);
+	tsd_latency_sampled_set(tsd, true);
+	uint64_t start = latency_now();
+	if (free_fastpath(ptr, 0, false)) {
+		latency_end(tsd_tsdn(tsd), latency_tier_free_fastpath, start);
+	} else {
+		start = latency_now();
+		free_default(ptr);
+		latency_end(tsd_tsdn(tsd), latency_tier_free_slowpath, start);
+	}
+	tsd_latency_sampled_set(tsd, sampled);
+}
+
 JEMALLOC_EXPORT void JEMALLOC_NOTHROW
 je_free(void *ptr) {
 	LOG("core.free.entry", "ptr: %p", ptr);
 
-	je_free_impl(ptr);
+	if (config_stats && unlikely(opt_stats_latency)) {
+		free_latency(ptr);
+	} else {
+		je_free_impl(ptr);
+	}
 
 	LOG("core.free.exit", "");
 }
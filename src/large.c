@@ -4,7 +4,9 @@
 #include "jemalloc/internal/assert.h"
 #include "jemalloc/internal/emap.h"
 #include "jemalloc/internal/extent_mmap.h"
+#include "jemalloc/internal/latency.h"
 #include "jemalloc/internal/mutex.h"
+#include "jemalloc/internal/nontemporal.h"
 #include "jemalloc/internal/prof_recent.h"
 #include "jemalloc/internal/util.h"
 
@@ -23,6 +25,7 @@ large_palloc(tsdn_t *tsdn, arena_t *arena, size_t usize, size_t alignment,
 	size_t ausize;
 	edata_t *edata;
 	UNUSED bool idump JEMALLOC_CC_SILENCE_INIT(false);
+	uint64_t start = latency_begin(tsdn);
 
 	assert(!tsdn_null(tsdn) || arena != NULL);
 
@@ -48,6 +51,7 @@ large_palloc(tsdn_t *tsdn, arena_t *arena, size_t usize, size_t alignment,
 	}
 
 	arena_decay_tick(tsdn, arena);
+	latency_end(tsdn, latency_tier_large_alloc, start);
 	return edata_addr_get(edata);
 }
 
@@ -219,7 +223,7 @@ large_ralloc(tsdn_t *tsdn, arena_t *arena, void *ptr, size_t usize,
 	    ? hook_dalloc_realloc : hook_dalloc_rallocx, ptr, hook_args->args);
 
 	size_t copysize = (usize < oldusize) ? usize : oldusize;
-	memcpy(ret, edata_addr_get(edata), copysize);
+	nontemporal_copy(ret, edata_addr_get(edata), copysize);
 	isdalloct(tsdn, edata_addr_get(edata), oldusize, tcache, NULL, true);
 	return ret;
 }
@@ -268,10 +272,12 @@ large_dalloc_finish(tsdn_t *tsdn, edata_t *edata) {
 
 void
 large_dalloc(tsdn_t *tsdn, edata_t *edata) {
+	uint64_t start = latency_begin(tsdn);
 	arena_t *arena = arena_get_from_edata(edata);
 	large_dalloc_prep_impl(tsdn, arena, edata, false);
 	large_dalloc_finish_impl(tsdn, arena, edata);
 	arena_decay_tick(tsdn, arena);
+	latency_end(tsdn, latency_tier_large_dalloc, start);
 }
 
 size_t
@@ -291,6 +297,9 @@ large_prof_info_get(tsd_t *tsd, edata_t *edata, prof_info_t *prof_info,
 		nstime_copy(&prof_info->alloc_time,
 		    edata_prof_alloc_time_get(edata));
 		prof_info->alloc_size = edata_prof_alloc_size_get(edata);
+		prof_info->alloc_sample_level =
+		    edata_prof_sample_level_get(edata);
+		prof_info->alloc_tag = edata_prof_alloc_tag_get(edata);
 		if (reset_recent) {
 			/*
 			 * Reset the pointer on the recent allocation record,
@@ -312,11 +321,14 @@ large_prof_tctx_reset(edata_t *edata) {
 }
 
 void
-large_prof_info_set(edata_t *edata, prof_tctx_t *tctx, size_t size) {
+large_prof_info_set(edata_t *edata, prof_tctx_t *tctx, size_t size,
+    unsigned sample_level, unsigned alloc_tag) {
 	nstime_t t;
 	nstime_prof_init_update(&t);
 	edata_prof_alloc_time_set(edata, &t);
 	edata_prof_alloc_size_set(edata, size);
+	edata_prof_sample_level_set(edata, sample_level);
+	edata_prof_alloc_tag_set(edata, alloc_tag);
 	edata_prof_recent_alloc_init(edata);
 	large_prof_tctx_set(edata, tctx);
 }
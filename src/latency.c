@@ -0,0 +1,84 @@
+#include "jemalloc/internal/jemalloc_preamble.h"
+#include "jemalloc/internal/jemalloc_internal_includes.h"
+
+#include "jemalloc/internal/latency.h"
+
+/******************************************************************************/
+/* Data. */
+
+bool opt_stats_latency = false;
+size_t opt_lg_stats_latency_sample = LG_STATS_LATENCY_SAMPLE_DEFAULT;
+
+const char *const latency_tier_names[latency_num_tiers] = {
+#define OP(tier) #tier,
+	LATENCY_TIERS
+#undef OP
+};
+
+/******************************************************************************/
+
+uint64_t
+latency_begin_sampled(tsdn_t *tsdn) {
+	if (tsdn_null(tsdn) || !tsd_latency_sampled_get(tsdn_tsd(tsdn))) {
+		return 0;
+	}
+	return latency_now();
+}
+
+void
+latency_record(tsdn_t *tsdn, latency_tier_t tier, uint64_t ns) {
+	assert(tier < latency_num_tiers);
+	assert(!tsdn_null(tsdn));
+	/* Threads that haven't picked an arena yet count towards arena 0. */
+	arena_t *arena = tsd_arena_get(tsdn_tsd(tsdn));
+	if (arena == NULL) {
+		arena = arena_get(tsdn, 0, false);
+	}
+	latency_hist_t *hist = &arena->latency[tier];
+
+	stat_u64_add(&hist->nsamples, 1);
+	stat_u64_add(&hist->total_ns, ns);
+	stat_u64_add(&hist->buckets[latency_bucket(ns)], 1);
+}
+
+void
+latency_hist_merge(latency_hist_t *hist, latency_stats_t *stats) {
+	/*
+	 * Not a consistent snapshot; the buckets may be a few samples ahead of
+	 * or behind nsamples.
+	 */
+	stats->nsamples += stat_u64_read(&hist->nsamples);
+	stats->total_ns += stat_u64_read(&hist->total_ns);
+	for (unsigned i = 0; i < LATENCY_NBUCKETS; i++) {
+		stats->buckets[i] += stat_u64_read(&hist->buckets[i]);
+	}
+}
+
+void
+latency_stats_merge(latency_stats_t *dst, const latency_stats_t *src) {
+	dst->nsamples += src->nsamples;
+	dst->total_ns += src->total_ns;
+	for (unsigned i = 0; i < LATENCY_NBUCKETS; i++) {
+		dst->buckets[i] += src->buckets[i];
+	}
+}
+
+uint64_t
+latency_quantile(const latency_stats_t *stats, double q) {
+	uint64_t total = 0;
+	for (unsigned i = 0; i < LATENCY_NBUCKETS; i++) {
+		total += stats->buckets[i];
+	}
+	if (total == 0) {
+		return 0;
+	}
+	uint64_t target = (uint64_t)(q * (double)total);
+	uint64_t seen = 0;
+	for (unsigned i = 0; i < LATENCY_NBUCKETS - 1; i++) {
+		seen += stats->buckets[i];
+		if (seen > target) {
+			return (UINT64_C(1) << (i + 1)) - 1;
+		}
+	}
+	return UINT64_C(1) << (LATENCY_NBUCKETS - 1);
+}
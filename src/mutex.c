@@ -2,8 +2,11 @@
 #include "jemalloc/internal/jemalloc_internal_includes.h"
 
 #include "jemalloc/internal/assert.h"
+#include "jemalloc/internal/latency.h"
 #include "jemalloc/internal/malloc_io.h"
+#include "jemalloc/internal/probe.h"
 #include "jemalloc/internal/spin.h"
+#include "jemalloc/internal/stat_u64.h"
 
 #if defined(_WIN32) && !defined(_CRT_SPINCOUNT)
 #define _CRT_SPINCOUNT 4000
@@ -15,9 +18,25 @@
  */
 int64_t opt_mutex_max_spin = 600;
 
+bool opt_mutex_prof_holders = false;
+
 /******************************************************************************/
 /* Data. */
 
+typedef struct mutex_prof_holder_slot_s mutex_prof_holder_slot_t;
+struct mutex_prof_holder_slot_s {
+	/* Set once (from NULL), by the first waiter to see the site. */
+	atomic_p_t		site;
+	stat_u64_t		n_wait_times;
+	stat_u64_t		tot_wait_time;
+};
+
+/*
+ * Open addressed by site, never shrinks; once full, waits on behalf of new
+ * sites are not recorded.
+ */
+static mutex_prof_holder_slot_t mutex_prof_holders[MUTEX_PROF_NHOLDERS];
+
 #ifdef JEMALLOC_LAZY_LOCK
 bool isthreaded = false;
 #endif
@@ -48,10 +67,11 @@ JEMALLOC_EXPORT int	_pthread_mutex_init_calloc_cb(pthread_mutex_t *mutex,
     void *(calloc_cb)(size_t, size_t));
 #endif
 
-void
-malloc_mutex_lock_slow(malloc_mutex_t *mutex) {
+static void
+malloc_mutex_lock_slow_impl(malloc_mutex_t *mutex) {
 	mutex_prof_data_t *data = &mutex->prof_data;
-	nstime_t before;
+	uint64_t before_ns;
+	const char *holder_site;
 
 	if (ncpus == 1) {
 		goto label_spin_done;
@@ -73,10 +93,15 @@ malloc_mutex_lock_slow(malloc_mutex_t *mutex) {
 		return;
 	}
 label_spin_done:
-	nstime_init_update(&before);
-	/* Copy before to after to avoid clock skews. */
-	nstime_t after;
-	nstime_copy(&after, &before);
+	/*
+	 * The wait is timed with the precise clock; the one behind
+	 * nstime_update() may have ms resolution, which would put nearly all
+	 * waits in the same histogram bucket.  Waits are attributed to whoever
+	 * held the mutex when this thread gave up spinning.
+	 */
+	before_ns = latency_now();
+	holder_site = opt_mutex_prof_holders ? (const char *)atomic_load_p(
+	    &data->holder_site, ATOMIC_RELAXED) : NULL;
 	uint32_t n_thds = atomic_fetch_add_u32(&data->n_waiting_thds, 1,
 	    ATOMIC_RELAXED) + 1;
 	/* One last try as above two calls may take quite some cycles. */
@@ -90,20 +115,80 @@ label_spin_done:
 	malloc_mutex_lock_final(mutex);
 	/* Update more slow-path only counters. */
 	atomic_fetch_sub_u32(&data->n_waiting_thds, 1, ATOMIC_RELAXED);
-	nstime_update(&after);
+	uint64_t after_ns = latency_now();
+	/* Avoid clock skews. */
+	uint64_t wait_ns = (after_ns > before_ns) ? after_ns - before_ns : 0;
 
 	nstime_t delta;
-	nstime_copy(&delta, &after);
-	nstime_subtract(&delta, &before);
+	nstime_init(&delta, wait_ns);
 
 	data->n_wait_times++;
 	nstime_add(&data->tot_wait_time, &delta);
 	if (nstime_compare(&data->max_wait_time, &delta) < 0) {
 		nstime_copy(&data->max_wait_time, &delta);
 	}
+	data->wait_hist[mutex_prof_wait_bucket(wait_ns)]++;
 	if (n_thds > data->max_n_thds) {
 		data->max_n_thds = n_thds;
 	}
+	if (holder_site != NULL) {
+		mutex_prof_holder_record(holder_site, wait_ns);
+	}
+}
+
+void
+malloc_mutex_lock_slow(malloc_mutex_t *mutex) {
+	JE_PROBE1(mutex_contend_begin, mutex);
+	malloc_mutex_lock_slow_impl(mutex);
+	JE_PROBE1(mutex_contend_end, mutex);
+}
+
+void
+mutex_prof_holder_record(const char *site, uint64_t wait_ns) {
+	assert(site != NULL);
+	/*
+	 * Keyed by the address of the name, which is cheaper than comparing
+	 * strings; functions inlined into several files may take several slots.
+	 */
+	size_t start = (size_t)(((uint64_t)(uintptr_t)site *
+	    UINT64_C(0x9e3779b97f4a7c15)) >> 32) % MUTEX_PROF_NHOLDERS;
+	for (size_t i = 0; i < MUTEX_PROF_NHOLDERS; i++) {
+		mutex_prof_holder_slot_t *slot = &mutex_prof_holders[
+		    (start + i) % MUTEX_PROF_NHOLDERS];
+		void *cur = atomic_load_p(&slot->site, ATOMIC_ACQUIRE);
+		if (cur == NULL) {
+			if (atomic_compare_exchange_strong_p(&slot->site, &cur,
+			    (void *)site, ATOMIC_ACQ_REL, ATOMIC_ACQUIRE)) {
+				cur = (void *)site;
+			}
+		}
+		if (cur == site) {
+			stat_u64_add(&slot->n_wait_times, 1);
+			stat_u64_add(&slot->tot_wait_time, wait_ns);
+			return;
+		}
+	}
+}
+
+void
+mutex_prof_holder_read(size_t ind, mutex_prof_holder_t *holder) {
+	assert(ind < MUTEX_PROF_NHOLDERS);
+	mutex_prof_holder_slot_t *slot = &mutex_prof_holders[ind];
+
+	holder->site = (const char *)atomic_load_p(&slot->site,
+	    ATOMIC_ACQUIRE);
+	holder->n_wait_times = stat_u64_read(&slot->n_wait_times);
+	holder->tot_wait_time = stat_u64_read(&slot->tot_wait_time);
+}
+
+void
+mutex_prof_holders_reset(void) {
+	/* Sites stay put, so that concurrent recording can't mix them up. */
+	for (size_t i = 0; i < MUTEX_PROF_NHOLDERS; i++) {
+		mutex_prof_holder_slot_t *slot = &mutex_prof_holders[i];
+		stat_u64_reset(&slot->n_wait_times);
+		stat_u64_reset(&slot->tot_wait_time);
+	}
 }
 
 static void
@@ -0,0 +1,150 @@
+#include "jemalloc/internal/jemalloc_preamble.h"
+#include "jemalloc/internal/jemalloc_internal_includes.h"
+
+#include "jemalloc/internal/nontemporal.h"
+
+#ifdef JEMALLOC_HAVE_NONTEMPORAL_X86
+#include <immintrin.h>
+#endif
+
+/******************************************************************************/
+/* Data. */
+
+size_t opt_nontemporal_threshold = NONTEMPORAL_THRESHOLD_DEFAULT;
+nontemporal_kernel_t nontemporal_kernel = nontemporal_kernel_none;
+
+/******************************************************************************/
+
+#ifdef JEMALLOC_HAVE_NONTEMPORAL_X86
+/*
+ * Streaming stores need aligned destinations.  Returns the number of leading
+ * bytes to handle with ordinary stores.
+ */
+static size_t
+nontemporal_head_size(const void *dst, size_t size, size_t alignment) {
+	size_t head = ALIGNMENT_CEILING((uintptr_t)dst, alignment) -
+	    (uintptr_t)dst;
+	return head < size ? head : size;
+}
+
+__attribute__((target("sse2"))) static void
+nontemporal_copy_sse2(void *dst, const void *src, size_t size) {
+	size_t head = nontemporal_head_size(dst, size, 16);
+	memcpy(dst, src, head);
+	byte_t *d = (byte_t *)dst + head;
+	const byte_t *s = (const byte_t *)src + head;
+	size -= head;
+	for (; size >= 64; d += 64, s += 64, size -= 64) {
+		__m128i a = _mm_loadu_si128((const __m128i *)s);
+		__m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+		__m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+		__m128i e = _mm_loadu_si128((const __m128i *)(s + 48));
+		_mm_stream_si128((__m128i *)d, a);
+		_mm_stream_si128((__m128i *)(d + 16), b);
+		_mm_stream_si128((__m128i *)(d + 32), c);
+		_mm_stream_si128((__m128i *)(d + 48), e);
+	}
+	/* Order the streaming stores before whatever publishes the memory. */
+	_mm_sfence();
+	memcpy(d, s, size);
+}
+
+__attribute__((target("sse2"))) static void
+nontemporal_zero_sse2(void *dst, size_t size) {
+	size_t head = nontemporal_head_size(dst, size, 16);
+	memset(dst, 0, head);
+	byte_t *d = (byte_t *)dst + head;
+	size -= head;
+	__m128i zero = _mm_setzero_si128();
+	for (; size >= 64; d += 64, size -= 64) {
+		_mm_stream_si128((__m128i *)d, zero);
+		_mm_stream_si128((__m128i *)(d + 16), zero);
+		_mm_stream_si128((__m128i *)(d + 32), zero);
+		_mm_stream_si128((__m128i *)(d + 48), zero);
+	}
+	_mm_sfence();
+	memset(d, 0, size);
+}
+
+__attribute__((target("avx2"))) static void
+nontemporal_copy_avx2(void *dst, const void *src, size_t size) {
+	size_t head = nontemporal_head_size(dst, size, 32);
+	memcpy(dst, src, head);
+	byte_t *d = (byte_t *)dst + head;
+	const byte_t *s = (const byte_t *)src + head;
+	size -= head;
+	for (; size >= 128; d += 128, s += 128, size -= 128) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)s);
+		__m256i b = _mm256_loadu_si256((const __m256i *)(s + 32));
+		__m256i c = _mm256_loadu_si256((const __m256i *)(s + 64));
+		__m256i e = _mm256_loadu_si256((const __m256i *)(s + 96));
+		_mm256_stream_si256((__m256i *)d, a);
+		_mm256_stream_si256((__m256i *)(d + 32), b);
+		_mm256_stream_si256((__m256i *)(d + 64), c);
+		_mm256_stream_si256((__m256i *)(d + 96), e);
+	}
+	_mm_sfence();
+	memcpy(d, s, size);
+}
+
+__attribute__((target("avx2"))) static void
+nontemporal_zero_avx2(void *dst, size_t size) {
+	size_t head = nontemporal_head_size(dst, size, 32);
+	memset(dst, 0, head);
+	byte_t *d = (byte_t *)dst + head;
+	size -= head;
+	__m256i zero = _mm256_setzero_si256();
+	for (; size >= 128; d += 128, size -= 128) {
+		_mm256_stream_si256((__m256i *)d, zero);
+		_mm256_stream_si256((__m256i *)(d + 32), zero);
+		_mm256_stream_si256((__m256i *)(d + 64), zero);
+		_mm256_stream_si256((__m256i *)(d + 96), zero);
+	}
+	_mm_sfence();
+	memset(d, 0, size);
+}
+#endif
+
+void
+nontemporal_copy_impl(void *dst, const void *src, size_t size) {
+	switch (nontemporal_kernel) {
+#ifdef JEMALLOC_HAVE_NONTEMPORAL_X86
+	case nontemporal_kernel_avx2:
+		nontemporal_copy_avx2(dst, src, size);
+		break;
+	case nontemporal_kernel_sse2:
+		nontemporal_copy_sse2(dst, src, size);
+		break;
+#endif
+	default:
+		memcpy(dst, src, size);
+	}
+}
+
+void
+nontemporal_zero_impl(void *dst, size_t size) {
+	switch (nontemporal_kernel) {
+#ifdef JEMALLOC_HAVE_NONTEMPORAL_X86
+	case nontemporal_kernel_avx2:
+		nontemporal_zero_avx2(dst, size);
+		break;
+	case nontemporal_kernel_sse2:
+		nontemporal_zero_sse2(dst, size);
+		break;
+#endif
+	default:
+		memset(dst, 0, size);
+	}
+}
+
+void
+nontemporal_boot(void) {
+#ifdef JEMALLOC_HAVE_NONTEMPORAL_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		nontemporal_kernel = nontemporal_kernel_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		nontemporal_kernel = nontemporal_kernel_sse2;
+	}
+#endif
+}
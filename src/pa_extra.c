@@ -174,6 +174,47 @@ pa_shard_stats_merge(tsdn_t *tsdn, pa_shard_t *shard,
 	}
 }
 
+static uint64_t
+pa_shard_hpa_nwork(const hpa_shard_nonderived_stats_t *stats) {
+	return stats->npurge_passes + stats->npurges + stats->nhugifies +
+	    stats->ndehugifies;
+}
+
+uint64_t
+pa_shard_nwork_get(tsdn_t *tsdn, pa_shard_t *shard) {
+	cassert(config_stats);
+
+	malloc_mutex_t *mtx = LOCKEDINT_MTX(*shard->stats_mtx);
+	LOCKEDINT_MTX_LOCK(tsdn, *shard->stats_mtx);
+	uint64_t nwork = locked_read_u64(tsdn, mtx,
+	    &shard->pac.stats->decay_dirty.npurge) + locked_read_u64(tsdn, mtx,
+	    &shard->pac.stats->decay_dirty.purged) + locked_read_u64(tsdn, mtx,
+	    &shard->pac.stats->decay_muzzy.npurge) + locked_read_u64(tsdn, mtx,
+	    &shard->pac.stats->decay_muzzy.purged);
+	LOCKEDINT_MTX_UNLOCK(tsdn, *shard->stats_mtx);
+
+	if (shard->ever_used_hpa) {
+		hpa_shard_nonderived_stats_t hpa_stats = {0};
+		hpa_shard_nonderived_stats_merge(tsdn, &shard->hpa_shard,
+		    &hpa_stats);
+		nwork += pa_shard_hpa_nwork(&hpa_stats);
+	}
+	return nwork;
+}
+
+uint64_t
+pa_shard_stats_nwork(pa_shard_stats_t *pa_shard_stats,
+    hpa_shard_stats_t *hpa_stats) {
+	cassert(config_stats);
+
+	pac_stats_t *pac_stats = &pa_shard_stats->pac_stats;
+	return locked_read_u64_unsynchronized(&pac_stats->decay_dirty.npurge) +
+	    locked_read_u64_unsynchronized(&pac_stats->decay_dirty.purged) +
+	    locked_read_u64_unsynchronized(&pac_stats->decay_muzzy.npurge) +
+	    locked_read_u64_unsynchronized(&pac_stats->decay_muzzy.purged) +
+	    pa_shard_hpa_nwork(&hpa_stats->nonderived_stats);
+}
+
 static void
 pa_shard_mtx_stats_read_single(tsdn_t *tsdn, mutex_prof_data_t *mutex_prof_data,
     malloc_mutex_t *mtx, int ind) {
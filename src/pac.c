@@ -2,6 +2,7 @@
 #include "jemalloc/internal/jemalloc_internal_includes.h"
 
 #include "jemalloc/internal/pac.h"
+#include "jemalloc/internal/probe.h"
 #include "jemalloc/internal/san.h"
 
 static edata_t *pac_alloc_impl(tsdn_t *tsdn, pai_t *self, size_t size,
@@ -15,6 +16,21 @@ static void pac_dalloc_impl(tsdn_t *tsdn, pai_t *self, edata_t *edata,
     bool *deferred_work_generated);
 static uint64_t pac_time_until_deferred_work(tsdn_t *tsdn, pai_t *self);
 
+/******************************************************************************/
+/* Data. */
+
+const char *const prefault_mode_names[] = {
+	"disabled",
+	"populate",
+	"mlock"
+};
+
+prefault_mode_t opt_prefault = PREFAULT_MODE_DEFAULT;
+size_t opt_prefault_reserve = PREFAULT_RESERVE_DEFAULT;
+unsigned opt_retain_lookahead_ms = RETAIN_LOOKAHEAD_MS_DEFAULT;
+
+/******************************************************************************/
+
 static inline void
 pac_decay_data_get(pac_t *pac, extent_state_t state,
     decay_t **r_decay, pac_decay_stats_t **r_decay_stats, ecache_t **r_ecache) {
@@ -79,6 +95,13 @@ pac_init(tsdn_t *tsdn, pac_t *pac, base_t *base, emap_t *emap,
 	}
 	atomic_store_zu(&pac->oversize_threshold, pac_oversize_threshold,
 	    ATOMIC_RELAXED);
+	pac_prefault_set(pac, opt_prefault);
+	pac_prefault_reserve_set(pac, opt_prefault_reserve);
+	pac_retain_lookahead_ms_set(pac, opt_retain_lookahead_ms);
+	atomic_store_zu(&pac->retained_consumed, 0, ATOMIC_RELAXED);
+	atomic_store_zu(&pac->retained_lookahead, 0, ATOMIC_RELAXED);
+	nstime_copy(&pac->lookahead_sample_time, cur_time);
+	atomic_store_zu(&pac->lookahead_sample_consumed, 0, ATOMIC_RELAXED);
 	if (decay_init(&pac->decay_dirty, cur_time, dirty_decay_ms)) {
 		return true;
 	}
@@ -187,6 +210,11 @@ pac_alloc_impl(tsdn_t *tsdn, pai_t *self, size_t size, size_t alignment,
 		edata = pac_alloc_new_guarded(tsdn, pac, ehooks, size,
 		    alignment, zero, frequent_reuse);
 	}
+	/* Let the background thread top up whatever this took from retained. */
+	if (pac_retained_deficit(pac) != 0 ||
+	    pac_retain_lookahead_pending(pac)) {
+		*deferred_work_generated = true;
+	}
 
 	return edata;
 }
@@ -301,6 +329,10 @@ pac_time_until_deferred_work(tsdn_t *tsdn, pai_t *self) {
 	uint64_t time;
 	pac_t *pac = (pac_t *)self;
 
+	if (pac_retained_deficit(pac) != 0) {
+		return BACKGROUND_THREAD_DEFERRED_MIN;
+	}
+
 	time = pac_ns_until_purge(tsdn,
 	    &pac->decay_dirty,
 	    ecache_npages_get(&pac->ecache_dirty));
@@ -314,6 +346,19 @@ pac_time_until_deferred_work(tsdn_t *tsdn, pai_t *self) {
 	if (muzzy < time) {
 		time = muzzy;
 	}
+
+	/*
+	 * Keep sampling while retained memory is being consumed, and until an
+	 * idle arena's prediction has decayed to nothing.
+	 */
+	if (pac_retain_lookahead_pending(pac) || atomic_load_zu(
+	    &pac->retained_lookahead, ATOMIC_RELAXED) != 0) {
+		uint64_t lookahead = PAC_RETAIN_LOOKAHEAD_INTERVAL_MS *
+		    (uint64_t)1000 * 1000;
+		if (lookahead < time) {
+			time = lookahead;
+		}
+	}
 	return time;
 }
 
@@ -412,6 +457,8 @@ pac_decay_stashed(tsdn_t *tsdn, pac_t *pac, decay_t *decay,
 			not_reached();
 		}
 	}
+	JE_PROBE4(extent_purge, ecache_ind_get(ecache), ecache->state, nmadvise,
+	    npurged << LG_PAGE);
 
 	if (config_stats) {
 		LOCKEDINT_MTX_LOCK(tsdn, *pac->stats_mtx);
@@ -511,6 +558,10 @@ pac_maybe_decay_purge(tsdn_t *tsdn, pac_t *pac, decay_t *decay,
 	size_t npages_current = ecache_npages_get(ecache);
 	bool epoch_advanced = decay_maybe_advance_epoch(decay, &time,
 	    npages_current);
+	if (epoch_advanced) {
+		JE_PROBE4(decay_epoch, ecache_ind_get(ecache), ecache->state,
+		    npages_current, decay_npages_limit_get(decay));
+	}
 	if (eagerness == PAC_PURGE_ALWAYS
 	    || (epoch_advanced && eagerness == PAC_PURGE_ON_EPOCH_ADVANCE)) {
 		size_t npages_limit = decay_npages_limit_get(decay);
@@ -560,6 +611,84 @@ pac_decay_ms_get(pac_t *pac, extent_state_t state) {
 	return decay_ms_read(decay);
 }
 
+static void
+pac_retain_lookahead_update(tsdn_t *tsdn, pac_t *pac) {
+	unsigned lookahead_ms = pac_retain_lookahead_ms_get(pac);
+	if (lookahead_ms == 0 && atomic_load_zu(&pac->retained_lookahead,
+	    ATOMIC_RELAXED) == 0) {
+		return;
+	}
+	nstime_t now;
+	nstime_init_update(&now);
+
+	malloc_mutex_lock(tsdn, &pac->grow_mtx);
+	if (nstime_compare(&now, &pac->lookahead_sample_time) <= 0) {
+		/* Time went backwards; start over. */
+		nstime_copy(&pac->lookahead_sample_time, &now);
+		malloc_mutex_unlock(tsdn, &pac->grow_mtx);
+		return;
+	}
+	nstime_t elapsed;
+	nstime_copy(&elapsed, &now);
+	nstime_subtract(&elapsed, &pac->lookahead_sample_time);
+	uint64_t elapsed_ms = nstime_msec(&elapsed);
+	if (elapsed_ms < PAC_RETAIN_LOOKAHEAD_INTERVAL_MS) {
+		malloc_mutex_unlock(tsdn, &pac->grow_mtx);
+		return;
+	}
+	size_t consumed = atomic_load_zu(&pac->retained_consumed,
+	    ATOMIC_RELAXED);
+	size_t delta = consumed - atomic_load_zu(
+	    &pac->lookahead_sample_consumed, ATOMIC_RELAXED);
+	/* Growth expected over the look-ahead window at the sampled rate. */
+	size_t rate = (size_t)(delta / elapsed_ms);
+	size_t expected = (lookahead_ms != 0 && rate > SIZE_MAX / lookahead_ms)
+	    ? SIZE_MAX : rate * lookahead_ms;
+	/*
+	 * Smooth out bursts; without further consumption the prediction halves
+	 * every sample.  Never predict more growth than the arena has seen in
+	 * its lifetime, so that short spikes can't make it run away.
+	 */
+	size_t lookahead = atomic_load_zu(&pac->retained_lookahead,
+	    ATOMIC_RELAXED) / 2 + expected / 2;
+	if (lookahead > consumed) {
+		lookahead = consumed;
+	}
+	atomic_store_zu(&pac->retained_lookahead, lookahead, ATOMIC_RELAXED);
+	nstime_copy(&pac->lookahead_sample_time, &now);
+	atomic_store_zu(&pac->lookahead_sample_consumed, consumed,
+	    ATOMIC_RELAXED);
+	malloc_mutex_unlock(tsdn, &pac->grow_mtx);
+}
+
+void
+pac_do_deferred_work(tsdn_t *tsdn, pac_t *pac) {
+	pac_retain_lookahead_update(tsdn, pac);
+
+	size_t deficit = pac_retained_deficit(pac);
+	if (deficit == 0) {
+		return;
+	}
+	size_t grow_limit;
+	pac_retain_grow_limit_get_set(tsdn, pac, &grow_limit, NULL);
+	while (deficit != 0) {
+		/*
+		 * Map in huge page multiples, to keep the reserve THP-friendly,
+		 * but no more than retain_grow_limit at a time.
+		 */
+		size_t size = HUGEPAGE_CEILING(deficit);
+		/* Beware size_t wrap-around. */
+		if (size < deficit || size > grow_limit) {
+			size = grow_limit;
+		}
+		if (extent_grow_retained_ahead(tsdn, pac, pac_ehooks_get(pac),
+		    size)) {
+			break;
+		}
+		deficit = (size < deficit) ? deficit - size : 0;
+	}
+}
+
 void
 pac_reset(tsdn_t *tsdn, pac_t *pac) {
 	/*
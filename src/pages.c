@@ -5,7 +5,9 @@
 #include "jemalloc/internal/jemalloc_internal_includes.h"
 
 #include "jemalloc/internal/assert.h"
+#include "jemalloc/internal/latency.h"
 #include "jemalloc/internal/malloc_io.h"
+#include "jemalloc/internal/stat_u64.h"
 
 #ifdef JEMALLOC_SYSCTL_VM_OVERCOMMIT
 #include <sys/sysctl.h>
@@ -51,9 +53,35 @@ const char *const thp_mode_names[] = {
 thp_mode_t opt_thp = THP_MODE_DEFAULT;
 thp_mode_t init_system_thp_mode;
 
+const char *const pages_caller_names[pages_num_callers] = {
+#define OP(caller) #caller,
+	PAGES_CALLERS
+#undef OP
+};
+
+const char *const pages_op_names[pages_num_ops] = {
+#define OP(op) #op,
+	PAGES_OPS
+#undef OP
+};
+
+typedef struct pages_stats_slot_s pages_stats_slot_t;
+struct pages_stats_slot_s {
+	stat_u64_t ncalls;
+	stat_u64_t bytes;
+	stat_u64_t total_ns;
+};
+
+static pages_stats_slot_t pages_stats[pages_num_callers][pages_num_ops];
+
 /* Runtime support for lazy purge. Irrelevant when !pages_can_purge_lazy. */
 static bool pages_can_purge_lazy_runtime = true;
 
+#ifdef JEMALLOC_MADVISE_POPULATE_WRITE
+/* Runtime support for MADV_POPULATE_WRITE (Linux 5.14+). */
+static bool pages_can_populate_write_runtime = true;
+#endif
+
 #ifdef JEMALLOC_PURGE_MADVISE_DONTNEED_ZEROS
 static int madvise_dont_need_zeros_is_faulty = -1;
 /**
@@ -131,6 +159,42 @@ static void os_pages_unmap(void *addr, size_t size);
 
 /******************************************************************************/
 
+/*
+ * The calls are timed with the precise clock (see latency_now()); its cost is
+ * small next to that of the system calls.
+ */
+static inline uint64_t
+pages_stats_begin(void) {
+	return config_stats ? latency_now() : 0;
+}
+
+static inline void
+pages_stats_end(pages_caller_t caller, pages_op_t op, size_t size,
+    uint64_t start) {
+	if (!config_stats) {
+		return;
+	}
+	assert(caller < pages_num_callers);
+	assert(op < pages_num_ops);
+	pages_stats_slot_t *slot = &pages_stats[caller][op];
+	uint64_t now = latency_now();
+
+	stat_u64_add(&slot->ncalls, 1);
+	stat_u64_add(&slot->bytes, size);
+	stat_u64_add(&slot->total_ns, (now > start) ? now - start : 0);
+}
+
+void
+pages_stats_read(pages_caller_t caller, pages_op_t op, pages_stats_t *stats) {
+	assert(caller < pages_num_callers);
+	assert(op < pages_num_ops);
+	pages_stats_slot_t *slot = &pages_stats[caller][op];
+
+	stats->ncalls = stat_u64_read(&slot->ncalls);
+	stats->bytes = stat_u64_read(&slot->bytes);
+	stats->total_ns = stat_u64_read(&slot->total_ns);
+}
+
 static void *
 os_pages_map(void *addr, size_t size, size_t alignment, bool *commit) {
 	assert(ALIGNMENT_ADDR2BASE(addr, os_page) == addr);
@@ -274,8 +338,8 @@ pages_map_slow(size_t size, size_t alignment, bool *commit) {
 	return ret;
 }
 
-void *
-pages_map(void *addr, size_t size, size_t alignment, bool *commit) {
+static void *
+pages_map_impl(void *addr, size_t size, size_t alignment, bool *commit) {
 	assert(alignment >= PAGE);
 	assert(ALIGNMENT_ADDR2BASE(addr, alignment) == addr);
 
@@ -336,12 +400,23 @@ pages_map(void *addr, size_t size, size_t alignment, bool *commit) {
 	return ret;
 }
 
+void *
+pages_map(pages_caller_t caller, void *addr, size_t size, size_t alignment,
+    bool *commit) {
+	uint64_t start = pages_stats_begin();
+	void *ret = pages_map_impl(addr, size, alignment, commit);
+	pages_stats_end(caller, pages_op_map, size, start);
+	return ret;
+}
+
 void
-pages_unmap(void *addr, size_t size) {
+pages_unmap(pages_caller_t caller, void *addr, size_t size) {
 	assert(PAGE_ADDR2BASE(addr) == addr);
 	assert(PAGE_CEILING(size) == size);
 
+	uint64_t start = pages_stats_begin();
 	os_pages_unmap(addr, size);
+	pages_stats_end(caller, pages_op_unmap, size, start);
 }
 
 static bool
@@ -383,17 +458,28 @@ pages_commit_impl(void *addr, size_t size, bool commit) {
 }
 
 bool
-pages_commit(void *addr, size_t size) {
-	return pages_commit_impl(addr, size, true);
+pages_commit(pages_caller_t caller, void *addr, size_t size) {
+	uint64_t start = pages_stats_begin();
+	bool err = pages_commit_impl(addr, size, true);
+	pages_stats_end(caller, pages_op_commit, size, start);
+	return err;
 }
 
 bool
-pages_decommit(void *addr, size_t size) {
-	return pages_commit_impl(addr, size, false);
+pages_decommit(pages_caller_t caller, void *addr, size_t size) {
+	uint64_t start = pages_stats_begin();
+	bool err = pages_commit_impl(addr, size, false);
+	pages_stats_end(caller, pages_op_decommit, size, start);
+	return err;
 }
 
-void
-pages_mark_guards(void *head, void *tail) {
+static size_t
+pages_guards_size(void *head, void *tail) {
+	return ((head != NULL) ? PAGE : 0) + ((tail != NULL) ? PAGE : 0);
+}
+
+static void
+os_pages_mark_guards(void *head, void *tail) {
 	assert(head != NULL || tail != NULL);
 	assert(head == NULL || tail == NULL ||
 	    (uintptr_t)head < (uintptr_t)tail);
@@ -416,7 +502,15 @@ pages_mark_guards(void *head, void *tail) {
 }
 
 void
-pages_unmark_guards(void *head, void *tail) {
+pages_mark_guards(pages_caller_t caller, void *head, void *tail) {
+	uint64_t start = pages_stats_begin();
+	os_pages_mark_guards(head, tail);
+	pages_stats_end(caller, pages_op_mark_guards,
+	    pages_guards_size(head, tail), start);
+}
+
+static void
+os_pages_unmark_guards(void *head, void *tail) {
 	assert(head != NULL || tail != NULL);
 	assert(head == NULL || tail == NULL ||
 	    (uintptr_t)head < (uintptr_t)tail);
@@ -452,8 +546,16 @@ pages_unmark_guards(void *head, void *tail) {
 #endif
 }
 
-bool
-pages_purge_lazy(void *addr, size_t size) {
+void
+pages_unmark_guards(pages_caller_t caller, void *head, void *tail) {
+	uint64_t start = pages_stats_begin();
+	os_pages_unmark_guards(head, tail);
+	pages_stats_end(caller, pages_op_unmark_guards,
+	    pages_guards_size(head, tail), start);
+}
+
+static bool
+os_pages_purge_lazy(void *addr, size_t size) {
 	assert(ALIGNMENT_ADDR2BASE(addr, os_page) == addr);
 	assert(PAGE_CEILING(size) == size);
 
@@ -491,7 +593,15 @@ pages_purge_lazy(void *addr, size_t size) {
 }
 
 bool
-pages_purge_forced(void *addr, size_t size) {
+pages_purge_lazy(pages_caller_t caller, void *addr, size_t size) {
+	uint64_t start = pages_stats_begin();
+	bool err = os_pages_purge_lazy(addr, size);
+	pages_stats_end(caller, pages_op_purge_lazy, size, start);
+	return err;
+}
+
+static bool
+os_pages_purge_forced(void *addr, size_t size) {
 	assert(PAGE_ADDR2BASE(addr) == addr);
 	assert(PAGE_CEILING(size) == size);
 
@@ -509,12 +619,20 @@ pages_purge_forced(void *addr, size_t size) {
 	    posix_madvise(addr, size, POSIX_MADV_DONTNEED) != 0);
 #elif defined(JEMALLOC_MAPS_COALESCE)
 	/* Try to overlay a new demand-zeroed mapping. */
-	return pages_commit(addr, size);
+	return pages_commit_impl(addr, size, true);
 #else
 	not_reached();
 #endif
 }
 
+bool
+pages_purge_forced(pages_caller_t caller, void *addr, size_t size) {
+	uint64_t start = pages_stats_begin();
+	bool err = os_pages_purge_forced(addr, size);
+	pages_stats_end(caller, pages_op_purge_forced, size, start);
+	return err;
+}
+
 static bool
 pages_huge_impl(void *addr, size_t size, bool aligned) {
 	if (aligned) {
@@ -533,14 +651,23 @@ pages_huge_impl(void *addr, size_t size, bool aligned) {
 #endif
 }
 
+static bool
+pages_huge_timed(pages_caller_t caller, void *addr, size_t size,
+    bool aligned) {
+	uint64_t start = pages_stats_begin();
+	bool err = pages_huge_impl(addr, size, aligned);
+	pages_stats_end(caller, pages_op_huge, size, start);
+	return err;
+}
+
 bool
-pages_huge(void *addr, size_t size) {
-	return pages_huge_impl(addr, size, true);
+pages_huge(pages_caller_t caller, void *addr, size_t size) {
+	return pages_huge_timed(caller, addr, size, true);
 }
 
 static bool
-pages_huge_unaligned(void *addr, size_t size) {
-	return pages_huge_impl(addr, size, false);
+pages_huge_unaligned(pages_caller_t caller, void *addr, size_t size) {
+	return pages_huge_timed(caller, addr, size, false);
 }
 
 static bool
@@ -557,14 +684,23 @@ pages_nohuge_impl(void *addr, size_t size, bool aligned) {
 #endif
 }
 
+static bool
+pages_nohuge_timed(pages_caller_t caller, void *addr, size_t size,
+    bool aligned) {
+	uint64_t start = pages_stats_begin();
+	bool err = pages_nohuge_impl(addr, size, aligned);
+	pages_stats_end(caller, pages_op_nohuge, size, start);
+	return err;
+}
+
 bool
-pages_nohuge(void *addr, size_t size) {
-	return pages_nohuge_impl(addr, size, true);
+pages_nohuge(pages_caller_t caller, void *addr, size_t size) {
+	return pages_nohuge_timed(caller, addr, size, true);
 }
 
 static bool
-pages_nohuge_unaligned(void *addr, size_t size) {
-	return pages_nohuge_impl(addr, size, false);
+pages_nohuge_unaligned(pages_caller_t caller, void *addr, size_t size) {
+	return pages_nohuge_timed(caller, addr, size, false);
 }
 
 bool
@@ -593,6 +729,71 @@ pages_dodump(void *addr, size_t size) {
 #endif
 }
 
+static bool
+os_pages_populate(void *addr, size_t size) {
+	assert(PAGE_ADDR2BASE(addr) == addr);
+	assert(PAGE_CEILING(size) == size);
+#ifdef JEMALLOC_MADVISE_POPULATE_WRITE
+	if (pages_can_populate_write_runtime) {
+		return madvise(addr, size, MADV_POPULATE_WRITE) != 0;
+	}
+#endif
+	/*
+	 * Write-fault each page by hand.  The range may already hold data (e.g.
+	 * when repopulating retained memory), so store back what was read.
+	 */
+	for (size_t i = 0; i < size; i += os_page) {
+		volatile byte_t *p = (volatile byte_t *)addr + i;
+		*p = *p;
+	}
+	return false;
+}
+
+bool
+pages_populate(pages_caller_t caller, void *addr, size_t size) {
+	uint64_t start = pages_stats_begin();
+	bool err = os_pages_populate(addr, size);
+	pages_stats_end(caller, pages_op_populate, size, start);
+	return err;
+}
+
+static bool
+os_pages_mlock(void *addr, size_t size) {
+	assert(PAGE_ADDR2BASE(addr) == addr);
+	assert(PAGE_CEILING(size) == size);
+#ifdef _WIN32
+	return !VirtualLock(addr, size);
+#else
+	return mlock(addr, size) != 0;
+#endif
+}
+
+bool
+pages_mlock(pages_caller_t caller, void *addr, size_t size) {
+	uint64_t start = pages_stats_begin();
+	bool err = os_pages_mlock(addr, size);
+	pages_stats_end(caller, pages_op_mlock, size, start);
+	return err;
+}
+
+static bool
+os_pages_munlock(void *addr, size_t size) {
+	assert(PAGE_ADDR2BASE(addr) == addr);
+	assert(PAGE_CEILING(size) == size);
+#ifdef _WIN32
+	return !VirtualUnlock(addr, size);
+#else
+	return munlock(addr, size) != 0;
+#endif
+}
+
+bool
+pages_munlock(pages_caller_t caller, void *addr, size_t size) {
+	uint64_t start = pages_stats_begin();
+	bool err = os_pages_munlock(addr, size);
+	pages_stats_end(caller, pages_op_munlock, size, start);
+	return err;
+}
 
 static size_t
 os_page_detect(void) {
@@ -708,7 +909,7 @@ os_overcommits_proc(void) {
 #endif
 
 void
-pages_set_thp_state (void *ptr, size_t size) {
+pages_set_thp_state(pages_caller_t caller, void *ptr, size_t size) {
 	if (opt_thp == thp_mode_default || opt_thp == init_system_thp_mode) {
 		return;
 	}
@@ -718,11 +919,11 @@ pages_set_thp_state (void *ptr, size_t size) {
 	if (opt_thp == thp_mode_always
 	    && init_system_thp_mode != thp_mode_never) {
 		assert(init_system_thp_mode == thp_mode_default);
-		pages_huge_unaligned(ptr, size);
+		pages_huge_unaligned(caller, ptr, size);
 	} else if (opt_thp == thp_mode_never) {
 		assert(init_system_thp_mode == thp_mode_default ||
 		    init_system_thp_mode == thp_mode_always);
-		pages_nohuge_unaligned(ptr, size);
+		pages_nohuge_unaligned(caller, ptr, size);
 	}
 }
 
@@ -842,12 +1043,25 @@ pages_boot(void) {
 			return true;
 		}
 		assert(pages_can_purge_lazy_runtime);
-		if (pages_purge_lazy(madv_free_page, PAGE)) {
+		if (os_pages_purge_lazy(madv_free_page, PAGE)) {
 			pages_can_purge_lazy_runtime = false;
 		}
 		os_pages_unmap(madv_free_page, PAGE);
 	}
 #endif
 
+#ifdef JEMALLOC_MADVISE_POPULATE_WRITE
+	/* Built with MADV_POPULATE_WRITE, but the kernel may predate it. */
+	bool committed = true;
+	void *populate_page = os_pages_map(NULL, PAGE, PAGE, &committed);
+	if (populate_page == NULL) {
+		return true;
+	}
+	if (madvise(populate_page, PAGE, MADV_POPULATE_WRITE) != 0) {
+		pages_can_populate_write_runtime = false;
+	}
+	os_pages_unmap(populate_page, PAGE);
+#endif
+
 	return false;
 }
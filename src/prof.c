@@ -34,10 +34,28 @@ bool opt_prof_final = false;
 bool opt_prof_leak = false;
 bool opt_prof_leak_error = false;
 bool opt_prof_accum = false;
+bool opt_prof_lifetime = false;
 bool opt_prof_pid_namespace = false;
 char opt_prof_prefix[PROF_DUMP_FILENAME_LEN];
 bool opt_prof_sys_thread_name = false;
+prof_format_t opt_prof_format = prof_format_heap_v2;
+const char *const prof_format_names[] = {
+	"heap_v2",
+	"pprof"
+};
+prof_backtrace_method_t opt_prof_backtrace_method =
+    prof_backtrace_method_default;
+const char *const prof_backtrace_method_names[] = {
+	"default",
+	"fp"
+};
 bool opt_prof_unbias = true;
+size_t opt_prof_sample_target = 0;
+size_t opt_prof_watermark_allocated = 0;
+size_t opt_prof_watermark_resident = 0;
+unsigned opt_prof_watermark_growth = 0;
+unsigned opt_prof_watermark_hysteresis = 0;
+unsigned opt_prof_watermark_interval_ms = PROF_WATERMARK_INTERVAL_MS_DEFAULT;
 
 /* Accessed via prof_sample_event_handler(). */
 static counter_accum_t prof_idump_accumulated;
@@ -67,6 +85,43 @@ uint64_t prof_interval = 0;
 
 size_t lg_prof_sample;
 
+atomic_u_t prof_sample_level = ATOMIC_INIT(0);
+/* Samples taken since the adaptive sampling level was last evaluated. */
+static UNUSED atomic_zu_t prof_sample_adapt_nsamples = ATOMIC_INIT(0);
+/* Protects prof_sample_adapt_epoch; only ever trylock'ed. */
+static malloc_mutex_t prof_sample_adapt_mtx;
+static nstime_t prof_sample_adapt_epoch;
+
+/*
+ * Trigger state of one watched heap metric.  A dump is due once the metric
+ * reaches level while armed.  Without opt_prof_watermark_growth, a dump disarms
+ * the watermark until the metric drops opt_prof_watermark_hysteresis percent
+ * below the threshold.  With it, the dump instead raises level by that much
+ * growth over the current value, and whenever the metric drops
+ * opt_prof_watermark_hysteresis percent below the value at the last dump (or
+ * last drop), level is lowered to follow it.
+ */
+typedef struct prof_watermark_s prof_watermark_t;
+struct prof_watermark_s {
+	size_t	level;
+	/* The value that drops are measured from; 0 until the first dump. */
+	size_t	base;
+	bool	armed;
+};
+
+/* Protects the watermark state; only the background thread evaluates it. */
+static malloc_mutex_t prof_watermark_mtx;
+static prof_watermark_t prof_watermark_allocated;
+static prof_watermark_t prof_watermark_resident;
+static nstime_t prof_watermark_last_check;
+static nstime_t prof_watermark_last_dump;
+static bool prof_watermark_dumped;
+/*
+ * Set by the background thread when a watermark is crossed.  The background
+ * thread can't write profiles itself, so the next sampling thread does it.
+ */
+static atomic_b_t prof_watermark_pending = ATOMIC_INIT(false);
+
 static uint64_t next_thr_uid;
 static malloc_mutex_t next_thr_uid_mtx;
 
@@ -122,7 +177,10 @@ prof_malloc_sample_object(tsd_t *tsd, const void *ptr, size_t size,
 
 	edata_t *edata = emap_edata_lookup(tsd_tsdn(tsd), &arena_emap_global,
 	    ptr);
-	prof_info_set(tsd, edata, tctx, size);
+	/* Weigh by the level the sample wait that just expired was drawn at. */
+	unsigned level = tctx->tdata->sample_level;
+	unsigned tag = tctx->tdata->alloc_tag;
+	prof_info_set(tsd, edata, tctx, size, level, tag);
 
 	szind_t szind = sz_size2index(usize);
 
@@ -137,8 +195,8 @@ prof_malloc_sample_object(tsd_t *tsd, const void *ptr, size_t size,
 	 * the prof_reset call is about to mark our tctx as expired before any
 	 * dumping of our corrupted output is attempted.
 	 */
-	size_t shifted_unbiased_cnt = prof_shifted_unbiased_cnt[szind];
-	size_t unbiased_bytes = prof_unbiased_sz[szind];
+	size_t shifted_unbiased_cnt = prof_shifted_unbiased_cnt[level][szind];
+	size_t unbiased_bytes = prof_unbiased_sz[level][szind];
 	tctx->cnts.curobjs++;
 	tctx->cnts.curobjs_shifted_unbiased += shifted_unbiased_cnt;
 	tctx->cnts.curbytes += usize;
@@ -158,7 +216,7 @@ prof_malloc_sample_object(tsd_t *tsd, const void *ptr, size_t size,
 	}
 
 	if (opt_prof_stats) {
-		prof_stats_inc(tsd, szind, size);
+		prof_stats_inc(tsd, szind, size, tag, shifted_unbiased_cnt);
 	}
 
 	/* Sample hook. */
@@ -171,6 +229,21 @@ prof_malloc_sample_object(tsd_t *tsd, const void *ptr, size_t size,
 	}
 }
 
+static void
+prof_lifetime_record(prof_gctx_t *gctx, const nstime_t *alloc_time) {
+	nstime_t lifetime;
+	nstime_prof_init_update(&lifetime);
+	if (nstime_compare(&lifetime, alloc_time) > 0) {
+		nstime_subtract(&lifetime, alloc_time);
+	} else {
+		/* The clock may not be monotonic. */
+		nstime_init_zero(&lifetime);
+	}
+	unsigned ind = prof_lifetime_bucket(nstime_ns(&lifetime));
+	/* Safe without gctx->lock; this object still pins tctx and gctx. */
+	atomic_fetch_add_zu(&gctx->lifetimes[ind], 1, ATOMIC_RELAXED);
+}
+
 void
 prof_free_sampled_object(tsd_t *tsd, const void *ptr, size_t usize,
     prof_info_t *prof_info) {
@@ -191,6 +264,10 @@ prof_free_sampled_object(tsd_t *tsd, const void *ptr, size_t usize,
 		post_reentrancy(tsd);
 	}
 
+	if (opt_prof_lifetime) {
+		prof_lifetime_record(tctx->gctx, &prof_info->alloc_time);
+	}
+
 	malloc_mutex_lock(tsd_tsdn(tsd), tctx->tdata->lock);
 
 	assert(tctx->cnts.curobjs > 0);
@@ -202,16 +279,20 @@ prof_free_sampled_object(tsd_t *tsd, const void *ptr, size_t usize,
 	 * yet.
 	 */
 	tctx->cnts.curobjs--;
-	tctx->cnts.curobjs_shifted_unbiased -= prof_shifted_unbiased_cnt[szind];
+	unsigned level = prof_info->alloc_sample_level;
+	tctx->cnts.curobjs_shifted_unbiased -=
+	    prof_shifted_unbiased_cnt[level][szind];
 	tctx->cnts.curbytes -= usize;
-	tctx->cnts.curbytes_unbiased -= prof_unbiased_sz[szind];
+	tctx->cnts.curbytes_unbiased -= prof_unbiased_sz[level][szind];
 
 	prof_try_log(tsd, usize, prof_info);
 
 	prof_tctx_try_destroy(tsd, tctx);
 
 	if (opt_prof_stats) {
-		prof_stats_dec(tsd, szind, prof_info->alloc_size);
+		prof_stats_dec(tsd, szind, prof_info->alloc_size,
+		    prof_info->alloc_tag,
+		    prof_shifted_unbiased_cnt[level][szind]);
 	}
 }
 
@@ -232,6 +313,86 @@ prof_tctx_create(tsd_t *tsd) {
 	return prof_lookup(tsd, &bt);
 }
 
+unsigned
+prof_sample_max_level(void) {
+	size_t max_level = (sizeof(uint64_t) << 3) - 1 - lg_prof_sample;
+	if (max_level > PROF_SAMPLE_NLEVELS - 1) {
+		max_level = PROF_SAMPLE_NLEVELS - 1;
+	}
+	return (unsigned)max_level;
+}
+
+/*
+ * Picks the sampling level for the next window, given that nsamples samples
+ * were taken at level during the last elapsed_ns.  Each level halves the
+ * sample rate, so step up while the rate is at least twice the target, and
+ * down while twice the rate would still be within it.
+ */
+unsigned
+prof_sample_level_next(unsigned level, unsigned max_level, uint64_t nsamples,
+    uint64_t elapsed_ns, size_t target) {
+	uint64_t elapsed_us = elapsed_ns / 1000;
+	/*
+	 * A window can last arbitrarily long (e.g. after an idle period), so
+	 * clamp it to where target * elapsed_us still fits.  The cap is long
+	 * enough that allowed saturates at more samples than can be counted.
+	 */
+	if (target != 0 && elapsed_us > UINT64_MAX / target) {
+		elapsed_us = UINT64_MAX / target;
+	}
+	uint64_t allowed = (uint64_t)target * elapsed_us / 1000000;
+	while (level < max_level && nsamples / 2 >= allowed) {
+		level++;
+		nsamples /= 2;
+	}
+	while (level > 0 && nsamples <= allowed / 2) {
+		level--;
+		nsamples *= 2;
+	}
+	return level;
+}
+
+#ifdef JEMALLOC_PROF
+/* Counts a sample, and returns the level to draw the next wait at. */
+static unsigned
+prof_sample_adapt(tsd_t *tsd) {
+	size_t nsamples = atomic_fetch_add_zu(&prof_sample_adapt_nsamples, 1,
+	    ATOMIC_RELAXED) + 1;
+	if (nsamples % PROF_SAMPLE_ADAPT_NSAMPLES == 0 &&
+	    !malloc_mutex_trylock(tsd_tsdn(tsd), &prof_sample_adapt_mtx)) {
+		nstime_t now;
+		nstime_init_update(&now);
+		if (nstime_compare(&now, &prof_sample_adapt_epoch) < 0) {
+			/* The clock went backwards; start a new window. */
+			nstime_copy(&prof_sample_adapt_epoch, &now);
+		} else {
+			nstime_t elapsed;
+			nstime_copy(&elapsed, &now);
+			nstime_subtract(&elapsed, &prof_sample_adapt_epoch);
+			uint64_t elapsed_ns = nstime_ns(&elapsed);
+			if (elapsed_ns >= PROF_SAMPLE_ADAPT_INTERVAL_NS) {
+				nsamples = atomic_exchange_zu(
+				    &prof_sample_adapt_nsamples, 0,
+				    ATOMIC_RELAXED);
+				unsigned level = prof_sample_level_next(
+				    atomic_load_u(&prof_sample_level,
+				    ATOMIC_RELAXED), prof_sample_max_level(),
+				    nsamples, elapsed_ns,
+				    opt_prof_sample_target);
+				atomic_store_u(&prof_sample_level, level,
+				    ATOMIC_RELAXED);
+				nstime_copy(&prof_sample_adapt_epoch, &now);
+			}
+		}
+		malloc_mutex_unlock(tsd_tsdn(tsd), &prof_sample_adapt_mtx);
+	}
+
+	unsigned level = atomic_load_u(&prof_sample_level, ATOMIC_RELAXED);
+	unsigned max_level = prof_sample_max_level();
+	return (level < max_level) ? level : max_level;
+}
+#endif
+
 /*
  * The bodies of this function and prof_leakcheck() are compiled out unless heap
  * profiling is enabled, so that it is possible to compile jemalloc with
@@ -248,13 +409,26 @@ prof_tctx_create(tsd_t *tsd) {
 uint64_t
 prof_sample_new_event_wait(tsd_t *tsd) {
 #ifdef JEMALLOC_PROF
-	if (lg_prof_sample == 0) {
+	size_t lg_sample = lg_prof_sample;
+	if (opt_prof_sample_target != 0) {
+		unsigned level = prof_sample_adapt(tsd);
+		/*
+		 * Remember the level, so that the sample this wait leads to is
+		 * weighted by the rate it was actually taken at.
+		 */
+		prof_tdata_t *tdata = tsd_prof_tdata_get(tsd);
+		if (tdata != NULL) {
+			tdata->sample_level = level;
+		}
+		lg_sample += level;
+	}
+	if (lg_sample == 0) {
 		return TE_MIN_START_WAIT;
 	}
 
 	/*
 	 * Compute sample interval as a geometrically distributed random
-	 * variable with mean (2^lg_prof_sample).
+	 * variable with mean (2^lg_sample).
 	 *
 	 *                      __        __
 	 *                      |  log(u)  |                     1
@@ -281,7 +455,7 @@ prof_sample_new_event_wait(tsd_t *tsd) {
 	double u = (r == 0U) ? 1.0 : (double)((long double)r *
 	    (1.0L/9007199254740992.0L));
 	return (uint64_t)(log(u) /
-	    log(1.0 - (1.0 / (double)((uint64_t)1U << lg_prof_sample))))
+	    log(1.0 - (1.0 / (double)((uint64_t)1U << lg_sample))))
 	    + (uint64_t)1U;
 #else
 	not_reached();
@@ -302,11 +476,34 @@ prof_sample_postponed_event_wait(tsd_t *tsd) {
 	return prof_sample_new_event_wait(tsd);
 }
 
+static void
+prof_watermark_dump(tsd_t *tsd) {
+	if (!prof_booted || tsd_reentrancy_level_get(tsd) > 0) {
+		return;
+	}
+	/* In either case, leave the dump to a later sample. */
+	prof_tdata_t *tdata = prof_tdata_get(tsd, false);
+	if (tdata == NULL || tdata->enq) {
+		return;
+	}
+	if (!atomic_exchange_b(&prof_watermark_pending, false,
+	    ATOMIC_ACQUIRE)) {
+		return;
+	}
+	prof_wdump_impl(tsd);
+}
+
 void
 prof_sample_event_handler(tsd_t *tsd, uint64_t elapsed) {
 	cassert(config_prof);
 	assert(elapsed > 0 && elapsed != TE_INVALID_ELAPSED);
-	if (prof_interval == 0 || !prof_active_get_unlocked()) {
+	if (!prof_active_get_unlocked()) {
+		return;
+	}
+	if (unlikely(atomic_load_b(&prof_watermark_pending, ATOMIC_RELAXED))) {
+		prof_watermark_dump(tsd);
+	}
+	if (prof_interval == 0) {
 		return;
 	}
 	if (counter_accum(tsd_tsdn(tsd), &prof_idump_accumulated, elapsed)) {
@@ -376,6 +573,18 @@ prof_mdump(tsd_t *tsd, const char *filename) {
 	return prof_mdump_impl(tsd, filename);
 }
 
+bool
+prof_mdump_cb(tsd_t *tsd, prof_dump_write_cb_t *write_cb, void *cbopaque) {
+	cassert(config_prof);
+	assert(tsd_reentrancy_level_get(tsd) == 0);
+
+	if (!opt_prof || !prof_booted) {
+		return true;
+	}
+
+	return prof_mdump_cb_impl(tsd, write_cb, cbopaque);
+}
+
 void
 prof_gdump(tsdn_t *tsdn) {
 	tsd_t *tsd;
@@ -403,6 +612,162 @@ prof_gdump(tsdn_t *tsdn) {
 	prof_gdump_impl(tsd);
 }
 
+bool
+prof_watermark_enabled(void) {
+	return config_stats && opt_prof && (opt_prof_watermark_allocated != 0
+	    || opt_prof_watermark_resident != 0);
+}
+
+/* Returns value * pct / 100, saturating at SIZE_MAX. */
+static size_t
+prof_watermark_scale(size_t value, uint64_t pct) {
+	uint64_t q = (uint64_t)value / 100;
+	uint64_t r = (uint64_t)value % 100;
+	if (q != 0 && pct > UINT64_MAX / q) {
+		return SIZE_MAX;
+	}
+	uint64_t scaled = q * pct;
+	if (scaled > UINT64_MAX - r * pct / 100) {
+		return SIZE_MAX;
+	}
+	scaled += r * pct / 100;
+	/* size_t may be narrower than uint64_t. */
+	return ((size_t)scaled == scaled) ? (size_t)scaled : SIZE_MAX;
+}
+
+static void
+prof_watermark_init(prof_watermark_t *watermark, size_t threshold) {
+	watermark->level = threshold;
+	watermark->base = 0;
+	watermark->armed = true;
+}
+
+static void
+prof_watermark_rebase(prof_watermark_t *watermark, size_t threshold,
+    size_t value) {
+	size_t level = prof_watermark_scale(value,
+	    100 + (uint64_t)opt_prof_watermark_growth);
+	if (level <= value && value != SIZE_MAX) {
+		level = value + 1;
+	}
+	watermark->level = (level > threshold) ? level : threshold;
+	watermark->base = value;
+}
+
+static bool
+prof_watermark_crossed(prof_watermark_t *watermark, size_t threshold,
+    size_t value) {
+	if (threshold == 0) {
+		return false;
+	}
+	if (value < prof_watermark_scale(watermark->base,
+	    100 - opt_prof_watermark_hysteresis)) {
+		if (opt_prof_watermark_growth == 0) {
+			watermark->armed = true;
+			watermark->base = 0;
+		} else {
+			prof_watermark_rebase(watermark, threshold, value);
+		}
+	}
+	return watermark->armed && value >= watermark->level;
+}
+
+static void
+prof_watermark_fired(prof_watermark_t *watermark, size_t threshold,
+    size_t value) {
+	if (opt_prof_watermark_growth == 0) {
+		watermark->armed = false;
+		watermark->base = threshold;
+	} else {
+		prof_watermark_rebase(watermark, threshold, value);
+	}
+}
+
+void
+prof_watermark_evaluate(tsdn_t *tsdn) {
+	cassert(config_prof);
+
+	if (!prof_watermark_enabled()) {
+		return;
+	}
+	arena_stats_summary_t summary = {0};
+	unsigned narenas = narenas_total_get();
+	for (unsigned i = 0; i < narenas; i++) {
+		arena_t *arena = arena_get(tsdn, i, false);
+		if (arena != NULL) {
+			arena_stats_summary_merge(tsdn, arena, &summary);
+		}
+	}
+	size_t allocated = summary.allocated;
+	size_t resident = summary.resident;
+
+	nstime_t now;
+	nstime_init_update(&now);
+	malloc_mutex_lock(tsdn, &prof_watermark_mtx);
+	nstime_copy(&prof_watermark_last_check, &now);
+	bool allocated_crossed = prof_watermark_crossed(
+	    &prof_watermark_allocated, opt_prof_watermark_allocated, allocated);
+	bool resident_crossed = prof_watermark_crossed(
+	    &prof_watermark_resident, opt_prof_watermark_resident, resident);
+	if (!allocated_crossed && !resident_crossed) {
+		malloc_mutex_unlock(tsdn, &prof_watermark_mtx);
+		return;
+	}
+	if (prof_watermark_dumped &&
+	    nstime_compare(&now, &prof_watermark_last_dump) > 0) {
+		nstime_t elapsed;
+		nstime_copy(&elapsed, &now);
+		nstime_subtract(&elapsed, &prof_watermark_last_dump);
+		if (nstime_msec(&elapsed) < opt_prof_watermark_interval_ms) {
+			/* Still crossed at a later check, if it persists. */
+			malloc_mutex_unlock(tsdn, &prof_watermark_mtx);
+			return;
+		}
+	}
+	if (allocated_crossed) {
+		prof_watermark_fired(&prof_watermark_allocated,
+		    opt_prof_watermark_allocated, allocated);
+	}
+	if (resident_crossed) {
+		prof_watermark_fired(&prof_watermark_resident,
+		    opt_prof_watermark_resident, resident);
+	}
+	nstime_copy(&prof_watermark_last_dump, &now);
+	prof_watermark_dumped = true;
+	atomic_store_b(&prof_watermark_pending, true, ATOMIC_RELEASE);
+	malloc_mutex_unlock(tsdn, &prof_watermark_mtx);
+}
+
+/*
+ * Called by background thread 0 every time it wakes up; returns the time until
+ * the watermarks need to be checked again.
+ */
+uint64_t
+prof_watermark_deferred_work(tsdn_t *tsdn) {
+	cassert(config_prof);
+
+	if (!prof_watermark_enabled()) {
+		return BACKGROUND_THREAD_DEFERRED_MAX;
+	}
+	nstime_t now;
+	nstime_init_update(&now);
+	uint64_t elapsed_ns = PROF_WATERMARK_CHECK_INTERVAL_NS;
+	malloc_mutex_lock(tsdn, &prof_watermark_mtx);
+	if (nstime_compare(&now, &prof_watermark_last_check) > 0) {
+		nstime_t elapsed;
+		nstime_copy(&elapsed, &now);
+		nstime_subtract(&elapsed, &prof_watermark_last_check);
+		elapsed_ns = nstime_ns(&elapsed);
+	}
+	malloc_mutex_unlock(tsdn, &prof_watermark_mtx);
+
+	if (elapsed_ns < PROF_WATERMARK_CHECK_INTERVAL_NS) {
+		return PROF_WATERMARK_CHECK_INTERVAL_NS - elapsed_ns;
+	}
+	prof_watermark_evaluate(tsdn);
+	return PROF_WATERMARK_CHECK_INTERVAL_NS;
+}
+
 static uint64_t
 prof_thr_uid_alloc(tsdn_t *tsdn) {
 	uint64_t thr_uid;
@@ -426,6 +791,7 @@ prof_tdata_reinit(tsd_t *tsd, prof_tdata_t *tdata) {
 	uint64_t thr_uid = tdata->thr_uid;
 	uint64_t thr_discrim = tdata->thr_discrim + 1;
 	bool active = tdata->active;
+	unsigned alloc_tag = tdata->alloc_tag;
 
 	/* Keep a local copy of the thread name, before detaching. */
 	prof_thread_name_assert(tdata);
@@ -433,8 +799,12 @@ prof_tdata_reinit(tsd_t *tsd, prof_tdata_t *tdata) {
 	strncpy(thread_name, tdata->thread_name, PROF_THREAD_NAME_MAX_LEN);
 	prof_tdata_detach(tsd, tdata);
 
-	return prof_tdata_init_impl(tsd, thr_uid, thr_discrim, thread_name,
-	    active);
+	prof_tdata_t *ret = prof_tdata_init_impl(tsd, thr_uid, thr_discrim,
+	    thread_name, active);
+	if (ret != NULL) {
+		ret->alloc_tag = alloc_tag;
+	}
+	return ret;
 }
 
 void
@@ -524,6 +894,30 @@ prof_thread_active_set(tsd_t *tsd, bool active) {
 	return false;
 }
 
+unsigned
+prof_thread_alloc_tag_get(tsd_t *tsd) {
+	assert(tsd_reentrancy_level_get(tsd) == 0);
+
+	prof_tdata_t *tdata = prof_tdata_get(tsd, true);
+	if (tdata == NULL) {
+		return 0;
+	}
+	return tdata->alloc_tag;
+}
+
+bool
+prof_thread_alloc_tag_set(tsd_t *tsd, unsigned tag) {
+	assert(tsd_reentrancy_level_get(tsd) == 0);
+	assert(tag < PROF_ALLOC_NTAGS);
+
+	prof_tdata_t *tdata = prof_tdata_get(tsd, true);
+	if (tdata == NULL) {
+		return true;
+	}
+	tdata->alloc_tag = tag;
+	return false;
+}
+
 bool
 prof_thread_active_init_get(tsdn_t *tsdn) {
 	bool active_init;
@@ -630,6 +1024,14 @@ prof_boot1(void) {
 		opt_prof_leak = true;
 	}
 
+	if (opt_prof_sample_target != 0) {
+		/*
+		 * Raw sample counts mix samples taken at different rates, so
+		 * only the unbiased counts mean anything.
+		 */
+		opt_prof_unbias = true;
+	}
+
 	if (opt_prof_leak && !opt_prof) {
 		/*
 		 * Enable opt_prof, but in such a way that profiles are never
@@ -637,6 +1039,8 @@ prof_boot1(void) {
 		 */
 		opt_prof = true;
 		opt_prof_gdump = false;
+		opt_prof_watermark_allocated = 0;
+		opt_prof_watermark_resident = 0;
 	} else if (opt_prof) {
 		if (opt_lg_prof_interval >= 0) {
 			prof_interval = (((uint64_t)1U) <<
@@ -666,10 +1070,6 @@ prof_boot2(tsd_t *tsd, base_t *base) {
 	    malloc_mutex_rank_exclusive)) {
 		return true;
 	}
-	if (malloc_mutex_init(&bt2gctx_mtx, "prof_bt2gctx",
-	    WITNESS_RANK_PROF_BT2GCTX, malloc_mutex_rank_exclusive)) {
-		return true;
-	}
 	if (malloc_mutex_init(&tdatas_mtx, "prof_tdatas",
 	    WITNESS_RANK_PROF_TDATAS, malloc_mutex_rank_exclusive)) {
 		return true;
@@ -691,6 +1091,21 @@ prof_boot2(tsd_t *tsd, base_t *base) {
 	    WITNESS_RANK_PROF_DUMP, malloc_mutex_rank_exclusive)) {
 		return true;
 	}
+	if (malloc_mutex_init(&prof_sample_adapt_mtx, "prof_sample_adapt",
+	    WITNESS_RANK_PROF_SAMPLE_ADAPT, malloc_mutex_rank_exclusive)) {
+		return true;
+	}
+	nstime_init_update(&prof_sample_adapt_epoch);
+	if (malloc_mutex_init(&prof_watermark_mtx, "prof_watermark",
+	    WITNESS_RANK_PROF_WATERMARK, malloc_mutex_rank_exclusive)) {
+		return true;
+	}
+	prof_watermark_init(&prof_watermark_allocated,
+	    opt_prof_watermark_allocated);
+	prof_watermark_init(&prof_watermark_resident,
+	    opt_prof_watermark_resident);
+	nstime_init_update(&prof_watermark_last_check);
+	nstime_init_zero(&prof_watermark_last_dump);
 
 	if (opt_prof) {
 		lg_prof_sample = opt_lg_prof_sample;
@@ -699,7 +1114,7 @@ prof_boot2(tsd_t *tsd, base_t *base) {
 		prof_gdump_val = opt_prof_gdump;
 		prof_thread_active_init = opt_prof_thread_active_init;
 
-		if (prof_data_init(tsd)) {
+		if (prof_data_init(tsd, base)) {
 			return true;
 		}
 
@@ -766,7 +1181,7 @@ prof_prefork0(tsdn_t *tsdn) {
 		unsigned i;
 
 		malloc_mutex_prefork(tsdn, &prof_dump_mtx);
-		malloc_mutex_prefork(tsdn, &bt2gctx_mtx);
+		prof_bt2gctx_prefork(tsdn);
 		malloc_mutex_prefork(tsdn, &tdatas_mtx);
 		for (i = 0; i < PROF_NTDATA_LOCKS; i++) {
 			malloc_mutex_prefork(tsdn, &tdata_locks[i]);
@@ -786,10 +1201,12 @@ prof_prefork1(tsdn_t *tsdn) {
 		malloc_mutex_prefork(tsdn, &prof_active_mtx);
 		malloc_mutex_prefork(tsdn, &prof_dump_filename_mtx);
 		malloc_mutex_prefork(tsdn, &prof_gdump_mtx);
-		malloc_mutex_prefork(tsdn, &prof_recent_alloc_mtx);
+		prof_recent_prefork(tsdn);
 		malloc_mutex_prefork(tsdn, &prof_stats_mtx);
 		malloc_mutex_prefork(tsdn, &next_thr_uid_mtx);
 		malloc_mutex_prefork(tsdn, &prof_thread_active_init_mtx);
+		malloc_mutex_prefork(tsdn, &prof_sample_adapt_mtx);
+		malloc_mutex_prefork(tsdn, &prof_watermark_mtx);
 	}
 }
 
@@ -798,11 +1215,13 @@ prof_postfork_parent(tsdn_t *tsdn) {
 	if (config_prof && opt_prof) {
 		unsigned i;
 
+		malloc_mutex_postfork_parent(tsdn, &prof_watermark_mtx);
+		malloc_mutex_postfork_parent(tsdn, &prof_sample_adapt_mtx);
 		malloc_mutex_postfork_parent(tsdn,
 		    &prof_thread_active_init_mtx);
 		malloc_mutex_postfork_parent(tsdn, &next_thr_uid_mtx);
 		malloc_mutex_postfork_parent(tsdn, &prof_stats_mtx);
-		malloc_mutex_postfork_parent(tsdn, &prof_recent_alloc_mtx);
+		prof_recent_postfork_parent(tsdn);
 		malloc_mutex_postfork_parent(tsdn, &prof_gdump_mtx);
 		malloc_mutex_postfork_parent(tsdn, &prof_dump_filename_mtx);
 		malloc_mutex_postfork_parent(tsdn, &prof_active_mtx);
@@ -816,7 +1235,7 @@ prof_postfork_parent(tsdn_t *tsdn) {
 			malloc_mutex_postfork_parent(tsdn, &tdata_locks[i]);
 		}
 		malloc_mutex_postfork_parent(tsdn, &tdatas_mtx);
-		malloc_mutex_postfork_parent(tsdn, &bt2gctx_mtx);
+		prof_bt2gctx_postfork_parent(tsdn);
 		malloc_mutex_postfork_parent(tsdn, &prof_dump_mtx);
 	}
 }
@@ -826,10 +1245,12 @@ prof_postfork_child(tsdn_t *tsdn) {
 	if (config_prof && opt_prof) {
 		unsigned i;
 
+		malloc_mutex_postfork_child(tsdn, &prof_watermark_mtx);
+		malloc_mutex_postfork_child(tsdn, &prof_sample_adapt_mtx);
 		malloc_mutex_postfork_child(tsdn, &prof_thread_active_init_mtx);
 		malloc_mutex_postfork_child(tsdn, &next_thr_uid_mtx);
 		malloc_mutex_postfork_child(tsdn, &prof_stats_mtx);
-		malloc_mutex_postfork_child(tsdn, &prof_recent_alloc_mtx);
+		prof_recent_postfork_child(tsdn);
 		malloc_mutex_postfork_child(tsdn, &prof_gdump_mtx);
 		malloc_mutex_postfork_child(tsdn, &prof_dump_filename_mtx);
 		malloc_mutex_postfork_child(tsdn, &prof_active_mtx);
@@ -843,7 +1264,7 @@ prof_postfork_child(tsdn_t *tsdn) {
 			malloc_mutex_postfork_child(tsdn, &tdata_locks[i]);
 		}
 		malloc_mutex_postfork_child(tsdn, &tdatas_mtx);
-		malloc_mutex_postfork_child(tsdn, &bt2gctx_mtx);
+		prof_bt2gctx_postfork_child(tsdn);
 		malloc_mutex_postfork_child(tsdn, &prof_dump_mtx);
 	}
 }
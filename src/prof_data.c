@@ -6,6 +6,8 @@
 #include "jemalloc/internal/hash.h"
 #include "jemalloc/internal/malloc_io.h"
 #include "jemalloc/internal/prof_data.h"
+#include "jemalloc/internal/prof_pprof.h"
+#include "jemalloc/internal/prof_stats.h"
 
 /*
  * This file defines and manages the core profiling data structures.
@@ -25,7 +27,6 @@
 
 /******************************************************************************/
 
-malloc_mutex_t bt2gctx_mtx;
 malloc_mutex_t tdatas_mtx;
 malloc_mutex_t prof_dump_mtx;
 
@@ -49,9 +50,13 @@ malloc_mutex_t *tdata_locks;
 
 /*
  * Global hash of (prof_bt_t *)-->(prof_gctx_t *).  This is the master data
- * structure that knows about all backtraces currently captured.
+ * structure that knows about all backtraces currently captured.  It is split
+ * into shards by backtrace hash, each with its own lock, so that threads
+ * sampling previously unseen backtraces rarely contend with each other.
+ * Operations over the whole index (dumping, counting) lock every shard, in
+ * address order.
  */
-static ckh_t bt2gctx;
+static prof_bt2gctx_shard_t *bt2gctx_shards;
 
 /*
  * Tree of all extant prof_tdata_t structures, regardless of state,
@@ -59,8 +64,8 @@ static ckh_t bt2gctx;
  */
 static prof_tdata_tree_t tdatas;
 
-size_t prof_unbiased_sz[PROF_SC_NSIZES];
-size_t prof_shifted_unbiased_cnt[PROF_SC_NSIZES];
+size_t prof_unbiased_sz[PROF_SAMPLE_NLEVELS][PROF_SC_NSIZES];
+size_t prof_shifted_unbiased_cnt[PROF_SAMPLE_NLEVELS][PROF_SC_NSIZES];
 
 /******************************************************************************/
 /* Red-black trees. */
@@ -143,14 +148,57 @@ prof_tdata_mutex_choose(uint64_t thr_uid) {
 }
 
 bool
-prof_data_init(tsd_t *tsd) {
+prof_data_init(tsd_t *tsd, base_t *base) {
 	tdata_tree_new(&tdatas);
-	return ckh_new(tsd, &bt2gctx, PROF_CKH_MINITEMS,
-	    prof_bt_hash, prof_bt_keycomp);
+
+	bt2gctx_shards = (prof_bt2gctx_shard_t *)base_alloc(tsd_tsdn(tsd),
+	    base, PROF_BT2GCTX_NSHARDS * sizeof(prof_bt2gctx_shard_t),
+	    CACHELINE);
+	if (bt2gctx_shards == NULL) {
+		return true;
+	}
+	for (unsigned i = 0; i < PROF_BT2GCTX_NSHARDS; i++) {
+		prof_bt2gctx_shard_t *shard = &bt2gctx_shards[i];
+		if (malloc_mutex_init(&shard->mtx, "prof_bt2gctx",
+		    WITNESS_RANK_PROF_BT2GCTX, malloc_mutex_address_ordered)) {
+			return true;
+		}
+		if (ckh_new(tsd, &shard->bt2gctx, PROF_CKH_MINITEMS,
+		    prof_bt_hash, prof_bt_keycomp)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Pick the shard for a backtrace, given its prof_bt_hash() hashes.  The same
+ * hashes are then passed on to the shard's ckh, so that each lookup hashes the
+ * backtrace only once.
+ */
+static prof_bt2gctx_shard_t *
+prof_bt2gctx_shard_get(const size_t hashes[2]) {
+	/* ckh indexes using the low bits; pick the shard with the high ones. */
+	return &bt2gctx_shards[hashes[1] >> ((sizeof(size_t) << 3) -
+	    LG_PROF_BT2GCTX_NSHARDS)];
 }
 
 static void
-prof_enter(tsd_t *tsd, prof_tdata_t *tdata) {
+prof_bt2gctx_lock_all(tsdn_t *tsdn) {
+	for (unsigned i = 0; i < PROF_BT2GCTX_NSHARDS; i++) {
+		malloc_mutex_lock(tsdn, &bt2gctx_shards[i].mtx);
+	}
+}
+
+static void
+prof_bt2gctx_unlock_all(tsdn_t *tsdn) {
+	for (unsigned i = PROF_BT2GCTX_NSHARDS; i > 0; i--) {
+		malloc_mutex_unlock(tsdn, &bt2gctx_shards[i - 1].mtx);
+	}
+}
+
+static void
+prof_enq_begin(tsd_t *tsd, prof_tdata_t *tdata) {
 	cassert(config_prof);
 	assert(tdata == prof_tdata_get(tsd, false));
 
@@ -158,17 +206,13 @@ prof_enter(tsd_t *tsd, prof_tdata_t *tdata) {
 		assert(!tdata->enq);
 		tdata->enq = true;
 	}
-
-	malloc_mutex_lock(tsd_tsdn(tsd), &bt2gctx_mtx);
 }
 
 static void
-prof_leave(tsd_t *tsd, prof_tdata_t *tdata) {
+prof_enq_end(tsd_t *tsd, prof_tdata_t *tdata) {
 	cassert(config_prof);
 	assert(tdata == prof_tdata_get(tsd, false));
 
-	malloc_mutex_unlock(tsd_tsdn(tsd), &bt2gctx_mtx);
-
 	if (tdata != NULL) {
 		bool idump, gdump;
 
@@ -188,6 +232,76 @@ prof_leave(tsd_t *tsd, prof_tdata_t *tdata) {
 	}
 }
 
+/* Lock one bt2gctx shard, deferring dumps triggered while holding it. */
+static void
+prof_enter_shard(tsd_t *tsd, prof_tdata_t *tdata,
+    prof_bt2gctx_shard_t *shard) {
+	prof_enq_begin(tsd, tdata);
+	malloc_mutex_lock(tsd_tsdn(tsd), &shard->mtx);
+}
+
+static void
+prof_leave_shard(tsd_t *tsd, prof_tdata_t *tdata,
+    prof_bt2gctx_shard_t *shard) {
+	malloc_mutex_unlock(tsd_tsdn(tsd), &shard->mtx);
+	prof_enq_end(tsd, tdata);
+}
+
+/* As above, but for the whole of bt2gctx. */
+static void
+prof_enter(tsd_t *tsd, prof_tdata_t *tdata) {
+	prof_enq_begin(tsd, tdata);
+	prof_bt2gctx_lock_all(tsd_tsdn(tsd));
+}
+
+static void
+prof_leave(tsd_t *tsd, prof_tdata_t *tdata) {
+	prof_bt2gctx_unlock_all(tsd_tsdn(tsd));
+	prof_enq_end(tsd, tdata);
+}
+
+void
+prof_bt2gctx_mutex_prof_read(tsdn_t *tsdn, mutex_prof_data_t *data) {
+	memset(data, 0, sizeof(mutex_prof_data_t));
+	for (unsigned i = 0; i < PROF_BT2GCTX_NSHARDS; i++) {
+		malloc_mutex_t *mtx = &bt2gctx_shards[i].mtx;
+		malloc_mutex_lock(tsdn, mtx);
+		malloc_mutex_prof_accum(tsdn, data, mtx);
+		malloc_mutex_unlock(tsdn, mtx);
+	}
+}
+
+void
+prof_bt2gctx_mutex_prof_reset(tsdn_t *tsdn) {
+	for (unsigned i = 0; i < PROF_BT2GCTX_NSHARDS; i++) {
+		malloc_mutex_t *mtx = &bt2gctx_shards[i].mtx;
+		malloc_mutex_lock(tsdn, mtx);
+		malloc_mutex_prof_data_reset(tsdn, mtx);
+		malloc_mutex_unlock(tsdn, mtx);
+	}
+}
+
+void
+prof_bt2gctx_prefork(tsdn_t *tsdn) {
+	for (unsigned i = 0; i < PROF_BT2GCTX_NSHARDS; i++) {
+		malloc_mutex_prefork(tsdn, &bt2gctx_shards[i].mtx);
+	}
+}
+
+void
+prof_bt2gctx_postfork_parent(tsdn_t *tsdn) {
+	for (unsigned i = PROF_BT2GCTX_NSHARDS; i > 0; i--) {
+		malloc_mutex_postfork_parent(tsdn, &bt2gctx_shards[i - 1].mtx);
+	}
+}
+
+void
+prof_bt2gctx_postfork_child(tsdn_t *tsdn) {
+	for (unsigned i = PROF_BT2GCTX_NSHARDS; i > 0; i--) {
+		malloc_mutex_postfork_child(tsdn, &bt2gctx_shards[i - 1].mtx);
+	}
+}
+
 static prof_gctx_t *
 prof_gctx_create(tsdn_t *tsdn, prof_bt_t *bt) {
 	/*
@@ -207,6 +321,9 @@ prof_gctx_create(tsdn_t *tsdn, prof_bt_t *bt) {
 	 */
 	gctx->nlimbo = 1;
 	tctx_tree_new(&gctx->tctxs);
+	for (unsigned i = 0; i < PROF_LIFETIME_NBUCKETS; i++) {
+		atomic_store_zu(&gctx->lifetimes[i], 0, ATOMIC_RELAXED);
+	}
 	/* Duplicate bt. */
 	memcpy(gctx->vec, bt->vec, bt->len * sizeof(void *));
 	gctx->bt.vec = gctx->vec;
@@ -214,6 +331,24 @@ prof_gctx_create(tsdn_t *tsdn, prof_bt_t *bt) {
 	return gctx;
 }
 
+/*
+ * Whether gctx has no lifetime histogram worth keeping.  Lifetimes are counted
+ * as sampled objects are freed, so a context whose objects are all gone may
+ * still hold the only record of how long they lived.
+ */
+static bool
+prof_gctx_lifetimes_empty(prof_gctx_t *gctx) {
+	if (!opt_prof_lifetime) {
+		return true;
+	}
+	for (unsigned i = 0; i < PROF_LIFETIME_NBUCKETS; i++) {
+		if (atomic_load_zu(&gctx->lifetimes[i], ATOMIC_RELAXED) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
 static void
 prof_gctx_try_destroy(tsd_t *tsd, prof_tdata_t *tdata_self,
     prof_gctx_t *gctx) {
@@ -226,15 +361,20 @@ prof_gctx_try_destroy(tsd_t *tsd, prof_tdata_t *tdata_self,
 	 * avoid a race between the main body of prof_tctx_destroy() and entry
 	 * into this function.
 	 */
-	prof_enter(tsd, tdata_self);
+	size_t hashes[2];
+	prof_bt_hash((void *)&gctx->bt, hashes);
+	prof_bt2gctx_shard_t *shard = prof_bt2gctx_shard_get(hashes);
+	prof_enter_shard(tsd, tdata_self, shard);
 	malloc_mutex_lock(tsd_tsdn(tsd), gctx->lock);
 	assert(gctx->nlimbo != 0);
-	if (tctx_tree_empty(&gctx->tctxs) && gctx->nlimbo == 1) {
+	if (tctx_tree_empty(&gctx->tctxs) && gctx->nlimbo == 1 &&
+	    prof_gctx_lifetimes_empty(gctx)) {
 		/* Remove gctx from bt2gctx. */
-		if (ckh_remove(tsd, &bt2gctx, &gctx->bt, NULL, NULL)) {
+		if (ckh_remove_hashed(tsd, &shard->bt2gctx, &gctx->bt, NULL,
+		    NULL, hashes)) {
 			not_reached();
 		}
-		prof_leave(tsd, tdata_self);
+		prof_leave_shard(tsd, tdata_self, shard);
 		/* Destroy gctx. */
 		malloc_mutex_unlock(tsd_tsdn(tsd), gctx->lock);
 		idalloctm(tsd_tsdn(tsd), gctx, NULL, NULL, true, true);
@@ -245,7 +385,7 @@ prof_gctx_try_destroy(tsd_t *tsd, prof_tdata_t *tdata_self,
 		 */
 		gctx->nlimbo--;
 		malloc_mutex_unlock(tsd_tsdn(tsd), gctx->lock);
-		prof_leave(tsd, tdata_self);
+		prof_leave_shard(tsd, tdata_self, shard);
 	}
 }
 
@@ -260,6 +400,9 @@ prof_gctx_should_destroy(prof_gctx_t *gctx) {
 	if (gctx->nlimbo != 0) {
 		return false;
 	}
+	if (!prof_gctx_lifetimes_empty(gctx)) {
+		return false;
+	}
 	return true;
 }
 
@@ -276,21 +419,27 @@ prof_lookup_global(tsd_t *tsd, prof_bt_t *bt, prof_tdata_t *tdata,
 	} btkey;
 	bool new_gctx;
 
-	prof_enter(tsd, tdata);
-	if (ckh_search(&bt2gctx, bt, &btkey.v, &gctx.v)) {
+	size_t hashes[2];
+	prof_bt_hash((void *)bt, hashes);
+	prof_bt2gctx_shard_t *shard = prof_bt2gctx_shard_get(hashes);
+	prof_enter_shard(tsd, tdata, shard);
+	if (ckh_search_hashed(&shard->bt2gctx, bt, &btkey.v, &gctx.v,
+	    hashes)) {
 		/* bt has never been seen before.  Insert it. */
-		prof_leave(tsd, tdata);
+		prof_leave_shard(tsd, tdata, shard);
 		tgctx.p = prof_gctx_create(tsd_tsdn(tsd), bt);
 		if (tgctx.v == NULL) {
 			return true;
 		}
-		prof_enter(tsd, tdata);
-		if (ckh_search(&bt2gctx, bt, &btkey.v, &gctx.v)) {
+		prof_enter_shard(tsd, tdata, shard);
+		if (ckh_search_hashed(&shard->bt2gctx, bt, &btkey.v, &gctx.v,
+		    hashes)) {
 			gctx.p = tgctx.p;
 			btkey.p = &gctx.p->bt;
-			if (ckh_insert(tsd, &bt2gctx, btkey.v, gctx.v)) {
+			if (ckh_insert_hashed(tsd, &shard->bt2gctx, btkey.v,
+			    gctx.v, hashes)) {
 				/* OOM. */
-				prof_leave(tsd, tdata);
+				prof_leave_shard(tsd, tdata, shard);
 				idalloctm(tsd_tsdn(tsd), gctx.v, NULL, NULL,
 				    true, true);
 				return true;
@@ -320,7 +469,7 @@ prof_lookup_global(tsd_t *tsd, prof_bt_t *bt, prof_tdata_t *tdata,
 			    true);
 		}
 	}
-	prof_leave(tsd, tdata);
+	prof_leave_shard(tsd, tdata, shard);
 
 	*p_btkey = btkey.v;
 	*p_gctx = gctx.p;
@@ -440,9 +589,12 @@ prof_bt_count(void) {
 		return 0;
 	}
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &bt2gctx_mtx);
-	bt_count = ckh_count(&bt2gctx);
-	malloc_mutex_unlock(tsd_tsdn(tsd), &bt2gctx_mtx);
+	bt_count = 0;
+	prof_bt2gctx_lock_all(tsd_tsdn(tsd));
+	for (unsigned i = 0; i < PROF_BT2GCTX_NSHARDS; i++) {
+		bt_count += ckh_count(&bt2gctx_shards[i].bt2gctx);
+	}
+	prof_bt2gctx_unlock_all(tsd_tsdn(tsd));
 
 	return bt_count;
 }
@@ -509,12 +661,12 @@ prof_double_uint64_cast(double d) {
 }
 #endif
 
-void prof_unbias_map_init(void) {
-	/* See the comment in prof_sample_new_event_wait */
 #ifdef JEMALLOC_PROF
+static void
+prof_unbias_map_init_level(unsigned level) {
 	for (szind_t i = 0; i < SC_NSIZES; i++) {
 		double sz = (double)sz_index2size(i);
-		double rate = (double)(ZU(1) << lg_prof_sample);
+		double rate = (double)((uint64_t)1U << (lg_prof_sample + level));
 		double div_val = 1.0 - exp(-sz / rate);
 		double unbiased_sz = sz / div_val;
 		/*
@@ -532,10 +684,22 @@ void prof_unbias_map_init(void) {
 		 */
 		double cnt_shift = (double)(ZU(1) << SC_LG_TINY_MIN);
 		double shifted_unbiased_cnt = cnt_shift / div_val;
-		prof_unbiased_sz[i] = (size_t)round(unbiased_sz);
-		prof_shifted_unbiased_cnt[i] = (size_t)round(
+		prof_unbiased_sz[level][i] = (size_t)round(unbiased_sz);
+		prof_shifted_unbiased_cnt[level][i] = (size_t)round(
 		    shifted_unbiased_cnt);
 	}
+}
+#endif
+
+void prof_unbias_map_init(void) {
+	/* See the comment in prof_sample_new_event_wait */
+#ifdef JEMALLOC_PROF
+	/* Without adaptive sampling, only level 0 is ever used. */
+	unsigned nlevels = (opt_prof_sample_target == 0) ? 1 :
+	    prof_sample_max_level() + 1;
+	for (unsigned level = 0; level < nlevels; level++) {
+		prof_unbias_map_init_level(level);
+	}
 #else
 	unreachable();
 #endif
@@ -717,37 +881,6 @@ prof_tctx_merge_iter(prof_tctx_tree_t *tctxs, prof_tctx_t *tctx, void *arg) {
 	return NULL;
 }
 
-typedef struct prof_dump_iter_arg_s prof_dump_iter_arg_t;
-struct prof_dump_iter_arg_s {
-	tsdn_t *tsdn;
-	write_cb_t *prof_dump_write;
-	void *cbopaque;
-};
-
-static prof_tctx_t *
-prof_tctx_dump_iter(prof_tctx_tree_t *tctxs, prof_tctx_t *tctx, void *opaque) {
-	prof_dump_iter_arg_t *arg = (prof_dump_iter_arg_t *)opaque;
-	malloc_mutex_assert_owner(arg->tsdn, tctx->gctx->lock);
-
-	switch (tctx->state) {
-	case prof_tctx_state_initializing:
-	case prof_tctx_state_nominal:
-		/* Not captured by this dump. */
-		break;
-	case prof_tctx_state_dumping:
-	case prof_tctx_state_purgatory:
-		prof_dump_printf(arg->prof_dump_write, arg->cbopaque,
-		    "  t%"FMTu64": ", tctx->thr_uid);
-		prof_dump_print_cnts(arg->prof_dump_write, arg->cbopaque,
-		    &tctx->dump_cnts);
-		arg->prof_dump_write(arg->cbopaque, "\n");
-		break;
-	default:
-		not_reached();
-	}
-	return NULL;
-}
-
 static prof_tctx_t *
 prof_tctx_finish_iter(prof_tctx_tree_t *tctxs, prof_tctx_t *tctx, void *arg) {
 	tsdn_t *tsdn = (tsdn_t *)arg;
@@ -911,47 +1044,205 @@ prof_tdata_merge_iter(prof_tdata_tree_t *tdatas_ptr, prof_tdata_t *tdata,
 	return NULL;
 }
 
+static void
+prof_dump_prep(tsd_t *tsd, prof_tdata_t *tdata, prof_cnt_t *cnt_all,
+    size_t *leak_ngctx, prof_gctx_tree_t *gctxs) {
+	size_t tabind;
+	union {
+		prof_gctx_t	*p;
+		void		*v;
+	} gctx;
+
+	prof_enter(tsd, tdata);
+
+	/*
+	 * Put gctx's in limbo and clear their counters in preparation for
+	 * summing.
+	 */
+	gctx_tree_new(gctxs);
+	for (unsigned i = 0; i < PROF_BT2GCTX_NSHARDS; i++) {
+		ckh_t *bt2gctx = &bt2gctx_shards[i].bt2gctx;
+		for (tabind = 0; !ckh_iter(bt2gctx, &tabind, NULL, &gctx.v);) {
+			prof_dump_gctx_prep(tsd_tsdn(tsd), gctx.p, gctxs);
+		}
+	}
+
+	/*
+	 * Iterate over tdatas, and for the non-expired ones snapshot their tctx
+	 * stats and merge them into the associated gctx's.
+	 */
+	memset(cnt_all, 0, sizeof(prof_cnt_t));
+	prof_tdata_merge_iter_arg_t prof_tdata_merge_iter_arg = {tsd_tsdn(tsd),
+	    cnt_all};
+	malloc_mutex_lock(tsd_tsdn(tsd), &tdatas_mtx);
+	tdata_tree_iter(&tdatas, NULL, prof_tdata_merge_iter,
+	    &prof_tdata_merge_iter_arg);
+	malloc_mutex_unlock(tsd_tsdn(tsd), &tdatas_mtx);
+
+	/* Merge tctx stats into gctx's. */
+	*leak_ngctx = 0;
+	prof_gctx_merge_iter_arg_t prof_gctx_merge_iter_arg = {tsd_tsdn(tsd),
+	    leak_ngctx};
+	gctx_tree_iter(gctxs, NULL, prof_gctx_merge_iter,
+	    &prof_gctx_merge_iter_arg);
+
+	prof_leave(tsd, tdata);
+}
+
+/*
+ * A private copy of everything a dump reports.  It is taken while the
+ * profiling locks are held and formatted only after they have all been
+ * released, so allocating threads wait for the copy but never for output.
+ * Records are packed back to back: ntdatas prof_dump_tdata_rec_t's, then for
+ * each of ngctxs, a prof_dump_gctx_rec_t, its backtrace, and its
+ * prof_dump_tctx_rec_t's.
+ */
+typedef struct prof_dump_tdata_rec_s prof_dump_tdata_rec_t;
+struct prof_dump_tdata_rec_s {
+	uint64_t	thr_uid;
+	prof_cnt_t	cnts;
+	char		thread_name[PROF_THREAD_NAME_MAX_LEN];
+};
+
+typedef struct prof_dump_gctx_rec_s prof_dump_gctx_rec_t;
+struct prof_dump_gctx_rec_s {
+	prof_cnt_t	cnts;
+	size_t		lifetimes[PROF_LIFETIME_NBUCKETS];
+	unsigned	len;
+	size_t		ntctxs;
+};
+
+typedef struct prof_dump_tctx_rec_s prof_dump_tctx_rec_t;
+struct prof_dump_tctx_rec_s {
+	uint64_t	thr_uid;
+	prof_cnt_t	cnts;
+};
+
+typedef struct prof_dump_snapshot_s prof_dump_snapshot_t;
+struct prof_dump_snapshot_s {
+	tsdn_t		*tsdn;
+	prof_cnt_t	cnt_all;
+	size_t		leak_ngctx;
+	size_t		ntdatas;
+	size_t		ngctxs;
+	/* Offset of the gctx record whose tctx's are being copied. */
+	size_t		gctx_rec_offset;
+	byte_t		*buf;
+	size_t		size;
+	size_t		capacity;
+	bool		oom;
+};
+
+#define PROF_DUMP_SNAPSHOT_MINSIZE	((size_t)16 << 10)
+
+static size_t
+prof_dump_snapshot_rec_size(size_t size) {
+	return ALIGNMENT_CEILING(size, sizeof(uint64_t));
+}
+
+/* Returns space for a record of the given size, or NULL on OOM. */
+static void *
+prof_dump_snapshot_reserve(prof_dump_snapshot_t *snapshot, size_t size) {
+	if (snapshot->oom) {
+		return NULL;
+	}
+	size = prof_dump_snapshot_rec_size(size);
+	if (size > snapshot->capacity - snapshot->size) {
+		size_t capacity = (snapshot->capacity == 0) ?
+		    PROF_DUMP_SNAPSHOT_MINSIZE : snapshot->capacity;
+		while (size > capacity - snapshot->size &&
+		    capacity <= SC_LARGE_MAXCLASS / 2) {
+			capacity <<= 1;
+		}
+		byte_t *buf = NULL;
+		if (size <= capacity - snapshot->size) {
+			buf = (byte_t *)iallocztm(snapshot->tsdn, capacity,
+			    sz_size2index(capacity), false, NULL, true,
+			    arena_get(TSDN_NULL, 0, true), true);
+		}
+		if (buf == NULL) {
+			snapshot->oom = true;
+			return NULL;
+		}
+		if (snapshot->buf != NULL) {
+			memcpy(buf, snapshot->buf, snapshot->size);
+			idalloctm(snapshot->tsdn, snapshot->buf, NULL, NULL,
+			    true, true);
+		}
+		snapshot->buf = buf;
+		snapshot->capacity = capacity;
+	}
+	void *ret = snapshot->buf + snapshot->size;
+	snapshot->size += size;
+	return ret;
+}
+
 static prof_tdata_t *
-prof_tdata_dump_iter(prof_tdata_tree_t *tdatas_ptr, prof_tdata_t *tdata,
+prof_tdata_snapshot_iter(prof_tdata_tree_t *tdatas_ptr, prof_tdata_t *tdata,
     void *opaque) {
 	if (!tdata->dumping) {
 		return NULL;
 	}
 
-	prof_dump_iter_arg_t *arg = (prof_dump_iter_arg_t *)opaque;
-	prof_dump_printf(arg->prof_dump_write, arg->cbopaque, "  t%"FMTu64": ",
-	    tdata->thr_uid);
-	prof_dump_print_cnts(arg->prof_dump_write, arg->cbopaque,
-	    &tdata->cnt_summed);
-	if (!prof_thread_name_empty(tdata)) {
-		arg->prof_dump_write(arg->cbopaque, " ");
-		arg->prof_dump_write(arg->cbopaque, tdata->thread_name);
+	prof_dump_snapshot_t *snapshot = (prof_dump_snapshot_t *)opaque;
+	prof_dump_tdata_rec_t *rec = (prof_dump_tdata_rec_t *)
+	    prof_dump_snapshot_reserve(snapshot, sizeof(prof_dump_tdata_rec_t));
+	if (rec == NULL) {
+		return tdata;
 	}
-	arg->prof_dump_write(arg->cbopaque, "\n");
+	rec->thr_uid = tdata->thr_uid;
+	rec->cnts = tdata->cnt_summed;
+	memcpy(rec->thread_name, tdata->thread_name, PROF_THREAD_NAME_MAX_LEN);
+	snapshot->ntdatas++;
 	return NULL;
 }
 
-static void
-prof_dump_header(prof_dump_iter_arg_t *arg, const prof_cnt_t *cnt_all) {
-	prof_dump_printf(arg->prof_dump_write, arg->cbopaque,
-	    "heap_v2/%"FMTu64"\n  t*: ", ((uint64_t)1U << lg_prof_sample));
-	prof_dump_print_cnts(arg->prof_dump_write, arg->cbopaque, cnt_all);
-	arg->prof_dump_write(arg->cbopaque, "\n");
+static prof_tctx_t *
+prof_tctx_snapshot_iter(prof_tctx_tree_t *tctxs, prof_tctx_t *tctx,
+    void *opaque) {
+	prof_dump_snapshot_t *snapshot = (prof_dump_snapshot_t *)opaque;
+	malloc_mutex_assert_owner(snapshot->tsdn, tctx->gctx->lock);
 
-	malloc_mutex_lock(arg->tsdn, &tdatas_mtx);
-	tdata_tree_iter(&tdatas, NULL, prof_tdata_dump_iter, arg);
-	malloc_mutex_unlock(arg->tsdn, &tdatas_mtx);
+	switch (tctx->state) {
+	case prof_tctx_state_initializing:
+	case prof_tctx_state_nominal:
+		/* Not captured by this dump. */
+		break;
+	case prof_tctx_state_dumping:
+	case prof_tctx_state_purgatory: {
+		prof_dump_tctx_rec_t *rec = (prof_dump_tctx_rec_t *)
+		    prof_dump_snapshot_reserve(snapshot,
+		    sizeof(prof_dump_tctx_rec_t));
+		if (rec == NULL) {
+			return tctx;
+		}
+		rec->thr_uid = tctx->thr_uid;
+		rec->cnts = tctx->dump_cnts;
+		/* Looked up only now, since reserving may move the buffer. */
+		prof_dump_gctx_rec_t *gctx_rec = (prof_dump_gctx_rec_t *)
+		    (snapshot->buf + snapshot->gctx_rec_offset);
+		gctx_rec->ntctxs++;
+		break;
+	}
+	default:
+		not_reached();
+	}
+	return NULL;
 }
 
-static void
-prof_dump_gctx(prof_dump_iter_arg_t *arg, prof_gctx_t *gctx,
-    const prof_bt_t *bt, prof_gctx_tree_t *gctxs) {
-	cassert(config_prof);
-	malloc_mutex_assert_owner(arg->tsdn, gctx->lock);
+static prof_gctx_t *
+prof_gctx_snapshot_iter(prof_gctx_tree_t *gctxs, prof_gctx_t *gctx,
+    void *opaque) {
+	prof_dump_snapshot_t *snapshot = (prof_dump_snapshot_t *)opaque;
+	malloc_mutex_lock(snapshot->tsdn, gctx->lock);
 
-	/* Avoid dumping such gctx's that have no useful data. */
-	if ((!opt_prof_accum && gctx->cnt_summed.curobjs == 0) ||
-	    (opt_prof_accum && gctx->cnt_summed.accumobjs == 0)) {
+	/*
+	 * Avoid dumping such gctx's that have no useful data.  A lifetime
+	 * histogram is useful even once all of its objects are gone.
+	 */
+	if (((!opt_prof_accum && gctx->cnt_summed.curobjs == 0) ||
+	    (opt_prof_accum && gctx->cnt_summed.accumobjs == 0)) &&
+	    prof_gctx_lifetimes_empty(gctx)) {
 		assert(gctx->cnt_summed.curobjs == 0);
 		assert(gctx->cnt_summed.curbytes == 0);
 		/*
@@ -964,21 +1255,164 @@ prof_dump_gctx(prof_dump_iter_arg_t *arg, prof_gctx_t *gctx,
 		assert(gctx->cnt_summed.accumobjs_shifted_unbiased == 0);
 		assert(gctx->cnt_summed.accumbytes == 0);
 		assert(gctx->cnt_summed.accumbytes_unbiased == 0);
-		return;
+		malloc_mutex_unlock(snapshot->tsdn, gctx->lock);
+		return NULL;
+	}
+
+	size_t offset = snapshot->size;
+	prof_dump_gctx_rec_t *rec = (prof_dump_gctx_rec_t *)
+	    prof_dump_snapshot_reserve(snapshot, sizeof(prof_dump_gctx_rec_t) +
+	    gctx->bt.len * sizeof(void *));
+	if (rec != NULL) {
+		rec->cnts = gctx->cnt_summed;
+		for (unsigned i = 0; i < PROF_LIFETIME_NBUCKETS; i++) {
+			rec->lifetimes[i] = atomic_load_zu(&gctx->lifetimes[i],
+			    ATOMIC_RELAXED);
+		}
+		rec->len = gctx->bt.len;
+		rec->ntctxs = 0;
+		memcpy(rec + 1, gctx->bt.vec, gctx->bt.len * sizeof(void *));
+		snapshot->gctx_rec_offset = offset;
+		tctx_tree_iter(&gctx->tctxs, NULL, prof_tctx_snapshot_iter,
+		    (void *)snapshot);
+		snapshot->ngctxs++;
+	}
+	malloc_mutex_unlock(snapshot->tsdn, gctx->lock);
+
+	return snapshot->oom ? gctx : NULL;
+}
+
+/*
+ * Takes the snapshot for one dump.  Returns true on OOM, in which case only
+ * cnt_all and leak_ngctx are valid.
+ */
+static bool
+prof_dump_snapshot_take(tsd_t *tsd, prof_tdata_t *tdata,
+    prof_dump_snapshot_t *snapshot) {
+	memset(snapshot, 0, sizeof(prof_dump_snapshot_t));
+	snapshot->tsdn = tsd_tsdn(tsd);
+
+	prof_gctx_tree_t gctxs;
+	prof_dump_prep(tsd, tdata, &snapshot->cnt_all, &snapshot->leak_ngctx,
+	    &gctxs);
+
+	malloc_mutex_lock(tsd_tsdn(tsd), &tdatas_mtx);
+	tdata_tree_iter(&tdatas, NULL, prof_tdata_snapshot_iter,
+	    (void *)snapshot);
+	malloc_mutex_unlock(tsd_tsdn(tsd), &tdatas_mtx);
+	gctx_tree_iter(&gctxs, NULL, prof_gctx_snapshot_iter, (void *)snapshot);
+
+	/* Everything needed is copied; let the gctx's and tctx's go. */
+	prof_gctx_finish(tsd, &gctxs);
+
+	return snapshot->oom;
+}
+
+static void
+prof_dump_snapshot_release(prof_dump_snapshot_t *snapshot) {
+	if (snapshot->buf != NULL) {
+		idalloctm(snapshot->tsdn, snapshot->buf, NULL, NULL, true,
+		    true);
+	}
+}
+
+/*
+ * Returns the gctx record at *cursor, and advances *cursor past it and its
+ * tctx records.
+ */
+static prof_dump_gctx_rec_t *
+prof_dump_snapshot_gctx_next(byte_t **cursor, prof_bt_t *bt,
+    prof_dump_tctx_rec_t **tctx_recs) {
+	prof_dump_gctx_rec_t *rec = (prof_dump_gctx_rec_t *)*cursor;
+	bt->vec = (void **)(rec + 1);
+	bt->len = rec->len;
+	*cursor += prof_dump_snapshot_rec_size(sizeof(prof_dump_gctx_rec_t) +
+	    rec->len * sizeof(void *));
+	*tctx_recs = (prof_dump_tctx_rec_t *)*cursor;
+	*cursor += rec->ntctxs *
+	    prof_dump_snapshot_rec_size(sizeof(prof_dump_tctx_rec_t));
+	return rec;
+}
+
+static void
+prof_dump_snapshot_write(const prof_dump_snapshot_t *snapshot,
+    write_cb_t *prof_dump_write, void *cbopaque) {
+	prof_dump_printf(prof_dump_write, cbopaque,
+	    "heap_v2/%"FMTu64"\n  t*: ", ((uint64_t)1U << lg_prof_sample));
+	prof_dump_print_cnts(prof_dump_write, cbopaque, &snapshot->cnt_all);
+	prof_dump_write(cbopaque, "\n");
+
+	byte_t *cursor = snapshot->buf;
+	for (size_t i = 0; i < snapshot->ntdatas; i++) {
+		prof_dump_tdata_rec_t *rec = (prof_dump_tdata_rec_t *)cursor;
+		cursor += prof_dump_snapshot_rec_size(
+		    sizeof(prof_dump_tdata_rec_t));
+		prof_dump_printf(prof_dump_write, cbopaque, "  t%"FMTu64": ",
+		    rec->thr_uid);
+		prof_dump_print_cnts(prof_dump_write, cbopaque, &rec->cnts);
+		if (rec->thread_name[0] != '\0') {
+			prof_dump_write(cbopaque, " ");
+			prof_dump_write(cbopaque, rec->thread_name);
+		}
+		prof_dump_write(cbopaque, "\n");
 	}
 
-	arg->prof_dump_write(arg->cbopaque, "@");
-	for (unsigned i = 0; i < bt->len; i++) {
-		prof_dump_printf(arg->prof_dump_write, arg->cbopaque,
-		    " %#"FMTxPTR, (uintptr_t)bt->vec[i]);
+	if (opt_prof_stats) {
+		/*
+		 * Estimated totals per allocation tag, for tags that have seen
+		 * any sampled allocations.  jeprof skips these lines.
+		 */
+		tsd_t *tsd = tsdn_tsd(snapshot->tsdn);
+		for (unsigned tag = 0; tag < PROF_ALLOC_NTAGS; tag++) {
+			prof_stats_t live, accum;
+			prof_stats_tag_get_accum(tsd, tag, &accum);
+			if (accum.count == 0) {
+				continue;
+			}
+			prof_stats_tag_get_live(tsd, tag, &live);
+			prof_dump_printf(prof_dump_write, cbopaque,
+			    "  tag%u: %"FMTu64": %"FMTu64" [%"FMTu64": %"FMTu64
+			    "]\n", tag, live.count, live.req_sum, accum.count,
+			    accum.req_sum);
+		}
 	}
 
-	arg->prof_dump_write(arg->cbopaque, "\n  t*: ");
-	prof_dump_print_cnts(arg->prof_dump_write, arg->cbopaque,
-	    &gctx->cnt_summed);
-	arg->prof_dump_write(arg->cbopaque, "\n");
+	for (size_t i = 0; i < snapshot->ngctxs; i++) {
+		prof_bt_t bt;
+		prof_dump_tctx_rec_t *tctx_recs;
+		prof_dump_gctx_rec_t *rec = prof_dump_snapshot_gctx_next(
+		    &cursor, &bt, &tctx_recs);
+
+		prof_dump_write(cbopaque, "@");
+		for (unsigned j = 0; j < bt.len; j++) {
+			prof_dump_printf(prof_dump_write, cbopaque,
+			    " %#"FMTxPTR, (uintptr_t)bt.vec[j]);
+		}
+		prof_dump_write(cbopaque, "\n  t*: ");
+		prof_dump_print_cnts(prof_dump_write, cbopaque, &rec->cnts);
+		prof_dump_write(cbopaque, "\n");
+		if (opt_prof_lifetime) {
+			/* jeprof skips lines it doesn't recognize. */
+			prof_dump_write(cbopaque, "  lifetime:");
+			for (unsigned j = 0; j < PROF_LIFETIME_NBUCKETS; j++) {
+				prof_dump_printf(prof_dump_write, cbopaque,
+				    " %zu", rec->lifetimes[j]);
+			}
+			prof_dump_write(cbopaque, "\n");
+		}
 
-	tctx_tree_iter(&gctx->tctxs, NULL, prof_tctx_dump_iter, arg);
+		for (size_t j = 0; j < rec->ntctxs; j++) {
+			prof_dump_tctx_rec_t *tctx_rec = (prof_dump_tctx_rec_t *)
+			    ((byte_t *)tctx_recs + j *
+			    prof_dump_snapshot_rec_size(
+			    sizeof(prof_dump_tctx_rec_t)));
+			prof_dump_printf(prof_dump_write, cbopaque,
+			    "  t%"FMTu64": ", tctx_rec->thr_uid);
+			prof_dump_print_cnts(prof_dump_write, cbopaque,
+			    &tctx_rec->cnts);
+			prof_dump_write(cbopaque, "\n");
+		}
+	}
 }
 
 /*
@@ -995,14 +1429,27 @@ prof_leakcheck(const prof_cnt_t *cnt_all, size_t leak_ngctx) {
 	 * reports the sums of the scaled values.
 	 */
 	if (cnt_all->curbytes != 0) {
-		double sample_period = (double)((uint64_t)1 << lg_prof_sample);
-		double ratio = (((double)cnt_all->curbytes) /
-		    (double)cnt_all->curobjs) / sample_period;
-		double scale_factor = 1.0 / (1.0 - exp(-ratio));
-		uint64_t curbytes = (uint64_t)round(((double)cnt_all->curbytes)
-		    * scale_factor);
-		uint64_t curobjs = (uint64_t)round(((double)cnt_all->curobjs) *
-		    scale_factor);
+		uint64_t curbytes;
+		uint64_t curobjs;
+		if (opt_prof_sample_target != 0) {
+			/*
+			 * Samples were taken at varying rates, so no single
+			 * scale factor applies; use the per-sample estimates.
+			 */
+			curbytes = cnt_all->curbytes_unbiased;
+			curobjs = cnt_all->curobjs_shifted_unbiased >>
+			    SC_LG_TINY_MIN;
+		} else {
+			double sample_period = (double)((uint64_t)1 <<
+			    lg_prof_sample);
+			double ratio = (((double)cnt_all->curbytes) /
+			    (double)cnt_all->curobjs) / sample_period;
+			double scale_factor = 1.0 / (1.0 - exp(-ratio));
+			curbytes = (uint64_t)round(((double)cnt_all->curbytes)
+			    * scale_factor);
+			curobjs = (uint64_t)round(((double)cnt_all->curobjs) *
+			    scale_factor);
+		}
 
 		malloc_printf("<jemalloc>: Leak approximation summary: ~%"FMTu64
 		    " byte%s, ~%"FMTu64" object%s, >= %zu context%s\n",
@@ -1024,73 +1471,55 @@ prof_leakcheck(const prof_cnt_t *cnt_all, size_t leak_ngctx) {
 #endif
 }
 
-static prof_gctx_t *
-prof_gctx_dump_iter(prof_gctx_tree_t *gctxs, prof_gctx_t *gctx, void *opaque) {
-	prof_dump_iter_arg_t *arg = (prof_dump_iter_arg_t *)opaque;
-	malloc_mutex_lock(arg->tsdn, gctx->lock);
-	prof_dump_gctx(arg, gctx, &gctx->bt, gctxs);
-	malloc_mutex_unlock(arg->tsdn, gctx->lock);
-	return NULL;
-}
-
-static void
-prof_dump_prep(tsd_t *tsd, prof_tdata_t *tdata, prof_cnt_t *cnt_all,
-    size_t *leak_ngctx, prof_gctx_tree_t *gctxs) {
-	size_t tabind;
-	union {
-		prof_gctx_t	*p;
-		void		*v;
-	} gctx;
-
-	prof_enter(tsd, tdata);
-
-	/*
-	 * Put gctx's in limbo and clear their counters in preparation for
-	 * summing.
-	 */
-	gctx_tree_new(gctxs);
-	for (tabind = 0; !ckh_iter(&bt2gctx, &tabind, NULL, &gctx.v);) {
-		prof_dump_gctx_prep(tsd_tsdn(tsd), gctx.p, gctxs);
+bool
+prof_dump_impl(tsd_t *tsd, write_cb_t *prof_dump_write, void *cbopaque,
+    prof_tdata_t *tdata, bool leakcheck) {
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_dump_mtx);
+	prof_dump_snapshot_t snapshot;
+	bool oom = prof_dump_snapshot_take(tsd, tdata, &snapshot);
+	if (!oom) {
+		prof_dump_snapshot_write(&snapshot, prof_dump_write, cbopaque);
 	}
-
-	/*
-	 * Iterate over tdatas, and for the non-expired ones snapshot their tctx
-	 * stats and merge them into the associated gctx's.
-	 */
-	memset(cnt_all, 0, sizeof(prof_cnt_t));
-	prof_tdata_merge_iter_arg_t prof_tdata_merge_iter_arg = {tsd_tsdn(tsd),
-	    cnt_all};
-	malloc_mutex_lock(tsd_tsdn(tsd), &tdatas_mtx);
-	tdata_tree_iter(&tdatas, NULL, prof_tdata_merge_iter,
-	    &prof_tdata_merge_iter_arg);
-	malloc_mutex_unlock(tsd_tsdn(tsd), &tdatas_mtx);
-
-	/* Merge tctx stats into gctx's. */
-	*leak_ngctx = 0;
-	prof_gctx_merge_iter_arg_t prof_gctx_merge_iter_arg = {tsd_tsdn(tsd),
-	    leak_ngctx};
-	gctx_tree_iter(gctxs, NULL, prof_gctx_merge_iter,
-	    &prof_gctx_merge_iter_arg);
-
-	prof_leave(tsd, tdata);
+	prof_dump_snapshot_release(&snapshot);
+	if (leakcheck) {
+		prof_leakcheck(&snapshot.cnt_all, snapshot.leak_ngctx);
+	}
+	return oom;
 }
 
-void
-prof_dump_impl(tsd_t *tsd, write_cb_t *prof_dump_write, void *cbopaque,
+bool
+prof_dump_pprof_impl(tsd_t *tsd, buf_writer_t *buf_writer,
     prof_tdata_t *tdata, bool leakcheck) {
 	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_dump_mtx);
-	prof_cnt_t cnt_all;
-	size_t leak_ngctx;
-	prof_gctx_tree_t gctxs;
-	prof_dump_prep(tsd, tdata, &cnt_all, &leak_ngctx, &gctxs);
-	prof_dump_iter_arg_t prof_dump_iter_arg = {tsd_tsdn(tsd),
-	    prof_dump_write, cbopaque};
-	prof_dump_header(&prof_dump_iter_arg, &cnt_all);
-	gctx_tree_iter(&gctxs, NULL, prof_gctx_dump_iter, &prof_dump_iter_arg);
-	prof_gctx_finish(tsd, &gctxs);
+	prof_dump_snapshot_t snapshot;
+	bool err = prof_dump_snapshot_take(tsd, tdata, &snapshot);
+	prof_pprof_t pprof;
+	if (!err) {
+		err = prof_pprof_begin(tsd, &pprof, buf_writer);
+	}
+	if (!err) {
+		byte_t *cursor = snapshot.buf;
+		cursor += snapshot.ntdatas *
+		    prof_dump_snapshot_rec_size(sizeof(prof_dump_tdata_rec_t));
+		for (size_t i = 0; i < snapshot.ngctxs; i++) {
+			prof_bt_t bt;
+			prof_dump_tctx_rec_t *tctx_recs;
+			prof_dump_gctx_rec_t *rec =
+			    prof_dump_snapshot_gctx_next(&cursor, &bt,
+			    &tctx_recs);
+			if (!opt_prof_accum && rec->cnts.curobjs == 0) {
+				/* Only kept for its lifetime histogram. */
+				continue;
+			}
+			prof_pprof_sample(tsd, &pprof, &bt, &rec->cnts);
+		}
+		prof_pprof_end(tsd, &pprof);
+	}
+	prof_dump_snapshot_release(&snapshot);
 	if (leakcheck) {
-		prof_leakcheck(&cnt_all, leak_ngctx);
+		prof_leakcheck(&snapshot.cnt_all, snapshot.leak_ngctx);
 	}
+	return err;
 }
 
 /* Used in unit tests. */
@@ -1175,6 +1604,11 @@ prof_tdata_init_impl(tsd_t *tsd, uint64_t thr_uid, uint64_t thr_discrim,
 
 	tdata->dumping = false;
 	tdata->active = active;
+	tdata->stack_bounds_fetched = false;
+	tdata->sample_level = atomic_load_u(&prof_sample_level, ATOMIC_RELAXED);
+	tdata->alloc_tag = 0;
+	tdata->stack_lo = 0;
+	tdata->stack_hi = 0;
 
 	malloc_mutex_lock(tsd_tsdn(tsd), &tdatas_mtx);
 	tdata_tree_insert(&tdatas, tdata);
@@ -1281,6 +1715,7 @@ prof_reset(tsd_t *tsd, size_t lg_sample) {
 	malloc_mutex_lock(tsd_tsdn(tsd), &tdatas_mtx);
 
 	lg_prof_sample = lg_sample;
+	atomic_store_u(&prof_sample_level, 0, ATOMIC_RELAXED);
 	prof_unbias_map_init();
 
 	next = NULL;
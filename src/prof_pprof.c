@@ -0,0 +1,437 @@
+#include "jemalloc/internal/jemalloc_preamble.h"
+#include "jemalloc/internal/jemalloc_internal_includes.h"
+
+#include "jemalloc/internal/malloc_io.h"
+#include "jemalloc/internal/prof_data.h"
+#include "jemalloc/internal/prof_pprof.h"
+#include "jemalloc/internal/prof_sys.h"
+
+/*
+ * Field numbers from profile.proto
+ * (https://github.com/google/pprof/blob/main/proto/profile.proto).
+ */
+#define PPROF_PROFILE_SAMPLE_TYPE		1
+#define PPROF_PROFILE_SAMPLE			2
+#define PPROF_PROFILE_MAPPING			3
+#define PPROF_PROFILE_LOCATION			4
+#define PPROF_PROFILE_STRING_TABLE		6
+#define PPROF_PROFILE_PERIOD_TYPE		11
+#define PPROF_PROFILE_PERIOD			12
+#define PPROF_PROFILE_DEFAULT_SAMPLE_TYPE	14
+
+#define PPROF_VALUE_TYPE_TYPE			1
+#define PPROF_VALUE_TYPE_UNIT			2
+
+#define PPROF_SAMPLE_LOCATION_ID		1
+#define PPROF_SAMPLE_VALUE			2
+
+#define PPROF_MAPPING_ID			1
+#define PPROF_MAPPING_MEMORY_START		2
+#define PPROF_MAPPING_MEMORY_LIMIT		3
+#define PPROF_MAPPING_FILE_OFFSET		4
+#define PPROF_MAPPING_FILENAME			5
+
+#define PPROF_LOCATION_ID			1
+#define PPROF_LOCATION_MAPPING_ID		2
+#define PPROF_LOCATION_ADDRESS			3
+
+/* Wire types. */
+#define PPROF_WIRE_VARINT			0
+#define PPROF_WIRE_LEN				2
+
+#define PPROF_VARINT_MAX_SIZE			10
+#define PPROF_NVALUES_MAX			4
+
+/* Long enough for any /proc/<pid>/maps line of interest. */
+#define PPROF_MAPS_LINE_MAX			(PATH_MAX + 128)
+
+/* Protected by prof_dump_mtx. */
+static char prof_pprof_maps_line[PPROF_MAPS_LINE_MAX];
+
+/******************************************************************************/
+/* Protobuf encoding. */
+
+static unsigned
+prof_pprof_varint_size(uint64_t v) {
+	unsigned n = 1;
+	while (v >= 0x80) {
+		v >>= 7;
+		n++;
+	}
+	return n;
+}
+
+static void
+prof_pprof_varint(prof_pprof_t *pprof, uint64_t v) {
+	unsigned char buf[PPROF_VARINT_MAX_SIZE];
+	unsigned n = 0;
+	do {
+		buf[n] = (unsigned char)(v & 0x7f);
+		v >>= 7;
+		if (v != 0) {
+			buf[n] |= 0x80;
+		}
+		n++;
+	} while (v != 0);
+	buf_writer_bytes(pprof->buf_writer, buf, n);
+}
+
+static void
+prof_pprof_key(prof_pprof_t *pprof, unsigned field, unsigned wire_type) {
+	prof_pprof_varint(pprof, ((uint64_t)field << 3) | wire_type);
+}
+
+/* Size of a varint field; fields with value 0 are omitted, as in proto3. */
+static size_t
+prof_pprof_uint_field_size(unsigned field, uint64_t v) {
+	if (v == 0) {
+		return 0;
+	}
+	return prof_pprof_varint_size((uint64_t)field << 3) +
+	    prof_pprof_varint_size(v);
+}
+
+static void
+prof_pprof_uint_field(prof_pprof_t *pprof, unsigned field, uint64_t v) {
+	if (v == 0) {
+		return;
+	}
+	prof_pprof_key(pprof, field, PPROF_WIRE_VARINT);
+	prof_pprof_varint(pprof, v);
+}
+
+static void
+prof_pprof_len_field(prof_pprof_t *pprof, unsigned field, size_t len) {
+	prof_pprof_key(pprof, field, PPROF_WIRE_LEN);
+	prof_pprof_varint(pprof, len);
+}
+
+/* Adds s to the string table, returning its index. */
+static uint64_t
+prof_pprof_string(prof_pprof_t *pprof, const char *s) {
+	size_t len = strlen(s);
+	prof_pprof_len_field(pprof, PPROF_PROFILE_STRING_TABLE, len);
+	buf_writer_bytes(pprof->buf_writer, s, len);
+	return pprof->nstrings++;
+}
+
+static void
+prof_pprof_value_type(prof_pprof_t *pprof, unsigned field, const char *type,
+    const char *unit) {
+	uint64_t type_ind = prof_pprof_string(pprof, type);
+	uint64_t unit_ind = prof_pprof_string(pprof, unit);
+	prof_pprof_len_field(pprof, field,
+	    prof_pprof_uint_field_size(PPROF_VALUE_TYPE_TYPE, type_ind) +
+	    prof_pprof_uint_field_size(PPROF_VALUE_TYPE_UNIT, unit_ind));
+	prof_pprof_uint_field(pprof, PPROF_VALUE_TYPE_TYPE, type_ind);
+	prof_pprof_uint_field(pprof, PPROF_VALUE_TYPE_UNIT, unit_ind);
+}
+
+/******************************************************************************/
+/* Mappings. */
+
+static void *
+prof_pprof_alloc(tsd_t *tsd, size_t size) {
+	return iallocztm(tsd_tsdn(tsd), size, sz_size2index(size), false, NULL,
+	    true, arena_get(TSDN_NULL, 0, true), true);
+}
+
+static void
+prof_pprof_dalloc(tsd_t *tsd, void *ptr) {
+	idalloctm(tsd_tsdn(tsd), ptr, NULL, NULL, true, true);
+}
+
+static bool
+prof_pprof_mapping_record(tsd_t *tsd, prof_pprof_t *pprof, uintptr_t start,
+    uintptr_t limit) {
+	if (pprof->nmappings == pprof->mappings_cap) {
+		size_t cap = pprof->mappings_cap == 0 ? 64 :
+		    pprof->mappings_cap * 2;
+		prof_pprof_mapping_t *mappings = (prof_pprof_mapping_t *)
+		    prof_pprof_alloc(tsd, cap * sizeof(prof_pprof_mapping_t));
+		if (mappings == NULL) {
+			return true;
+		}
+		if (pprof->mappings != NULL) {
+			memcpy(mappings, pprof->mappings, pprof->nmappings *
+			    sizeof(prof_pprof_mapping_t));
+			prof_pprof_dalloc(tsd, pprof->mappings);
+		}
+		pprof->mappings = mappings;
+		pprof->mappings_cap = cap;
+	}
+	pprof->mappings[pprof->nmappings].start = start;
+	pprof->mappings[pprof->nmappings].limit = limit;
+	pprof->nmappings++;
+	return false;
+}
+
+static const char *
+prof_pprof_skip_field(const char *s) {
+	while (*s == ' ') {
+		s++;
+	}
+	while (*s != ' ' && *s != '\0') {
+		s++;
+	}
+	return s;
+}
+
+/*
+ * Parses one line of the form
+ *   <start>-<limit> <perms> <offset> <dev> <inode> [<path>]
+ * and writes a Mapping for it if it is executable.
+ */
+static void
+prof_pprof_mapping(tsd_t *tsd, prof_pprof_t *pprof, const char *line) {
+	char *end;
+	uintptr_t start = (uintptr_t)malloc_strtoumax(line, &end, 16);
+	if (*end != '-') {
+		return;
+	}
+	uintptr_t limit = (uintptr_t)malloc_strtoumax(end + 1, &end, 16);
+	if (*end != ' ' || limit <= start) {
+		return;
+	}
+	const char *perms = end + 1;
+	if (strlen(perms) < 5 || perms[2] != 'x' || perms[4] != ' ') {
+		return;
+	}
+	uint64_t offset = (uint64_t)malloc_strtoumax(perms + 5, &end, 16);
+	if (*end != ' ') {
+		return;
+	}
+	/* Skip the device and inode. */
+	const char *path = prof_pprof_skip_field(prof_pprof_skip_field(end));
+	while (*path == ' ') {
+		path++;
+	}
+	/* Mapping ids are positions in pprof->mappings; keep those sorted. */
+	if (pprof->nmappings > 0 &&
+	    start < pprof->mappings[pprof->nmappings - 1].limit) {
+		return;
+	}
+	if (prof_pprof_mapping_record(tsd, pprof, start, limit)) {
+		return;
+	}
+
+	uint64_t id = pprof->nmappings;
+	uint64_t filename = *path == '\0' ? 0 : prof_pprof_string(pprof, path);
+	prof_pprof_len_field(pprof, PPROF_PROFILE_MAPPING,
+	    prof_pprof_uint_field_size(PPROF_MAPPING_ID, id) +
+	    prof_pprof_uint_field_size(PPROF_MAPPING_MEMORY_START, start) +
+	    prof_pprof_uint_field_size(PPROF_MAPPING_MEMORY_LIMIT, limit) +
+	    prof_pprof_uint_field_size(PPROF_MAPPING_FILE_OFFSET, offset) +
+	    prof_pprof_uint_field_size(PPROF_MAPPING_FILENAME, filename));
+	prof_pprof_uint_field(pprof, PPROF_MAPPING_ID, id);
+	prof_pprof_uint_field(pprof, PPROF_MAPPING_MEMORY_START, start);
+	prof_pprof_uint_field(pprof, PPROF_MAPPING_MEMORY_LIMIT, limit);
+	prof_pprof_uint_field(pprof, PPROF_MAPPING_FILE_OFFSET, offset);
+	prof_pprof_uint_field(pprof, PPROF_MAPPING_FILENAME, filename);
+}
+
+static void
+prof_pprof_mappings(tsd_t *tsd, prof_pprof_t *pprof) {
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_dump_mtx);
+
+	if (prof_dump_open_maps == NULL) {
+		return;
+	}
+	int mfd = prof_dump_open_maps();
+	if (mfd == -1) {
+		return;
+	}
+
+	char buf[512];
+	char *line = prof_pprof_maps_line;
+	size_t linelen = 0;
+	bool truncated = false;
+	ssize_t nread;
+	while ((nread = malloc_read_fd(mfd, buf, sizeof(buf))) > 0) {
+		for (ssize_t i = 0; i < nread; i++) {
+			if (buf[i] == '\n') {
+				line[linelen] = '\0';
+				if (!truncated) {
+					prof_pprof_mapping(tsd, pprof, line);
+				}
+				linelen = 0;
+				truncated = false;
+			} else if (linelen < PPROF_MAPS_LINE_MAX - 1) {
+				line[linelen++] = buf[i];
+			} else {
+				truncated = true;
+			}
+		}
+	}
+	if (linelen > 0 && !truncated) {
+		line[linelen] = '\0';
+		prof_pprof_mapping(tsd, pprof, line);
+	}
+	close(mfd);
+}
+
+static uint64_t
+prof_pprof_mapping_id(prof_pprof_t *pprof, uintptr_t addr) {
+	size_t lo = 0;
+	size_t hi = pprof->nmappings;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		const prof_pprof_mapping_t *mapping = &pprof->mappings[mid];
+		if (addr < mapping->start) {
+			hi = mid;
+		} else if (addr >= mapping->limit) {
+			lo = mid + 1;
+		} else {
+			return mid + 1;
+		}
+	}
+	return 0;
+}
+
+/******************************************************************************/
+/* Locations and samples. */
+
+/* Returns the id of the location for addr, writing it out if it's new. */
+static uint64_t
+prof_pprof_location(tsd_t *tsd, prof_pprof_t *pprof, uintptr_t addr) {
+	void *data;
+	if (!ckh_search(&pprof->locations, (void *)addr, NULL, &data)) {
+		return (uint64_t)(uintptr_t)data;
+	}
+
+	uint64_t id = ++pprof->nlocations;
+	/*
+	 * On OOM the location is written again when next seen, which consumers
+	 * tolerate; it just makes the profile bigger.
+	 */
+	ckh_insert(tsd, &pprof->locations, (void *)addr,
+	    (void *)(uintptr_t)id);
+
+	uint64_t mapping_id = prof_pprof_mapping_id(pprof, addr);
+	prof_pprof_len_field(pprof, PPROF_PROFILE_LOCATION,
+	    prof_pprof_uint_field_size(PPROF_LOCATION_ID, id) +
+	    prof_pprof_uint_field_size(PPROF_LOCATION_MAPPING_ID, mapping_id) +
+	    prof_pprof_uint_field_size(PPROF_LOCATION_ADDRESS, addr));
+	prof_pprof_uint_field(pprof, PPROF_LOCATION_ID, id);
+	prof_pprof_uint_field(pprof, PPROF_LOCATION_MAPPING_ID, mapping_id);
+	prof_pprof_uint_field(pprof, PPROF_LOCATION_ADDRESS, addr);
+	return id;
+}
+
+static uint64_t
+prof_pprof_objs(uint64_t shifted_unbiased) {
+	return (shifted_unbiased + (ZU(1) << (SC_LG_TINY_MIN - 1))) >>
+	    SC_LG_TINY_MIN;
+}
+
+bool
+prof_pprof_begin(tsd_t *tsd, prof_pprof_t *pprof, buf_writer_t *buf_writer) {
+	cassert(config_prof);
+
+	pprof->buf_writer = buf_writer;
+	pprof->nstrings = 0;
+	pprof->mappings = NULL;
+	pprof->nmappings = 0;
+	pprof->mappings_cap = 0;
+	pprof->nlocations = 0;
+	pprof->location_ids = (uint64_t *)prof_pprof_alloc(tsd,
+	    opt_prof_bt_max * sizeof(uint64_t));
+	if (pprof->location_ids == NULL) {
+		return true;
+	}
+	if (ckh_new(tsd, &pprof->locations, PROF_CKH_MINITEMS,
+	    ckh_pointer_hash, ckh_pointer_keycomp)) {
+		prof_pprof_dalloc(tsd, pprof->location_ids);
+		return true;
+	}
+
+	/* The string table must start with "". */
+	prof_pprof_string(pprof, "");
+	if (opt_prof_accum) {
+		prof_pprof_value_type(pprof, PPROF_PROFILE_SAMPLE_TYPE,
+		    "alloc_objects", "count");
+		prof_pprof_value_type(pprof, PPROF_PROFILE_SAMPLE_TYPE,
+		    "alloc_space", "bytes");
+	}
+	prof_pprof_value_type(pprof, PPROF_PROFILE_SAMPLE_TYPE,
+	    "inuse_objects", "count");
+	prof_pprof_value_type(pprof, PPROF_PROFILE_SAMPLE_TYPE,
+	    "inuse_space", "bytes");
+	uint64_t default_type = pprof->nstrings - 2;
+	prof_pprof_uint_field(pprof, PPROF_PROFILE_DEFAULT_SAMPLE_TYPE,
+	    default_type);
+	prof_pprof_value_type(pprof, PPROF_PROFILE_PERIOD_TYPE, "space",
+	    "bytes");
+	prof_pprof_uint_field(pprof, PPROF_PROFILE_PERIOD,
+	    (uint64_t)1 << lg_prof_sample);
+
+	prof_pprof_mappings(tsd, pprof);
+	return false;
+}
+
+/*
+ * Writes one sample.  Values are the unbiased estimates of the true counts,
+ * since pprof consumers know nothing about jemalloc's sampling.
+ */
+void
+prof_pprof_sample(tsd_t *tsd, prof_pprof_t *pprof, const prof_bt_t *bt,
+    const prof_cnt_t *cnts) {
+	cassert(config_prof);
+	assert(bt->len <= opt_prof_bt_max);
+
+	size_t locations_size = 0;
+	for (unsigned i = 0; i < bt->len; i++) {
+		/*
+		 * Backtraces hold return addresses; like jeprof, point all but
+		 * the first frame back into the call instruction.
+		 */
+		uintptr_t addr = (uintptr_t)bt->vec[i] - (i == 0 ? 0 : 1);
+		pprof->location_ids[i] = prof_pprof_location(tsd, pprof, addr);
+		locations_size += prof_pprof_varint_size(
+		    pprof->location_ids[i]);
+	}
+
+	uint64_t values[PPROF_NVALUES_MAX];
+	unsigned nvalues = 0;
+	if (opt_prof_accum) {
+		values[nvalues++] = prof_pprof_objs(
+		    cnts->accumobjs_shifted_unbiased);
+		values[nvalues++] = cnts->accumbytes_unbiased;
+	}
+	values[nvalues++] = prof_pprof_objs(cnts->curobjs_shifted_unbiased);
+	values[nvalues++] = cnts->curbytes_unbiased;
+	size_t values_size = 0;
+	for (unsigned i = 0; i < nvalues; i++) {
+		values_size += prof_pprof_varint_size(values[i]);
+	}
+
+	size_t sample_size = 1 + prof_pprof_varint_size(values_size) +
+	    values_size;
+	if (bt->len > 0) {
+		sample_size += 1 + prof_pprof_varint_size(locations_size) +
+		    locations_size;
+	}
+	prof_pprof_len_field(pprof, PPROF_PROFILE_SAMPLE, sample_size);
+	if (bt->len > 0) {
+		prof_pprof_len_field(pprof, PPROF_SAMPLE_LOCATION_ID,
+		    locations_size);
+		for (unsigned i = 0; i < bt->len; i++) {
+			prof_pprof_varint(pprof, pprof->location_ids[i]);
+		}
+	}
+	prof_pprof_len_field(pprof, PPROF_SAMPLE_VALUE, values_size);
+	for (unsigned i = 0; i < nvalues; i++) {
+		prof_pprof_varint(pprof, values[i]);
+	}
+}
+
+void
+prof_pprof_end(tsd_t *tsd, prof_pprof_t *pprof) {
+	cassert(config_prof);
+
+	ckh_delete(tsd, &pprof->locations);
+	prof_pprof_dalloc(tsd, pprof->location_ids);
+	if (pprof->mappings != NULL) {
+		prof_pprof_dalloc(tsd, pprof->mappings);
+	}
+}
@@ -6,12 +6,43 @@
 #include "jemalloc/internal/emitter.h"
 #include "jemalloc/internal/prof_data.h"
 #include "jemalloc/internal/prof_recent.h"
+#include "jemalloc/internal/spin.h"
+
+/*
+ * The recent allocation records live in a fixed-capacity ring.  A sampled
+ * allocation takes the next ticket t from the ring and writes its record into
+ * slot t % cap, evicting the record of ticket t - cap; no lock is taken and
+ * nothing is allocated on the way.  The seq field of a slot tells which ticket
+ * the slot holds and doubles as a per-slot spin lock:
+ *
+ *   0                                never written;
+ *   PROF_RECENT_SEQ(t)               holds the record of ticket t;
+ *   PROF_RECENT_SEQ(t) | SEQ_BUSY    being written, either by the owner of
+ *                                    ticket t, or by a thread updating or
+ *                                    reading the record of ticket t.
+ *
+ * The writer of ticket t waits for the slot to reach PROF_RECENT_SEQ(t - cap),
+ * so that each slot is written in ticket order.  A ring smaller than
+ * prof_recent_alloc_max is never wrapped around; a writer drawing a ticket
+ * past its end rebuilds it at twice the size instead.
+ *
+ * Replacing the ring -- to grow it, to apply a new max, or to take it aside
+ * for dumping -- is serialized by prof_recent_alloc_mtx, and first waits for
+ * all threads to leave the ring (see prof_recent_block()), after which the
+ * slots can be accessed freely.  Threads in the ring never block on a lock.
+ */
+#define PROF_RECENT_SEQ(t) (((t) + 1) << 1)
+#define PROF_RECENT_SEQ_BUSY ((size_t)1)
+/* Initial capacity of a ring below prof_recent_alloc_max. */
+#define PROF_RECENT_RING_CAP_MIN 64
 
 ssize_t opt_prof_recent_alloc_max = PROF_RECENT_ALLOC_MAX_DEFAULT;
-malloc_mutex_t prof_recent_alloc_mtx; /* Protects the fields below */
+malloc_mutex_t prof_recent_alloc_mtx; /* Serializes ring replacement. */
 static atomic_zd_t prof_recent_alloc_max;
-static ssize_t prof_recent_alloc_count = 0;
-prof_recent_list_t prof_recent_alloc_list;
+static atomic_p_t prof_recent_ring;
+/* Number of threads accessing the ring; see prof_recent_enter(). */
+static atomic_zu_t prof_recent_nusers;
+static atomic_b_t prof_recent_blocked;
 
 malloc_mutex_t prof_recent_dump_mtx; /* Protects dumping. */
 
@@ -40,18 +71,136 @@ prof_recent_alloc_max_update(tsd_t *tsd, ssize_t max) {
 	return old_max;
 }
 
-static prof_recent_t *
-prof_recent_allocate_node(tsdn_t *tsdn) {
-	return (prof_recent_t *)iallocztm(tsdn, sizeof(prof_recent_t),
-	    sz_size2index(sizeof(prof_recent_t)), false, NULL, true,
-	    arena_get(tsdn, 0, false), true);
+static prof_recent_ring_t *
+prof_recent_ring_new(tsdn_t *tsdn, size_t cap) {
+	assert(cap > 0);
+	if (cap > (SC_LARGE_MAXCLASS - sizeof(prof_recent_ring_t)) /
+	    sizeof(prof_recent_t)) {
+		return NULL;
+	}
+	size_t size = sizeof(prof_recent_ring_t) + cap * sizeof(prof_recent_t);
+	prof_recent_ring_t *ring = (prof_recent_ring_t *)iallocztm(tsdn, size,
+	    sz_size2index(size), true, NULL, true, arena_get(tsdn, 0, false),
+	    true);
+	if (ring == NULL) {
+		return NULL;
+	}
+	atomic_store_zu(&ring->next, 0, ATOMIC_RELAXED);
+	ring->cap = cap;
+	ring->limit = -1;
+	ring->slots = (prof_recent_t *)(ring + 1);
+	return ring;
+}
+
+static void
+prof_recent_ring_free(tsdn_t *tsdn, prof_recent_ring_t *ring) {
+	assert(ring != NULL);
+	idalloctm(tsdn, ring, NULL, NULL, true, true);
+}
+
+static inline bool
+prof_recent_ring_full(const prof_recent_ring_t *ring) {
+	return ring->limit != -1 && ring->cap == (size_t)ring->limit;
+}
+
+static inline prof_recent_t *
+prof_recent_ring_slot(prof_recent_ring_t *ring, size_t t) {
+	return &ring->slots[t % ring->cap];
 }
 
+/* Tickets of the records in the ring, oldest first, are [*lo, *hi). */
 static void
-prof_recent_free_node(tsdn_t *tsdn, prof_recent_t *node) {
-	assert(node != NULL);
-	assert(isalloc(tsdn, node) == sz_s2u(sizeof(prof_recent_t)));
-	idalloctm(tsdn, node, NULL, NULL, true, true);
+prof_recent_ring_window(const prof_recent_ring_t *ring, size_t *lo,
+    size_t *hi) {
+	size_t next = atomic_load_zu(&ring->next, ATOMIC_ACQUIRE);
+	if (next <= ring->cap) {
+		*lo = 0;
+		*hi = next;
+	} else if (prof_recent_ring_full(ring)) {
+		*lo = next - ring->cap;
+		*hi = next;
+	} else {
+		/* Tickets past the end of a growing ring are never used. */
+		*lo = 0;
+		*hi = ring->cap;
+	}
+}
+
+static size_t
+prof_recent_ring_count(const prof_recent_ring_t *ring) {
+	if (ring == NULL) {
+		return 0;
+	}
+	size_t lo, hi;
+	prof_recent_ring_window(ring, &lo, &hi);
+	return hi - lo;
+}
+
+/*
+ * Any access to the slots of the current ring, or of a ring set aside for
+ * dumping, happens between prof_recent_enter() and prof_recent_exit().
+ */
+static void
+prof_recent_enter(tsd_t *tsd) {
+	malloc_mutex_assert_not_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	while (true) {
+		atomic_fetch_add_zu(&prof_recent_nusers, 1, ATOMIC_SEQ_CST);
+		if (!atomic_load_b(&prof_recent_blocked, ATOMIC_SEQ_CST)) {
+			return;
+		}
+		atomic_fetch_sub_zu(&prof_recent_nusers, 1, ATOMIC_RELEASE);
+		/* Wait out whoever is replacing the ring. */
+		malloc_mutex_lock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+		malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	}
+}
+
+static void
+prof_recent_exit(void) {
+	atomic_fetch_sub_zu(&prof_recent_nusers, 1, ATOMIC_RELEASE);
+}
+
+/* Keeps everybody out of the ring until prof_recent_unblock(). */
+static void
+prof_recent_block(tsdn_t *tsdn) {
+	malloc_mutex_assert_owner(tsdn, &prof_recent_alloc_mtx);
+	atomic_store_b(&prof_recent_blocked, true, ATOMIC_SEQ_CST);
+	spin_t spinner = SPIN_INITIALIZER;
+	while (atomic_load_zu(&prof_recent_nusers, ATOMIC_SEQ_CST) != 0) {
+		spin_adaptive(&spinner);
+	}
+}
+
+static void
+prof_recent_unblock(tsdn_t *tsdn) {
+	malloc_mutex_assert_owner(tsdn, &prof_recent_alloc_mtx);
+	atomic_store_b(&prof_recent_blocked, false, ATOMIC_SEQ_CST);
+}
+
+/*
+ * Locks a slot holding a record, returning the seq to hand back to
+ * prof_recent_slot_unlock().
+ */
+static size_t
+prof_recent_slot_lock(prof_recent_t *n) {
+	spin_t spinner = SPIN_INITIALIZER;
+	while (true) {
+		size_t seq = atomic_load_zu(&n->seq, ATOMIC_RELAXED);
+		assert(seq != 0);
+		if ((seq & PROF_RECENT_SEQ_BUSY) == 0 &&
+		    atomic_compare_exchange_weak_zu(&n->seq, &seq,
+		    seq | PROF_RECENT_SEQ_BUSY, ATOMIC_ACQUIRE,
+		    ATOMIC_RELAXED)) {
+			return seq;
+		}
+		spin_adaptive(&spinner);
+	}
+}
+
+static void
+prof_recent_slot_unlock(prof_recent_t *n, size_t seq) {
+	assert((seq & PROF_RECENT_SEQ_BUSY) == 0);
+	atomic_store_zu(&n->seq, seq, ATOMIC_RELEASE);
 }
 
 static inline void
@@ -68,13 +217,7 @@ prof_recent_alloc_prepare(tsd_t *tsd, prof_tctx_t *tctx) {
 	malloc_mutex_assert_owner(tsd_tsdn(tsd), tctx->tdata->lock);
 	malloc_mutex_assert_not_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
 
-	/*
-	 * Check whether last-N mode is turned on without trying to acquire the
-	 * lock, so as to optimize for the following two scenarios:
-	 * (1) Last-N mode is switched off;
-	 * (2) Dumping, during which last-N mode is temporarily turned off so
-	 *     as not to block sampled allocations.
-	 */
+	/* Check whether last-N mode is turned on. */
 	if (prof_recent_alloc_max_get_no_lock() == 0) {
 		return false;
 	}
@@ -82,9 +225,8 @@ prof_recent_alloc_prepare(tsd_t *tsd, prof_tctx_t *tctx) {
 	/*
 	 * Increment recent_count to hold the tctx so that it won't be gone
 	 * even after tctx->tdata->lock is released.  This acts as a
-	 * "placeholder"; the real recording of the allocation requires a lock
-	 * on prof_recent_alloc_mtx and is done in prof_recent_alloc (when
-	 * tctx->tdata->lock has been released).
+	 * "placeholder"; the real recording of the allocation is done in
+	 * prof_recent_alloc (when tctx->tdata->lock has been released).
 	 */
 	increment_recent_count(tsd, tctx);
 	return true;
@@ -111,18 +253,6 @@ prof_recent_alloc_edata_get_no_lock_test(const prof_recent_t *n) {
 	return prof_recent_alloc_edata_get_no_lock(n);
 }
 
-static inline edata_t *
-prof_recent_alloc_edata_get(tsd_t *tsd, const prof_recent_t *n) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	return prof_recent_alloc_edata_get_no_lock(n);
-}
-
-static void
-prof_recent_alloc_edata_set(tsd_t *tsd, prof_recent_t *n, edata_t *edata) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	atomic_store_p(&n->alloc_edata, edata, ATOMIC_RELEASE);
-}
-
 void
 edata_prof_recent_alloc_init(edata_t *edata) {
 	cassert(config_prof);
@@ -141,47 +271,36 @@ edata_prof_recent_alloc_get_no_lock_test(const edata_t *edata) {
 	return edata_prof_recent_alloc_get_no_lock(edata);
 }
 
-static inline prof_recent_t *
-edata_prof_recent_alloc_get(tsd_t *tsd, const edata_t *edata) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	prof_recent_t *recent_alloc =
-	    edata_prof_recent_alloc_get_no_lock(edata);
-	assert(recent_alloc == NULL ||
-	    prof_recent_alloc_edata_get(tsd, recent_alloc) == edata);
-	return recent_alloc;
-}
-
-static prof_recent_t *
-edata_prof_recent_alloc_update_internal(tsd_t *tsd, edata_t *edata,
-    prof_recent_t *recent_alloc) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	prof_recent_t *old_recent_alloc =
-	    edata_prof_recent_alloc_get(tsd, edata);
-	edata_prof_recent_alloc_set_dont_call_directly(edata, recent_alloc);
-	return old_recent_alloc;
+/* Links the record in n and the allocation edata to each other. */
+static void
+prof_recent_alloc_link(prof_recent_t *n, edata_t *edata) {
+	atomic_store_p(&n->alloc_edata, edata, ATOMIC_RELEASE);
+	if (edata != NULL) {
+		edata_prof_recent_alloc_set_dont_call_directly(edata, n);
+	}
 }
 
+/* Unlinks the record in n from its allocation, if still alive. */
 static void
-edata_prof_recent_alloc_set(tsd_t *tsd, edata_t *edata,
-    prof_recent_t *recent_alloc) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	assert(recent_alloc != NULL);
-	prof_recent_t *old_recent_alloc =
-	    edata_prof_recent_alloc_update_internal(tsd, edata, recent_alloc);
-	assert(old_recent_alloc == NULL);
-	prof_recent_alloc_edata_set(tsd, recent_alloc, edata);
+prof_recent_alloc_unlink(prof_recent_t *n) {
+	edata_t *edata = prof_recent_alloc_edata_get_no_lock(n);
+	if (edata != NULL) {
+		assert(edata_prof_recent_alloc_get_no_lock(edata) == n);
+		edata_prof_recent_alloc_set_dont_call_directly(edata, NULL);
+		atomic_store_p(&n->alloc_edata, NULL, ATOMIC_RELEASE);
+	}
 }
 
 static void
-edata_prof_recent_alloc_reset(tsd_t *tsd, edata_t *edata,
-    prof_recent_t *recent_alloc) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	assert(recent_alloc != NULL);
-	prof_recent_t *old_recent_alloc =
-	    edata_prof_recent_alloc_update_internal(tsd, edata, NULL);
-	assert(old_recent_alloc == recent_alloc);
-	assert(edata == prof_recent_alloc_edata_get(tsd, recent_alloc));
-	prof_recent_alloc_edata_set(tsd, recent_alloc, NULL);
+prof_recent_alloc_copy(prof_recent_t *dst, const prof_recent_t *src) {
+	nstime_copy(&dst->alloc_time, &src->alloc_time);
+	nstime_copy(&dst->dalloc_time, &src->dalloc_time);
+	dst->size = src->size;
+	dst->usize = src->usize;
+	atomic_store_p(&dst->alloc_edata,
+	    prof_recent_alloc_edata_get_no_lock(src), ATOMIC_RELAXED);
+	dst->alloc_tctx = src->alloc_tctx;
+	dst->dalloc_tctx = src->dalloc_tctx;
 }
 
 /*
@@ -197,7 +316,7 @@ prof_recent_alloc_reset(tsd_t *tsd, edata_t *edata) {
 	cassert(config_prof);
 	/*
 	 * Check whether the recent allocation record still exists without
-	 * trying to acquire the lock.
+	 * entering the ring.
 	 */
 	if (edata_prof_recent_alloc_get_no_lock(edata) == NULL) {
 		return;
@@ -207,7 +326,7 @@ prof_recent_alloc_reset(tsd_t *tsd, edata_t *edata) {
 	/*
 	 * In case dalloc_tctx is NULL, e.g. due to OOM, we will not record the
 	 * deallocation time / tctx, which is handled later, after we check
-	 * again when holding the lock.
+	 * again when holding the record.
 	 */
 
 	if (dalloc_tctx != NULL) {
@@ -217,172 +336,275 @@ prof_recent_alloc_reset(tsd_t *tsd, edata_t *edata) {
 		malloc_mutex_unlock(tsd_tsdn(tsd), dalloc_tctx->tdata->lock);
 	}
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	/* Check again after acquiring the lock.  */
-	prof_recent_t *recent = edata_prof_recent_alloc_get(tsd, edata);
-	if (recent != NULL) {
-		assert(nstime_equals_zero(&recent->dalloc_time));
-		assert(recent->dalloc_tctx == NULL);
-		if (dalloc_tctx != NULL) {
-			nstime_prof_update(&recent->dalloc_time);
-			recent->dalloc_tctx = dalloc_tctx;
-			dalloc_tctx = NULL;
+	prof_recent_enter(tsd);
+	prof_recent_t *n;
+	while ((n = edata_prof_recent_alloc_get_no_lock(edata)) != NULL) {
+		size_t seq = prof_recent_slot_lock(n);
+		/* Check again now that the record can't change. */
+		if (prof_recent_alloc_edata_get_no_lock(n) == edata) {
+			assert(nstime_equals_zero(&n->dalloc_time));
+			assert(n->dalloc_tctx == NULL);
+			if (dalloc_tctx != NULL) {
+				nstime_prof_update(&n->dalloc_time);
+				n->dalloc_tctx = dalloc_tctx;
+				dalloc_tctx = NULL;
+			}
+			prof_recent_alloc_unlink(n);
+			prof_recent_slot_unlock(n, seq);
+			break;
 		}
-		edata_prof_recent_alloc_reset(tsd, edata, recent);
+		/* The record was just evicted, which unlinked edata. */
+		prof_recent_slot_unlock(n, seq);
 	}
-	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	prof_recent_exit();
 
 	if (dalloc_tctx != NULL) {
-		/* We lost the rase - the allocation record was just gone. */
+		/* We lost the race - the allocation record was just gone. */
 		decrement_recent_count(tsd, dalloc_tctx);
 	}
 }
 
+/*
+ * Writes the record of ticket t, handing back the tctxs of the record it
+ * evicts, if any.
+ */
 static void
-prof_recent_alloc_evict_edata(tsd_t *tsd, prof_recent_t *recent_alloc) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	edata_t *edata = prof_recent_alloc_edata_get(tsd, recent_alloc);
-	if (edata != NULL) {
-		edata_prof_recent_alloc_reset(tsd, edata, recent_alloc);
+prof_recent_ring_put(prof_recent_ring_t *ring, size_t t, edata_t *edata,
+    size_t size, size_t usize, prof_tctx_t **old_alloc_tctx,
+    prof_tctx_t **old_dalloc_tctx) {
+	prof_recent_t *n = prof_recent_ring_slot(ring, t);
+	size_t prev = t < ring->cap ? 0 : PROF_RECENT_SEQ(t - ring->cap);
+	spin_t spinner = SPIN_INITIALIZER;
+	while (true) {
+		size_t seq = prev;
+		if (atomic_compare_exchange_weak_zu(&n->seq, &seq,
+		    PROF_RECENT_SEQ(t) | PROF_RECENT_SEQ_BUSY, ATOMIC_ACQUIRE,
+		    ATOMIC_RELAXED)) {
+			break;
+		}
+		/* The writer of the previous lap is yet to finish. */
+		spin_adaptive(&spinner);
 	}
+
+	if (prev != 0) {
+		*old_alloc_tctx = n->alloc_tctx;
+		assert(*old_alloc_tctx != NULL);
+		*old_dalloc_tctx = n->dalloc_tctx;
+		prof_recent_alloc_unlink(n);
+	}
+
+	n->size = size;
+	n->usize = usize;
+	nstime_copy(&n->alloc_time, edata_prof_alloc_time_get(edata));
+	n->alloc_tctx = edata_prof_tctx_get(edata);
+	nstime_init_zero(&n->dalloc_time);
+	n->dalloc_tctx = NULL;
+	assert(edata_prof_recent_alloc_get_no_lock(edata) == NULL);
+	prof_recent_alloc_link(n, edata);
+	prof_recent_slot_unlock(n, PROF_RECENT_SEQ(t));
 }
 
-static bool
-prof_recent_alloc_is_empty(tsd_t *tsd) {
+/*
+ * Moves the records of from over to the end of to (which may be NULL), after
+ * evicting the first *skip of them.  The tctxs of the evicted records stay in
+ * from, to be released by prof_recent_ring_destroy().
+ */
+static void
+prof_recent_ring_move(prof_recent_ring_t *from, prof_recent_ring_t *to,
+    size_t *skip) {
+	size_t lo, hi;
+	prof_recent_ring_window(from, &lo, &hi);
+	for (size_t t = lo; t < hi; ++t) {
+		prof_recent_t *n = prof_recent_ring_slot(from, t);
+		assert(atomic_load_zu(&n->seq, ATOMIC_RELAXED) ==
+		    PROF_RECENT_SEQ(t));
+		if (*skip > 0) {
+			--*skip;
+			prof_recent_alloc_unlink(n);
+			continue;
+		}
+		assert(to != NULL);
+		size_t i = atomic_load_zu(&to->next, ATOMIC_RELAXED);
+		assert(i < to->cap);
+		prof_recent_t *m = &to->slots[i];
+		prof_recent_alloc_copy(m, n);
+		prof_recent_alloc_link(m, prof_recent_alloc_edata_get_no_lock(n));
+		atomic_store_zu(&m->seq, PROF_RECENT_SEQ(i), ATOMIC_RELAXED);
+		atomic_store_zu(&to->next, i + 1, ATOMIC_RELAXED);
+		atomic_store_p(&n->alloc_edata, NULL, ATOMIC_RELAXED);
+		n->alloc_tctx = NULL;
+		n->dalloc_tctx = NULL;
+	}
+}
+
+/*
+ * Makes to (which may be NULL) the current ring, carrying over the records of
+ * other (which may also be NULL) followed by those of the current ring, and
+ * evicting the oldest ones that don't fit.  Returns the replaced ring.  Both
+ * it and other are to be destroyed once prof_recent_alloc_mtx is released.
+ */
+static prof_recent_ring_t *
+prof_recent_ring_replace(tsd_t *tsd, prof_recent_ring_t *to,
+    prof_recent_ring_t *other) {
 	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	if (ql_empty(&prof_recent_alloc_list)) {
-		assert(prof_recent_alloc_count == 0);
-		return true;
-	} else {
-		assert(prof_recent_alloc_count > 0);
-		return false;
+	ssize_t max = prof_recent_alloc_max_get(tsd);
+	assert(to == NULL || max != 0);
+	prof_recent_block(tsd_tsdn(tsd));
+
+	prof_recent_ring_t *from = (prof_recent_ring_t *)atomic_load_p(
+	    &prof_recent_ring, ATOMIC_RELAXED);
+	size_t count = prof_recent_ring_count(other) +
+	    prof_recent_ring_count(from);
+	size_t skip = count;
+	if (to != NULL) {
+		if (max != -1 && to->cap > (size_t)max) {
+			to->cap = (size_t)max;
+		}
+		to->limit = max;
+		skip = count > to->cap ? count - to->cap : 0;
+	}
+	if (other != NULL) {
+		prof_recent_ring_move(other, to, &skip);
 	}
+	if (from != NULL) {
+		prof_recent_ring_move(from, to, &skip);
+	}
+	assert(skip == 0);
+
+	atomic_store_p(&prof_recent_ring, to, ATOMIC_RELEASE);
+	prof_recent_unblock(tsd_tsdn(tsd));
+	return from;
 }
 
+/* Releases the tctxs of the records left in a replaced ring, and the ring. */
 static void
-prof_recent_alloc_assert_count(tsd_t *tsd) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	if (!config_debug) {
+prof_recent_ring_destroy(tsd_t *tsd, prof_recent_ring_t *ring) {
+	malloc_mutex_assert_not_owner(tsd_tsdn(tsd), &prof_recent_dump_mtx);
+	malloc_mutex_assert_not_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	if (ring == NULL) {
 		return;
 	}
-	ssize_t count = 0;
-	prof_recent_t *n;
-	ql_foreach(n, &prof_recent_alloc_list, link) {
-		++count;
+	for (size_t i = 0; i < ring->cap; ++i) {
+		prof_recent_t *n = &ring->slots[i];
+		assert(prof_recent_alloc_edata_get_no_lock(n) == NULL);
+		if (n->alloc_tctx != NULL) {
+			decrement_recent_count(tsd, n->alloc_tctx);
+		}
+		if (n->dalloc_tctx != NULL) {
+			decrement_recent_count(tsd, n->dalloc_tctx);
+		}
 	}
-	assert(count == prof_recent_alloc_count);
-	assert(prof_recent_alloc_max_get(tsd) == -1 ||
-	    count <= prof_recent_alloc_max_get(tsd));
+	prof_recent_ring_free(tsd_tsdn(tsd), ring);
 }
 
-void
-prof_recent_alloc(tsd_t *tsd, edata_t *edata, size_t size, size_t usize) {
-	cassert(config_prof);
-	assert(edata != NULL);
-	prof_tctx_t *tctx = edata_prof_tctx_get(edata);
-
-	malloc_mutex_assert_not_owner(tsd_tsdn(tsd), tctx->tdata->lock);
-	malloc_mutex_lock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	prof_recent_alloc_assert_count(tsd);
-
-	/*
-	 * Reserve a new prof_recent_t node if needed.  If needed, we release
-	 * the prof_recent_alloc_mtx lock and allocate.  Then, rather than
-	 * immediately checking for OOM, we regain the lock and try to make use
-	 * of the reserve node if needed.  There are six scenarios:
-	 *
-	 *          \ now | no need | need but OOMed | need and allocated
-	 *     later \    |         |                |
-	 *    ------------------------------------------------------------
-	 *     no need    |   (1)   |      (2)       |         (3)
-	 *    ------------------------------------------------------------
-	 *     need       |   (4)   |      (5)       |         (6)
-	 *
-	 * First, "(4)" never happens, because we don't release the lock in the
-	 * middle if there's no need for a new node; in such cases "(1)" always
-	 * takes place, which is trivial.
-	 *
-	 * Out of the remaining four scenarios, "(6)" is the common case and is
-	 * trivial.  "(5)" is also trivial, in which case we'll rollback the
-	 * effect of prof_recent_alloc_prepare() as expected.
-	 *
-	 * "(2)" / "(3)" occurs when the need for a new node is gone after we
-	 * regain the lock.  If the new node is successfully allocated, i.e. in
-	 * the case of "(3)", we'll release it in the end; otherwise, i.e. in
-	 * the case of "(2)", we do nothing - we're lucky that the OOM ends up
-	 * doing no harm at all.
-	 *
-	 * Therefore, the only performance cost of the "release lock" ->
-	 * "allocate" -> "regain lock" design is the "(3)" case, but it happens
-	 * very rarely, so the cost is relatively small compared to the gain of
-	 * not having to have the lock order of prof_recent_alloc_mtx above all
-	 * the allocation locks.
-	 */
-	prof_recent_t *reserve = NULL;
-	if (prof_recent_alloc_max_get(tsd) == -1 ||
-	    prof_recent_alloc_count < prof_recent_alloc_max_get(tsd)) {
-		assert(prof_recent_alloc_max_get(tsd) != 0);
+/*
+ * Returns a ring able to take over the records of the current ring plus
+ * nextra more, or NULL if none is needed or on OOM (in which case the records
+ * get dropped).  The ring is allocated with prof_recent_alloc_mtx released,
+ * hence the retries.
+ */
+static prof_recent_ring_t *
+prof_recent_ring_alloc_locked(tsd_t *tsd, size_t nextra) {
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	prof_recent_ring_t *to = NULL;
+	while (true) {
+		ssize_t max = prof_recent_alloc_max_get(tsd);
+		prof_recent_ring_t *ring = (prof_recent_ring_t *)atomic_load_p(
+		    &prof_recent_ring, ATOMIC_RELAXED);
+		size_t cap = nextra + (ring == NULL ? 0 : ring->cap);
+		if (max != -1 && cap > (size_t)max) {
+			cap = (size_t)max;
+		}
+		if (to == NULL ? cap == 0 : (cap != 0 && to->cap >= cap)) {
+			return to;
+		}
 		malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-		reserve = prof_recent_allocate_node(tsd_tsdn(tsd));
+		if (to != NULL) {
+			prof_recent_ring_free(tsd_tsdn(tsd), to);
+		}
+		to = cap == 0 ? NULL : prof_recent_ring_new(tsd_tsdn(tsd), cap);
 		malloc_mutex_lock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-		prof_recent_alloc_assert_count(tsd);
+		if (cap != 0 && to == NULL) {
+			return NULL;
+		}
 	}
+}
 
-	if (prof_recent_alloc_max_get(tsd) == 0) {
-		assert(prof_recent_alloc_is_empty(tsd));
-		goto label_rollback;
+/*
+ * Called when the writer of a sampled allocation found ring, of capacity cap,
+ * missing or out of room.  Returns true if the allocation is not to be
+ * recorded.
+ */
+static bool
+prof_recent_ring_grow(tsd_t *tsd, prof_recent_ring_t *ring, size_t cap) {
+	ssize_t max = prof_recent_alloc_max_get_no_lock();
+	if (max == 0) {
+		return true;
+	}
+	cap = ring == NULL ? PROF_RECENT_RING_CAP_MIN : cap * 2;
+	if (max != -1 && cap > (size_t)max) {
+		cap = (size_t)max;
+	}
+	prof_recent_ring_t *to = prof_recent_ring_new(tsd_tsdn(tsd), cap);
+	if (to == NULL) {
+		return true;
 	}
 
-	prof_tctx_t *old_alloc_tctx, *old_dalloc_tctx;
-	if (prof_recent_alloc_count == prof_recent_alloc_max_get(tsd)) {
-		/* If upper limit is reached, rotate the head. */
-		assert(prof_recent_alloc_max_get(tsd) != -1);
-		assert(!prof_recent_alloc_is_empty(tsd));
-		prof_recent_t *head = ql_first(&prof_recent_alloc_list);
-		old_alloc_tctx = head->alloc_tctx;
-		assert(old_alloc_tctx != NULL);
-		old_dalloc_tctx = head->dalloc_tctx;
-		prof_recent_alloc_evict_edata(tsd, head);
-		ql_rotate(&prof_recent_alloc_list, link);
-	} else {
-		/* Otherwise make use of the new node. */
-		assert(prof_recent_alloc_max_get(tsd) == -1 ||
-		    prof_recent_alloc_count < prof_recent_alloc_max_get(tsd));
-		if (reserve == NULL) {
-			goto label_rollback;
-		}
-		ql_elm_new(reserve, link);
-		ql_tail_insert(&prof_recent_alloc_list, reserve, link);
-		reserve = NULL;
-		old_alloc_tctx = NULL;
-		old_dalloc_tctx = NULL;
-		++prof_recent_alloc_count;
-	}
-
-	/* Fill content into the tail node. */
-	prof_recent_t *tail = ql_last(&prof_recent_alloc_list, link);
-	assert(tail != NULL);
-	tail->size = size;
-	tail->usize = usize;
-	nstime_copy(&tail->alloc_time, edata_prof_alloc_time_get(edata));
-	tail->alloc_tctx = tctx;
-	nstime_init_zero(&tail->dalloc_time);
-	tail->dalloc_tctx = NULL;
-	edata_prof_recent_alloc_set(tsd, edata, tail);
-
-	assert(!prof_recent_alloc_is_empty(tsd));
-	prof_recent_alloc_assert_count(tsd);
+	malloc_mutex_lock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	prof_recent_ring_t *from = (prof_recent_ring_t *)atomic_load_p(
+	    &prof_recent_ring, ATOMIC_RELAXED);
+	/* Somebody else may have replaced the ring in the meantime. */
+	bool grow = from == ring && (from == NULL || from->cap < cap) &&
+	    prof_recent_alloc_max_get(tsd) != 0;
+	if (grow) {
+		from = prof_recent_ring_replace(tsd, to, NULL);
+	}
 	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
 
-	if (reserve != NULL) {
-		prof_recent_free_node(tsd_tsdn(tsd), reserve);
+	if (grow) {
+		prof_recent_ring_destroy(tsd, from);
+	} else {
+		prof_recent_ring_free(tsd_tsdn(tsd), to);
+	}
+	return false;
+}
+
+void
+prof_recent_alloc(tsd_t *tsd, edata_t *edata, size_t size, size_t usize) {
+	cassert(config_prof);
+	assert(edata != NULL);
+	prof_tctx_t *tctx = edata_prof_tctx_get(edata);
+	malloc_mutex_assert_not_owner(tsd_tsdn(tsd), tctx->tdata->lock);
+
+	prof_tctx_t *old_alloc_tctx = NULL;
+	prof_tctx_t *old_dalloc_tctx = NULL;
+	while (true) {
+		prof_recent_enter(tsd);
+		prof_recent_ring_t *ring = (prof_recent_ring_t *)atomic_load_p(
+		    &prof_recent_ring, ATOMIC_ACQUIRE);
+		size_t cap = 0;
+		if (ring != NULL) {
+			size_t t = atomic_fetch_add_zu(&ring->next, 1,
+			    ATOMIC_RELAXED);
+			if (t < ring->cap || prof_recent_ring_full(ring)) {
+				prof_recent_ring_put(ring, t, edata, size,
+				    usize, &old_alloc_tctx, &old_dalloc_tctx);
+				prof_recent_exit();
+				break;
+			}
+			cap = ring->cap;
+		}
+		prof_recent_exit();
+		if (prof_recent_ring_grow(tsd, ring, cap)) {
+			/* Roll back prof_recent_alloc_prepare(). */
+			decrement_recent_count(tsd, tctx);
+			return;
+		}
 	}
 
 	/*
-	 * Asynchronously handle the tctx of the old node, so that there's no
-	 * simultaneous holdings of prof_recent_alloc_mtx and tdata->lock.
-	 * In the worst case this may delay the tctx release but it's better
-	 * than holding prof_recent_alloc_mtx for longer.
+	 * Release the tctxs of the evicted record only now, so that nobody
+	 * blocks on a tdata lock while in the ring.
 	 */
 	if (old_alloc_tctx != NULL) {
 		decrement_recent_count(tsd, old_alloc_tctx);
@@ -390,16 +612,6 @@ prof_recent_alloc(tsd_t *tsd, edata_t *edata, size_t size, size_t usize) {
 	if (old_dalloc_tctx != NULL) {
 		decrement_recent_count(tsd, old_dalloc_tctx);
 	}
-	return;
-
-label_rollback:
-	assert(edata_prof_recent_alloc_get(tsd, edata) == NULL);
-	prof_recent_alloc_assert_count(tsd);
-	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	if (reserve != NULL) {
-		prof_recent_free_node(tsd_tsdn(tsd), reserve);
-	}
-	decrement_recent_count(tsd, tctx);
 }
 
 ssize_t
@@ -409,67 +621,37 @@ prof_recent_alloc_max_ctl_read(void) {
 	return prof_recent_alloc_max_get_no_lock();
 }
 
-static void
-prof_recent_alloc_restore_locked(tsd_t *tsd, prof_recent_list_t *to_delete) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	ssize_t max = prof_recent_alloc_max_get(tsd);
-	if (max == -1 || prof_recent_alloc_count <= max) {
-		/* Easy case - no need to alter the list. */
-		ql_new(to_delete);
-		prof_recent_alloc_assert_count(tsd);
-		return;
-	}
-
-	prof_recent_t *node;
-	ql_foreach(node, &prof_recent_alloc_list, link) {
-		if (prof_recent_alloc_count == max) {
-			break;
-		}
-		prof_recent_alloc_evict_edata(tsd, node);
-		--prof_recent_alloc_count;
-	}
-	assert(prof_recent_alloc_count == max);
-
-	ql_move(to_delete, &prof_recent_alloc_list);
-	if (max == 0) {
-		assert(node == NULL);
-	} else {
-		assert(node != NULL);
-		ql_split(to_delete, node, &prof_recent_alloc_list, link);
-	}
-	assert(!ql_empty(to_delete));
-	prof_recent_alloc_assert_count(tsd);
-}
-
-static void
-prof_recent_alloc_async_cleanup(tsd_t *tsd, prof_recent_list_t *to_delete) {
-	malloc_mutex_assert_not_owner(tsd_tsdn(tsd), &prof_recent_dump_mtx);
-	malloc_mutex_assert_not_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	while (!ql_empty(to_delete)) {
-		prof_recent_t *node = ql_first(to_delete);
-		ql_remove(to_delete, node, link);
-		decrement_recent_count(tsd, node->alloc_tctx);
-		if (node->dalloc_tctx != NULL) {
-			decrement_recent_count(tsd, node->dalloc_tctx);
-		}
-		prof_recent_free_node(tsd_tsdn(tsd), node);
-	}
-}
-
 ssize_t
 prof_recent_alloc_max_ctl_write(tsd_t *tsd, ssize_t max) {
 	cassert(config_prof);
 	assert(max >= -1);
 	malloc_mutex_lock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	prof_recent_alloc_assert_count(tsd);
 	const ssize_t old_max = prof_recent_alloc_max_update(tsd, max);
-	prof_recent_list_t to_delete;
-	prof_recent_alloc_restore_locked(tsd, &to_delete);
+	prof_recent_ring_t *to = prof_recent_ring_alloc_locked(tsd, 0);
+	prof_recent_ring_t *from = prof_recent_ring_replace(tsd, to, NULL);
 	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	prof_recent_alloc_async_cleanup(tsd, &to_delete);
+	prof_recent_ring_destroy(tsd, from);
 	return old_max;
 }
 
+size_t
+prof_recent_alloc_count_test(void) {
+	cassert(config_prof);
+	return prof_recent_ring_count((prof_recent_ring_t *)atomic_load_p(
+	    &prof_recent_ring, ATOMIC_ACQUIRE));
+}
+
+prof_recent_t *
+prof_recent_alloc_nth_test(size_t i) {
+	cassert(config_prof);
+	prof_recent_ring_t *ring = (prof_recent_ring_t *)atomic_load_p(
+	    &prof_recent_ring, ATOMIC_ACQUIRE);
+	assert(i < prof_recent_ring_count(ring));
+	size_t lo, hi;
+	prof_recent_ring_window(ring, &lo, &hi);
+	return prof_recent_ring_slot(ring, lo + i);
+}
+
 static void
 prof_recent_alloc_dump_bt(emitter_t *emitter, prof_tctx_t *tctx) {
 	char bt_buf[2 * sizeof(intptr_t) + 3];
@@ -529,6 +711,21 @@ prof_recent_alloc_dump_node(emitter_t *emitter, prof_recent_t *node) {
 	emitter_json_object_end(emitter);
 }
 
+/*
+ * Takes the current ring aside for dumping; sampled allocations start over in
+ * a new ring meanwhile, to be merged back by prof_recent_ring_replace().
+ */
+static prof_recent_ring_t *
+prof_recent_ring_detach(tsd_t *tsd) {
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	prof_recent_block(tsd_tsdn(tsd));
+	prof_recent_ring_t *ring = (prof_recent_ring_t *)atomic_load_p(
+	    &prof_recent_ring, ATOMIC_RELAXED);
+	atomic_store_p(&prof_recent_ring, NULL, ATOMIC_RELAXED);
+	prof_recent_unblock(tsd_tsdn(tsd));
+	return ring;
+}
+
 #define PROF_RECENT_PRINT_BUFSIZE 65536
 JEMALLOC_COLD
 void
@@ -541,15 +738,10 @@ prof_recent_alloc_dump(tsd_t *tsd, write_cb_t *write_cb, void *cbopaque) {
 	emitter_t emitter;
 	emitter_init(&emitter, emitter_output_json_compact, buf_writer_cb,
 	    &buf_writer);
-	prof_recent_list_t temp_list;
 
 	malloc_mutex_lock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	prof_recent_alloc_assert_count(tsd);
 	ssize_t dump_max = prof_recent_alloc_max_get(tsd);
-	ql_move(&temp_list, &prof_recent_alloc_list);
-	ssize_t dump_count = prof_recent_alloc_count;
-	prof_recent_alloc_count = 0;
-	prof_recent_alloc_assert_count(tsd);
+	prof_recent_ring_t *dump_ring = prof_recent_ring_detach(tsd);
 	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
 
 	emitter_begin(&emitter);
@@ -559,25 +751,39 @@ prof_recent_alloc_dump(tsd_t *tsd, write_cb_t *write_cb, void *cbopaque) {
 	emitter_json_kv(&emitter, "recent_alloc_max", emitter_type_ssize,
 	    &dump_max);
 	emitter_json_array_kv_begin(&emitter, "recent_alloc");
-	prof_recent_t *node;
-	ql_foreach(node, &temp_list, link) {
-		prof_recent_alloc_dump_node(&emitter, node);
+	if (dump_ring != NULL) {
+		/*
+		 * The set of records is fixed now; only their release can
+		 * still be recorded concurrently, so copy each out under its
+		 * slot lock.  The tctxs stay pinned by the records.
+		 */
+		size_t lo, hi;
+		prof_recent_ring_window(dump_ring, &lo, &hi);
+		for (size_t t = lo; t < hi; ++t) {
+			prof_recent_t *n = prof_recent_ring_slot(dump_ring, t);
+			prof_recent_t node;
+			size_t seq = prof_recent_slot_lock(n);
+			assert(seq == PROF_RECENT_SEQ(t));
+			prof_recent_alloc_copy(&node, n);
+			prof_recent_slot_unlock(n, seq);
+			prof_recent_alloc_dump_node(&emitter, &node);
+		}
 	}
 	emitter_json_array_end(&emitter);
 	emitter_end(&emitter);
 
 	malloc_mutex_lock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	prof_recent_alloc_assert_count(tsd);
-	ql_concat(&temp_list, &prof_recent_alloc_list, link);
-	ql_move(&prof_recent_alloc_list, &temp_list);
-	prof_recent_alloc_count += dump_count;
-	prof_recent_alloc_restore_locked(tsd, &temp_list);
+	prof_recent_ring_t *to = prof_recent_ring_alloc_locked(tsd,
+	    prof_recent_ring_count(dump_ring));
+	prof_recent_ring_t *from = prof_recent_ring_replace(tsd, to,
+	    dump_ring);
 	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
 
 	buf_writer_terminate(tsd_tsdn(tsd), &buf_writer);
 	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_dump_mtx);
 
-	prof_recent_alloc_async_cleanup(tsd, &temp_list);
+	prof_recent_ring_destroy(tsd, from);
+	prof_recent_ring_destroy(tsd, dump_ring);
 }
 #undef PROF_RECENT_PRINT_BUFSIZE
 
@@ -596,7 +802,30 @@ prof_recent_init(void) {
 		return true;
 	}
 
-	ql_new(&prof_recent_alloc_list);
+	atomic_store_p(&prof_recent_ring, NULL, ATOMIC_RELAXED);
+	atomic_store_zu(&prof_recent_nusers, 0, ATOMIC_RELAXED);
+	atomic_store_b(&prof_recent_blocked, false, ATOMIC_RELAXED);
 
 	return false;
 }
+
+void
+prof_recent_prefork(tsdn_t *tsdn) {
+	malloc_mutex_prefork(tsdn, &prof_recent_alloc_mtx);
+	/* Leave no thread halfway through updating a slot. */
+	prof_recent_block(tsdn);
+}
+
+void
+prof_recent_postfork_parent(tsdn_t *tsdn) {
+	prof_recent_unblock(tsdn);
+	malloc_mutex_postfork_parent(tsdn, &prof_recent_alloc_mtx);
+}
+
+void
+prof_recent_postfork_child(tsdn_t *tsdn) {
+	assert(atomic_load_zu(&prof_recent_nusers, ATOMIC_RELAXED) == 0);
+	/* The witnesses were already reset; skip prof_recent_unblock(). */
+	atomic_store_b(&prof_recent_blocked, false, ATOMIC_RELAXED);
+	malloc_mutex_postfork_child(tsdn, &prof_recent_alloc_mtx);
+}
@@ -7,11 +7,17 @@ bool opt_prof_stats = false;
 malloc_mutex_t prof_stats_mtx;
 static prof_stats_t prof_stats_live[PROF_SC_NSIZES];
 static prof_stats_t prof_stats_accum[PROF_SC_NSIZES];
+/*
+ * Per allocation tag.  Unlike the per size class stats these are estimates of
+ * the true totals, kept in the same shifted form as the unbiased counts in
+ * prof_cnt_t, so that samples taken at different rates add up.
+ */
+static prof_stats_t prof_stats_tags_live[PROF_ALLOC_NTAGS];
+static prof_stats_t prof_stats_tags_accum[PROF_ALLOC_NTAGS];
 
 static void
-prof_stats_enter(tsd_t *tsd, szind_t ind) {
+prof_stats_enter(tsd_t *tsd) {
 	assert(opt_prof && opt_prof_stats);
-	assert(ind < SC_NSIZES);
 	malloc_mutex_lock(tsd_tsdn(tsd), &prof_stats_mtx);
 }
 
@@ -21,29 +27,44 @@ prof_stats_leave(tsd_t *tsd) {
 }
 
 void
-prof_stats_inc(tsd_t *tsd, szind_t ind, size_t size) {
+prof_stats_inc(tsd_t *tsd, szind_t ind, size_t size, unsigned tag,
+    size_t shifted_unbiased_cnt) {
 	cassert(config_prof);
-	prof_stats_enter(tsd, ind);
+	assert(ind < SC_NSIZES);
+	assert(tag < PROF_ALLOC_NTAGS);
+	uint64_t shifted_req_sum = (uint64_t)size * shifted_unbiased_cnt;
+	prof_stats_enter(tsd);
 	prof_stats_live[ind].req_sum += size;
 	prof_stats_live[ind].count++;
 	prof_stats_accum[ind].req_sum += size;
 	prof_stats_accum[ind].count++;
+	prof_stats_tags_live[tag].req_sum += shifted_req_sum;
+	prof_stats_tags_live[tag].count += shifted_unbiased_cnt;
+	prof_stats_tags_accum[tag].req_sum += shifted_req_sum;
+	prof_stats_tags_accum[tag].count += shifted_unbiased_cnt;
 	prof_stats_leave(tsd);
 }
 
 void
-prof_stats_dec(tsd_t *tsd, szind_t ind, size_t size) {
+prof_stats_dec(tsd_t *tsd, szind_t ind, size_t size, unsigned tag,
+    size_t shifted_unbiased_cnt) {
 	cassert(config_prof);
-	prof_stats_enter(tsd, ind);
+	assert(ind < SC_NSIZES);
+	assert(tag < PROF_ALLOC_NTAGS);
+	prof_stats_enter(tsd);
 	prof_stats_live[ind].req_sum -= size;
 	prof_stats_live[ind].count--;
+	prof_stats_tags_live[tag].req_sum -= (uint64_t)size *
+	    shifted_unbiased_cnt;
+	prof_stats_tags_live[tag].count -= shifted_unbiased_cnt;
 	prof_stats_leave(tsd);
 }
 
 void
 prof_stats_get_live(tsd_t *tsd, szind_t ind, prof_stats_t *stats) {
 	cassert(config_prof);
-	prof_stats_enter(tsd, ind);
+	assert(ind < SC_NSIZES);
+	prof_stats_enter(tsd);
 	memcpy(stats, &prof_stats_live[ind], sizeof(prof_stats_t));
 	prof_stats_leave(tsd);
 }
@@ -51,7 +72,32 @@ prof_stats_get_live(tsd_t *tsd, szind_t ind, prof_stats_t *stats) {
 void
 prof_stats_get_accum(tsd_t *tsd, szind_t ind, prof_stats_t *stats) {
 	cassert(config_prof);
-	prof_stats_enter(tsd, ind);
+	assert(ind < SC_NSIZES);
+	prof_stats_enter(tsd);
 	memcpy(stats, &prof_stats_accum[ind], sizeof(prof_stats_t));
 	prof_stats_leave(tsd);
 }
+
+static void
+prof_stats_tag_unshift(const prof_stats_t *shifted, prof_stats_t *stats) {
+	stats->req_sum = shifted->req_sum >> SC_LG_TINY_MIN;
+	stats->count = shifted->count >> SC_LG_TINY_MIN;
+}
+
+void
+prof_stats_tag_get_live(tsd_t *tsd, unsigned tag, prof_stats_t *stats) {
+	cassert(config_prof);
+	assert(tag < PROF_ALLOC_NTAGS);
+	prof_stats_enter(tsd);
+	prof_stats_tag_unshift(&prof_stats_tags_live[tag], stats);
+	prof_stats_leave(tsd);
+}
+
+void
+prof_stats_tag_get_accum(tsd_t *tsd, unsigned tag, prof_stats_t *stats) {
+	cassert(config_prof);
+	assert(tag < PROF_ALLOC_NTAGS);
+	prof_stats_enter(tsd);
+	prof_stats_tag_unshift(&prof_stats_tags_accum[tag], stats);
+	prof_stats_leave(tsd);
+}
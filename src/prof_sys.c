@@ -30,6 +30,7 @@ static uint64_t prof_dump_seq;
 static uint64_t prof_dump_iseq;
 static uint64_t prof_dump_mseq;
 static uint64_t prof_dump_useq;
+static uint64_t prof_dump_wseq;
 
 static char *prof_prefix = NULL;
 
@@ -416,6 +417,84 @@ prof_backtrace_impl(void **vec, unsigned *len, unsigned max_len) {
 }
 #endif
 
+/*
+ * Walks the chain of frame records starting at fp, where each record holds the
+ * caller's frame pointer followed by the return address.  Records have to be
+ * aligned, lie within [stack_lo, stack_hi), and move strictly toward the stack
+ * base; a zero frame pointer or return address ends the chain.  Returns true
+ * if the chain is invalid or yields no frames, in which case the contents of
+ * vec are unspecified.
+ */
+bool
+prof_backtrace_fp_walk(void **vec, unsigned *len, unsigned max_len,
+    uintptr_t fp, uintptr_t stack_lo, uintptr_t stack_hi) {
+	*len = 0;
+	if (stack_hi < stack_lo ||
+	    stack_hi - stack_lo < 2 * sizeof(uintptr_t)) {
+		return true;
+	}
+	while (fp != 0 && *len < max_len) {
+		if ((fp & (sizeof(uintptr_t) - 1)) != 0 || fp < stack_lo ||
+		    fp > stack_hi - 2 * sizeof(uintptr_t)) {
+			return true;
+		}
+		const uintptr_t *frame = (const uintptr_t *)fp;
+		uintptr_t next = frame[0];
+		uintptr_t ret = frame[1];
+		if (ret == 0) {
+			break;
+		}
+		vec[(*len)++] = (void *)ret;
+		if (next != 0 && next <= fp) {
+			return true;
+		}
+		fp = next;
+	}
+	return *len == 0;
+}
+
+static void
+prof_stack_bounds_fetch(prof_tdata_t *tdata) {
+	if (tdata->stack_bounds_fetched) {
+		return;
+	}
+	tdata->stack_bounds_fetched = true;
+#ifdef JEMALLOC_PROF_FRAME_POINTER
+	pthread_attr_t attr;
+	if (pthread_getattr_np(pthread_self(), &attr) != 0) {
+		return;
+	}
+	void *addr;
+	size_t size;
+	if (pthread_attr_getstack(&attr, &addr, &size) == 0) {
+		tdata->stack_lo = (uintptr_t)addr;
+		tdata->stack_hi = (uintptr_t)addr + size;
+	}
+	pthread_attr_destroy(&attr);
+#endif
+}
+
+static void
+prof_backtrace_fp_impl(void **vec, unsigned *len, unsigned max_len) {
+	cassert(config_prof);
+
+	prof_tdata_t *tdata = prof_tdata_get(tsd_fetch(), false);
+	if (tdata != NULL) {
+		prof_stack_bounds_fetch(tdata);
+		if (!prof_backtrace_fp_walk(vec, len, max_len,
+		    (uintptr_t)__builtin_frame_address(0), tdata->stack_lo,
+		    tdata->stack_hi)) {
+			return;
+		}
+	}
+	/*
+	 * Something on the stack was built without frame pointers (or the
+	 * stack bounds are unknown); take the slow but reliable path.
+	 */
+	*len = 0;
+	prof_backtrace_impl(vec, len, max_len);
+}
+
 void
 prof_backtrace(tsd_t *tsd, prof_bt_t *bt) {
 	cassert(config_prof);
@@ -429,7 +508,9 @@ prof_backtrace(tsd_t *tsd, prof_bt_t *bt) {
 
 void
 prof_hooks_init(void) {
-	prof_backtrace_hook_set(&prof_backtrace_impl);
+	prof_backtrace_hook_set(
+	    opt_prof_backtrace_method == prof_backtrace_method_fp ?
+	    &prof_backtrace_fp_impl : &prof_backtrace_impl);
 	prof_dump_hook_set(NULL);
 	prof_sample_hook_set(NULL);
 	prof_sample_free_hook_set(NULL);
@@ -543,6 +624,9 @@ struct prof_dump_arg_s {
 	bool error;
 	/* File descriptor of the dump file. */
 	int prof_dump_fd;
+	/* If non-NULL, output goes here rather than to prof_dump_fd. */
+	prof_dump_write_cb_t *write_cb;
+	void *cbopaque;
 };
 
 static void
@@ -590,7 +674,9 @@ static void
 prof_dump_flush(void *opaque, const char *s) {
 	cassert(config_prof);
 	prof_dump_arg_t *arg = (prof_dump_arg_t *)opaque;
-	if (!arg->error) {
+	if (arg->write_cb != NULL) {
+		arg->write_cb(arg->cbopaque, s, strlen(s));
+	} else if (!arg->error) {
 		ssize_t err = prof_dump_write_file(arg->prof_dump_fd, s,
 		    strlen(s));
 		prof_dump_check_possible_error(arg, err == -1,
@@ -598,6 +684,20 @@ prof_dump_flush(void *opaque, const char *s) {
 	}
 }
 
+static void
+prof_dump_flush_bytes(void *opaque, const void *bytes, size_t len) {
+	cassert(config_prof);
+	prof_dump_arg_t *arg = (prof_dump_arg_t *)opaque;
+	if (arg->write_cb != NULL) {
+		arg->write_cb(arg->cbopaque, bytes, len);
+	} else if (!arg->error) {
+		ssize_t err = prof_dump_write_file(arg->prof_dump_fd, bytes,
+		    len);
+		prof_dump_check_possible_error(arg, err == -1,
+		    "<jemalloc>: failed to write during heap profile flush\n");
+	}
+}
+
 static void
 prof_dump_close(prof_dump_arg_t *arg) {
 	if (arg->prof_dump_fd != -1) {
@@ -738,6 +838,38 @@ prof_dump_maps(buf_writer_t *buf_writer) {
 }
 #endif /* __APPLE__ */
 
+/*
+ * Writes the profile, in opt_prof_format, to wherever arg points.  Requires
+ * prof_dump_mtx.
+ */
+static void
+prof_dump_profile(tsd_t *tsd, prof_tdata_t *tdata, prof_dump_arg_t *arg,
+    bool leakcheck) {
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_dump_mtx);
+
+	buf_writer_t buf_writer;
+	bool err = buf_writer_init(tsd_tsdn(tsd), &buf_writer, prof_dump_flush,
+	    arg, prof_dump_buf, PROF_DUMP_BUFSIZE);
+	assert(!err);
+	if (opt_prof_format == prof_format_pprof) {
+		/* Mappings are part of the protobuf output. */
+		buf_writer_set_bytes_cb(&buf_writer, prof_dump_flush_bytes);
+		err = prof_dump_pprof_impl(tsd, &buf_writer, tdata,
+		    leakcheck);
+	} else {
+		err = prof_dump_impl(tsd, buf_writer_cb, &buf_writer, tdata,
+		    leakcheck);
+		if (!err) {
+			prof_dump_maps(&buf_writer);
+		}
+	}
+	if (!arg->error) {
+		prof_dump_check_possible_error(arg, err,
+		    "<jemalloc>: out of memory during heap profile dump\n");
+	}
+	buf_writer_terminate(tsd_tsdn(tsd), &buf_writer);
+}
+
 static bool
 prof_dump(tsd_t *tsd, bool propagate_err, const char *filename,
     bool leakcheck) {
@@ -750,19 +882,14 @@ prof_dump(tsd_t *tsd, bool propagate_err, const char *filename,
 	}
 
 	prof_dump_arg_t arg = {/* handle_error_locally */ !propagate_err,
-	    /* error */ false, /* prof_dump_fd */ -1};
+	    /* error */ false, /* prof_dump_fd */ -1, /* write_cb */ NULL,
+	    /* cbopaque */ NULL};
 
 	pre_reentrancy(tsd, NULL);
 	malloc_mutex_lock(tsd_tsdn(tsd), &prof_dump_mtx);
 
 	prof_dump_open(&arg, filename);
-	buf_writer_t buf_writer;
-	bool err = buf_writer_init(tsd_tsdn(tsd), &buf_writer, prof_dump_flush,
-	    &arg, prof_dump_buf, PROF_DUMP_BUFSIZE);
-	assert(!err);
-	prof_dump_impl(tsd, buf_writer_cb, &buf_writer, tdata, leakcheck);
-	prof_dump_maps(&buf_writer);
-	buf_writer_terminate(tsd_tsdn(tsd), &buf_writer);
+	prof_dump_profile(tsd, tdata, &arg, leakcheck);
 	prof_dump_close(&arg);
 
 	prof_dump_hook_t dump_hook = prof_dump_hook_get();
@@ -928,6 +1055,26 @@ prof_mdump_impl(tsd_t *tsd, const char *filename) {
 	return prof_dump(tsd, true, filename, false);
 }
 
+bool
+prof_mdump_cb_impl(tsd_t *tsd, prof_dump_write_cb_t *write_cb,
+    void *cbopaque) {
+	prof_tdata_t *tdata = prof_tdata_get(tsd, true);
+	if (tdata == NULL) {
+		return true;
+	}
+
+	prof_dump_arg_t arg = {/* handle_error_locally */ false,
+	    /* error */ false, /* prof_dump_fd */ -1, write_cb, cbopaque};
+
+	pre_reentrancy(tsd, NULL);
+	malloc_mutex_lock(tsd_tsdn(tsd), &prof_dump_mtx);
+	prof_dump_profile(tsd, tdata, &arg, false);
+	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_dump_mtx);
+	post_reentrancy(tsd);
+
+	return arg.error;
+}
+
 void
 prof_gdump_impl(tsd_t *tsd) {
 	tsdn_t *tsdn = tsd_tsdn(tsd);
@@ -942,3 +1089,18 @@ prof_gdump_impl(tsd_t *tsd) {
 	malloc_mutex_unlock(tsdn, &prof_dump_filename_mtx);
 	prof_dump(tsd, false, filename, false);
 }
+
+void
+prof_wdump_impl(tsd_t *tsd) {
+	tsdn_t *tsdn = tsd_tsdn(tsd);
+	malloc_mutex_lock(tsdn, &prof_dump_filename_mtx);
+	if (prof_prefix_get(tsdn)[0] == '\0') {
+		malloc_mutex_unlock(tsdn, &prof_dump_filename_mtx);
+		return;
+	}
+	char filename[DUMP_FILENAME_BUFSIZE];
+	prof_dump_filename(tsd, filename, 'w', prof_dump_wseq);
+	prof_dump_wseq++;
+	malloc_mutex_unlock(tsdn, &prof_dump_filename_mtx);
+	prof_dump(tsd, false, filename, false);
+}
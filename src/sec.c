@@ -344,6 +344,11 @@ sec_dalloc(tsdn_t *tsdn, pai_t *self, edata_t *edata,
 		    deferred_work_generated);
 		return;
 	}
+	/*
+	 * Cached extents are handed out again as-is; whatever the fallback
+	 * knew about their contents no longer holds.
+	 */
+	edata_zeroed_set(edata, false);
 	sec_shard_t *shard = sec_shard_pick(tsdn, sec);
 	malloc_mutex_lock(tsdn, &shard->mtx);
 	if (shard->enabled) {
@@ -2,8 +2,10 @@
 #include "jemalloc/internal/jemalloc_internal_includes.h"
 
 #include "jemalloc/internal/assert.h"
+#include "jemalloc/internal/buf_writer.h"
 #include "jemalloc/internal/ctl.h"
 #include "jemalloc/internal/emitter.h"
+#include "jemalloc/internal/latency.h"
 #include "jemalloc/internal/fxp.h"
 #include "jemalloc/internal/mutex.h"
 #include "jemalloc/internal/mutex_prof.h"
@@ -21,6 +23,11 @@ static const char *const arena_mutex_names[mutex_prof_num_arena_mutexes] = {
 #undef OP
 };
 
+/* Buffer size for the stats_bg delta reports. */
+#define STATS_BG_BUFSIZE 65536
+/* Initial size of the buffer the stats_bg reports are collected in. */
+#define STATS_BG_REPORT_SIZE_MIN 65536
+
 #define CTL_GET(n, v, t) do {						\
 	size_t sz = sizeof(t);						\
 	xmallctl(n, (void *)v, &sz, NULL, 0);				\
@@ -67,6 +74,40 @@ static counter_accum_t stats_interval_accumulated;
 /* Per thread batch accum size for stats_interval. */
 static uint64_t stats_interval_accum_batch;
 
+int64_t opt_stats_bg_interval_ms = STATS_BG_INTERVAL_MS_DEFAULT;
+char opt_stats_bg_opts[stats_print_tot_num_options+1] = "";
+bool opt_stats_bg_delta = false;
+int opt_stats_bg_fd = -1;
+
+/* stats_bg_hook_mtx protects stats_bg_hook. */
+static malloc_mutex_t stats_bg_hook_mtx;
+static stats_bg_hook_t stats_bg_hook;
+/* Only accessed by background thread 0. */
+static nstime_t stats_bg_last;
+static uint64_t *stats_bg_prev;
+/*
+ * A report is collected here while ctl_mtx is held, and written out only once
+ * it is released; the buffer is kept from one report to the next.
+ */
+static char *stats_bg_report;
+static size_t stats_bg_report_size;
+static size_t stats_bg_report_len;
+static bool stats_bg_report_oom;
+
+int64_t opt_stats_ts_interval_ms = STATS_TS_INTERVAL_MS_DEFAULT;
+size_t opt_stats_ts_nsamples = STATS_TS_NSAMPLES_DEFAULT;
+
+/*
+ * stats_ts_mtx protects the sample ring, which is written by background
+ * thread 0 only.
+ */
+static malloc_mutex_t stats_ts_mtx;
+static stats_ts_sample_t *stats_ts_ring;
+/* Total number of samples taken; the newest is at (stats_ts_nsampled - 1). */
+static uint64_t stats_ts_nsampled;
+/* Only accessed by background thread 0. */
+static nstime_t stats_ts_last;
+
 /******************************************************************************/
 
 static uint64_t
@@ -148,7 +189,7 @@ mutex_stats_read_global(size_t mib[], size_t miblen, const char *name,
     emitter_col_t *col_name,
     emitter_col_t col_uint64_t[mutex_prof_num_uint64_t_counters],
     emitter_col_t col_uint32_t[mutex_prof_num_uint32_t_counters],
-    uint64_t uptime) {
+    uint64_t wait_hist[MUTEX_PROF_WAIT_NBUCKETS], uint64_t uptime) {
 	CTL_LEAF_PREPARE(mib, miblen, name);
 	size_t miblen_name = miblen + 1;
 
@@ -174,6 +215,8 @@ mutex_stats_read_global(size_t mib[], size_t miblen, const char *name,
 #undef OP
 #undef EMITTER_TYPE_uint32_t
 #undef EMITTER_TYPE_uint64_t
+	CTL_LEAF(mib, miblen_name, "wait_histogram", wait_hist,
+	    uint64_t[MUTEX_PROF_WAIT_NBUCKETS]);
 }
 
 static void
@@ -181,7 +224,7 @@ mutex_stats_read_arena(size_t mib[], size_t miblen, const char *name,
     emitter_col_t *col_name,
     emitter_col_t col_uint64_t[mutex_prof_num_uint64_t_counters],
     emitter_col_t col_uint32_t[mutex_prof_num_uint32_t_counters],
-    uint64_t uptime) {
+    uint64_t wait_hist[MUTEX_PROF_WAIT_NBUCKETS], uint64_t uptime) {
 	CTL_LEAF_PREPARE(mib, miblen, name);
 	size_t miblen_name = miblen + 1;
 
@@ -207,13 +250,15 @@ mutex_stats_read_arena(size_t mib[], size_t miblen, const char *name,
 #undef OP
 #undef EMITTER_TYPE_uint32_t
 #undef EMITTER_TYPE_uint64_t
+	CTL_LEAF(mib, miblen_name, "wait_histogram", wait_hist,
+	    uint64_t[MUTEX_PROF_WAIT_NBUCKETS]);
 }
 
 static void
 mutex_stats_read_arena_bin(size_t mib[], size_t miblen,
     emitter_col_t col_uint64_t[mutex_prof_num_uint64_t_counters],
     emitter_col_t col_uint32_t[mutex_prof_num_uint32_t_counters],
-    uint64_t uptime) {
+    uint64_t wait_hist[MUTEX_PROF_WAIT_NBUCKETS], uint64_t uptime) {
 	CTL_LEAF_PREPARE(mib, miblen, "mutex");
 	size_t miblen_mutex = miblen + 1;
 
@@ -238,13 +283,16 @@ mutex_stats_read_arena_bin(size_t mib[], size_t miblen,
 #undef OP
 #undef EMITTER_TYPE_uint32_t
 #undef EMITTER_TYPE_uint64_t
+	CTL_LEAF(mib, miblen_mutex, "wait_histogram", wait_hist,
+	    uint64_t[MUTEX_PROF_WAIT_NBUCKETS]);
 }
 
 /* "row" can be NULL to avoid emitting in table mode. */
 static void
 mutex_stats_emit(emitter_t *emitter, emitter_row_t *row,
     emitter_col_t col_uint64_t[mutex_prof_num_uint64_t_counters],
-    emitter_col_t col_uint32_t[mutex_prof_num_uint32_t_counters]) {
+    emitter_col_t col_uint32_t[mutex_prof_num_uint32_t_counters],
+    const uint64_t wait_hist[MUTEX_PROF_WAIT_NBUCKETS]) {
 	if (row != NULL) {
 		emitter_table_row(emitter, row);
 	}
@@ -267,6 +315,19 @@ mutex_stats_emit(emitter_t *emitter, emitter_row_t *row,
 #undef OP
 #undef EMITTER_TYPE_uint32_t
 #undef EMITTER_TYPE_uint64_t
+
+	/*
+	 * JSON only; OpenMetrics samples of the buckets would all get the same
+	 * name.
+	 */
+	if (emitter_outputs_json(emitter)) {
+		emitter_json_array_kv_begin(emitter, "wait_histogram");
+		for (unsigned i = 0; i < MUTEX_PROF_WAIT_NBUCKETS; i++) {
+			emitter_json_value(emitter, emitter_type_uint64,
+			    &wait_hist[i]);
+		}
+		emitter_json_array_end(emitter);
+	}
 }
 
 #define COL_DECLARE(column_name)					\
@@ -301,6 +362,191 @@ mutex_stats_emit(emitter_t *emitter, emitter_row_t *row,
 	COL_HDR_INIT(row_name, column_name, human, left_or_right,	\
 	    col_width, etype)
 
+JEMALLOC_COLD
+static void
+stats_mutex_holders_print(emitter_t *emitter) {
+	mutex_prof_holder_t holders[MUTEX_PROF_NHOLDERS];
+	unsigned nholders = 0;
+
+	size_t stats_holders_mib[CTL_MAX_DEPTH];
+	CTL_LEAF_PREPARE(stats_holders_mib, 0, "stats.mutexes.holders");
+	for (size_t i = 0; i < MUTEX_PROF_NHOLDERS; i++) {
+		mutex_prof_holder_t holder;
+		stats_holders_mib[3] = i;
+		CTL_LEAF(stats_holders_mib, 4, "site", &holder.site,
+		    const char *);
+		if (holder.site == NULL) {
+			continue;
+		}
+		CTL_LEAF(stats_holders_mib, 4, "num_wait",
+		    &holder.n_wait_times, uint64_t);
+		CTL_LEAF(stats_holders_mib, 4, "total_wait_time",
+		    &holder.tot_wait_time, uint64_t);
+		/* Insertion sort, by total wait time, descending. */
+		unsigned j = nholders++;
+		for (; j > 0 && holders[j - 1].tot_wait_time <
+		    holder.tot_wait_time; j--) {
+			holders[j] = holders[j - 1];
+		}
+		holders[j] = holder;
+	}
+
+	emitter_row_t header_row;
+	emitter_row_init(&header_row);
+
+	emitter_row_t row;
+	emitter_row_init(&row);
+
+	COL_HDR(row, site, "mutex holders:", left, 40, title)
+	COL_HDR(row, num_wait, "n_waiting", right, 16, uint64)
+	COL_HDR(row, total_wait_time, "total_wait_ns", right, 16, uint64)
+
+	emitter_table_row(emitter, &header_row);
+	emitter_json_array_kv_begin(emitter, "mutex_holders");
+	for (unsigned i = 0; i < nholders; i++) {
+		col_site.str_val = holders[i].site;
+		col_num_wait.uint64_val = holders[i].n_wait_times;
+		col_total_wait_time.uint64_val = holders[i].tot_wait_time;
+		emitter_table_row(emitter, &row);
+
+		emitter_json_object_begin(emitter);
+		emitter_openmetrics_label(emitter, "site", emitter_type_string,
+		    &holders[i].site);
+		emitter_json_kv(emitter, "site", emitter_type_string,
+		    &holders[i].site);
+		emitter_json_kv(emitter, "num_wait", emitter_type_uint64,
+		    &holders[i].n_wait_times);
+		emitter_json_kv(emitter, "total_wait_time",
+		    emitter_type_uint64, &holders[i].tot_wait_time);
+		emitter_json_object_end(emitter);
+	}
+	emitter_json_array_end(emitter); /* Close "mutex_holders". */
+}
+
+JEMALLOC_COLD
+static void
+stats_latency_print(emitter_t *emitter) {
+	emitter_row_t header_row;
+	emitter_row_init(&header_row);
+
+	emitter_row_t row;
+	emitter_row_init(&row);
+
+	COL_HDR(row, tier, "latency (ns):", left, 28, title)
+	COL_HDR(row, nsamples, NULL, right, 13, uint64)
+	COL_HDR(row, mean, NULL, right, 10, uint64)
+	COL_HDR(row, p50, NULL, right, 12, uint64)
+	COL_HDR(row, p99, NULL, right, 12, uint64)
+	COL_HDR(row, p999, NULL, right, 12, uint64)
+
+	emitter_table_row(emitter, &header_row);
+	emitter_json_object_kv_begin(emitter, "latency");
+
+	size_t stats_latency_mib[CTL_MAX_DEPTH];
+	CTL_LEAF_PREPARE(stats_latency_mib, 0, "stats.latency");
+	for (unsigned i = 0; i < latency_num_tiers; i++) {
+		const char *name = latency_tier_names[i];
+		latency_stats_t stats;
+
+		CTL_LEAF_PREPARE(stats_latency_mib, 2, name);
+		CTL_LEAF(stats_latency_mib, 3, "nsamples", &stats.nsamples,
+		    uint64_t);
+		CTL_LEAF(stats_latency_mib, 3, "total_ns", &stats.total_ns,
+		    uint64_t);
+		CTL_LEAF(stats_latency_mib, 3, "histogram", stats.buckets,
+		    uint64_t[LATENCY_NBUCKETS]);
+
+		col_tier.str_val = name;
+		col_nsamples.uint64_val = stats.nsamples;
+		col_mean.uint64_val = (stats.nsamples == 0) ? 0 :
+		    stats.total_ns / stats.nsamples;
+		col_p50.uint64_val = latency_quantile(&stats, 0.5);
+		col_p99.uint64_val = latency_quantile(&stats, 0.99);
+		col_p999.uint64_val = latency_quantile(&stats, 0.999);
+		emitter_table_row(emitter, &row);
+
+		emitter_json_object_kv_begin(emitter, name);
+		emitter_openmetrics_label(emitter, "tier", emitter_type_string,
+		    &name);
+		emitter_json_kv(emitter, "nsamples", emitter_type_uint64,
+		    &stats.nsamples);
+		emitter_json_kv(emitter, "total_ns", emitter_type_uint64,
+		    &stats.total_ns);
+		emitter_json_object_end(emitter);
+	}
+
+	emitter_json_object_end(emitter); /* Close "latency". */
+}
+
+JEMALLOC_COLD
+static void
+stats_pages_print(emitter_t *emitter) {
+	emitter_row_t header_row;
+	emitter_row_init(&header_row);
+
+	emitter_row_t row;
+	emitter_row_init(&row);
+
+	COL_HDR(row, caller, "pages:", left, 7, title)
+	COL_HDR(row, op, NULL, left, 14, title)
+	COL_HDR(row, ncalls, NULL, right, 13, uint64)
+	COL_HDR(row, bytes, NULL, right, 17, uint64)
+	COL_HDR(row, total_ns, NULL, right, 17, uint64)
+	COL_HDR(row, mean_ns, NULL, right, 12, uint64)
+
+	emitter_table_row(emitter, &header_row);
+	emitter_json_object_kv_begin(emitter, "pages");
+
+	size_t stats_pages_mib[CTL_MAX_DEPTH];
+	CTL_LEAF_PREPARE(stats_pages_mib, 0, "stats.pages");
+	for (unsigned i = 0; i < pages_num_callers; i++) {
+		const char *caller = pages_caller_names[i];
+
+		CTL_LEAF_PREPARE(stats_pages_mib, 2, caller);
+		emitter_json_object_kv_begin(emitter, caller);
+		emitter_openmetrics_label(emitter, "caller",
+		    emitter_type_string, &caller);
+		for (unsigned j = 0; j < pages_num_ops; j++) {
+			const char *op = pages_op_names[j];
+			pages_stats_t stats;
+
+			CTL_LEAF_PREPARE(stats_pages_mib, 3, op);
+			CTL_LEAF(stats_pages_mib, 4, "ncalls", &stats.ncalls,
+			    uint64_t);
+			CTL_LEAF(stats_pages_mib, 4, "bytes", &stats.bytes,
+			    uint64_t);
+			CTL_LEAF(stats_pages_mib, 4, "total_ns",
+			    &stats.total_ns, uint64_t);
+
+			/* Most combinations never happen; skip them. */
+			if (stats.ncalls != 0) {
+				col_caller.str_val = caller;
+				col_op.str_val = op;
+				col_ncalls.uint64_val = stats.ncalls;
+				col_bytes.uint64_val = stats.bytes;
+				col_total_ns.uint64_val = stats.total_ns;
+				col_mean_ns.uint64_val = stats.total_ns /
+				    stats.ncalls;
+				emitter_table_row(emitter, &row);
+			}
+
+			emitter_json_object_kv_begin(emitter, op);
+			emitter_openmetrics_label(emitter, "op",
+			    emitter_type_string, &op);
+			emitter_json_kv(emitter, "ncalls", emitter_type_uint64,
+			    &stats.ncalls);
+			emitter_json_kv(emitter, "bytes", emitter_type_uint64,
+			    &stats.bytes);
+			emitter_json_kv(emitter, "total_ns",
+			    emitter_type_uint64, &stats.total_ns);
+			emitter_json_object_end(emitter); /* Close op. */
+		}
+		emitter_json_object_end(emitter); /* Close caller. */
+	}
+
+	emitter_json_object_end(emitter); /* Close "pages". */
+}
+
 JEMALLOC_COLD
 static void
 stats_arena_bins_print(emitter_t *emitter, bool mutex, unsigned i,
@@ -376,6 +622,7 @@ stats_arena_bins_print(emitter_t *emitter, bool mutex, unsigned i,
 
 	emitter_col_t header_mutex64[mutex_prof_num_uint64_t_counters];
 	emitter_col_t header_mutex32[mutex_prof_num_uint32_t_counters];
+	uint64_t mutex_wait_hist[MUTEX_PROF_WAIT_NBUCKETS];
 
 	if (mutex) {
 		mutex_stats_init_cols(&row, NULL, NULL, col_mutex64,
@@ -475,10 +722,14 @@ stats_arena_bins_print(emitter_t *emitter, bool mutex, unsigned i,
 
 		if (mutex) {
 			mutex_stats_read_arena_bin(stats_arenas_mib, 5,
-			    col_mutex64, col_mutex32, uptime);
+			    col_mutex64, col_mutex32, mutex_wait_hist, uptime);
 		}
 
 		emitter_json_object_begin(emitter);
+		emitter_openmetrics_label(emitter, "bin", emitter_type_unsigned,
+		    &j);
+		emitter_openmetrics_label(emitter, "size", emitter_type_size,
+		    &reg_size);
 		emitter_json_kv(emitter, "nmalloc", emitter_type_uint64,
 		    &nmalloc);
 		emitter_json_kv(emitter, "ndalloc", emitter_type_uint64,
@@ -518,7 +769,7 @@ stats_arena_bins_print(emitter_t *emitter, bool mutex, unsigned i,
 		if (mutex) {
 			emitter_json_object_kv_begin(emitter, "mutex");
 			mutex_stats_emit(emitter, NULL, col_mutex64,
-			    col_mutex32);
+			    col_mutex32, mutex_wait_hist);
 			emitter_json_object_end(emitter);
 		}
 		emitter_json_object_end(emitter);
@@ -693,7 +944,15 @@ stats_arena_lextents_print(emitter_t *emitter, unsigned i, uint64_t uptime) {
 			    prof_stats_t);
 		}
 
+		if (in_gap && !emitter_outputs_json(emitter)) {
+			continue;
+		}
+
 		emitter_json_object_begin(emitter);
+		emitter_openmetrics_label(emitter, "lextent",
+		    emitter_type_unsigned, &j);
+		emitter_openmetrics_label(emitter, "size", emitter_type_size,
+		    &lextent_size);
 		if (prof_stats_on) {
 			emitter_json_kv(emitter, "prof_live_requested",
 			    emitter_type_uint64, &prof_live.req_sum);
@@ -795,7 +1054,16 @@ stats_arena_extents_print(emitter_t *emitter, unsigned i) {
 			    "                     ---\n");
 		}
 
+		if (in_gap && !emitter_outputs_json(emitter)) {
+			continue;
+		}
+
+		size_t extent_size = sz_pind2sz(j);
 		emitter_json_object_begin(emitter);
+		emitter_openmetrics_label(emitter, "pind", emitter_type_unsigned,
+		    &j);
+		emitter_openmetrics_label(emitter, "size", emitter_type_size,
+		    &extent_size);
 		emitter_json_kv(emitter, "ndirty", emitter_type_size, &ndirty);
 		emitter_json_kv(emitter, "nmuzzy", emitter_type_size, &nmuzzy);
 		emitter_json_kv(emitter, "nretained", emitter_type_size,
@@ -809,7 +1077,7 @@ stats_arena_extents_print(emitter_t *emitter, unsigned i) {
 		    &retained_bytes);
 		emitter_json_object_end(emitter);
 
-		col_size.size_val = sz_pind2sz(j);
+		col_size.size_val = extent_size;
 		col_ind.size_val = j;
 		col_ndirty.size_val = ndirty;
 		col_dirty.size_val = dirty_bytes;
@@ -921,8 +1189,8 @@ stats_arena_hpa_shard_print(emitter_t *emitter, unsigned i, uint64_t uptime) {
 	    &npageslabs_huge);
 	emitter_json_kv(emitter, "nactive_huge", emitter_type_size,
 	    &nactive_huge);
-	emitter_json_kv(emitter, "nactive_huge", emitter_type_size,
-	    &nactive_huge);
+	emitter_json_kv(emitter, "ndirty_huge", emitter_type_size,
+	    &ndirty_huge);
 	emitter_json_kv(emitter, "npageslabs_nonhuge", emitter_type_size,
 	    &npageslabs_nonhuge);
 	emitter_json_kv(emitter, "nactive_nonhuge", emitter_type_size,
@@ -964,8 +1232,8 @@ stats_arena_hpa_shard_print(emitter_t *emitter, unsigned i, uint64_t uptime) {
 	    &npageslabs_huge);
 	emitter_json_kv(emitter, "nactive_huge", emitter_type_size,
 	    &nactive_huge);
-	emitter_json_kv(emitter, "nactive_huge", emitter_type_size,
-	    &nactive_huge);
+	emitter_json_kv(emitter, "ndirty_huge", emitter_type_size,
+	    &ndirty_huge);
 	emitter_json_kv(emitter, "npageslabs_nonhuge", emitter_type_size,
 	    &npageslabs_nonhuge);
 	emitter_json_kv(emitter, "nactive_nonhuge", emitter_type_size,
@@ -1033,7 +1301,16 @@ stats_arena_hpa_shard_print(emitter_t *emitter, unsigned i, uint64_t uptime) {
 			emitter_table_row(emitter, &row);
 		}
 
+		if (in_gap && !emitter_outputs_json(emitter)) {
+			continue;
+		}
+
+		size_t psz = sz_pind2sz(j);
 		emitter_json_object_begin(emitter);
+		emitter_openmetrics_label(emitter, "pind", emitter_type_unsigned,
+		    &j);
+		emitter_openmetrics_label(emitter, "size", emitter_type_size,
+		    &psz);
 		emitter_json_kv(emitter, "npageslabs_huge", emitter_type_size,
 		    &npageslabs_huge);
 		emitter_json_kv(emitter, "nactive_huge", emitter_type_size,
@@ -1061,6 +1338,7 @@ stats_arena_mutexes_print(emitter_t *emitter, unsigned arena_ind, uint64_t uptim
 	emitter_col_t col_name;
 	emitter_col_t col64[mutex_prof_num_uint64_t_counters];
 	emitter_col_t col32[mutex_prof_num_uint32_t_counters];
+	uint64_t wait_hist[MUTEX_PROF_WAIT_NBUCKETS];
 
 	emitter_row_init(&row);
 	mutex_stats_init_cols(&row, "", &col_name, col64, col32);
@@ -1077,9 +1355,11 @@ stats_arena_mutexes_print(emitter_t *emitter, unsigned arena_ind, uint64_t uptim
 	    i++) {
 		const char *name = arena_mutex_names[i];
 		emitter_json_object_kv_begin(emitter, name);
+		emitter_openmetrics_label(emitter, "mutex", emitter_type_string,
+		    &name);
 		mutex_stats_read_arena(stats_arenas_mib, 4, name, &col_name,
-		    col64, col32, uptime);
-		mutex_stats_emit(emitter, &row, col64, col32);
+		    col64, col32, wait_hist, uptime);
+		mutex_stats_emit(emitter, &row, col64, col32, wait_hist);
 		emitter_json_object_end(emitter); /* Close the mutex dict. */
 	}
 	emitter_json_object_end(emitter); /* End "mutexes". */
@@ -1428,14 +1708,16 @@ static void
 stats_general_print(emitter_t *emitter) {
 	const char *cpv;
 	bool bv, bv2;
+	int iv;
 	unsigned uv;
 	uint32_t u32v;
 	uint64_t u64v;
 	int64_t i64v;
 	ssize_t ssv, ssv2;
-	size_t sv, bsz, usz, u32sz, u64sz, i64sz, ssz, sssz, cpsz;
+	size_t sv, bsz, isz, usz, u32sz, u64sz, i64sz, ssz, sssz, cpsz;
 
 	bsz = sizeof(bool);
+	isz = sizeof(int);
 	usz = sizeof(unsigned);
 	ssz = sizeof(size_t);
 	sssz = sizeof(ssize_t);
@@ -1495,6 +1777,8 @@ stats_general_print(emitter_t *emitter) {
 #define OPT_WRITE_BOOL_MUTABLE(name, altname)				\
 	OPT_WRITE_MUTABLE(name, bv, bv2, bsz, emitter_type_bool, altname)
 
+#define OPT_WRITE_INT(name)						\
+	OPT_WRITE(name, iv, isz, emitter_type_int)
 #define OPT_WRITE_UNSIGNED(name)					\
 	OPT_WRITE(name, uv, usz, emitter_type_unsigned)
 
@@ -1555,10 +1839,16 @@ stats_general_print(emitter_t *emitter) {
 	OPT_WRITE_BOOL("cache_oblivious")
 	OPT_WRITE_BOOL("confirm_conf")
 	OPT_WRITE_BOOL("retain")
+	OPT_WRITE_UNSIGNED("retain_lookahead_ms")
 	OPT_WRITE_CHAR_P("dss")
+	OPT_WRITE_CHAR_P("hugetlb")
+	OPT_WRITE_CHAR_P("hugetlb_path")
+	OPT_WRITE_CHAR_P("prefault")
+	OPT_WRITE_SIZE_T("prefault_reserve")
 	OPT_WRITE_UNSIGNED("narenas")
 	OPT_WRITE_CHAR_P("percpu_arena")
 	OPT_WRITE_SIZE_T("oversize_threshold")
+	OPT_WRITE_SIZE_T("nontemporal_threshold")
 	OPT_WRITE_BOOL("hpa")
 	OPT_WRITE_SIZE_T("hpa_slab_max_alloc")
 	OPT_WRITE_SIZE_T("hpa_hugification_threshold")
@@ -1589,6 +1879,7 @@ stats_general_print(emitter_t *emitter) {
 	OPT_WRITE_SIZE_T("hpa_sec_batch_fill_extra")
 	OPT_WRITE_CHAR_P("metadata_thp")
 	OPT_WRITE_INT64("mutex_max_spin")
+	OPT_WRITE_BOOL("mutex_prof_holders")
 	OPT_WRITE_BOOL_MUTABLE("background_thread", "background_thread")
 	OPT_WRITE_SSIZE_T_MUTABLE("dirty_decay_ms", "arenas.dirty_decay_ms")
 	OPT_WRITE_SSIZE_T_MUTABLE("muzzy_decay_ms", "arenas.muzzy_decay_ms")
@@ -1615,23 +1906,38 @@ stats_general_print(emitter_t *emitter) {
 	OPT_WRITE_CHAR_P("thp")
 	OPT_WRITE_BOOL("prof")
 	OPT_WRITE_UNSIGNED("prof_bt_max")
+	OPT_WRITE_CHAR_P("prof_backtrace_method")
+	OPT_WRITE_CHAR_P("prof_format")
 	OPT_WRITE_CHAR_P("prof_prefix")
 	OPT_WRITE_BOOL_MUTABLE("prof_active", "prof.active")
 	OPT_WRITE_BOOL_MUTABLE("prof_thread_active_init",
 	    "prof.thread_active_init")
 	OPT_WRITE_SSIZE_T_MUTABLE("lg_prof_sample", "prof.lg_sample")
+	OPT_WRITE_SIZE_T("prof_sample_target")
 	OPT_WRITE_BOOL("prof_accum")
+	OPT_WRITE_BOOL("prof_lifetime")
 	OPT_WRITE_SSIZE_T("lg_prof_interval")
 	OPT_WRITE_BOOL("prof_gdump")
+	OPT_WRITE_SIZE_T("prof_watermark_allocated")
+	OPT_WRITE_SIZE_T("prof_watermark_resident")
+	OPT_WRITE_UNSIGNED("prof_watermark_growth")
+	OPT_WRITE_UNSIGNED("prof_watermark_hysteresis")
+	OPT_WRITE_UNSIGNED("prof_watermark_interval_ms")
 	OPT_WRITE_BOOL("prof_final")
 	OPT_WRITE_BOOL("prof_leak")
 	OPT_WRITE_BOOL("prof_leak_error")
 	OPT_WRITE_BOOL("stats_print")
 	OPT_WRITE_CHAR_P("stats_print_opts")
-	OPT_WRITE_BOOL("stats_print")
-	OPT_WRITE_CHAR_P("stats_print_opts")
 	OPT_WRITE_INT64("stats_interval")
 	OPT_WRITE_CHAR_P("stats_interval_opts")
+	OPT_WRITE_INT64("stats_bg_interval_ms")
+	OPT_WRITE_CHAR_P("stats_bg_opts")
+	OPT_WRITE_BOOL("stats_bg_delta")
+	OPT_WRITE_INT("stats_bg_fd")
+	OPT_WRITE_INT64("stats_ts_interval_ms")
+	OPT_WRITE_SIZE_T("stats_ts_nsamples")
+	OPT_WRITE_BOOL("stats_latency")
+	OPT_WRITE_SIZE_T("lg_stats_latency_sample")
 	OPT_WRITE_CHAR_P("zero_realloc")
 
 	emitter_dict_end(emitter); /* Close "opt". */
@@ -1640,6 +1946,7 @@ stats_general_print(emitter_t *emitter) {
 #undef OPT_WRITE_MUTABLE
 #undef OPT_WRITE_BOOL
 #undef OPT_WRITE_BOOL_MUTABLE
+#undef OPT_WRITE_INT
 #undef OPT_WRITE_UNSIGNED
 #undef OPT_WRITE_SSIZE_T
 #undef OPT_WRITE_SSIZE_T_MUTABLE
@@ -1857,6 +2164,7 @@ stats_print_helper(emitter_t *emitter, bool merged, bool destroyed,
 		emitter_col_t name;
 		emitter_col_t col64[mutex_prof_num_uint64_t_counters];
 		emitter_col_t col32[mutex_prof_num_uint32_t_counters];
+		uint64_t wait_hist[MUTEX_PROF_WAIT_NBUCKETS];
 		uint64_t uptime;
 
 		emitter_row_init(&row);
@@ -1871,15 +2179,33 @@ stats_print_helper(emitter_t *emitter, bool merged, bool destroyed,
 		CTL_LEAF_PREPARE(stats_mutexes_mib, 0, "stats.mutexes");
 		for (int i = 0; i < mutex_prof_num_global_mutexes; i++) {
 			mutex_stats_read_global(stats_mutexes_mib, 2,
-			    global_mutex_names[i], &name, col64, col32, uptime);
+			    global_mutex_names[i], &name, col64, col32,
+			    wait_hist, uptime);
 			emitter_json_object_kv_begin(emitter, global_mutex_names[i]);
-			mutex_stats_emit(emitter, &row, col64, col32);
+			emitter_openmetrics_label(emitter, "mutex",
+			    emitter_type_string, &global_mutex_names[i]);
+			mutex_stats_emit(emitter, &row, col64, col32,
+			    wait_hist);
 			emitter_json_object_end(emitter);
 		}
 
 		emitter_json_object_end(emitter); /* Close "mutexes". */
+
+		bool mutex_prof_holders;
+		CTL_GET("opt.mutex_prof_holders", &mutex_prof_holders, bool);
+		if (mutex_prof_holders) {
+			stats_mutex_holders_print(emitter);
+		}
 	}
 
+	bool stats_latency;
+	CTL_GET("opt.stats_latency", &stats_latency, bool);
+	if (stats_latency) {
+		stats_latency_print(emitter);
+	}
+
+	stats_pages_print(emitter);
+
 	emitter_json_object_end(emitter); /* Close "stats". */
 
 	if (merged || destroyed || unmerged) {
@@ -1913,8 +2239,11 @@ stats_print_helper(emitter_t *emitter, bool merged, bool destroyed,
 		/* Merged stats. */
 		if (merged && (ninitialized > 1 || !unmerged)) {
 			/* Print merged arena stats. */
+			const char *arena_name = "merged";
 			emitter_table_printf(emitter, "Merged arenas stats:\n");
-			emitter_json_object_kv_begin(emitter, "merged");
+			emitter_json_object_kv_begin(emitter, arena_name);
+			emitter_openmetrics_label(emitter, "arena",
+			    emitter_type_string, &arena_name);
 			stats_arena_print(emitter, MALLCTL_ARENAS_ALL, bins,
 			    large, mutex, extents, hpa);
 			emitter_json_object_end(emitter); /* Close "merged". */
@@ -1923,9 +2252,12 @@ stats_print_helper(emitter_t *emitter, bool merged, bool destroyed,
 		/* Destroyed stats. */
 		if (destroyed_initialized && destroyed) {
 			/* Print destroyed arena stats. */
+			const char *arena_name = "destroyed";
 			emitter_table_printf(emitter,
 			    "Destroyed arenas stats:\n");
-			emitter_json_object_kv_begin(emitter, "destroyed");
+			emitter_json_object_kv_begin(emitter, arena_name);
+			emitter_openmetrics_label(emitter, "arena",
+			    emitter_type_string, &arena_name);
 			stats_arena_print(emitter, MALLCTL_ARENAS_DESTROYED,
 			    bins, large, mutex, extents, hpa);
 			emitter_json_object_end(emitter); /* Close "destroyed". */
@@ -1940,6 +2272,8 @@ stats_print_helper(emitter_t *emitter, bool merged, bool destroyed,
 					    sizeof(arena_ind_str), "%u", i);
 					emitter_json_object_kv_begin(emitter,
 					    arena_ind_str);
+					emitter_openmetrics_label(emitter,
+					    "arena", emitter_type_unsigned, &i);
 					emitter_table_printf(emitter,
 					    "arenas[%s]:\n", arena_ind_str);
 					stats_arena_print(emitter, i, bins,
@@ -1953,6 +2287,36 @@ stats_print_helper(emitter_t *emitter, bool merged, bool destroyed,
 	}
 }
 
+/*
+ * The OpenMetrics families that only ever grow (event and operation counts,
+ * cumulative bytes and times); all the others are gauges.
+ */
+static bool
+stats_openmetrics_counter(const char *family) {
+	static const char *const suffixes[] = {
+		"_nmalloc", "_ndalloc", "_nrequests", "_nfills", "_nflushes",
+		"_nreslabs", "_batch_pops", "_batch_failed_pushes",
+		"_batch_pushes", "_batch_pushed_elems",
+		"_npurge", "_nmadvise", "_purged",
+		"_npurge_passes", "_npurges", "_nhugifies", "_ndehugifies",
+		"_num_ops", "_num_wait", "_num_spin_acq", "_num_owner_switch",
+		"_total_wait_time",
+		"_num_runs", "_zero_reallocs", "_abandoned_vm",
+		"_latency_nsamples", "_latency_total_ns",
+		"_pages_ncalls", "_pages_bytes", "_pages_total_ns"
+	};
+	size_t len = strlen(family);
+	for (unsigned i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]);
+	    i++) {
+		size_t suffix_len = strlen(suffixes[i]);
+		if (len >= suffix_len && strcmp(&family[len - suffix_len],
+		    suffixes[i]) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void
 stats_print(write_cb_t *write_cb, void *cbopaque, const char *opts) {
 	int err;
@@ -1995,10 +2359,15 @@ stats_print(write_cb_t *write_cb, void *cbopaque, const char *opts) {
 		}
 	}
 
+	emitter_output_t output = emitter_output_table;
+	if (json) {
+		output = emitter_output_json_compact;
+	} else if (openmetrics) {
+		output = emitter_output_openmetrics;
+	}
 	emitter_t emitter;
-	emitter_init(&emitter,
-	    json ? emitter_output_json_compact : emitter_output_table,
-	    write_cb, cbopaque);
+	emitter_init(&emitter, output, write_cb, cbopaque);
+	emitter_openmetrics_counter_set(&emitter, stats_openmetrics_counter);
 	emitter_begin(&emitter);
 	emitter_table_printf(&emitter, "___ Begin jemalloc statistics ___\n");
 	emitter_json_object_kv_begin(&emitter, "jemalloc");
@@ -2035,6 +2404,384 @@ stats_interval_event_handler(tsd_t *tsd, uint64_t elapsed) {
 	}
 }
 
+void
+stats_bg_hook_get(tsdn_t *tsdn, stats_bg_hook_t *hook) {
+	malloc_mutex_lock(tsdn, &stats_bg_hook_mtx);
+	*hook = stats_bg_hook;
+	malloc_mutex_unlock(tsdn, &stats_bg_hook_mtx);
+}
+
+void
+stats_bg_hook_set(tsdn_t *tsdn, const stats_bg_hook_t *hook) {
+	malloc_mutex_lock(tsdn, &stats_bg_hook_mtx);
+	stats_bg_hook = *hook;
+	malloc_mutex_unlock(tsdn, &stats_bg_hook_mtx);
+}
+
+/* Appends s to the report being collected, growing the buffer as needed. */
+static void
+stats_bg_collect_cb(void *cbopaque, const char *s) {
+	if (stats_bg_report_oom) {
+		return;
+	}
+	size_t len = strlen(s);
+	if (stats_bg_report_len + len + 1 > stats_bg_report_size) {
+		size_t new_size = (stats_bg_report_size == 0) ?
+		    STATS_BG_REPORT_SIZE_MIN : stats_bg_report_size;
+		while (new_size < stats_bg_report_len + len + 1) {
+			new_size <<= 1;
+		}
+		tsdn_t *tsdn = (tsdn_t *)cbopaque;
+		char *new_report = (new_size > SC_LARGE_MAXCLASS) ? NULL :
+		    (char *)iallocztm(tsdn, new_size, sz_size2index(new_size),
+		    false, NULL, true, arena_get(tsdn, 0, false), true);
+		if (new_report == NULL) {
+			stats_bg_report_oom = true;
+			return;
+		}
+		if (stats_bg_report != NULL) {
+			memcpy(new_report, stats_bg_report,
+			    stats_bg_report_len + 1);
+			idalloctm(tsdn, stats_bg_report, NULL, NULL, true, true);
+		}
+		stats_bg_report = new_report;
+		stats_bg_report_size = new_size;
+	}
+	memcpy(&stats_bg_report[stats_bg_report_len], s, len + 1);
+	stats_bg_report_len += len;
+}
+
+/* Writes out the collected report, with ctl_mtx no longer held. */
+static void
+stats_bg_report_write(tsdn_t *tsdn) {
+	stats_bg_hook_t hook;
+	stats_bg_hook_get(tsdn, &hook);
+	const char *s = (stats_bg_report_len != 0) ? stats_bg_report : "";
+	if (hook.write_cb != NULL) {
+		hook.write_cb(hook.cbopaque, s);
+	} else if (opt_stats_bg_fd >= 0) {
+		malloc_write_fd(opt_stats_bg_fd, s, stats_bg_report_len);
+	} else {
+		malloc_write(s);
+	}
+	if (stats_bg_report_oom) {
+		malloc_write("<jemalloc>: Out of memory in background stats "
+		    "output; report truncated\n");
+	}
+	stats_bg_report_len = 0;
+	stats_bg_report_oom = false;
+}
+
+enum {
+#define OP(name) stats_bg_header_##name,
+	CTL_SNAPSHOT_HEADER_FIELDS
+#undef OP
+	stats_bg_header_nfields
+};
+
+#define OP(name, expr) #name,
+static const char *const stats_bg_global_names[] = {
+	CTL_SNAPSHOT_GLOBAL_FIELDS
+};
+static const char *const stats_bg_mutex_names[] = {
+	CTL_SNAPSHOT_MUTEX_FIELDS
+};
+static const char *const stats_bg_arena_names[] = {
+	CTL_SNAPSHOT_ARENA_FIELDS
+};
+static const char *const stats_bg_bin_names[] = {
+	CTL_SNAPSHOT_BIN_FIELDS
+};
+static const char *const stats_bg_lextent_names[] = {
+	CTL_SNAPSHOT_LEXTENT_FIELDS
+};
+#undef OP
+#define STATS_BG_NFIELDS(names) (sizeof(names) / sizeof(const char *))
+
+/*
+ * Emits "<prefix><name> <value> <delta>" for every one of the n values that
+ * changed since the previous report (prev being NULL if there was none).
+ */
+static void
+stats_bg_delta_emit(buf_writer_t *buf_writer, const char *prefix,
+    const char *const *names, size_t n, const uint64_t *cur,
+    const uint64_t *prev) {
+	for (size_t i = 0; i < n; i++) {
+		uint64_t old = (prev != NULL) ? prev[i] : 0;
+		if (cur[i] == old) {
+			continue;
+		}
+		char line[128];
+		malloc_snprintf(line, sizeof(line), "%s%s %"FMTu64" %+"FMTd64
+		    "\n", prefix, names[i], cur[i], (int64_t)(cur[i] - old));
+		buf_writer_cb(buf_writer, line);
+	}
+}
+
+static void
+stats_bg_delta_emit_mutexes(buf_writer_t *buf_writer, const char *prefix,
+    const char *const *mutex_names, size_t nmutexes, const uint64_t *cur,
+    const uint64_t *prev) {
+	const size_t nfields = STATS_BG_NFIELDS(stats_bg_mutex_names);
+	for (size_t i = 0; i < nmutexes; i++) {
+		char mutex_prefix[96];
+		malloc_snprintf(mutex_prefix, sizeof(mutex_prefix), "%s%s.",
+		    prefix, mutex_names[i]);
+		stats_bg_delta_emit(buf_writer, mutex_prefix,
+		    stats_bg_mutex_names, nfields, &cur[i * nfields],
+		    (prev != NULL) ? &prev[i * nfields] : NULL);
+	}
+}
+
+static void
+stats_bg_delta_emit_arena(buf_writer_t *buf_writer, const uint64_t *cur,
+    const uint64_t *prev) {
+	const size_t nmutex_fields = STATS_BG_NFIELDS(stats_bg_mutex_names);
+	const size_t nbin_fields = STATS_BG_NFIELDS(stats_bg_bin_names);
+	const size_t nlextent_fields = STATS_BG_NFIELDS(stats_bg_lextent_names);
+	char prefix[64];
+	char name[96];
+
+	/* The arena index is the first arena field. */
+	if (cur[0] == MALLCTL_ARENAS_DESTROYED) {
+		malloc_snprintf(prefix, sizeof(prefix),
+		    "stats.arenas.destroyed.");
+	} else {
+		malloc_snprintf(prefix, sizeof(prefix), "stats.arenas.%"FMTu64
+		    ".", cur[0]);
+	}
+	size_t pos = STATS_BG_NFIELDS(stats_bg_arena_names);
+	stats_bg_delta_emit(buf_writer, prefix, stats_bg_arena_names, pos, cur,
+	    prev);
+
+	malloc_snprintf(name, sizeof(name), "%smutexes.", prefix);
+	stats_bg_delta_emit_mutexes(buf_writer, name, arena_mutex_names,
+	    mutex_prof_num_arena_mutexes, &cur[pos],
+	    (prev != NULL) ? &prev[pos] : NULL);
+	pos += mutex_prof_num_arena_mutexes * nmutex_fields;
+
+	for (unsigned i = 0; i < SC_NBINS; i++) {
+		malloc_snprintf(name, sizeof(name), "%sbins.%u.", prefix, i);
+		stats_bg_delta_emit(buf_writer, name, stats_bg_bin_names,
+		    nbin_fields, &cur[pos], (prev != NULL) ? &prev[pos] : NULL);
+		pos += nbin_fields;
+		malloc_snprintf(name, sizeof(name), "%sbins.%u.mutex.",
+		    prefix, i);
+		stats_bg_delta_emit(buf_writer, name, stats_bg_mutex_names,
+		    nmutex_fields, &cur[pos],
+		    (prev != NULL) ? &prev[pos] : NULL);
+		pos += nmutex_fields;
+	}
+
+	for (unsigned i = 0; i < SC_NSIZES - SC_NBINS; i++) {
+		malloc_snprintf(name, sizeof(name), "%slextents.%u.", prefix,
+		    i);
+		stats_bg_delta_emit(buf_writer, name, stats_bg_lextent_names,
+		    nlextent_fields, &cur[pos],
+		    (prev != NULL) ? &prev[pos] : NULL);
+		pos += nlextent_fields;
+	}
+}
+
+/*
+ * Reports the values that changed since the previous report, as read from
+ * experimental.stats_snapshot.  Both snapshots come from this process, so
+ * they share a layout; arena records are matched by index.
+ */
+static void
+stats_bg_print_delta(tsdn_t *tsdn) {
+	bool refresh = true;
+	size_t size;
+	if (je_mallctl("experimental.stats_snapshot", NULL, &size,
+	    (void *)&refresh, sizeof(refresh)) != 0) {
+		return;
+	}
+	uint64_t *cur = (uint64_t *)iallocztm(tsdn, size, sz_size2index(size),
+	    false, NULL, true, arena_get(tsdn, 0, false), true);
+	if (cur == NULL) {
+		return;
+	}
+	if (je_mallctl("experimental.stats_snapshot", (void *)cur, &size, NULL,
+	    0) != 0) {
+		idalloctm(tsdn, cur, NULL, NULL, true, true);
+		return;
+	}
+	assert(cur[stats_bg_header_nglobal_fields] ==
+	    STATS_BG_NFIELDS(stats_bg_global_names));
+	assert(cur[stats_bg_header_nmutex_fields] ==
+	    STATS_BG_NFIELDS(stats_bg_mutex_names));
+	const uint64_t *prev = stats_bg_prev;
+
+	buf_writer_t buf_writer;
+	buf_writer_init(tsdn, &buf_writer, stats_bg_collect_cb, (void *)tsdn,
+	    NULL, STATS_BG_BUFSIZE);
+	char line[64];
+	malloc_snprintf(line, sizeof(line), "--- Begin jemalloc statistics "
+	    "delta (epoch %"FMTu64") ---\n", cur[stats_bg_header_epoch]);
+	buf_writer_cb(&buf_writer, line);
+
+	size_t pos = stats_bg_header_nfields;
+	stats_bg_delta_emit(&buf_writer, "stats.", stats_bg_global_names,
+	    STATS_BG_NFIELDS(stats_bg_global_names), &cur[pos],
+	    (prev != NULL) ? &prev[pos] : NULL);
+	pos += STATS_BG_NFIELDS(stats_bg_global_names);
+	stats_bg_delta_emit_mutexes(&buf_writer, "stats.mutexes.",
+	    global_mutex_names, mutex_prof_num_global_mutexes, &cur[pos],
+	    (prev != NULL) ? &prev[pos] : NULL);
+	pos += mutex_prof_num_global_mutexes *
+	    STATS_BG_NFIELDS(stats_bg_mutex_names);
+
+	size_t record_len = cur[stats_bg_header_narena_fields]
+	    + cur[stats_bg_header_narena_mutexes]
+	    * cur[stats_bg_header_nmutex_fields]
+	    + cur[stats_bg_header_nbins] * (cur[stats_bg_header_nbin_fields]
+	    + cur[stats_bg_header_nmutex_fields])
+	    + cur[stats_bg_header_nlextents]
+	    * cur[stats_bg_header_nlextent_fields];
+	uint64_t nprev = (prev != NULL) ? prev[stats_bg_header_narenas] : 0;
+	uint64_t j = 0;
+	for (uint64_t i = 0; i < cur[stats_bg_header_narenas]; i++) {
+		const uint64_t *rec = &cur[pos + i * record_len];
+		/* Records are sorted by arena index in both snapshots. */
+		while (j < nprev && prev[pos + j * record_len] < rec[0]) {
+			j++;
+		}
+		const uint64_t *prev_rec = (j < nprev &&
+		    prev[pos + j * record_len] == rec[0]) ?
+		    &prev[pos + j * record_len] : NULL;
+		stats_bg_delta_emit_arena(&buf_writer, rec, prev_rec);
+	}
+
+	buf_writer_cb(&buf_writer, "--- End jemalloc statistics delta ---\n");
+	buf_writer_terminate(tsdn, &buf_writer);
+
+	if (stats_bg_prev != NULL) {
+		idalloctm(tsdn, stats_bg_prev, NULL, NULL, true, true);
+	}
+	stats_bg_prev = cur;
+}
+
+static uint64_t
+stats_bg_deferred_work(tsdn_t *tsdn) {
+	if (opt_stats_bg_interval_ms < 0) {
+		return BACKGROUND_THREAD_DEFERRED_MAX;
+	}
+	uint64_t interval_ns = (uint64_t)opt_stats_bg_interval_ms * 1000000;
+	nstime_t now;
+	nstime_init_update(&now);
+	if (nstime_ns(&stats_bg_last) == 0) {
+		/* The first report is due one interval after startup. */
+		nstime_copy(&stats_bg_last, &now);
+		return interval_ns;
+	}
+	uint64_t elapsed_ns = 0;
+	if (nstime_compare(&now, &stats_bg_last) > 0) {
+		nstime_t elapsed;
+		nstime_copy(&elapsed, &now);
+		nstime_subtract(&elapsed, &stats_bg_last);
+		elapsed_ns = nstime_ns(&elapsed);
+	}
+	if (elapsed_ns < interval_ns) {
+		return interval_ns - elapsed_ns;
+	}
+
+	/*
+	 * Threads holding ctl_mtx may be waiting for this thread (e.g. to stop
+	 * it), so never block on it; just retry soon.  Nor hold it while the
+	 * report is written out, which may block for arbitrarily long.
+	 */
+	if (ctl_batch_trylock(tsdn)) {
+		return 0;
+	}
+	if (opt_stats_bg_delta) {
+		stats_bg_print_delta(tsdn);
+	} else {
+		je_malloc_stats_print(stats_bg_collect_cb, (void *)tsdn,
+		    opt_stats_bg_opts);
+	}
+	ctl_batch_unlock(tsdn);
+	stats_bg_report_write(tsdn);
+	nstime_copy(&stats_bg_last, &now);
+	return interval_ns;
+}
+
+size_t
+stats_ts_read(tsdn_t *tsdn, stats_ts_sample_t *samples, size_t max) {
+	malloc_mutex_lock(tsdn, &stats_ts_mtx);
+	size_t n = (stats_ts_nsampled < opt_stats_ts_nsamples) ?
+	    (size_t)stats_ts_nsampled : opt_stats_ts_nsamples;
+	if (samples != NULL) {
+		if (n > max) {
+			n = max;
+		}
+		for (size_t i = 0; i < n; i++) {
+			uint64_t ind = stats_ts_nsampled - n + i;
+			samples[i] = stats_ts_ring[ind % opt_stats_ts_nsamples];
+		}
+	}
+	malloc_mutex_unlock(tsdn, &stats_ts_mtx);
+	return n;
+}
+
+static uint64_t
+stats_ts_deferred_work(tsdn_t *tsdn) {
+	if (opt_stats_ts_interval_ms < 0) {
+		return BACKGROUND_THREAD_DEFERRED_MAX;
+	}
+	uint64_t interval_ns = (uint64_t)opt_stats_ts_interval_ms * 1000000;
+	nstime_t now;
+	nstime_init_update(&now);
+	/* Unlike reports, the first sample is taken right away. */
+	if (nstime_ns(&stats_ts_last) != 0) {
+		uint64_t elapsed_ns = 0;
+		if (nstime_compare(&now, &stats_ts_last) > 0) {
+			nstime_t elapsed;
+			nstime_copy(&elapsed, &now);
+			nstime_subtract(&elapsed, &stats_ts_last);
+			elapsed_ns = nstime_ns(&elapsed);
+		}
+		if (elapsed_ns < interval_ns) {
+			return interval_ns - elapsed_ns;
+		}
+	}
+
+	if (stats_ts_ring == NULL) {
+		stats_ts_sample_t *ring = (stats_ts_sample_t *)base_alloc(tsdn,
+		    b0get(), opt_stats_ts_nsamples * sizeof(stats_ts_sample_t),
+		    CACHELINE);
+		if (ring == NULL) {
+			nstime_copy(&stats_ts_last, &now);
+			return interval_ns;
+		}
+		malloc_mutex_lock(tsdn, &stats_ts_mtx);
+		stats_ts_ring = ring;
+		malloc_mutex_unlock(tsdn, &stats_ts_mtx);
+	}
+	/* As for reports, never block on ctl_mtx; just retry soon. */
+	stats_ts_sample_t sample;
+	if (ctl_stats_ts_sample(tsdn, &sample)) {
+		return 0;
+	}
+	malloc_mutex_lock(tsdn, &stats_ts_mtx);
+	stats_ts_ring[stats_ts_nsampled % opt_stats_ts_nsamples] = sample;
+	stats_ts_nsampled++;
+	malloc_mutex_unlock(tsdn, &stats_ts_mtx);
+	nstime_copy(&stats_ts_last, &now);
+	return interval_ns;
+}
+
+bool
+stats_deferred_work_enabled(void) {
+	return opt_stats_bg_interval_ms >= 0 || opt_stats_ts_interval_ms >= 0;
+}
+
+uint64_t
+stats_deferred_work(tsdn_t *tsdn) {
+	uint64_t ns_bg = stats_bg_deferred_work(tsdn);
+	uint64_t ns_ts = stats_ts_deferred_work(tsdn);
+	return (ns_bg < ns_ts) ? ns_bg : ns_ts;
+}
+
 bool
 stats_boot(void) {
 	uint64_t stats_interval;
@@ -2056,20 +2803,35 @@ stats_boot(void) {
 		stats_interval_accum_batch = batch;
 	}
 
+	if (malloc_mutex_init(&stats_bg_hook_mtx, "stats_bg_hook",
+	    WITNESS_RANK_STATS_BG_HOOK, malloc_mutex_rank_exclusive)) {
+		return true;
+	}
+	if (malloc_mutex_init(&stats_ts_mtx, "stats_ts", WITNESS_RANK_STATS_TS,
+	    malloc_mutex_rank_exclusive)) {
+		return true;
+	}
+
 	return counter_accum_init(&stats_interval_accumulated, stats_interval);
 }
 
 void
 stats_prefork(tsdn_t *tsdn) {
 	counter_prefork(tsdn, &stats_interval_accumulated);
+	malloc_mutex_prefork(tsdn, &stats_bg_hook_mtx);
+	malloc_mutex_prefork(tsdn, &stats_ts_mtx);
 }
 
 void
 stats_postfork_parent(tsdn_t *tsdn) {
 	counter_postfork_parent(tsdn, &stats_interval_accumulated);
+	malloc_mutex_postfork_parent(tsdn, &stats_bg_hook_mtx);
+	malloc_mutex_postfork_parent(tsdn, &stats_ts_mtx);
 }
 
 void
 stats_postfork_child(tsdn_t *tsdn) {
 	counter_postfork_child(tsdn, &stats_interval_accumulated);
+	malloc_mutex_postfork_child(tsdn, &stats_bg_hook_mtx);
+	malloc_mutex_postfork_child(tsdn, &stats_ts_mtx);
 }
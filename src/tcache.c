@@ -3,7 +3,9 @@
 
 #include "jemalloc/internal/assert.h"
 #include "jemalloc/internal/base.h"
+#include "jemalloc/internal/latency.h"
 #include "jemalloc/internal/mutex.h"
+#include "jemalloc/internal/probe.h"
 #include "jemalloc/internal/safety_check.h"
 #include "jemalloc/internal/san.h"
 #include "jemalloc/internal/sc.h"
@@ -246,6 +248,7 @@ tcache_alloc_small_hard(tsdn_t *tsdn, arena_t *arena,
     bool *tcache_success) {
 	tcache_slow_t *tcache_slow = tcache->tcache_slow;
 	void *ret;
+	uint64_t start = latency_begin(tsdn);
 
 	assert(tcache_slow->arena != NULL);
 	assert(!tcache_bin_disabled(binind, cache_bin, tcache_slow));
@@ -254,10 +257,13 @@ tcache_alloc_small_hard(tsdn_t *tsdn, arena_t *arena,
 	if (nfill == 0) {
 		nfill = 1;
 	}
+	uint64_t fill_start = latency_begin(tsdn);
 	arena_cache_bin_fill_small(tsdn, arena, cache_bin, binind, nfill);
+	latency_end(tsdn, latency_tier_arena_cache_bin_fill_small, fill_start);
 	tcache_slow->bin_refilled[binind] = true;
 	ret = cache_bin_alloc(cache_bin, tcache_success);
 
+	latency_end(tsdn, latency_tier_tcache_alloc_small_hard, start);
 	return ret;
 }
 
@@ -603,6 +609,9 @@ tcache_bin_flush_impl_small(tsd_t *tsd, tcache_t *tcache, cache_bin_t *cache_bin
 			cache_bin->tstats.nrequests = 0;
 			malloc_mutex_unlock(tsdn, &bin->lock);
 	}
+	if (config_stats) {
+		arena_stats_touch(tcache_arena);
+	}
 }
 
 JEMALLOC_ALWAYS_INLINE void
@@ -707,6 +716,9 @@ tcache_bin_flush_impl_large(tsd_t *tsd, tcache_t *tcache, cache_bin_t *cache_bin
 		    cache_bin->tstats.nrequests);
 		cache_bin->tstats.nrequests = 0;
 	}
+	if (config_stats) {
+		arena_stats_touch(tcache_arena);
+	}
 }
 
 JEMALLOC_ALWAYS_INLINE void
@@ -753,6 +765,7 @@ tcache_bin_flush_bottom(tsd_t *tsd, tcache_t *tcache, cache_bin_t *cache_bin,
 		rem = ncached;
 	}
 	cache_bin_sz_t nflush = ncached - (cache_bin_sz_t)rem;
+	JE_PROBE3(tcache_bin_flush, binind, nflush, rem);
 
 	CACHE_BIN_PTR_ARRAY_DECLARE(ptrs, nflush);
 	cache_bin_init_ptr_array_for_flush(cache_bin, &ptrs, nflush);
@@ -766,8 +779,10 @@ tcache_bin_flush_bottom(tsd_t *tsd, tcache_t *tcache, cache_bin_t *cache_bin,
 void
 tcache_bin_flush_small(tsd_t *tsd, tcache_t *tcache, cache_bin_t *cache_bin,
     szind_t binind, unsigned rem) {
+	uint64_t start = latency_begin(tsd_tsdn(tsd));
 	tcache_bin_flush_bottom(tsd, tcache, cache_bin, binind, rem,
 	    /* small */ true);
+	latency_end(tsd_tsdn(tsd), latency_tier_tcache_bin_flush_small, start);
 }
 
 void
@@ -1386,6 +1401,7 @@ tcache_stats_merge(tsdn_t *tsdn, tcache_t *tcache, arena_t *arena) {
 		}
 		cache_bin->tstats.nrequests = 0;
 	}
+	arena_stats_touch(arena);
 }
 
 static bool
@@ -295,7 +295,7 @@ extent_dalloc_unmap(extent_hooks_t *extent_hooks, void *addr, size_t size,
 	if (!maps_coalesce && opt_retain) {
 		return true;
 	}
-	pages_unmap(addr, size);
+	pages_unmap(pages_caller_pac, addr, size);
 	return false;
 }
 
@@ -176,6 +176,59 @@ TEST_BEGIN(test_buf_write_pipe) {
 }
 TEST_END
 
+static char test_bytes_out[UNIT_MAX * 4];
+static size_t test_bytes_out_len;
+
+static void
+test_write_bytes_cb(void *cbopaque, const void *bytes, size_t len) {
+	assert_zu_le(test_bytes_out_len + len, sizeof(test_bytes_out),
+	    "Test write overflowed");
+	memcpy(test_bytes_out + test_bytes_out_len, bytes, len);
+	test_bytes_out_len += len;
+}
+
+static void
+test_buf_writer_bytes_body(tsdn_t *tsdn, buf_writer_t *buf_writer) {
+	unsigned char in[UNIT_MAX * 4];
+	for (size_t i = 0; i < sizeof(in); i++) {
+		/* Plenty of embedded NULs. */
+		in[i] = (unsigned char)(i % 7 == 0 ? 0 : i);
+	}
+	test_bytes_out_len = 0;
+	buf_writer_set_bytes_cb(buf_writer, test_write_bytes_cb);
+	size_t off = 0;
+	for (size_t n = 1; off + n <= UNIT_MAX * 3; n++) {
+		buf_writer_bytes(buf_writer, in + off, n);
+		off += n;
+	}
+	buf_writer_cb(buf_writer, "tail");
+	memcpy(in + off, "tail", 4);
+	off += 4;
+	buf_writer_terminate(tsdn, buf_writer);
+	expect_zu_eq(test_bytes_out_len, off, "Incorrect output length");
+	expect_d_eq(memcmp(test_bytes_out, in, off), 0,
+	    "Output should match input byte for byte");
+}
+
+TEST_BEGIN(test_buf_write_bytes) {
+	buf_writer_t buf_writer;
+	tsdn_t *tsdn = tsdn_fetch();
+	assert_false(buf_writer_init(tsdn, &buf_writer, test_write_cb, &arg,
+	    test_buf, TEST_BUF_SIZE),
+	    "buf_writer_init() should not encounter error on static buffer");
+	test_buf_writer_bytes_body(tsdn, &buf_writer);
+}
+TEST_END
+
+TEST_BEGIN(test_buf_write_bytes_oom) {
+	buf_writer_t buf_writer;
+	tsdn_t *tsdn = tsdn_fetch();
+	assert_true(buf_writer_init(tsdn, &buf_writer, test_write_cb, &arg,
+	    NULL, SC_LARGE_MAXCLASS + 1), "buf_writer_init() should OOM");
+	test_buf_writer_bytes_body(tsdn, &buf_writer);
+}
+TEST_END
+
 TEST_BEGIN(test_buf_write_pipe_oom) {
 	buf_writer_t buf_writer;
 	tsdn_t *tsdn = tsdn_fetch();
@@ -192,5 +245,7 @@ main(void) {
 	    test_buf_write_dynamic,
 	    test_buf_write_oom,
 	    test_buf_write_pipe,
-	    test_buf_write_pipe_oom);
+	    test_buf_write_pipe_oom,
+	    test_buf_write_bytes,
+	    test_buf_write_bytes_oom);
 }
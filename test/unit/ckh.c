@@ -202,10 +202,64 @@ TEST_BEGIN(test_insert_iter_remove) {
 }
 TEST_END
 
+TEST_BEGIN(test_hashed) {
+#define NITEMS ZU(1000)
+	tsd_t *tsd;
+	ckh_t ckh;
+	void *p[NITEMS];
+	void *q, *r;
+	size_t hashes[2];
+	size_t i;
+
+	tsd = tsd_fetch();
+
+	expect_false(ckh_new(tsd, &ckh, 2, ckh_pointer_hash,
+	    ckh_pointer_keycomp), "Unexpected ckh_new() error");
+
+	/* Enough items to grow the table (and relocate items) many times. */
+	for (i = 0; i < NITEMS; i++) {
+		p[i] = mallocx(i+1, 0);
+		expect_ptr_not_null(p[i], "Unexpected mallocx() failure");
+		ckh_pointer_hash(p[i], hashes);
+		expect_true(ckh_search_hashed(&ckh, p[i], NULL, NULL, hashes),
+		    "Unexpected ckh_search_hashed() success");
+		expect_false(ckh_insert_hashed(tsd, &ckh, p[i], p[i], hashes),
+		    "Unexpected ckh_insert_hashed() failure");
+	}
+	expect_zu_eq(ckh_count(&ckh), NITEMS,
+	    "ckh_count() should return %zu, but it returned %zu", NITEMS,
+	    ckh_count(&ckh));
+
+	for (i = 0; i < NITEMS; i++) {
+		/* Items inserted with their hashes are found without them. */
+		expect_false(ckh_search(&ckh, p[i], &q, &r),
+		    "Unexpected ckh_search() failure");
+		expect_ptr_eq(p[i], q, "Key pointer mismatch");
+		expect_ptr_eq(p[i], r, "Value pointer mismatch");
+
+		ckh_pointer_hash(p[i], hashes);
+		expect_false(ckh_remove_hashed(tsd, &ckh, p[i], &q, &r,
+		    hashes), "Unexpected ckh_remove_hashed() failure");
+		expect_ptr_eq(p[i], q, "Key pointer mismatch");
+		expect_ptr_eq(p[i], r, "Value pointer mismatch");
+		expect_true(ckh_search_hashed(&ckh, p[i], NULL, NULL, hashes),
+		    "Unexpected ckh_search_hashed() success");
+		dallocx(p[i], 0);
+	}
+
+	expect_zu_eq(ckh_count(&ckh), 0,
+	    "ckh_count() should return %zu, but it returned %zu",
+	    ZU(0), ckh_count(&ckh));
+	ckh_delete(tsd, &ckh);
+#undef NITEMS
+}
+TEST_END
+
 int
 main(void) {
 	return test(
 	    test_new_delete,
 	    test_count_insert_search_remove,
-	    test_insert_iter_remove);
+	    test_insert_iter_remove,
+	    test_hashed);
 }
@@ -68,7 +68,8 @@ static void
 expect_emit_output(void (*emit_fn)(emitter_t *),
     const char *expected_json_output,
     const char *expected_json_compact_output,
-    const char *expected_table_output) {
+    const char *expected_table_output,
+    const char *expected_openmetrics_output) {
 	emitter_t emitter;
 	char buf[MALLOC_PRINTF_BUFSIZE];
 	buf_descriptor_t buf_descriptor;
@@ -100,6 +101,16 @@ expect_emit_output(void (*emit_fn)(emitter_t *),
 	    &buf_descriptor);
 	(*emit_fn)(&emitter);
 	expect_str_eq(expected_table_output, buf, "table output failure");
+
+	buf_descriptor.buf = buf;
+	buf_descriptor.len = MALLOC_PRINTF_BUFSIZE;
+	buf_descriptor.mid_quote = false;
+
+	emitter_init(&emitter, emitter_output_openmetrics, &forwarding_cb,
+	    &buf_descriptor);
+	(*emit_fn)(&emitter);
+	expect_str_eq(expected_openmetrics_output, buf,
+	    "openmetrics output failure");
 }
 
 static void
@@ -145,6 +156,14 @@ static const char *dict_table =
 "  DEF: true\n"
 "  GHI: 123 (note_key1: \"a string\")\n"
 "  JKL: \"a string\" (note_key2: false)\n";
+static const char *dict_openmetrics =
+"# TYPE foo_abc gauge\n"
+"foo_abc 0\n"
+"# TYPE foo_def gauge\n"
+"foo_def 1\n"
+"# TYPE foo_ghi gauge\n"
+"foo_ghi 123\n"
+"# EOF\n";
 
 static void
 emit_table_printf(emitter_t *emitter) {
@@ -162,6 +181,7 @@ static const char *table_printf_json_compact = "{}";
 static const char *table_printf_table =
 "Table note 1\n"
 "Table note 2 with format string\n";
+static const char *table_printf_openmetrics = "# EOF\n";
 
 static void emit_nested_dict(emitter_t *emitter) {
 	int val = 123;
@@ -213,6 +233,12 @@ static const char *nested_dict_table =
 "  Dict 3\n"
 "Dict 4\n"
 "  Another primitive: 123\n";
+static const char *nested_dict_openmetrics =
+"# TYPE json1_json2_primitive gauge\n"
+"json1_json2_primitive 123\n"
+"# TYPE json4_primitive gauge\n"
+"json4_primitive 123\n"
+"# EOF\n";
 
 static void
 emit_types(emitter_t *emitter) {
@@ -272,6 +298,22 @@ static const char *types_table =
 "K6: \"string\"\n"
 "K7: 789\n"
 "K8: 10000000000\n";
+static const char *types_openmetrics =
+"# TYPE k1 gauge\n"
+"k1 0\n"
+"# TYPE k2 gauge\n"
+"k2 -123\n"
+"# TYPE k3 gauge\n"
+"k3 123\n"
+"# TYPE k4 gauge\n"
+"k4 -456\n"
+"# TYPE k5 gauge\n"
+"k5 456\n"
+"# TYPE k7 gauge\n"
+"k7 789\n"
+"# TYPE k8 gauge\n"
+"k8 10000000000\n"
+"# EOF\n";
 
 static void
 emit_modal(emitter_t *emitter) {
@@ -325,6 +367,18 @@ const char *modal_table =
 "    I4: 123\n"
 "    I5: 123\n"
 "  I6: 123\n";
+const char *modal_openmetrics =
+"# TYPE j0_j1_i1 gauge\n"
+"j0_j1_i1 123\n"
+"# TYPE j0_j1_i2 gauge\n"
+"j0_j1_i2 123\n"
+"# TYPE j0_j1_i4 gauge\n"
+"j0_j1_i4 123\n"
+"# TYPE j0_i5 gauge\n"
+"j0_i5 123\n"
+"# TYPE j0_i6 gauge\n"
+"j0_i6 123\n"
+"# EOF\n";
 
 static void
 emit_json_array(emitter_t *emitter) {
@@ -383,6 +437,17 @@ static const char *json_array_json_compact =
 	"}"
 "}";
 static const char *json_array_table = "";
+static const char *json_array_openmetrics =
+"# TYPE dict_arr_foo gauge\n"
+"dict_arr_foo 123\n"
+"# TYPE dict_arr gauge\n"
+"dict_arr 123\n"
+"dict_arr 123\n"
+"# TYPE dict_arr_bar gauge\n"
+"dict_arr_bar 123\n"
+"# TYPE dict_arr_baz gauge\n"
+"dict_arr_baz 123\n"
+"# EOF\n";
 
 static void
 emit_json_nested_array(emitter_t *emitter) {
@@ -450,6 +515,7 @@ static const char *json_nested_array_json_compact =
 	"]"
 "}";
 static const char *json_nested_array_table = "";
+static const char *json_nested_array_openmetrics = "# EOF\n";
 
 static void
 emit_table_row(emitter_t *emitter) {
@@ -502,11 +568,104 @@ static const char *table_row_table =
 "123                  true  456\n"
 "789                 false 1011\n"
 "\"a string\"          false  ghi\n";
+static const char *table_row_openmetrics = "# EOF\n";
+
+static bool
+openmetrics_counter(const char *family) {
+	return strcmp(family, "stats_arenas_bins_nmalloc") == 0;
+}
+
+static void
+emit_openmetrics_labels(emitter_t *emitter) {
+	const char *arenas[] = {"0", "1"};
+	unsigned nthreads = 2;
+	unsigned bin = 3;
+	size_t size = 48;
+	uint64_t nmalloc = 10;
+
+	emitter_openmetrics_counter_set(emitter, openmetrics_counter);
+	emitter_begin(emitter);
+	emitter_json_object_kv_begin(emitter, "stats.arenas");
+	/* The families of both arenas interleave; each must stay together. */
+	for (unsigned i = 0; i < sizeof(arenas) / sizeof(arenas[0]); i++) {
+		emitter_json_object_kv_begin(emitter, arenas[i]);
+		emitter_openmetrics_label(emitter, "arena",
+		    emitter_type_string, &arenas[i]);
+		emitter_json_kv(emitter, "nthreads", emitter_type_unsigned,
+		    &nthreads);
+		emitter_json_array_kv_begin(emitter, "bins");
+		emitter_json_object_begin(emitter);
+		emitter_openmetrics_label(emitter, "bin", emitter_type_unsigned,
+		    &bin);
+		emitter_openmetrics_label(emitter, "size", emitter_type_size,
+		    &size);
+		emitter_json_kv(emitter, "nmalloc", emitter_type_uint64,
+		    &nmalloc);
+		emitter_json_object_end(emitter); /* Close bins[0]. */
+		emitter_json_array_end(emitter); /* Close bins. */
+		emitter_json_object_end(emitter); /* Close arenas[i]. */
+	}
+	emitter_json_object_end(emitter); /* Close "stats.arenas". */
+	emitter_end(emitter);
+}
+
+static const char *openmetrics_labels_json =
+"{\n"
+"\t\"stats.arenas\": {\n"
+"\t\t\"0\": {\n"
+"\t\t\t\"nthreads\": 2,\n"
+"\t\t\t\"bins\": [\n"
+"\t\t\t\t{\n"
+"\t\t\t\t\t\"nmalloc\": 10\n"
+"\t\t\t\t}\n"
+"\t\t\t]\n"
+"\t\t},\n"
+"\t\t\"1\": {\n"
+"\t\t\t\"nthreads\": 2,\n"
+"\t\t\t\"bins\": [\n"
+"\t\t\t\t{\n"
+"\t\t\t\t\t\"nmalloc\": 10\n"
+"\t\t\t\t}\n"
+"\t\t\t]\n"
+"\t\t}\n"
+"\t}\n"
+"}\n";
+static const char *openmetrics_labels_json_compact =
+"{"
+	"\"stats.arenas\":{"
+		"\"0\":{"
+			"\"nthreads\":2,"
+			"\"bins\":["
+				"{"
+					"\"nmalloc\":10"
+				"}"
+			"]"
+		"},"
+		"\"1\":{"
+			"\"nthreads\":2,"
+			"\"bins\":["
+				"{"
+					"\"nmalloc\":10"
+				"}"
+			"]"
+		"}"
+	"}"
+"}";
+static const char *openmetrics_labels_table = "";
+static const char *openmetrics_labels_openmetrics =
+"# TYPE stats_arenas_nthreads gauge\n"
+"stats_arenas_nthreads{arena=\"0\"} 2\n"
+"stats_arenas_nthreads{arena=\"1\"} 2\n"
+"# TYPE stats_arenas_bins_nmalloc counter\n"
+"stats_arenas_bins_nmalloc_total{arena=\"0\",bin=\"3\",size=\"48\"} 10\n"
+"stats_arenas_bins_nmalloc_total{arena=\"1\",bin=\"3\",size=\"48\"} 10\n"
+"# EOF\n";
 
 #define GENERATE_TEST(feature)					\
 TEST_BEGIN(test_##feature) {					\
 	expect_emit_output(emit_##feature, feature##_json,	\
-	    feature##_json_compact, feature##_table);		\
+	    feature##_json_compact, feature##_table,		\
+	    feature##_openmetrics);				\
 }								\
 TEST_END
 
@@ -518,6 +677,7 @@ GENERATE_TEST(modal)
 GENERATE_TEST(json_array)
 GENERATE_TEST(json_nested_array)
 GENERATE_TEST(table_row)
+GENERATE_TEST(openmetrics_labels)
 
 int
 main(void) {
@@ -529,5 +689,6 @@ main(void) {
 	    test_modal,
 	    test_json_array,
 	    test_json_nested_array,
-	    test_table_row);
+	    test_table_row,
+	    test_openmetrics_labels);
 }
@@ -359,11 +359,12 @@ defer_test_unmap(void *ptr, size_t size) {
 }
 
 static bool defer_purge_called = false;
-static void
+static bool
 defer_test_purge(void *ptr, size_t size) {
 	(void)ptr;
 	(void)size;
 	defer_purge_called = true;
+	return false;
 }
 
 static bool defer_hugify_called = false;
@@ -234,11 +234,60 @@ TEST_BEGIN(test_hugify) {
 }
 TEST_END
 
+static void
+do_purge(hpdata_t *hpdata, bool purged_zeroed) {
+	hpdata_alloc_allowed_set(hpdata, false);
+	hpdata_purge_state_t purge_state;
+	hpdata_purge_begin(hpdata, &purge_state);
+	void *purge_addr;
+	size_t purge_size;
+	while (hpdata_purge_next(hpdata, &purge_state, &purge_addr,
+	    &purge_size)) {
+	}
+	if (!purged_zeroed) {
+		purge_state.purged_zeroed = false;
+	}
+	hpdata_purge_end(hpdata, &purge_state);
+	hpdata_alloc_allowed_set(hpdata, true);
+}
+
+TEST_BEGIN(test_zeroed) {
+	hpdata_t hpdata;
+	hpdata_init(&hpdata, HPDATA_ADDR, HPDATA_AGE);
+
+	/* Fresh pages are known to be zero. */
+	void *alloc = hpdata_reserve_alloc(&hpdata, HUGEPAGE / 2);
+	expect_true(hpdata_range_zeroed(&hpdata, alloc, HUGEPAGE / 2), "");
+
+	/* Freed pages aren't, until they're purged. */
+	hpdata_unreserve(&hpdata, alloc, HUGEPAGE / 4);
+	alloc = hpdata_reserve_alloc(&hpdata, HUGEPAGE / 2);
+	expect_ptr_eq((char *)HPDATA_ADDR + HUGEPAGE / 2, alloc,
+	    "Expected first fit to skip the freed range");
+	expect_true(hpdata_range_zeroed(&hpdata, alloc, HUGEPAGE / 2), "");
+	alloc = hpdata_reserve_alloc(&hpdata, HUGEPAGE / 4);
+	expect_ptr_eq(HPDATA_ADDR, alloc, "");
+	expect_false(hpdata_range_zeroed(&hpdata, alloc, HUGEPAGE / 4), "");
+
+	/* Failed purges leave the pages dirty. */
+	hpdata_unreserve(&hpdata, alloc, HUGEPAGE / 4);
+	do_purge(&hpdata, /* purged_zeroed */ false);
+	alloc = hpdata_reserve_alloc(&hpdata, HUGEPAGE / 4);
+	expect_false(hpdata_range_zeroed(&hpdata, alloc, HUGEPAGE / 4), "");
+
+	hpdata_unreserve(&hpdata, alloc, HUGEPAGE / 4);
+	do_purge(&hpdata, /* purged_zeroed */ true);
+	alloc = hpdata_reserve_alloc(&hpdata, HUGEPAGE / 4);
+	expect_true(hpdata_range_zeroed(&hpdata, alloc, HUGEPAGE / 4), "");
+}
+TEST_END
+
 int main(void) {
 	return test_no_reentrancy(
 	    test_reserve_alloc,
 	    test_purge_simple,
 	    test_purge_intervening_dalloc,
 	    test_purge_over_retained,
-	    test_hugify);
+	    test_hugify,
+	    test_zeroed);
 }
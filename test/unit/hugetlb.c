@@ -0,0 +1,158 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/extent_hugetlb.h"
+
+static unsigned
+do_arena_create(extent_hooks_t *h) {
+	unsigned arena_ind;
+	size_t sz = sizeof(unsigned);
+	expect_d_eq(mallctl("arenas.create", (void *)&arena_ind, &sz,
+	    (void *)(h != NULL ? &h : NULL), (h != NULL ? sizeof(h) : 0)), 0,
+	    "Unexpected mallctl() failure");
+	return arena_ind;
+}
+
+static void
+do_arena_ctl(const char *name, unsigned arena_ind) {
+	size_t mib[3];
+	size_t miblen = sizeof(mib) / sizeof(size_t);
+	expect_d_eq(mallctlnametomib(name, mib, &miblen), 0,
+	    "Unexpected mallctlnametomib() failure");
+	mib[1] = (size_t)arena_ind;
+	expect_d_eq(mallctlbymib(mib, miblen, NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctlbymib() failure");
+}
+
+static int
+do_hugetlb(unsigned arena_ind, const char **oldp, const char *newval) {
+	size_t mib[3];
+	size_t miblen = sizeof(mib) / sizeof(size_t);
+	size_t sz = sizeof(const char *);
+	expect_d_eq(mallctlnametomib("arena.0.hugetlb", mib, &miblen), 0,
+	    "Unexpected mallctlnametomib() failure");
+	mib[1] = (size_t)arena_ind;
+	return mallctlbymib(mib, miblen, (void *)oldp,
+	    oldp != NULL ? &sz : NULL, newval != NULL ? (void *)&newval : NULL,
+	    newval != NULL ? sizeof(const char *) : 0);
+}
+
+static void
+expect_hugetlb_mode(unsigned arena_ind, const char *expected) {
+	const char *mode;
+	expect_d_eq(do_hugetlb(arena_ind, &mode, NULL), 0,
+	    "Unexpected arena.<i>.hugetlb failure");
+	expect_str_eq(mode, expected, "Unexpected hugetlb mode");
+}
+
+static bool
+hugetlb_configured(void) {
+	const char *mode;
+	size_t sz = sizeof(mode);
+	expect_d_eq(mallctl("opt.hugetlb", (void *)&mode, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	/* hugetlb.sh asks for 2m; this fails on systems without support. */
+	return strcmp(mode, "2m") == 0;
+}
+
+TEST_BEGIN(test_hugetlb_opt) {
+	test_skip_if(!hugetlb_configured());
+
+	/* Arena 0 is bootstrapped with the default hooks. */
+	expect_hugetlb_mode(0, "disabled");
+	unsigned arena_ind = do_arena_create(NULL);
+	expect_hugetlb_mode(arena_ind, "2m");
+	expect_ptr_eq(extent_hugetlb_hooks_get(hugetlb_mode_2m),
+	    extent_hugetlb_hooks_get(extent_hugetlb_mode_get(
+	    extent_hugetlb_hooks_get(hugetlb_mode_2m))),
+	    "Mode lookup should round-trip");
+
+	/* Explicitly supplied hooks are left alone. */
+	extent_hooks_t *hooks = extent_hugetlb_hooks_get(hugetlb_mode_1g);
+	arena_ind = do_arena_create(hooks);
+	expect_hugetlb_mode(arena_ind, "1g");
+}
+TEST_END
+
+TEST_BEGIN(test_hugetlb_mode_ctl) {
+	test_skip_if(!hugetlb_configured());
+
+	unsigned arena_ind = do_arena_create(NULL);
+	const char *old;
+	expect_d_eq(do_hugetlb(arena_ind, &old, "1g"), 0,
+	    "Unexpected arena.<i>.hugetlb failure");
+	expect_str_eq(old, "2m", "Should return the previous mode");
+	expect_hugetlb_mode(arena_ind, "1g");
+
+	expect_d_eq(do_hugetlb(arena_ind, NULL, "3m"), EINVAL,
+	    "Expected failure for an unknown mode");
+	expect_d_eq(do_hugetlb(arena_ind, NULL, "N/A"), EINVAL,
+	    "Expected failure for the custom hooks placeholder");
+	expect_hugetlb_mode(arena_ind, "1g");
+
+	expect_d_eq(do_hugetlb(arena_ind, NULL, "disabled"), 0,
+	    "Unexpected arena.<i>.hugetlb failure");
+	expect_hugetlb_mode(arena_ind, "disabled");
+
+	expect_d_eq(do_hugetlb(narenas_total_get() + 1, NULL, "2m"), ENOENT,
+	    "Expected failure for a nonexistent arena");
+}
+TEST_END
+
+static void
+do_hugetlb_alloc(const char *mode) {
+	unsigned arena_ind = do_arena_create(NULL);
+	expect_d_eq(do_hugetlb(arena_ind, NULL, mode), 0,
+	    "Unexpected arena.<i>.hugetlb failure");
+	int flags = MALLOCX_ARENA(arena_ind) | MALLOCX_TCACHE_NONE;
+
+	/* Small, large, and huge-page-sized and -aligned requests. */
+	size_t sizes[] = {8, 4096, 100 * 1024, ZU(1) << LG_HUGETLB_2M,
+	    (ZU(3) << LG_HUGETLB_2M) + 4096};
+	void *ptrs[sizeof(sizes) / sizeof(sizes[0])];
+	for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		ptrs[i] = mallocx(sizes[i], flags | MALLOCX_ZERO);
+		expect_ptr_not_null(ptrs[i], "Unexpected mallocx() failure");
+		char *p = (char *)ptrs[i];
+		expect_c_eq(p[0], 0, "Memory should be zeroed");
+		expect_c_eq(p[sizes[i] - 1], 0, "Memory should be zeroed");
+		memset(p, 0xa5, sizes[i]);
+	}
+	void *aligned = mallocx(ZU(1) << LG_HUGETLB_2M,
+	    flags | MALLOCX_ALIGN(ZU(1) << LG_HUGETLB_2M));
+	expect_ptr_not_null(aligned, "Unexpected mallocx() failure");
+	expect_zu_eq((uintptr_t)aligned & ((ZU(1) << LG_HUGETLB_2M) - 1), 0,
+	    "Alignment not honored");
+	memset(aligned, 0x5a, ZU(1) << LG_HUGETLB_2M);
+
+	for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		dallocx(ptrs[i], flags);
+	}
+	dallocx(aligned, flags);
+
+	/* Purged memory must read back as zeros when reused. */
+	do_arena_ctl("arena.0.purge", arena_ind);
+	void *p = mallocx(ZU(1) << LG_HUGETLB_2M, flags | MALLOCX_ZERO);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	for (size_t i = 0; i < (ZU(1) << LG_HUGETLB_2M); i += PAGE) {
+		expect_c_eq(((char *)p)[i], 0, "Memory should be zeroed");
+	}
+	dallocx(p, flags);
+
+	do_arena_ctl("arena.0.destroy", arena_ind);
+}
+
+TEST_BEGIN(test_hugetlb_alloc) {
+	test_skip_if(!hugetlb_configured());
+
+	do_hugetlb_alloc("2m");
+	do_hugetlb_alloc("1g");
+}
+TEST_END
+
+int
+main(void) {
+	return test(
+	    test_hugetlb_opt,
+	    test_hugetlb_mode_ctl,
+	    test_hugetlb_alloc);
+}
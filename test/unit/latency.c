@@ -0,0 +1,178 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/latency.h"
+
+const char *malloc_conf = "stats_latency:true,lg_stats_latency_sample:0";
+
+static uint64_t
+nsamples_get(const char *tier) {
+	char cmd[128];
+	malloc_snprintf(cmd, sizeof(cmd), "stats.latency.%s.nsamples", tier);
+	uint64_t nsamples;
+	size_t sz = sizeof(nsamples);
+	expect_d_eq(mallctl(cmd, (void *)&nsamples, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	return nsamples;
+}
+
+TEST_BEGIN(test_latency_bucket) {
+	expect_u_eq(latency_bucket(0), 0, "");
+	expect_u_eq(latency_bucket(1), 0, "");
+	expect_u_eq(latency_bucket(2), 1, "");
+	expect_u_eq(latency_bucket(3), 1, "");
+	expect_u_eq(latency_bucket(4), 2, "");
+	expect_u_eq(latency_bucket(1000), 9, "");
+	expect_u_eq(latency_bucket((UINT64_C(1) << (LATENCY_NBUCKETS - 1)) - 1),
+	    LATENCY_NBUCKETS - 2, "");
+	expect_u_eq(latency_bucket(UINT64_C(1) << (LATENCY_NBUCKETS - 1)),
+	    LATENCY_NBUCKETS - 1, "");
+	expect_u_eq(latency_bucket(UINT64_MAX), LATENCY_NBUCKETS - 1, "");
+}
+TEST_END
+
+TEST_BEGIN(test_latency_quantile) {
+	latency_stats_t stats = {0};
+	expect_u64_eq(latency_quantile(&stats, 0.5), 0,
+	    "Empty histogram should have no quantiles");
+
+	stats.buckets[4] = 90;
+	stats.buckets[10] = 9;
+	stats.buckets[LATENCY_NBUCKETS - 1] = 1;
+	expect_u64_eq(latency_quantile(&stats, 0.5), 31, "");
+	expect_u64_eq(latency_quantile(&stats, 0.9), 2047, "");
+	expect_u64_eq(latency_quantile(&stats, 0.999),
+	    UINT64_C(1) << (LATENCY_NBUCKETS - 1), "");
+}
+TEST_END
+
+TEST_BEGIN(test_latency_malloc_free) {
+	test_skip_if(!config_stats);
+
+	/* Make sure that the thread's tsd is set up. */
+	free(malloc(1));
+
+	/*
+	 * Debug builds junk fill by default, which keeps malloc() and free()
+	 * off of the fast path; count both.
+	 */
+	uint64_t nmalloc0 = nsamples_get("malloc_fastpath") +
+	    nsamples_get("malloc_slowpath");
+	uint64_t nfree0 = nsamples_get("free_fastpath") +
+	    nsamples_get("free_slowpath");
+	const unsigned nptrs = 10;
+	void *ptrs[10];
+	for (unsigned i = 0; i < nptrs; i++) {
+		ptrs[i] = malloc(1);
+		expect_ptr_not_null(ptrs[i], "Unexpected malloc() failure");
+	}
+	for (unsigned i = 0; i < nptrs; i++) {
+		free(ptrs[i]);
+	}
+	expect_u64_eq(nsamples_get("malloc_fastpath") +
+	    nsamples_get("malloc_slowpath") - nmalloc0, nptrs,
+	    "Every malloc() call should have been timed");
+	expect_u64_eq(nsamples_get("free_fastpath") +
+	    nsamples_get("free_slowpath") - nfree0, nptrs,
+	    "Every free() call should have been timed");
+
+	/* Too large to be cached, so that it reaches the inner tiers. */
+	const size_t large_size = 8 << 20;
+	uint64_t nlarge_alloc0 = nsamples_get("large_alloc");
+	uint64_t nlarge_dalloc0 = nsamples_get("large_dalloc");
+	void *p = malloc(large_size);
+	expect_ptr_not_null(p, "Unexpected malloc() failure");
+	free(p);
+	expect_u64_eq(nsamples_get("large_alloc") - nlarge_alloc0, 1,
+	    "Large allocation should have been timed");
+	expect_u64_eq(nsamples_get("large_dalloc") - nlarge_dalloc0, 1,
+	    "Large deallocation should have been timed");
+
+	/* Outside of sampled malloc() and free() calls, inner tiers aren't. */
+	int flags = MALLOCX_TCACHE_NONE;
+	p = mallocx(large_size, flags);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	dallocx(p, flags);
+	expect_u64_eq(nsamples_get("large_alloc") - nlarge_alloc0, 1,
+	    "Large allocation by mallocx() should not have been timed");
+	expect_u64_eq(nsamples_get("large_dalloc") - nlarge_dalloc0, 1,
+	    "Large deallocation by dallocx() should not have been timed");
+}
+TEST_END
+
+TEST_BEGIN(test_latency_arena_destroy) {
+	test_skip_if(!config_stats);
+
+	unsigned arena_ind;
+	size_t sz = sizeof(arena_ind);
+	expect_d_eq(mallctl("arenas.create", (void *)&arena_ind, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	unsigned old_arena_ind;
+	sz = sizeof(old_arena_ind);
+	expect_d_eq(mallctl("thread.arena", (void *)&old_arena_ind, &sz,
+	    (void *)&arena_ind, sizeof(arena_ind)), 0,
+	    "Unexpected mallctl() failure");
+	free(malloc(1));
+	uint64_t nmalloc0 = nsamples_get("malloc_fastpath") +
+	    nsamples_get("malloc_slowpath");
+	for (unsigned i = 0; i < 10; i++) {
+		free(malloc(1));
+	}
+	expect_d_eq(mallctl("thread.arena", NULL, NULL,
+	    (void *)&old_arena_ind, sizeof(old_arena_ind)), 0,
+	    "Unexpected mallctl() failure");
+	expect_d_eq(mallctl("thread.tcache.flush", NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+
+	/* The histograms of a destroyed arena are still counted. */
+	char cmd[128];
+	malloc_snprintf(cmd, sizeof(cmd), "arena.%u.destroy", arena_ind);
+	expect_d_eq(mallctl(cmd, NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_u64_ge(nsamples_get("malloc_fastpath") +
+	    nsamples_get("malloc_slowpath"), nmalloc0 + 10,
+	    "Destroyed arena's samples should have been kept");
+}
+TEST_END
+
+TEST_BEGIN(test_latency_histogram) {
+	test_skip_if(!config_stats);
+
+	free(malloc(1));
+	const char *tier = (nsamples_get("malloc_fastpath") > 0) ?
+	    "malloc_fastpath" : "malloc_slowpath";
+	char cmd[128];
+	malloc_snprintf(cmd, sizeof(cmd), "stats.latency.%s.histogram", tier);
+	uint64_t buckets[LATENCY_NBUCKETS];
+	size_t sz = sizeof(buckets);
+	expect_d_eq(mallctl(cmd, NULL, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_zu_eq(sz, sizeof(buckets), "Unexpected histogram size");
+	expect_d_eq(mallctl(cmd, (void *)buckets, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	uint64_t total = 0;
+	for (unsigned i = 0; i < LATENCY_NBUCKETS; i++) {
+		total += buckets[i];
+	}
+	expect_u64_gt(total, 0, "Histogram should not be empty");
+	expect_u64_le(total, nsamples_get(tier),
+	    "Histogram should only count timed calls");
+
+	sz = sizeof(buckets) - 1;
+	expect_d_eq(mallctl(cmd, (void *)buckets, &sz, NULL, 0), EINVAL,
+	    "Short buffer should be rejected");
+	uint64_t nsamples = 0;
+	expect_d_eq(mallctl("stats.latency.malloc_fastpath.nsamples", NULL,
+	    NULL, (void *)&nsamples, sizeof(nsamples)), EPERM,
+	    "Latency stats should be read-only");
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(
+	    test_latency_bucket,
+	    test_latency_quantile,
+	    test_latency_malloc_free,
+	    test_latency_arena_destroy,
+	    test_latency_histogram);
+}
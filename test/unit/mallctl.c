@@ -284,7 +284,12 @@ TEST_BEGIN(test_mallctl_opt) {
 	TEST_MALLCTL_OPT(bool, confirm_conf, always);
 	TEST_MALLCTL_OPT(const char *, metadata_thp, always);
 	TEST_MALLCTL_OPT(bool, retain, always);
+	TEST_MALLCTL_OPT(unsigned, retain_lookahead_ms, always);
 	TEST_MALLCTL_OPT(const char *, dss, always);
+	TEST_MALLCTL_OPT(const char *, hugetlb, always);
+	TEST_MALLCTL_OPT(const char *, hugetlb_path, always);
+	TEST_MALLCTL_OPT(const char *, prefault, always);
+	TEST_MALLCTL_OPT(size_t, prefault_reserve, always);
 	TEST_MALLCTL_OPT(bool, hpa, always);
 	TEST_MALLCTL_OPT(size_t, hpa_slab_max_alloc, always);
 	TEST_MALLCTL_OPT(size_t, hpa_sec_nshards, always);
@@ -295,6 +300,7 @@ TEST_BEGIN(test_mallctl_opt) {
 	TEST_MALLCTL_OPT(unsigned, narenas, always);
 	TEST_MALLCTL_OPT(const char *, percpu_arena, always);
 	TEST_MALLCTL_OPT(size_t, oversize_threshold, always);
+	TEST_MALLCTL_OPT(size_t, nontemporal_threshold, always);
 	TEST_MALLCTL_OPT(bool, background_thread, always);
 	TEST_MALLCTL_OPT(ssize_t, dirty_decay_ms, always);
 	TEST_MALLCTL_OPT(ssize_t, muzzy_decay_ms, always);
@@ -302,6 +308,15 @@ TEST_BEGIN(test_mallctl_opt) {
 	TEST_MALLCTL_OPT(const char *, stats_print_opts, always);
 	TEST_MALLCTL_OPT(int64_t, stats_interval, always);
 	TEST_MALLCTL_OPT(const char *, stats_interval_opts, always);
+	TEST_MALLCTL_OPT(int64_t, stats_bg_interval_ms, stats);
+	TEST_MALLCTL_OPT(const char *, stats_bg_opts, stats);
+	TEST_MALLCTL_OPT(bool, stats_bg_delta, stats);
+	TEST_MALLCTL_OPT(int, stats_bg_fd, stats);
+	TEST_MALLCTL_OPT(int64_t, stats_ts_interval_ms, stats);
+	TEST_MALLCTL_OPT(size_t, stats_ts_nsamples, stats);
+	TEST_MALLCTL_OPT(bool, stats_latency, stats);
+	TEST_MALLCTL_OPT(size_t, lg_stats_latency_sample, stats);
+	TEST_MALLCTL_OPT(bool, mutex_prof_holders, stats);
 	TEST_MALLCTL_OPT(const char *, junk, fill);
 	TEST_MALLCTL_OPT(bool, zero, fill);
 	TEST_MALLCTL_OPT(bool, utrace, utrace);
@@ -316,16 +331,25 @@ TEST_BEGIN(test_mallctl_opt) {
 	TEST_MALLCTL_OPT(bool, prof_active, prof);
 	TEST_MALLCTL_OPT(unsigned, prof_bt_max, prof);
 	TEST_MALLCTL_OPT(ssize_t, lg_prof_sample, prof);
+	TEST_MALLCTL_OPT(size_t, prof_sample_target, prof);
 	TEST_MALLCTL_OPT(bool, prof_accum, prof);
+	TEST_MALLCTL_OPT(bool, prof_lifetime, prof);
 	TEST_MALLCTL_OPT(bool, prof_pid_namespace, prof);
 	TEST_MALLCTL_OPT(ssize_t, lg_prof_interval, prof);
 	TEST_MALLCTL_OPT(bool, prof_gdump, prof);
+	TEST_MALLCTL_OPT(size_t, prof_watermark_allocated, prof);
+	TEST_MALLCTL_OPT(size_t, prof_watermark_resident, prof);
+	TEST_MALLCTL_OPT(unsigned, prof_watermark_growth, prof);
+	TEST_MALLCTL_OPT(unsigned, prof_watermark_hysteresis, prof);
+	TEST_MALLCTL_OPT(unsigned, prof_watermark_interval_ms, prof);
 	TEST_MALLCTL_OPT(bool, prof_final, prof);
 	TEST_MALLCTL_OPT(bool, prof_leak, prof);
 	TEST_MALLCTL_OPT(bool, prof_leak_error, prof);
 	TEST_MALLCTL_OPT(ssize_t, prof_recent_alloc_max, prof);
 	TEST_MALLCTL_OPT(bool, prof_stats, prof);
 	TEST_MALLCTL_OPT(bool, prof_sys_thread_name, prof);
+	TEST_MALLCTL_OPT(const char *, prof_backtrace_method, prof);
+	TEST_MALLCTL_OPT(const char *, prof_format, prof);
 	TEST_MALLCTL_OPT(ssize_t, lg_san_uaf_align, uaf_detection);
 	TEST_MALLCTL_OPT(unsigned, debug_double_free_max_scan, always);
 
@@ -1283,6 +1307,106 @@ TEST_BEGIN(test_thread_activity_callback) {
 }
 TEST_END
 
+typedef struct batch_read_entry_s batch_read_entry_t;
+struct batch_read_entry_s {
+	const size_t *mib;
+	size_t miblen;
+	void *oldp;
+	size_t *oldlenp;
+};
+
+TEST_BEGIN(test_batch_read) {
+	size_t epoch_mib[1], pactive_mib[4], narenas_mib[2], partial_mib[3];
+	size_t bad_mib[2], create_mib[2], tcache_create_mib[2];
+	size_t epoch_miblen = 1, pactive_miblen = 4, narenas_miblen = 2;
+	size_t partial_miblen = 3, bad_miblen = 2, create_miblen = 2;
+	size_t tcache_create_miblen = 2;
+	size_t reset_mib[3], reset_miblen = 3;
+	expect_d_eq(mallctlnametomib("epoch", epoch_mib, &epoch_miblen), 0,
+	    "Unexpected mallctlnametomib() failure");
+	expect_d_eq(mallctlnametomib("stats.arenas.0.pactive", pactive_mib,
+	    &pactive_miblen), 0, "Unexpected mallctlnametomib() failure");
+	expect_d_eq(mallctlnametomib("arenas.narenas", narenas_mib,
+	    &narenas_miblen), 0, "Unexpected mallctlnametomib() failure");
+	expect_d_eq(mallctlnametomib("stats.arenas.0", partial_mib,
+	    &partial_miblen), 0, "Unexpected mallctlnametomib() failure");
+	expect_d_eq(mallctlnametomib("arenas.create", create_mib,
+	    &create_miblen), 0, "Unexpected mallctlnametomib() failure");
+	expect_d_eq(mallctlnametomib("tcache.create", tcache_create_mib,
+	    &tcache_create_miblen), 0, "Unexpected mallctlnametomib() failure");
+	expect_d_eq(mallctlnametomib("stats.mutexes.reset", reset_mib,
+	    &reset_miblen), 0, "Unexpected mallctlnametomib() failure");
+	bad_mib[0] = narenas_mib[0];
+	bad_mib[1] = 9999;
+
+	uint64_t epoch;
+	size_t pactive;
+	unsigned narenas, unused;
+	size_t epoch_sz = sizeof(epoch), pactive_sz = sizeof(pactive),
+	    narenas_sz = sizeof(narenas), unused_sz = sizeof(unused);
+	size_t short_sz = sizeof(uint32_t);
+	batch_read_entry_t entries[] = {
+		{epoch_mib, epoch_miblen, &epoch, &epoch_sz},
+		{pactive_mib, pactive_miblen, &pactive, &pactive_sz},
+		{narenas_mib, narenas_miblen, &narenas, &narenas_sz},
+		{partial_mib, partial_miblen, &unused, &unused_sz},
+		{bad_mib, bad_miblen, &unused, &unused_sz},
+		{narenas_mib, narenas_miblen, NULL, NULL},
+		{epoch_mib, epoch_miblen, &epoch, &short_sz},
+		{create_mib, create_miblen, &unused, &unused_sz},
+		{tcache_create_mib, tcache_create_miblen, &unused, &unused_sz},
+		{reset_mib, reset_miblen, &unused, &unused_sz},
+	};
+	int rets[sizeof(entries) / sizeof(entries[0])];
+	size_t rets_sz = sizeof(rets);
+
+	expect_d_eq(mallctl("experimental.batch_read", rets, &rets_sz, entries,
+	    sizeof(entries)), 0, "Unexpected mallctl() failure");
+	expect_d_eq(rets[0], 0, "Unexpected epoch read failure");
+	expect_d_eq(rets[1], config_stats ? 0 : ENOENT,
+	    "Unexpected stats read result");
+	expect_d_eq(rets[2], 0, "Unexpected arenas.narenas read failure");
+	expect_d_eq(rets[3], ENOENT, "Partial MIB should fail");
+	expect_d_eq(rets[4], ENOENT, "Bad MIB should fail");
+	expect_d_eq(rets[5], EINVAL, "Entries must read");
+	expect_d_eq(rets[6], EINVAL, "Short read buffer should fail");
+	expect_d_eq(rets[7], EPERM, "arenas.create should be rejected");
+	expect_d_eq(rets[8], EPERM, "tcache.create should be rejected");
+	expect_d_eq(rets[9], config_stats ? EPERM : ENOENT,
+	    "stats.mutexes.reset should be rejected");
+
+	/* The values match what the individual reads return. */
+	uint64_t epoch_single;
+	unsigned narenas_single;
+	size_t sz = sizeof(epoch_single);
+	expect_d_eq(mallctl("epoch", &epoch_single, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_u64_eq(epoch, epoch_single, "Inconsistent epoch");
+	sz = sizeof(narenas_single);
+	expect_d_eq(mallctl("arenas.narenas", &narenas_single, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	/* Which also checks that the batch created no arena. */
+	expect_u_eq(narenas, narenas_single, "Inconsistent arenas.narenas");
+	if (config_stats) {
+		size_t pactive_single;
+		sz = sizeof(pactive_single);
+		expect_d_eq(mallctl("stats.arenas.0.pactive", &pactive_single,
+		    &sz, NULL, 0), 0, "Unexpected mallctl() failure");
+		expect_zu_eq(pactive, pactive_single, "Inconsistent pactive");
+	}
+
+	/* Malformed batches. */
+	rets_sz = sizeof(rets) - sizeof(int);
+	expect_d_eq(mallctl("experimental.batch_read", rets, &rets_sz, entries,
+	    sizeof(entries)), EINVAL, "Mismatched result array should fail");
+	rets_sz = sizeof(rets);
+	expect_d_eq(mallctl("experimental.batch_read", rets, &rets_sz, entries,
+	    sizeof(entries) - 1), EINVAL, "Truncated entry should fail");
+	expect_d_eq(mallctl("experimental.batch_read", rets, &rets_sz, NULL,
+	    0), EINVAL, "Empty batch should fail");
+}
+TEST_END
+
 int
 main(void) {
 	return test(
@@ -1321,5 +1445,6 @@ main(void) {
 	    test_hooks_exhaustion,
 	    test_thread_idle,
 	    test_thread_peak,
-	    test_thread_activity_callback);
+	    test_thread_activity_callback,
+	    test_batch_read);
 }
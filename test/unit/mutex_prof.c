@@ -0,0 +1,153 @@
+#include "test/jemalloc_test.h"
+
+const char *malloc_conf = "mutex_prof_holders:true";
+
+#define HOLD_NS (50 * 1000 * 1000)
+
+static malloc_mutex_t mtx;
+static atomic_b_t waiter_started;
+
+static void *
+thd_start(void *arg) {
+	tsdn_t *tsdn = tsdn_fetch();
+
+	atomic_store_b(&waiter_started, true, ATOMIC_RELEASE);
+	malloc_mutex_lock(tsdn, &mtx);
+	malloc_mutex_unlock(tsdn, &mtx);
+	return NULL;
+}
+
+TEST_BEGIN(test_mutex_prof_wait_bucket) {
+	expect_u_eq(mutex_prof_wait_bucket(0), 0, "");
+	expect_u_eq(mutex_prof_wait_bucket(1023), 0, "");
+	expect_u_eq(mutex_prof_wait_bucket(1024), 1, "");
+	expect_u_eq(mutex_prof_wait_bucket(2047), 1, "");
+	expect_u_eq(mutex_prof_wait_bucket(2048), 2, "");
+	expect_u_eq(mutex_prof_wait_bucket((UINT64_C(1) << 24) - 1),
+	    MUTEX_PROF_WAIT_NBUCKETS - 2, "");
+	expect_u_eq(mutex_prof_wait_bucket(UINT64_C(1) << 24),
+	    MUTEX_PROF_WAIT_NBUCKETS - 1, "");
+	expect_u_eq(mutex_prof_wait_bucket(UINT64_MAX),
+	    MUTEX_PROF_WAIT_NBUCKETS - 1, "");
+}
+TEST_END
+
+TEST_BEGIN(test_mutex_prof_wait) {
+	test_skip_if(!config_stats);
+
+	tsdn_t *tsdn = tsdn_fetch();
+	expect_false(malloc_mutex_init(&mtx, "mutex_prof", WITNESS_RANK_OMIT,
+	    malloc_mutex_rank_exclusive), "Unexpected mutex init failure");
+	atomic_store_b(&waiter_started, false, ATOMIC_RELAXED);
+
+	/* Hold the mutex long enough for the waiter to block on it. */
+	malloc_mutex_lock(tsdn, &mtx);
+	thd_t thd;
+	thd_create(&thd, thd_start, NULL);
+	while (!atomic_load_b(&waiter_started, ATOMIC_ACQUIRE)) {
+		sleep_ns(1000 * 1000);
+	}
+	sleep_ns(HOLD_NS);
+	malloc_mutex_unlock(tsdn, &mtx);
+	thd_join(thd, NULL);
+
+	malloc_mutex_lock(tsdn, &mtx);
+	mutex_prof_data_t *data = &mtx.prof_data;
+	expect_u64_eq(data->n_wait_times, 1, "Waiter should have blocked");
+	expect_u64_eq(data->wait_hist[MUTEX_PROF_WAIT_NBUCKETS - 1], 1,
+	    "The wait should be in the last bucket");
+	uint64_t total = 0;
+	for (unsigned i = 0; i < MUTEX_PROF_WAIT_NBUCKETS; i++) {
+		total += data->wait_hist[i];
+	}
+	expect_u64_eq(total, data->n_wait_times,
+	    "Histogram should count every wait");
+	malloc_mutex_unlock(tsdn, &mtx);
+
+	/* The wait should be attributed to where this thread locked mtx. */
+	bool found = false;
+	for (size_t i = 0; i < MUTEX_PROF_NHOLDERS; i++) {
+		char cmd[128];
+		const char *holder_site;
+		uint64_t num_wait, total_wait_time;
+		size_t sz;
+
+		malloc_snprintf(cmd, sizeof(cmd),
+		    "stats.mutexes.holders.%zu.site", i);
+		sz = sizeof(holder_site);
+		expect_d_eq(mallctl(cmd, (void *)&holder_site, &sz, NULL, 0),
+		    0, "Unexpected mallctl() failure");
+		if (holder_site == NULL) {
+			continue;
+		}
+		malloc_snprintf(cmd, sizeof(cmd),
+		    "stats.mutexes.holders.%zu.num_wait", i);
+		sz = sizeof(num_wait);
+		expect_d_eq(mallctl(cmd, (void *)&num_wait, &sz, NULL, 0),
+		    0, "Unexpected mallctl() failure");
+		malloc_snprintf(cmd, sizeof(cmd),
+		    "stats.mutexes.holders.%zu.total_wait_time", i);
+		sz = sizeof(total_wait_time);
+		expect_d_eq(mallctl(cmd, (void *)&total_wait_time, &sz, NULL,
+		    0), 0, "Unexpected mallctl() failure");
+		if (strcmp(holder_site, __func__) == 0) {
+			expect_u64_eq(num_wait, 1, "Unexpected number of waits");
+			expect_u64_ge(total_wait_time, HOLD_NS / 2,
+			    "Wait time should be attributed to the holder");
+			found = true;
+		}
+	}
+	expect_true(found, "The wait should have been attributed");
+
+	expect_d_eq(mallctl("stats.mutexes.reset", NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	mutex_prof_holder_t holder;
+	for (size_t i = 0; i < MUTEX_PROF_NHOLDERS; i++) {
+		mutex_prof_holder_read(i, &holder);
+		expect_u64_eq(holder.n_wait_times, 0,
+		    "Reset should clear holder stats");
+	}
+
+	const char *site;
+	size_t sz = sizeof(site);
+	expect_d_eq(mallctl("stats.mutexes.holders.64.site", (void *)&site,
+	    &sz, NULL, 0), ENOENT, "Out of range holders should not exist");
+}
+TEST_END
+
+TEST_BEGIN(test_mutex_prof_wait_histogram_ctl) {
+	test_skip_if(!config_stats);
+
+	uint64_t epoch = 1;
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch,
+	    sizeof(epoch)), 0, "Unexpected mallctl() failure");
+
+	const char *cmds[] = {
+		"stats.mutexes.ctl.wait_histogram",
+		"stats.arenas.0.mutexes.large.wait_histogram",
+		"stats.arenas.0.bins.0.mutex.wait_histogram"
+	};
+	for (unsigned i = 0; i < sizeof(cmds) / sizeof(cmds[0]); i++) {
+		uint64_t hist[MUTEX_PROF_WAIT_NBUCKETS];
+		size_t sz = 0;
+		expect_d_eq(mallctl(cmds[i], NULL, &sz, NULL, 0), 0,
+		    "Unexpected mallctl() failure");
+		expect_zu_eq(sz, sizeof(hist), "Unexpected histogram size");
+		expect_d_eq(mallctl(cmds[i], (void *)hist, &sz, NULL, 0), 0,
+		    "Unexpected mallctl() failure");
+		sz = sizeof(hist) - 1;
+		expect_d_eq(mallctl(cmds[i], (void *)hist, &sz, NULL, 0),
+		    EINVAL, "Short buffer should be rejected");
+		expect_d_eq(mallctl(cmds[i], NULL, NULL, (void *)hist,
+		    sizeof(hist)), EPERM, "Histograms should be read-only");
+	}
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(
+	    test_mutex_prof_wait_bucket,
+	    test_mutex_prof_wait,
+	    test_mutex_prof_wait_histogram_ctl);
+}
@@ -0,0 +1,113 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/nontemporal.h"
+
+#define BUF_SIZE 4096
+#define GUARD 0x5a
+
+static unsigned char src_buf[BUF_SIZE + 128];
+static unsigned char dst_buf[BUF_SIZE + 128];
+
+static void
+expect_guarded(size_t begin, size_t end) {
+	for (size_t i = 0; i < sizeof(dst_buf); i++) {
+		if (i < begin || i >= end) {
+			expect_u_eq(dst_buf[i], GUARD,
+			    "Byte %zu outside of [%zu, %zu) was overwritten", i,
+			    begin, end);
+		}
+	}
+}
+
+static void
+do_test_kernel(void) {
+	for (size_t i = 0; i < sizeof(src_buf); i++) {
+		src_buf[i] = (unsigned char)(i * 7 + 1);
+	}
+	size_t sizes[] = {0, 1, 15, 16, 31, 63, 64, 65, 127, 128, 129, 1000,
+	    BUF_SIZE};
+	for (size_t dst_off = 0; dst_off < 64; dst_off += 5) {
+		for (size_t src_off = 0; src_off < 64; src_off += 9) {
+			for (unsigned j = 0; j < sizeof(sizes) / sizeof(sizes[0]);
+			    j++) {
+				size_t size = sizes[j];
+				memset(dst_buf, GUARD, sizeof(dst_buf));
+				nontemporal_copy_impl(&dst_buf[dst_off],
+				    &src_buf[src_off], size);
+				expect_d_eq(memcmp(&dst_buf[dst_off],
+				    &src_buf[src_off], size), 0,
+				    "Copy mismatch (size=%zu, offsets=%zu/%zu)",
+				    size, dst_off, src_off);
+				expect_guarded(dst_off, dst_off + size);
+
+				memset(dst_buf, GUARD, sizeof(dst_buf));
+				nontemporal_zero_impl(&dst_buf[dst_off], size);
+				for (size_t k = 0; k < size; k++) {
+					expect_u_eq(dst_buf[dst_off + k], 0,
+					    "Byte %zu/%zu not zeroed", k, size);
+				}
+				expect_guarded(dst_off, dst_off + size);
+			}
+		}
+	}
+}
+
+TEST_BEGIN(test_nontemporal_kernels) {
+	nontemporal_kernel_t detected = nontemporal_kernel;
+	/* Every kernel up to the detected one is supported by this CPU. */
+	for (unsigned k = nontemporal_kernel_none; k <= detected; k++) {
+		nontemporal_kernel = (nontemporal_kernel_t)k;
+		do_test_kernel();
+	}
+	nontemporal_kernel = detected;
+}
+TEST_END
+
+TEST_BEGIN(test_nontemporal_ralloc) {
+	size_t threshold;
+	size_t sz = sizeof(threshold);
+	expect_d_eq(mallctl("opt.nontemporal_threshold", (void *)&threshold,
+	    &sz, NULL, 0), 0, "Unexpected mallctl() failure");
+	/* Set by nontemporal.sh. */
+	expect_zu_eq(threshold, 65536, "Unexpected opt.nontemporal_threshold");
+
+	size_t size = ZU(4) << 20;
+	unsigned char *p = mallocx(size, MALLOCX_ZERO);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	for (size_t i = 0; i < size; i += 4093) {
+		expect_u_eq(p[i], 0, "Memory should be zeroed");
+		p[i] = (unsigned char)(i % 251 + 1);
+	}
+
+	/*
+	 * Keep the allocation from growing in place (most likely, the next
+	 * extent is carved out right after it), and grow it until it moves.
+	 */
+	void *blocker = mallocx(size, 0);
+	expect_ptr_not_null(blocker, "Unexpected mallocx() failure");
+	void *old = p;
+	size_t new_size = size;
+	while (p == old && new_size < (ZU(256) << 20)) {
+		new_size *= 2;
+		p = rallocx(p, new_size, MALLOCX_ZERO);
+		expect_ptr_not_null(p, "Unexpected rallocx() failure");
+	}
+	expect_ptr_ne(p, old, "Allocation should have moved");
+	for (size_t i = 0; i < size; i += 4093) {
+		expect_u_eq(p[i], (unsigned char)(i % 251 + 1),
+		    "Contents not preserved at offset %zu", i);
+	}
+	for (size_t i = size; i < new_size; i += 4093) {
+		expect_u_eq(p[i], 0, "Memory should be zeroed");
+	}
+	dallocx(p, 0);
+	dallocx(blocker, 0);
+}
+TEST_END
+
+int
+main(void) {
+	return test(
+	    test_nontemporal_kernels,
+	    test_nontemporal_ralloc);
+}
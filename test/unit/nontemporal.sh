@@ -0,0 +1,3 @@
+#!/bin/sh
+
+export MALLOC_CONF="nontemporal_threshold:65536"
@@ -5,7 +5,8 @@
 static void *
 alloc_hook(extent_hooks_t *extent_hooks, void *new_addr, size_t size,
     size_t alignment, bool *zero, bool *commit, unsigned arena_ind) {
-	void *ret = pages_map(new_addr, size, alignment, commit);
+	void *ret = pages_map(pages_caller_pac, new_addr, size, alignment,
+	    commit);
 	return ret;
 }
 
@@ -7,23 +7,86 @@ TEST_BEGIN(test_pages_huge) {
 
 	alloc_size = HUGEPAGE * 2 - PAGE;
 	commit = true;
-	pages = pages_map(NULL, alloc_size, PAGE, &commit);
+	pages = pages_map(pages_caller_pac, NULL, alloc_size, PAGE, &commit);
 	expect_ptr_not_null(pages, "Unexpected pages_map() error");
 
 	if (init_system_thp_mode == thp_mode_default) {
 	    hugepage = (void *)(ALIGNMENT_CEILING((uintptr_t)pages, HUGEPAGE));
-	    expect_b_ne(pages_huge(hugepage, HUGEPAGE), have_madvise_huge,
-	        "Unexpected pages_huge() result");
-	    expect_false(pages_nohuge(hugepage, HUGEPAGE),
+	    expect_b_ne(pages_huge(pages_caller_pac, hugepage, HUGEPAGE),
+	        have_madvise_huge, "Unexpected pages_huge() result");
+	    expect_false(pages_nohuge(pages_caller_pac, hugepage, HUGEPAGE),
 	        "Unexpected pages_nohuge() result");
 	}
 
-	pages_unmap(pages, alloc_size);
+	pages_unmap(pages_caller_pac, pages, alloc_size);
+}
+TEST_END
+
+static pages_stats_t
+pages_stats_get(const char *caller, const char *op) {
+	pages_stats_t stats;
+	char cmd[128];
+	size_t sz;
+
+	malloc_snprintf(cmd, sizeof(cmd), "stats.pages.%s.%s.ncalls", caller,
+	    op);
+	sz = sizeof(stats.ncalls);
+	expect_d_eq(mallctl(cmd, (void *)&stats.ncalls, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	malloc_snprintf(cmd, sizeof(cmd), "stats.pages.%s.%s.bytes", caller,
+	    op);
+	sz = sizeof(stats.bytes);
+	expect_d_eq(mallctl(cmd, (void *)&stats.bytes, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	malloc_snprintf(cmd, sizeof(cmd), "stats.pages.%s.%s.total_ns", caller,
+	    op);
+	sz = sizeof(stats.total_ns);
+	expect_d_eq(mallctl(cmd, (void *)&stats.total_ns, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	return stats;
+}
+
+TEST_BEGIN(test_pages_stats) {
+	test_skip_if(!config_stats);
+
+	pages_stats_t map0 = pages_stats_get("base", "map");
+	pages_stats_t unmap0 = pages_stats_get("base", "unmap");
+	pages_stats_t pac_map0 = pages_stats_get("pac", "map");
+
+	size_t size = 4 * PAGE;
+	bool commit = true;
+	void *pages = pages_map(pages_caller_base, NULL, size, PAGE, &commit);
+	expect_ptr_not_null(pages, "Unexpected pages_map() error");
+	pages_unmap(pages_caller_base, pages, size);
+
+	pages_stats_t map1 = pages_stats_get("base", "map");
+	pages_stats_t unmap1 = pages_stats_get("base", "unmap");
+	expect_u64_eq(map1.ncalls - map0.ncalls, 1,
+	    "pages_map() should have been counted");
+	expect_u64_eq(map1.bytes - map0.bytes, size,
+	    "pages_map() size should have been counted");
+	expect_u64_ge(map1.total_ns, map0.total_ns,
+	    "pages_map() time should not decrease");
+	expect_u64_eq(unmap1.ncalls - unmap0.ncalls, 1,
+	    "pages_unmap() should have been counted");
+	expect_u64_eq(unmap1.bytes - unmap0.bytes, size,
+	    "pages_unmap() size should have been counted");
+	expect_u64_eq(pages_stats_get("pac", "map").ncalls, pac_map0.ncalls,
+	    "Calls should only be counted for their caller");
+
+	uint64_t ncalls = 0;
+	expect_d_eq(mallctl("stats.pages.base.map.ncalls", NULL, NULL,
+	    (void *)&ncalls, sizeof(ncalls)), EPERM,
+	    "Pages stats should be read-only");
+	size_t sz = sizeof(ncalls);
+	expect_d_eq(mallctl("stats.pages.base.mmap.ncalls", (void *)&ncalls,
+	    &sz, NULL, 0), ENOENT, "Unknown ops should not exist");
 }
 TEST_END
 
 int
 main(void) {
 	return test(
-	    test_pages_huge);
+	    test_pages_huge,
+	    test_pages_stats);
 }
@@ -0,0 +1,284 @@
+#include "test/jemalloc_test.h"
+
+#define RESERVE_SIZE (ZU(8) << 20)
+
+static unsigned
+do_arena_create(void) {
+	unsigned arena_ind;
+	size_t sz = sizeof(unsigned);
+	expect_d_eq(mallctl("arenas.create", (void *)&arena_ind, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	return arena_ind;
+}
+
+static void
+do_arena_destroy(unsigned arena_ind) {
+	size_t mib[3];
+	size_t miblen = sizeof(mib) / sizeof(size_t);
+	expect_d_eq(mallctlnametomib("arena.0.destroy", mib, &miblen), 0,
+	    "Unexpected mallctlnametomib() failure");
+	mib[1] = (size_t)arena_ind;
+	expect_d_eq(mallctlbymib(mib, miblen, NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctlbymib() failure");
+}
+
+static void
+do_arena_purge(unsigned arena_ind) {
+	size_t mib[3];
+	size_t miblen = sizeof(mib) / sizeof(size_t);
+	expect_d_eq(mallctlnametomib("arena.0.purge", mib, &miblen), 0,
+	    "Unexpected mallctlnametomib() failure");
+	mib[1] = (size_t)arena_ind;
+	expect_d_eq(mallctlbymib(mib, miblen, NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctlbymib() failure");
+}
+
+static int
+do_prefault(unsigned arena_ind, const char **oldp, const char *newval) {
+	size_t mib[3];
+	size_t miblen = sizeof(mib) / sizeof(size_t);
+	size_t sz = sizeof(const char *);
+	expect_d_eq(mallctlnametomib("arena.0.prefault", mib, &miblen), 0,
+	    "Unexpected mallctlnametomib() failure");
+	mib[1] = (size_t)arena_ind;
+	return mallctlbymib(mib, miblen, (void *)oldp,
+	    oldp != NULL ? &sz : NULL, newval != NULL ? (void *)&newval : NULL,
+	    newval != NULL ? sizeof(const char *) : 0);
+}
+
+static int
+do_prefault_reserve(unsigned arena_ind, size_t *oldp, size_t *newp) {
+	size_t mib[3];
+	size_t miblen = sizeof(mib) / sizeof(size_t);
+	size_t sz = sizeof(size_t);
+	expect_d_eq(mallctlnametomib("arena.0.prefault_reserve", mib, &miblen),
+	    0, "Unexpected mallctlnametomib() failure");
+	mib[1] = (size_t)arena_ind;
+	return mallctlbymib(mib, miblen, (void *)oldp,
+	    oldp != NULL ? &sz : NULL, (void *)newp,
+	    newp != NULL ? sizeof(size_t) : 0);
+}
+
+static size_t
+do_get_retained(unsigned arena_ind) {
+	uint64_t epoch = 1;
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch,
+	    sizeof(epoch)), 0, "Unexpected mallctl() failure");
+
+	size_t mib[4];
+	size_t miblen = sizeof(mib) / sizeof(size_t);
+	expect_d_eq(mallctlnametomib("stats.arenas.0.retained", mib, &miblen),
+	    0, "Unexpected mallctlnametomib() failure");
+	mib[2] = (size_t)arena_ind;
+	size_t retained;
+	size_t sz = sizeof(retained);
+	expect_d_eq(mallctlbymib(mib, miblen, (void *)&retained, &sz, NULL, 0),
+	    0, "Unexpected mallctlbymib() failure");
+	return retained;
+}
+
+TEST_BEGIN(test_prefault_ctl) {
+	const char *mode;
+	size_t sz = sizeof(mode);
+	expect_d_eq(mallctl("opt.prefault", (void *)&mode, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	/* Set by prefault.sh. */
+	expect_str_eq(mode, "populate", "Unexpected opt.prefault");
+
+	unsigned arena_ind = do_arena_create();
+	const char *old;
+	expect_d_eq(do_prefault(arena_ind, &old, "mlock"), 0,
+	    "Unexpected arena.<i>.prefault failure");
+	expect_str_eq(old, "populate", "Arenas should start with opt.prefault");
+	expect_d_eq(do_prefault(arena_ind, &old, NULL), 0,
+	    "Unexpected arena.<i>.prefault failure");
+	expect_str_eq(old, "mlock", "Unexpected prefault mode");
+	expect_d_eq(do_prefault(arena_ind, NULL, "always"), EINVAL,
+	    "Expected failure for an unknown mode");
+	expect_d_eq(do_prefault(narenas_total_get() + 1, NULL, "disabled"),
+	    ENOENT, "Expected failure for a nonexistent arena");
+
+	size_t reserve = RESERVE_SIZE;
+	size_t old_reserve;
+	expect_d_eq(do_prefault_reserve(arena_ind, &old_reserve, &reserve), 0,
+	    "Unexpected arena.<i>.prefault_reserve failure");
+	expect_zu_eq(old_reserve, 0, "Unexpected default reserve");
+	expect_d_eq(do_prefault_reserve(arena_ind, &old_reserve, NULL), 0,
+	    "Unexpected arena.<i>.prefault_reserve failure");
+	expect_zu_eq(old_reserve, RESERVE_SIZE, "Unexpected reserve");
+
+	do_arena_destroy(arena_ind);
+}
+TEST_END
+
+static void
+do_prefault_alloc(const char *mode) {
+#if defined(__linux__)
+	unsigned arena_ind = do_arena_create();
+	expect_d_eq(do_prefault(arena_ind, NULL, mode), 0,
+	    "Unexpected arena.<i>.prefault failure");
+
+	/*
+	 * Fresh, zeroed extents are never written to by the allocator itself,
+	 * so residency is due to prefaulting alone.
+	 */
+	size_t size = ZU(4) << 20;
+	void *p = mallocx(size, MALLOCX_ARENA(arena_ind) | MALLOCX_TCACHE_NONE |
+	    MALLOCX_ZERO);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	void *base = (void *)ALIGNMENT_ADDR2BASE(p, os_page);
+	size_t len = ALIGNMENT_CEILING((uintptr_t)p + size, os_page) -
+	    (uintptr_t)base;
+	unsigned char vec[(ZU(4) << 20) / 4096 + 2];
+	size_t npages = len / os_page;
+	expect_zu_le(npages, sizeof(vec), "Unexpected page count");
+	expect_d_eq(mincore(base, len, vec), 0, "Unexpected mincore() failure");
+	for (size_t i = 0; i < npages; i++) {
+		expect_true(vec[i] & 1, "Page %zu of %zu not resident", i,
+		    npages);
+	}
+	expect_c_eq(((char *)p)[size - 1], 0, "Memory should be zeroed");
+	dallocx(p, MALLOCX_TCACHE_NONE);
+
+	do_arena_destroy(arena_ind);
+#endif
+}
+
+TEST_BEGIN(test_prefault_alloc) {
+	test_skip_if(!opt_retain);
+	test_skip_if(os_page != 4096);
+
+	do_prefault_alloc("populate");
+	do_prefault_alloc("mlock");
+}
+TEST_END
+
+TEST_BEGIN(test_prefault_reserve) {
+	test_skip_if(!have_background_thread);
+	test_skip_if(!config_stats);
+	test_skip_if(!opt_retain);
+
+	bool enable = true;
+	expect_d_eq(mallctl("background_thread", NULL, NULL, (void *)&enable,
+	    sizeof(enable)), 0, "Unexpected mallctl() failure");
+
+	unsigned arena_ind = do_arena_create();
+	expect_zu_lt(do_get_retained(arena_ind), RESERVE_SIZE,
+	    "Reserve should start out empty");
+	size_t reserve = RESERVE_SIZE;
+	expect_d_eq(do_prefault_reserve(arena_ind, NULL, &reserve), 0,
+	    "Unexpected arena.<i>.prefault_reserve failure");
+
+	/* The background thread fills the reserve asynchronously. */
+	nstime_t start, now;
+	nstime_init_update(&start);
+	size_t retained;
+	while ((retained = do_get_retained(arena_ind)) < RESERVE_SIZE) {
+		nstime_init_update(&now);
+		nstime_subtract(&now, &start);
+		if (nstime_sec(&now) > 30) {
+			break;
+		}
+		sleep_ns(10 * 1000 * 1000);
+	}
+	expect_zu_ge(retained, RESERVE_SIZE, "Reserve was never filled");
+
+	enable = false;
+	expect_d_eq(mallctl("background_thread", NULL, NULL, (void *)&enable,
+	    sizeof(enable)), 0, "Unexpected mallctl() failure");
+	do_arena_destroy(arena_ind);
+}
+TEST_END
+
+TEST_BEGIN(test_prefault_reserve_purged) {
+	test_skip_if(!opt_retain);
+
+	tsdn_t *tsdn = tsdn_fetch();
+	unsigned arena_ind = do_arena_create();
+	pac_t *pac = &arena_get(tsdn, arena_ind, false)->pa_shard.pac;
+
+	/* Leave purged memory in the retained ecache. */
+	void *p = mallocx(2 * RESERVE_SIZE, MALLOCX_ARENA(arena_ind) |
+	    MALLOCX_TCACHE_NONE);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	dallocx(p, MALLOCX_TCACHE_NONE);
+	do_arena_purge(arena_ind);
+	expect_zu_ge(ecache_npages_get(&pac->ecache_retained) << LG_PAGE,
+	    2 * RESERVE_SIZE, "Purged memory should have been retained");
+
+	size_t reserve = RESERVE_SIZE;
+	expect_d_eq(do_prefault_reserve(arena_ind, NULL, &reserve), 0,
+	    "Unexpected arena.<i>.prefault_reserve failure");
+	expect_zu_eq(pac_retained_deficit(pac), RESERVE_SIZE,
+	    "Purged memory shouldn't count toward the reserve");
+
+	/* Fill the reserve the way the background thread would. */
+	pac_do_deferred_work(tsdn, pac);
+	size_t nprefaulted = ecache_npages_prefaulted_get(&pac->ecache_retained);
+	expect_zu_ge(nprefaulted << LG_PAGE, RESERVE_SIZE,
+	    "Reserve should have been filled");
+	expect_zu_eq(pac_retained_deficit(pac), 0, "Unexpected deficit");
+
+	/* Growth is served from the reserve first. */
+	p = mallocx(RESERVE_SIZE / 2, MALLOCX_ARENA(arena_ind) |
+	    MALLOCX_TCACHE_NONE);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	expect_zu_lt(ecache_npages_prefaulted_get(&pac->ecache_retained),
+	    nprefaulted, "Allocation should have used the reserve");
+	expect_zu_gt(pac_retained_deficit(pac), 0,
+	    "Using the reserve should create a deficit");
+	dallocx(p, MALLOCX_TCACHE_NONE);
+
+	do_arena_destroy(arena_ind);
+}
+TEST_END
+
+TEST_BEGIN(test_prefault_mlock_purge) {
+	test_skip_if(!opt_retain);
+	test_skip_if(os_page != 4096);
+#if defined(__linux__)
+	unsigned arena_ind = do_arena_create();
+	expect_d_eq(do_prefault(arena_ind, NULL, "mlock"), 0,
+	    "Unexpected arena.<i>.prefault failure");
+	size_t mib[3];
+	size_t miblen = sizeof(mib) / sizeof(size_t);
+	expect_d_eq(mallctlnametomib("arena.0.muzzy_decay_ms", mib, &miblen),
+	    0, "Unexpected mallctlnametomib() failure");
+	mib[1] = (size_t)arena_ind;
+	ssize_t decay_ms = 0;
+	expect_d_eq(mallctlbymib(mib, miblen, NULL, NULL, (void *)&decay_ms,
+	    sizeof(decay_ms)), 0, "Unexpected mallctlbymib() failure");
+
+	size_t size = ZU(1) << 20;
+	void *p = mallocx(size, MALLOCX_ARENA(arena_ind) |
+	    MALLOCX_TCACHE_NONE);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	memset(p, 1, size);
+	dallocx(p, MALLOCX_TCACHE_NONE);
+	do_arena_purge(arena_ind);
+
+	/* Locked pages would have survived the purge. */
+	void *base = (void *)PAGE_CEILING((uintptr_t)p);
+	size_t len = (((uintptr_t)p + size) & ~PAGE_MASK) - (uintptr_t)base;
+	unsigned char vec[(ZU(1) << 20) / 4096];
+	size_t npages = len / os_page;
+	expect_d_eq(mincore(base, len, vec), 0, "Unexpected mincore() failure");
+	for (size_t i = 0; i < npages; i++) {
+		expect_false(vec[i] & 1, "Page %zu of %zu still resident", i,
+		    npages);
+	}
+
+	do_arena_destroy(arena_ind);
+#endif
+}
+TEST_END
+
+int
+main(void) {
+	return test(
+	    test_prefault_ctl,
+	    test_prefault_alloc,
+	    test_prefault_reserve,
+	    test_prefault_reserve_purged,
+	    test_prefault_mlock_purge);
+}
@@ -0,0 +1,160 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/prof_stats.h"
+#include "jemalloc/internal/prof_sys.h"
+
+#define NALLOCS 8
+#define ALLOC_SIZE 1000
+#define TAG 7
+#define DUMP_BUF_SIZE (1 << 20)
+
+static const char *test_filename = "test_filename";
+static char dump_buf[DUMP_BUF_SIZE];
+static size_t dump_len;
+
+static int
+prof_dump_open_file_intercept(const char *filename, int mode) {
+	int fd = open("/dev/null", O_WRONLY);
+	assert_d_ne(fd, -1, "Unexpected open() failure");
+	dump_len = 0;
+	return fd;
+}
+
+static ssize_t
+prof_dump_write_file_intercept(int fd, const void *s, size_t len) {
+	assert_zu_lt(dump_len + len, DUMP_BUF_SIZE, "Dump too large");
+	memcpy(dump_buf + dump_len, s, len);
+	dump_len += len;
+	dump_buf[dump_len] = '\0';
+	return len;
+}
+
+static unsigned
+alloc_tag_get(void) {
+	unsigned tag;
+	size_t sz = sizeof(tag);
+	expect_d_eq(mallctl("thread.prof.alloc_tag", &tag, &sz, NULL, 0), 0,
+	    "Unexpected mallctl failure");
+	return tag;
+}
+
+static void
+alloc_tag_set(unsigned tag) {
+	expect_d_eq(mallctl("thread.prof.alloc_tag", NULL, NULL, &tag,
+	    sizeof(tag)), 0, "Unexpected mallctl failure");
+}
+
+static void
+tag_stats_get(unsigned tag, prof_stats_t *live, prof_stats_t *accum) {
+	size_t mib[5];
+	size_t miblen = sizeof(mib) / sizeof(mib[0]);
+	size_t sz = sizeof(prof_stats_t);
+	expect_d_eq(mallctlnametomib("prof.stats.tags.0.live", mib, &miblen),
+	    0, "Unexpected mallctlnametomib failure");
+	mib[3] = tag;
+	expect_d_eq(mallctlbymib(mib, miblen, live, &sz, NULL, 0), 0,
+	    "Unexpected mallctlbymib failure");
+	expect_d_eq(mallctlnametomib("prof.stats.tags.0.accum", mib, &miblen),
+	    0, "Unexpected mallctlnametomib failure");
+	mib[3] = tag;
+	expect_d_eq(mallctlbymib(mib, miblen, accum, &sz, NULL, 0), 0,
+	    "Unexpected mallctlbymib failure");
+}
+
+TEST_BEGIN(test_alloc_tag_ctl) {
+	test_skip_if(!config_prof);
+
+	expect_u_eq(alloc_tag_get(), 0, "Threads should start untagged");
+	alloc_tag_set(TAG);
+	expect_u_eq(alloc_tag_get(), TAG, "Tag not set");
+
+	unsigned tag = PROF_ALLOC_NTAGS;
+	expect_d_eq(mallctl("thread.prof.alloc_tag", NULL, NULL, &tag,
+	    sizeof(tag)), EINVAL, "Out of range tag should be rejected");
+	expect_u_eq(alloc_tag_get(), TAG, "Rejected tag should not stick");
+
+	expect_d_eq(mallctl("prof.reset", NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl failure");
+	expect_u_eq(alloc_tag_get(), TAG, "Tag should survive prof.reset");
+
+	prof_stats_t stats;
+	size_t sz = sizeof(stats);
+	expect_d_eq(mallctl("prof.stats.tags.256.live", &stats, &sz, NULL,
+	    0), ENOENT, "Out of range tag should not exist");
+
+	alloc_tag_set(0);
+}
+TEST_END
+
+static void *
+thd_free(void *arg) {
+	void **ptrs = (void **)arg;
+	for (unsigned i = 0; i < NALLOCS; i++) {
+		free(ptrs[i]);
+	}
+	return NULL;
+}
+
+TEST_BEGIN(test_alloc_tag_stats) {
+	test_skip_if(!config_prof);
+
+	prof_stats_t live_0, accum_0;
+	tag_stats_get(TAG, &live_0, &accum_0);
+
+	/*
+	 * With lg_prof_sample:0 every allocation is sampled with a weight of
+	 * one, so the estimates are exact.
+	 */
+	void *ptrs[NALLOCS];
+	alloc_tag_set(TAG);
+	for (unsigned i = 0; i < NALLOCS; i++) {
+		ptrs[i] = malloc(ALLOC_SIZE);
+		expect_ptr_not_null(ptrs[i], "Unexpected malloc() failure");
+	}
+	alloc_tag_set(0);
+
+	prof_stats_t live_1, accum_1;
+	tag_stats_get(TAG, &live_1, &accum_1);
+	expect_u64_eq(live_1.count - live_0.count, NALLOCS, "");
+	expect_u64_eq(live_1.req_sum - live_0.req_sum,
+	    NALLOCS * ALLOC_SIZE, "");
+	expect_u64_eq(accum_1.count - accum_0.count, NALLOCS, "");
+	expect_u64_eq(accum_1.req_sum - accum_0.req_sum,
+	    NALLOCS * ALLOC_SIZE, "");
+
+	prof_dump_open_file_t *open_file_orig = prof_dump_open_file;
+	prof_dump_write_file_t *write_file_orig = prof_dump_write_file;
+	prof_dump_open_file = prof_dump_open_file_intercept;
+	prof_dump_write_file = prof_dump_write_file_intercept;
+	expect_d_eq(mallctl("prof.dump", NULL, NULL, (void *)&test_filename,
+	    sizeof(test_filename)), 0,
+	    "Unexpected mallctl failure while dumping");
+	prof_dump_open_file = open_file_orig;
+	prof_dump_write_file = write_file_orig;
+
+	char line[64];
+	malloc_snprintf(line, sizeof(line), "\n  tag%u: %"FMTu64": %"FMTu64
+	    " [", TAG, live_1.count, live_1.req_sum);
+	expect_ptr_not_null(strstr(dump_buf, line),
+	    "Dump should report the tag's live totals");
+
+	/* The tag belongs to the allocation, not to the freeing thread. */
+	thd_t thd;
+	thd_create(&thd, thd_free, (void *)ptrs);
+	thd_join(thd, NULL);
+
+	prof_stats_t live_2, accum_2;
+	tag_stats_get(TAG, &live_2, &accum_2);
+	expect_u64_eq(live_2.count, live_0.count, "");
+	expect_u64_eq(live_2.req_sum, live_0.req_sum, "");
+	expect_u64_eq(accum_2.count, accum_1.count, "");
+	expect_u64_eq(accum_2.req_sum, accum_1.req_sum, "");
+}
+TEST_END
+
+int
+main(void) {
+	return test(
+	    test_alloc_tag_ctl,
+	    test_alloc_tag_stats);
+}
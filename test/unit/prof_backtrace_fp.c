@@ -0,0 +1,121 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/prof_sys.h"
+
+#define NFRAMES 8
+
+/* A fake stack of frame records: {saved frame pointer, return address}. */
+static uintptr_t stack[NFRAMES * 2 + 2];
+
+static void
+build_chain(void) {
+	for (unsigned i = 0; i < NFRAMES; i++) {
+		uintptr_t *frame = &stack[i * 2];
+		frame[0] = (i == NFRAMES - 1) ? 0 : (uintptr_t)&stack[(i + 1) * 2];
+		frame[1] = 0x1000 + i;
+	}
+}
+
+static uintptr_t
+stack_lo(void) {
+	return (uintptr_t)stack;
+}
+
+static uintptr_t
+stack_hi(void) {
+	return (uintptr_t)stack + sizeof(stack);
+}
+
+TEST_BEGIN(test_fp_walk) {
+	void *vec[NFRAMES * 2];
+	unsigned len;
+
+	build_chain();
+	expect_false(prof_backtrace_fp_walk(vec, &len, NFRAMES * 2,
+	    (uintptr_t)stack, stack_lo(), stack_hi()),
+	    "Valid chain should be walked");
+	expect_u_eq(len, NFRAMES, "Should stop at a zero frame pointer");
+	for (unsigned i = 0; i < len; i++) {
+		expect_ptr_eq(vec[i], (void *)(uintptr_t)(0x1000 + i),
+		    "Wrong return address for frame %u", i);
+	}
+
+	expect_false(prof_backtrace_fp_walk(vec, &len, 3, (uintptr_t)stack,
+	    stack_lo(), stack_hi()), "Truncated walk should succeed");
+	expect_u_eq(len, 3, "Walk should stop at max_len");
+
+	stack[3 * 2 + 1] = 0;
+	expect_false(prof_backtrace_fp_walk(vec, &len, NFRAMES * 2,
+	    (uintptr_t)stack, stack_lo(), stack_hi()),
+	    "Zero return address should end the chain");
+	expect_u_eq(len, 3, "Should stop at a zero return address");
+}
+TEST_END
+
+TEST_BEGIN(test_fp_walk_invalid) {
+	void *vec[NFRAMES * 2];
+	unsigned len;
+
+	build_chain();
+	expect_true(prof_backtrace_fp_walk(vec, &len, NFRAMES * 2,
+	    (uintptr_t)stack, stack_lo() + sizeof(uintptr_t) * 4, stack_hi()),
+	    "Frame below the stack should be rejected");
+	expect_true(prof_backtrace_fp_walk(vec, &len, NFRAMES * 2,
+	    (uintptr_t)stack, stack_lo(), stack_hi() - sizeof(uintptr_t) * 4),
+	    "Frame above the stack should be rejected");
+	expect_true(prof_backtrace_fp_walk(vec, &len, NFRAMES * 2,
+	    (uintptr_t)stack, 0, 0), "Empty stack bounds should be rejected");
+	expect_true(prof_backtrace_fp_walk(vec, &len, NFRAMES * 2,
+	    (uintptr_t)stack + 1, stack_lo(), stack_hi()),
+	    "Misaligned frame should be rejected");
+	expect_true(prof_backtrace_fp_walk(vec, &len, NFRAMES * 2, 0,
+	    stack_lo(), stack_hi()), "An empty backtrace should be rejected");
+
+	/* A cycle, and a chain running away from the stack base. */
+	stack[4 * 2] = (uintptr_t)&stack[4 * 2];
+	expect_true(prof_backtrace_fp_walk(vec, &len, NFRAMES * 2,
+	    (uintptr_t)stack, stack_lo(), stack_hi()),
+	    "Cyclic chain should be rejected");
+	stack[4 * 2] = (uintptr_t)&stack[2 * 2];
+	expect_true(prof_backtrace_fp_walk(vec, &len, NFRAMES * 2,
+	    (uintptr_t)stack, stack_lo(), stack_hi()),
+	    "Backwards chain should be rejected");
+}
+TEST_END
+
+TEST_BEGIN(test_fp_backtrace) {
+	test_skip_if(!config_prof);
+	test_skip_if(opt_prof_backtrace_method != prof_backtrace_method_fp);
+
+	const char *method;
+	size_t sz = sizeof(method);
+	expect_d_eq(mallctl("opt.prof_backtrace_method", (void *)&method, &sz,
+	    NULL, 0), 0, "Unexpected mallctl() failure");
+	expect_str_eq(method, "fp", "Unexpected opt.prof_backtrace_method");
+
+	/*
+	 * Whether or not the frame records here are usable, sampled allocations
+	 * must end up with a backtrace.
+	 */
+	void *vec[PROF_BT_MAX_DEFAULT];
+	prof_bt_t bt;
+	bt_init(&bt, vec);
+	prof_backtrace(tsd_fetch(), &bt);
+	expect_u_gt(bt.len, 0, "Expected a non-empty backtrace");
+	for (unsigned i = 0; i < bt.len; i++) {
+		expect_ptr_not_null(bt.vec[i], "Unexpected NULL frame");
+	}
+
+	void *p = malloc(1);
+	expect_ptr_not_null(p, "Unexpected malloc() failure");
+	free(p);
+}
+TEST_END
+
+int
+main(void) {
+	return test(
+	    test_fp_walk,
+	    test_fp_walk_invalid,
+	    test_fp_backtrace);
+}
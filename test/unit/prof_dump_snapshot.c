@@ -0,0 +1,89 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/prof_data.h"
+#include "jemalloc/internal/prof_sys.h"
+
+/* Enough distinct backtraces that the dump spans many buffer flushes. */
+#define NBTS 1024
+
+static const char *test_filename = "test_filename";
+static unsigned nwrites;
+static bool saw_header;
+static size_t bt_count_during_write;
+static void *thd_ptrs[2];
+
+static int
+prof_dump_open_file_intercept(const char *filename, int mode) {
+	int fd = open("/dev/null", O_WRONLY);
+	assert_d_ne(fd, -1, "Unexpected open() failure");
+	return fd;
+}
+
+static void *
+thd_start(void *varg) {
+	/* Creating a tdata takes tdatas_mtx. */
+	thd_ptrs[0] = btalloc(1, NBTS);
+	expect_ptr_not_null(thd_ptrs[0], "Unexpected btalloc() failure");
+	/* A fresh backtrace needs the bt2gctx and gctx locks. */
+	thd_ptrs[1] = btalloc(1, NBTS + 1);
+	expect_ptr_not_null(thd_ptrs[1], "Unexpected btalloc() failure");
+	return NULL;
+}
+
+static ssize_t
+prof_dump_write_file_intercept(int fd, const void *s, size_t len) {
+	if (nwrites++ == 0) {
+		saw_header = (strncmp(s, "heap_v2/", strlen("heap_v2/")) == 0);
+		/*
+		 * Output happens from the snapshot, with none of the profiling
+		 * locks held, so a thread that needs all of them can run to
+		 * completion in the middle of it.
+		 */
+		thd_t thd;
+		thd_create(&thd, thd_start, NULL);
+		thd_join(thd, NULL);
+		bt_count_during_write = prof_bt_count();
+	}
+	return len;
+}
+
+TEST_BEGIN(test_dump_does_not_block_allocation) {
+	test_skip_if(!config_prof);
+	test_skip_if(opt_prof_format != prof_format_heap_v2);
+
+	void *ptrs[NBTS];
+	for (unsigned i = 0; i < NBTS; i++) {
+		ptrs[i] = btalloc(1, i);
+		assert_ptr_not_null(ptrs[i], "Unexpected btalloc() failure");
+	}
+	size_t bt_count = prof_bt_count();
+
+	prof_dump_open_file_t *open_file_orig = prof_dump_open_file;
+	prof_dump_write_file_t *write_file_orig = prof_dump_write_file;
+	prof_dump_open_file = prof_dump_open_file_intercept;
+	prof_dump_write_file = prof_dump_write_file_intercept;
+	nwrites = 0;
+	expect_d_eq(mallctl("prof.dump", NULL, NULL, (void *)&test_filename,
+	    sizeof(test_filename)), 0,
+	    "Unexpected mallctl failure while dumping");
+	prof_dump_open_file = open_file_orig;
+	prof_dump_write_file = write_file_orig;
+
+	expect_u_gt(nwrites, 1, "Dump should need more than one flush");
+	expect_true(saw_header, "Dump should start with the header");
+	expect_zu_gt(bt_count_during_write, bt_count,
+	    "New backtraces should be recorded while the dump is written");
+
+	for (unsigned i = 0; i < NBTS; i++) {
+		dallocx(ptrs[i], 0);
+	}
+	dallocx(thd_ptrs[0], 0);
+	dallocx(thd_ptrs[1], 0);
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(
+	    test_dump_does_not_block_allocation);
+}
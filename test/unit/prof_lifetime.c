@@ -0,0 +1,118 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/prof_sys.h"
+
+#define NALLOCS 16
+#define DUMP_BUF_SIZE (1 << 20)
+
+static const char *test_filename = "test_filename";
+static char dump_buf[DUMP_BUF_SIZE];
+static size_t dump_len;
+
+static uint64_t mock_ns;
+
+static void
+nstime_prof_update_mock(nstime_t *time) {
+	nstime_init(time, mock_ns);
+}
+
+static int
+prof_dump_open_file_intercept(const char *filename, int mode) {
+	int fd = open("/dev/null", O_WRONLY);
+	assert_d_ne(fd, -1, "Unexpected open() failure");
+	dump_len = 0;
+	return fd;
+}
+
+static ssize_t
+prof_dump_write_file_intercept(int fd, const void *s, size_t len) {
+	assert_zu_lt(dump_len + len, DUMP_BUF_SIZE, "Dump too large");
+	memcpy(dump_buf + dump_len, s, len);
+	dump_len += len;
+	dump_buf[dump_len] = '\0';
+	return len;
+}
+
+TEST_BEGIN(test_lifetime_bucket) {
+	test_skip_if(!config_prof);
+
+	expect_u_eq(prof_lifetime_bucket(0), 0, "");
+	expect_u_eq(prof_lifetime_bucket(1023), 0, "");
+	expect_u_eq(prof_lifetime_bucket(1024), 1, "");
+	expect_u_eq(prof_lifetime_bucket(4095), 1, "");
+	expect_u_eq(prof_lifetime_bucket(4096), 2, "");
+	expect_u_eq(prof_lifetime_bucket((UINT64_C(1) << 46) - 1),
+	    PROF_LIFETIME_NBUCKETS - 2, "");
+	expect_u_eq(prof_lifetime_bucket(UINT64_C(1) << 46),
+	    PROF_LIFETIME_NBUCKETS - 1, "");
+	expect_u_eq(prof_lifetime_bucket(UINT64_MAX),
+	    PROF_LIFETIME_NBUCKETS - 1, "");
+}
+TEST_END
+
+/* Sums bucket ind over all "lifetime:" lines of the captured dump. */
+static size_t
+dump_lifetime_count(unsigned ind) {
+	size_t total = 0;
+	const char *line = dump_buf;
+	while ((line = strstr(line, "  lifetime:")) != NULL) {
+		char *end = (char *)line + strlen("  lifetime:");
+		for (unsigned i = 0; i < PROF_LIFETIME_NBUCKETS; i++) {
+			size_t count = (size_t)strtoull(end, &end, 10);
+			if (i == ind) {
+				total += count;
+			}
+		}
+		line = end;
+	}
+	return total;
+}
+
+TEST_BEGIN(test_lifetime_dump) {
+	test_skip_if(!config_prof);
+	test_skip_if(!opt_prof_lifetime);
+	test_skip_if(opt_prof_format != prof_format_heap_v2);
+
+	nstime_prof_update_t *update_orig = nstime_prof_update;
+	nstime_prof_update = nstime_prof_update_mock;
+
+	/* Far from any real clock reading, so no other frees land here. */
+	unsigned ind = 11;
+	mock_ns = UINT64_C(1) << 56;
+	void *ptrs[NALLOCS];
+	for (unsigned i = 0; i < NALLOCS; i++) {
+		ptrs[i] = btalloc(1, i);
+		assert_ptr_not_null(ptrs[i], "Unexpected btalloc() failure");
+	}
+	mock_ns += UINT64_C(1) << (PROF_LIFETIME_LG_MIN_NS +
+	    (ind - 1) * PROF_LIFETIME_LG_STEP);
+	/*
+	 * Free every object of the allocation contexts; without prof_accum,
+	 * their histograms must outlive them to make it into the dump.
+	 */
+	for (unsigned i = 0; i < NALLOCS; i++) {
+		dallocx(ptrs[i], 0);
+	}
+	nstime_prof_update = update_orig;
+
+	prof_dump_open_file_t *open_file_orig = prof_dump_open_file;
+	prof_dump_write_file_t *write_file_orig = prof_dump_write_file;
+	prof_dump_open_file = prof_dump_open_file_intercept;
+	prof_dump_write_file = prof_dump_write_file_intercept;
+	expect_d_eq(mallctl("prof.dump", NULL, NULL, (void *)&test_filename,
+	    sizeof(test_filename)), 0,
+	    "Unexpected mallctl failure while dumping");
+	prof_dump_open_file = open_file_orig;
+	prof_dump_write_file = write_file_orig;
+
+	expect_zu_eq(dump_lifetime_count(ind), NALLOCS,
+	    "Each freed sample should be counted once in its bucket");
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(
+	    test_lifetime_bucket,
+	    test_lifetime_dump);
+}
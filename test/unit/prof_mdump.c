@@ -45,6 +45,78 @@ TEST_BEGIN(test_mdump_normal) {
 }
 TEST_END
 
+static int
+prof_dump_open_file_unexpected(const char *filename, int mode) {
+	did_prof_dump_open = true;
+	return -1;
+}
+
+typedef struct {
+	char *buf;
+	size_t len;
+	size_t cap;
+} dump_buf_t;
+
+static void
+prof_dump_write_cb(void *cbopaque, const void *bytes, size_t len) {
+	dump_buf_t *dump_buf = (dump_buf_t *)cbopaque;
+	if (dump_buf->len + len + 1 > dump_buf->cap) {
+		size_t cap = dump_buf->cap == 0 ? 4096 : dump_buf->cap;
+		while (dump_buf->len + len + 1 > cap) {
+			cap *= 2;
+		}
+		dump_buf->buf = realloc(dump_buf->buf, cap);
+		assert_ptr_not_null(dump_buf->buf,
+		    "Unexpected realloc() failure");
+		dump_buf->cap = cap;
+	}
+	memcpy(dump_buf->buf + dump_buf->len, bytes, len);
+	dump_buf->len += len;
+	dump_buf->buf[dump_buf->len] = '\0';
+}
+
+TEST_BEGIN(test_mdump_cb) {
+	test_skip_if(!config_prof);
+
+	prof_dump_open_file_t *open_file_orig = prof_dump_open_file;
+
+	void *p = mallocx(1, 0);
+	assert_ptr_not_null(p, "Unexpected mallocx() failure");
+
+	struct {
+		prof_dump_write_cb_t *write_cb;
+		void *cbopaque;
+	} packet;
+	dump_buf_t dump_buf = {NULL, 0, 0};
+	packet.write_cb = prof_dump_write_cb;
+	packet.cbopaque = &dump_buf;
+
+	prof_dump_open_file = prof_dump_open_file_unexpected;
+	did_prof_dump_open = false;
+	expect_d_eq(mallctl("experimental.prof_dump", NULL, NULL, &packet,
+	    sizeof(packet)), 0, "Unexpected mallctl failure while dumping");
+	expect_false(did_prof_dump_open, "No dump file should be opened");
+	prof_dump_open_file = open_file_orig;
+
+	assert_ptr_not_null(dump_buf.buf, "Expected dump output");
+	expect_d_eq(strncmp(dump_buf.buf, "heap_v2/1\n", 10), 0,
+	    "Unexpected dump header");
+	expect_ptr_not_null(strstr(dump_buf.buf, "\n@ "),
+	    "Expected the sampled allocation in the dump");
+	if (prof_dump_open_maps != NULL) {
+		expect_ptr_not_null(strstr(dump_buf.buf, "MAPPED_LIBRARIES:"),
+		    "Expected mappings in the dump");
+	}
+	free(dump_buf.buf);
+
+	packet.write_cb = NULL;
+	expect_d_eq(mallctl("experimental.prof_dump", NULL, NULL, &packet,
+	    sizeof(packet)), EINVAL, "A callback is required");
+
+	dallocx(p, 0);
+}
+TEST_END
+
 static int
 prof_dump_open_file_error(const char *filename, int mode) {
 	return -1;
@@ -212,6 +284,7 @@ int
 main(void) {
 	return test(
 	    test_mdump_normal,
+	    test_mdump_cb,
 	    test_mdump_output_error,
 	    test_mdump_maps_error);
 }
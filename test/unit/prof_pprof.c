@@ -0,0 +1,203 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/prof_sys.h"
+
+#define DUMP_BUF_SIZE	(4 << 20)
+#define MAX_LOCATIONS	4096
+#define ALLOC_SIZE	12345
+
+static const char *test_filename = "test_filename";
+static unsigned char dump_buf[DUMP_BUF_SIZE];
+static size_t dump_len;
+
+static int
+prof_dump_open_file_intercept(const char *filename, int mode) {
+	int fd = open("/dev/null", O_WRONLY);
+	assert_d_ne(fd, -1, "Unexpected open() failure");
+	dump_len = 0;
+	return fd;
+}
+
+static ssize_t
+prof_dump_write_file_intercept(int fd, const void *s, size_t len) {
+	assert_zu_le(dump_len + len, DUMP_BUF_SIZE, "Dump too large");
+	memcpy(dump_buf + dump_len, s, len);
+	dump_len += len;
+	return len;
+}
+
+typedef struct {
+	const unsigned char *p;
+	const unsigned char *end;
+} pb_reader_t;
+
+static uint64_t
+pb_varint(pb_reader_t *r) {
+	uint64_t v = 0;
+	for (unsigned shift = 0; ; shift += 7) {
+		assert_true(r->p < r->end, "Truncated varint");
+		assert_u_lt(shift, 64, "Varint too long");
+		unsigned char b = *r->p++;
+		v |= (uint64_t)(b & 0x7f) << shift;
+		if ((b & 0x80) == 0) {
+			return v;
+		}
+	}
+}
+
+/* Returns the wire type; sets *field and, for LEN fields, *sub. */
+static unsigned
+pb_field(pb_reader_t *r, uint64_t *field, pb_reader_t *sub, uint64_t *val) {
+	uint64_t key = pb_varint(r);
+	*field = key >> 3;
+	unsigned wire = (unsigned)(key & 7);
+	if (wire == 0) {
+		*val = pb_varint(r);
+	} else {
+		assert_u_eq(wire, 2, "Unexpected wire type");
+		uint64_t len = pb_varint(r);
+		assert_u64_le(len, (uint64_t)(r->end - r->p),
+		    "Truncated length-delimited field");
+		sub->p = r->p;
+		sub->end = r->p + len;
+		r->p += len;
+	}
+	return wire;
+}
+
+static uint64_t location_ids[MAX_LOCATIONS];
+static unsigned nlocations;
+
+static bool
+location_known(uint64_t id) {
+	for (unsigned i = 0; i < nlocations; i++) {
+		if (location_ids[i] == id) {
+			return true;
+		}
+	}
+	return false;
+}
+
+TEST_BEGIN(test_pprof_dump) {
+	test_skip_if(!config_prof);
+	test_skip_if(opt_prof_format != prof_format_pprof);
+
+	prof_dump_open_file_t *open_file_orig = prof_dump_open_file;
+	prof_dump_write_file_t *write_file_orig = prof_dump_write_file;
+
+	void *p = btalloc(ALLOC_SIZE, 0);
+	assert_ptr_not_null(p, "Unexpected btalloc() failure");
+
+	prof_dump_open_file = prof_dump_open_file_intercept;
+	prof_dump_write_file = prof_dump_write_file_intercept;
+	expect_d_eq(mallctl("prof.dump", NULL, NULL, (void *)&test_filename,
+	    sizeof(test_filename)), 0,
+	    "Unexpected mallctl failure while dumping");
+	prof_dump_open_file = open_file_orig;
+	prof_dump_write_file = write_file_orig;
+
+	assert_zu_gt(dump_len, 0, "Empty dump");
+
+	/* First pass: strings, sample types, mappings and locations. */
+	unsigned nstrings = 0, nsample_types = 0, nmappings = 0;
+	uint64_t period = 0;
+	nlocations = 0;
+	pb_reader_t r = {dump_buf, dump_buf + dump_len};
+	while (r.p < r.end) {
+		uint64_t field, val;
+		pb_reader_t sub;
+		unsigned wire = pb_field(&r, &field, &sub, &val);
+		switch (field) {
+		case 1: /* sample_type */
+			nsample_types++;
+			break;
+		case 3: /* mapping */
+			expect_u_eq(wire, 2, "Mapping should be a message");
+			nmappings++;
+			break;
+		case 4: { /* location */
+			uint64_t id = 0;
+			while (sub.p < sub.end) {
+				uint64_t f, v;
+				pb_reader_t s;
+				if (pb_field(&sub, &f, &s, &v) == 0 && f == 1) {
+					id = v;
+				}
+			}
+			expect_u64_ne(id, 0, "Location ids must be nonzero");
+			expect_false(location_known(id),
+			    "Duplicate location id %"FMTu64, id);
+			assert_u_lt(nlocations, MAX_LOCATIONS,
+			    "Too many locations");
+			location_ids[nlocations++] = id;
+			break;
+		}
+		case 6: /* string_table */
+			if (nstrings == 0) {
+				expect_ptr_eq(sub.p, sub.end,
+				    "string_table[0] must be empty");
+			}
+			nstrings++;
+			break;
+		case 12: /* period */
+			period = val;
+			break;
+		default:
+			break;
+		}
+	}
+	expect_u_gt(nstrings, 1, "Missing string table");
+	expect_u_ge(nsample_types, 2, "Missing sample types");
+	expect_u64_eq(period, ZU(1) << opt_lg_prof_sample, "Wrong period");
+#ifdef __linux__
+	expect_u_gt(nmappings, 0, "Expected mappings from /proc/self/maps");
+#endif
+
+	/* Second pass: samples. */
+	unsigned nsamples = 0;
+	bool found_alloc = false;
+	r.p = dump_buf;
+	while (r.p < r.end) {
+		uint64_t field, val;
+		pb_reader_t sub;
+		pb_field(&r, &field, &sub, &val);
+		if (field != 2) {
+			continue;
+		}
+		nsamples++;
+		unsigned nvalues = 0;
+		uint64_t inuse_space = 0;
+		while (sub.p < sub.end) {
+			uint64_t f, v;
+			pb_reader_t s;
+			expect_u_eq(pb_field(&sub, &f, &s, &v), 2,
+			    "Expected packed repeated fields");
+			while (s.p < s.end) {
+				v = pb_varint(&s);
+				if (f == 1) {
+					expect_true(location_known(v),
+					    "Unknown location id %"FMTu64, v);
+				} else if (f == 2) {
+					nvalues++;
+					inuse_space = v;
+				}
+			}
+		}
+		expect_u_eq(nvalues, nsample_types,
+		    "Sample value count should match the sample types");
+		if (inuse_space >= ALLOC_SIZE) {
+			found_alloc = true;
+		}
+	}
+	expect_u_gt(nsamples, 0, "Expected at least one sample");
+	expect_true(found_alloc, "Expected a sample covering the allocation");
+
+	dallocx(p, 0);
+}
+TEST_END
+
+int
+main(void) {
+	return test(
+	    test_pprof_dump);
+}
@@ -142,6 +142,13 @@ confirm_record_released(prof_recent_t *n) {
 	    "dalloc_tctx in record should not be NULL for released pointer");
 }
 
+/* The i'th oldest record, or NULL if there are fewer records. */
+static prof_recent_t *
+recent_nth(unsigned i) {
+	return i < prof_recent_alloc_count_test() ?
+	    prof_recent_alloc_nth_test(i) : NULL;
+}
+
 TEST_BEGIN(test_prof_recent_alloc) {
 	test_skip_if(!config_prof);
 
@@ -164,7 +171,7 @@ TEST_BEGIN(test_prof_recent_alloc) {
 		p = malloc(req_size);
 		confirm_malloc(p);
 		if (i < OPT_ALLOC_MAX - 1) {
-			assert_false(ql_empty(&prof_recent_alloc_list),
+			assert_zu_ne(prof_recent_alloc_count_test(), 0,
 			    "Empty recent allocation");
 			free(p);
 			/*
@@ -174,8 +181,7 @@ TEST_BEGIN(test_prof_recent_alloc) {
 			 */
 			continue;
 		}
-		c = 0;
-		ql_foreach(n, &prof_recent_alloc_list, link) {
+		for (c = 0; (n = recent_nth(c)) != NULL;) {
 			++c;
 			confirm_record_size(n, i + c - OPT_ALLOC_MAX);
 			if (c == OPT_ALLOC_MAX) {
@@ -203,11 +209,9 @@ TEST_BEGIN(test_prof_recent_alloc) {
 		req_size = NTH_REQ_SIZE(i);
 		p = malloc(req_size);
 		assert_ptr_not_null(p, "malloc failed unexpectedly");
-		c = 0;
-		ql_foreach(n, &prof_recent_alloc_list, link) {
+		for (c = 0; (n = recent_nth(c)) != NULL; ++c) {
 			confirm_record_size(n, c + OPT_ALLOC_MAX);
 			confirm_record_released(n);
-			++c;
 		}
 		assert_u_eq(c, OPT_ALLOC_MAX,
 		    "Incorrect total number of allocations");
@@ -230,8 +234,7 @@ TEST_BEGIN(test_prof_recent_alloc) {
 		req_size = NTH_REQ_SIZE(i);
 		p = malloc(req_size);
 		confirm_malloc(p);
-		c = 0;
-		ql_foreach(n, &prof_recent_alloc_list, link) {
+		for (c = 0; (n = recent_nth(c)) != NULL;) {
 			++c;
 			confirm_record_size(n,
 			    /* Is the allocation from the third batch? */
@@ -258,11 +261,9 @@ TEST_BEGIN(test_prof_recent_alloc) {
 	future = OPT_ALLOC_MAX + 1;
 	assert_d_eq(mallctl("experimental.prof_recent.alloc_max",
 	    NULL, NULL, &future, sizeof(ssize_t)), 0, "Write error");
-	c = 0;
-	ql_foreach(n, &prof_recent_alloc_list, link) {
+	for (c = 0; (n = recent_nth(c)) != NULL; ++c) {
 		confirm_record_size(n, c + 3 * OPT_ALLOC_MAX);
 		confirm_record_released(n);
-		++c;
 	}
 	assert_u_eq(c, OPT_ALLOC_MAX,
 	    "Incorrect total number of allocations");
@@ -274,11 +275,9 @@ TEST_BEGIN(test_prof_recent_alloc) {
 	future = OPT_ALLOC_MAX;
 	assert_d_eq(mallctl("experimental.prof_recent.alloc_max",
 	    NULL, NULL, &future, sizeof(ssize_t)), 0, "Write error");
-	c = 0;
-	ql_foreach(n, &prof_recent_alloc_list, link) {
+	for (c = 0; (n = recent_nth(c)) != NULL; ++c) {
 		confirm_record_size(n, c + 3 * OPT_ALLOC_MAX);
 		confirm_record_released(n);
-		++c;
 	}
 	assert_u_eq(c, OPT_ALLOC_MAX,
 	    "Incorrect total number of allocations");
@@ -290,8 +289,7 @@ TEST_BEGIN(test_prof_recent_alloc) {
 	future = OPT_ALLOC_MAX - 1;
 	assert_d_eq(mallctl("experimental.prof_recent.alloc_max",
 	    NULL, NULL, &future, sizeof(ssize_t)), 0, "Write error");
-	c = 0;
-	ql_foreach(n, &prof_recent_alloc_list, link) {
+	for (c = 0; (n = recent_nth(c)) != NULL;) {
 		++c;
 		confirm_record_size(n, c + 3 * OPT_ALLOC_MAX);
 		confirm_record_released(n);
@@ -303,8 +301,7 @@ TEST_BEGIN(test_prof_recent_alloc) {
 	future = -1;
 	assert_d_eq(mallctl("experimental.prof_recent.alloc_max",
 	    NULL, NULL, &future, sizeof(ssize_t)), 0, "Write error");
-	c = 0;
-	ql_foreach(n, &prof_recent_alloc_list, link) {
+	for (c = 0; (n = recent_nth(c)) != NULL;) {
 		++c;
 		confirm_record_size(n, c + 3 * OPT_ALLOC_MAX);
 		confirm_record_released(n);
@@ -316,25 +313,25 @@ TEST_BEGIN(test_prof_recent_alloc) {
 	future = 1;
 	assert_d_eq(mallctl("experimental.prof_recent.alloc_max",
 	    NULL, NULL, &future, sizeof(ssize_t)), 0, "Write error");
-	assert_false(ql_empty(&prof_recent_alloc_list), "Recent list is empty");
-	n = ql_first(&prof_recent_alloc_list);
+	n = recent_nth(0);
+	assert_ptr_not_null(n, "Recent list is empty");
 	confirm_record_size(n, 4 * OPT_ALLOC_MAX - 1);
 	confirm_record_released(n);
-	n = ql_next(&prof_recent_alloc_list, n, link);
-	assert_ptr_null(n, "Recent list should only contain one record");
+	assert_ptr_null(recent_nth(1),
+	    "Recent list should only contain one record");
 
 	/* Completely turn off. */
 	future = 0;
 	assert_d_eq(mallctl("experimental.prof_recent.alloc_max",
 	    NULL, NULL, &future, sizeof(ssize_t)), 0, "Write error");
-	assert_true(ql_empty(&prof_recent_alloc_list),
+	assert_zu_eq(prof_recent_alloc_count_test(), 0,
 	    "Recent list should be empty");
 
 	/* Restore the settings. */
 	future = OPT_ALLOC_MAX;
 	assert_d_eq(mallctl("experimental.prof_recent.alloc_max",
 	    NULL, NULL, &future, sizeof(ssize_t)), 0, "Write error");
-	assert_true(ql_empty(&prof_recent_alloc_list),
+	assert_zu_eq(prof_recent_alloc_count_test(), 0,
 	    "Recent list should be empty");
 
 	confirm_prof_setup();
@@ -0,0 +1,115 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/prof_data.h"
+
+#define NHELD 64
+#define ALLOC_SIZE 96
+
+TEST_BEGIN(test_sample_level_next) {
+	test_skip_if(!config_prof);
+
+	/* 100 samples/s against a target of 100/s: stay put. */
+	expect_u_eq(prof_sample_level_next(3, 7, 10, 100000000, 100), 3, "");
+	/* Twice the target: one step up. */
+	expect_u_eq(prof_sample_level_next(3, 7, 20, 100000000, 100), 4, "");
+	/* Eight times the target: three steps up. */
+	expect_u_eq(prof_sample_level_next(0, 7, 80, 100000000, 100), 3, "");
+	/* Capped by max_level. */
+	expect_u_eq(prof_sample_level_next(0, 2, 1000, 100000000, 100), 2,
+	    "");
+	/* Half the target: one step down. */
+	expect_u_eq(prof_sample_level_next(3, 7, 5, 100000000, 100), 2, "");
+	/* No samples at all: all the way down. */
+	expect_u_eq(prof_sample_level_next(5, 7, 0, 100000000, 100), 0, "");
+	/* Level 0 is the floor. */
+	expect_u_eq(prof_sample_level_next(0, 7, 1, 1000000000, 100), 0, "");
+	/*
+	 * A long window (~213 days here) with a high target must not wrap
+	 * target * elapsed around to a tiny allowance.
+	 */
+	expect_u_eq(prof_sample_level_next(3, 7, 1000, 18446744073710000ULL,
+	    1000000), 0, "");
+	expect_u_eq(prof_sample_level_next(3, 7, 1000, UINT64_MAX, SIZE_MAX),
+	    0, "");
+}
+TEST_END
+
+TEST_BEGIN(test_sample_adapt) {
+	test_skip_if(!config_prof);
+
+	expect_zu_eq(opt_prof_sample_target, 1, "Unexpected option value");
+	expect_true(opt_prof_unbias,
+	    "prof_sample_target should force prof_unbias");
+	/* Earlier runs of this test leave the level raised. */
+	expect_d_eq(mallctl("prof.reset", NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl failure");
+	expect_u_eq(atomic_load_u(&prof_sample_level, ATOMIC_RELAXED), 0,
+	    "prof.reset should restore the configured rate");
+
+	prof_cnt_t cnt_0;
+	prof_cnt_all(&cnt_0);
+
+	/* Sampled at level 0. */
+	void *held_0[NHELD];
+	for (unsigned i = 0; i < NHELD; i++) {
+		held_0[i] = malloc(ALLOC_SIZE);
+		expect_ptr_not_null(held_0[i], "Unexpected malloc() failure");
+	}
+
+	/*
+	 * Sampling every allocation is far above one sample per second, so
+	 * the level should rise once the first window closes.
+	 */
+	nstime_t start, now;
+	nstime_init_update(&start);
+	while (atomic_load_u(&prof_sample_level, ATOMIC_RELAXED) == 0) {
+		void *p = malloc(ALLOC_SIZE);
+		expect_ptr_not_null(p, "Unexpected malloc() failure");
+		free(p);
+		nstime_init_update(&now);
+		nstime_subtract(&now, &start);
+		if (nstime_sec(&now) >= 10) {
+			break;
+		}
+	}
+	expect_u_gt(atomic_load_u(&prof_sample_level, ATOMIC_RELAXED), 0,
+	    "Sampling level should have risen");
+	expect_u_le(atomic_load_u(&prof_sample_level, ATOMIC_RELAXED),
+	    prof_sample_max_level(), "Sampling level out of range");
+
+	/* Whatever gets sampled now is weighted at the higher levels. */
+	void *held_1[NHELD];
+	for (unsigned i = 0; i < NHELD; i++) {
+		held_1[i] = malloc(ALLOC_SIZE);
+		expect_ptr_not_null(held_1[i], "Unexpected malloc() failure");
+	}
+
+	prof_cnt_t cnt_1;
+	prof_cnt_all(&cnt_1);
+	expect_u64_gt(cnt_1.curobjs, cnt_0.curobjs,
+	    "Held allocations should have been sampled");
+
+	/*
+	 * Frees must subtract the weight each object was sampled with, so the
+	 * unbiased totals return exactly to where they started.
+	 */
+	for (unsigned i = 0; i < NHELD; i++) {
+		free(held_0[i]);
+		free(held_1[i]);
+	}
+	prof_cnt_t cnt_2;
+	prof_cnt_all(&cnt_2);
+	expect_u64_eq(cnt_2.curobjs, cnt_0.curobjs, "Leaked sample");
+	expect_u64_eq(cnt_2.curobjs_shifted_unbiased,
+	    cnt_0.curobjs_shifted_unbiased, "Unbiased count mismatch");
+	expect_u64_eq(cnt_2.curbytes_unbiased, cnt_0.curbytes_unbiased,
+	    "Unbiased bytes mismatch");
+}
+TEST_END
+
+int
+main(void) {
+	return test(
+	    test_sample_level_next,
+	    test_sample_adapt);
+}
@@ -0,0 +1,121 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/prof_sys.h"
+
+#define TEST_PREFIX "test_prefix"
+#define MB ((size_t)1 << 20)
+
+static unsigned nwdumps;
+
+static int
+prof_dump_open_file_intercept(const char *filename, int mode) {
+	const char filename_prefix[] = TEST_PREFIX ".";
+	expect_d_eq(strncmp(filename_prefix, filename, sizeof(filename_prefix)
+	    - 1), 0, "Dump file name should start with \"" TEST_PREFIX ".\"");
+	expect_ptr_not_null(strstr(filename, ".w"),
+	    "Expected a watermark dump file name, got \"%s\"", filename);
+	nwdumps++;
+
+	int fd = open("/dev/null", O_WRONLY);
+	assert_d_ne(fd, -1, "Unexpected open() failure");
+
+	return fd;
+}
+
+/* Checks the watermarks, then takes a sample, which writes any due dump. */
+static unsigned
+watermark_check(void) {
+	prof_watermark_evaluate(tsd_tsdn(tsd_fetch()));
+	void *p = mallocx(1, 0);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	dallocx(p, 0);
+	return nwdumps;
+}
+
+static void
+watermark_setup(void) {
+	const char *test_prefix = TEST_PREFIX;
+	expect_d_eq(mallctl("prof.prefix", NULL, NULL, (void *)&test_prefix,
+	    sizeof(test_prefix)), 0,
+	    "Unexpected mallctl failure while overwriting dump prefix");
+	prof_dump_open_file = prof_dump_open_file_intercept;
+}
+
+TEST_BEGIN(test_watermark_growth) {
+	test_skip_if(!config_prof);
+	test_skip_if(!config_stats);
+
+	watermark_setup();
+	expect_u_eq(watermark_check(), 0, "Dumped below the threshold");
+
+	/* Reaching 32 MiB triggers, and moves the next dump to 2x. */
+	void *a = mallocx(32 * MB, 0);
+	expect_u_eq(watermark_check(), 1, "Expected a dump at the threshold");
+	expect_u_eq(watermark_check(), 1, "Dumped twice for one crossing");
+
+	void *b = mallocx(16 * MB, 0);
+	expect_u_eq(watermark_check(), 1, "Dumped before doubling");
+	void *c = mallocx(32 * MB, 0);
+	expect_u_eq(watermark_check(), 2, "Expected a dump after doubling");
+
+	/* Dropping to within the hysteresis keeps the 80 MiB baseline. */
+	dallocx(b, 0);
+	expect_u_eq(watermark_check(), 2, "Unexpected dump");
+	b = mallocx(16 * MB, 0);
+	expect_u_eq(watermark_check(), 2, "Unexpected dump");
+
+	/* Dropping by more than half measures growth from the lower value. */
+	dallocx(b, 0);
+	dallocx(c, 0);
+	expect_u_eq(watermark_check(), 2, "Unexpected dump");
+	b = mallocx(40 * MB, 0);
+	expect_u_eq(watermark_check(), 3,
+	    "Expected a dump after doubling from the lower value");
+
+	dallocx(a, 0);
+	dallocx(b, 0);
+}
+TEST_END
+
+TEST_BEGIN(test_watermark_background_thread) {
+	test_skip_if(!config_prof);
+	test_skip_if(!config_stats);
+	test_skip_if(!have_background_thread);
+
+	watermark_setup();
+	unsigned ndumps = watermark_check();
+	/* Well beyond any level the previous test could have left. */
+	void *p = mallocx(256 * MB, 0);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+
+	bool enable = true;
+	expect_d_eq(mallctl("background_thread", NULL, NULL, &enable,
+	    sizeof(enable)), 0, "Failed to enable background threads");
+
+	nstime_t start, now;
+	nstime_init_update(&start);
+	while (nwdumps == ndumps) {
+		void *q = mallocx(1, 0);
+		expect_ptr_not_null(q, "Unexpected mallocx() failure");
+		dallocx(q, 0);
+		sleep_ns(10 * 1000 * 1000);
+		nstime_init_update(&now);
+		nstime_subtract(&now, &start);
+		assert_u64_lt(nstime_sec(&now), 10,
+		    "The background thread never triggered a dump");
+	}
+	expect_u_eq(nwdumps, ndumps + 1, "Expected exactly one dump");
+
+	enable = false;
+	expect_d_eq(mallctl("background_thread", NULL, NULL, &enable,
+	    sizeof(enable)), 0, "Failed to disable background threads");
+	dallocx(p, 0);
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(
+	    test_watermark_growth,
+	    test_watermark_background_thread);
+}
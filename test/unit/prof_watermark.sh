@@ -0,0 +1,5 @@
+#!/bin/sh
+
+if [ "x${enable_prof}" = "x1" ] ; then
+  export MALLOC_CONF="prof:true,prof_active:true,lg_prof_sample:0,prof_watermark_allocated:33554432,prof_watermark_growth:100,prof_watermark_hysteresis:50,prof_watermark_interval_ms:0"
+fi
@@ -179,8 +179,96 @@ TEST_BEGIN(test_retained) {
 }
 TEST_END
 
+static size_t
+do_get_retained(unsigned ind) {
+	do_refresh();
+	return do_get_size_impl("stats.arenas.0.retained", ind);
+}
+
+static void
+do_arena_set_size(const char *cmd, unsigned ind, void *newp, size_t newlen) {
+	size_t mib[3];
+	size_t miblen = sizeof(mib) / sizeof(size_t);
+	expect_d_eq(mallctlnametomib(cmd, mib, &miblen), 0,
+	    "Unexpected mallctlnametomib(\"%s\", ...) failure", cmd);
+	mib[1] = (size_t)ind;
+	expect_d_eq(mallctlbymib(mib, miblen, NULL, NULL, newp, newlen), 0,
+	    "Unexpected mallctlbymib([\"%s\"], ...) failure", cmd);
+}
+
+#define LOOKAHEAD_NBATCHES 64
+#define LOOKAHEAD_BATCH 128
+static void *lookahead_ptrs[LOOKAHEAD_NBATCHES * LOOKAHEAD_BATCH];
+
+/*
+ * Allocates steadily from a fresh arena that grows retained memory one huge
+ * page at a time, and returns how much retained memory the arena ends up with.
+ * Page-sized slabs use up each growth exactly, so that retained memory only
+ * accumulates if it is mapped ahead of demand.
+ */
+static size_t
+do_lookahead_workload(unsigned lookahead_ms) {
+	unsigned ind = do_arena_create(NULL);
+	size_t grow_limit = HUGEPAGE;
+	do_arena_set_size("arena.0.retain_grow_limit", ind, &grow_limit,
+	    sizeof(grow_limit));
+	do_arena_set_size("arena.0.retain_lookahead_ms", ind, &lookahead_ms,
+	    sizeof(lookahead_ms));
+
+	for (unsigned i = 0; i < LOOKAHEAD_NBATCHES * LOOKAHEAD_BATCH; i++) {
+		lookahead_ptrs[i] = mallocx(PAGE, MALLOCX_ARENA(ind) |
+		    MALLOCX_TCACHE_NONE);
+		expect_ptr_not_null(lookahead_ptrs[i],
+		    "Unexpected mallocx() failure");
+		if (i % LOOKAHEAD_BATCH == 0) {
+			sleep_ns(10 * 1000 * 1000);
+		}
+	}
+
+	/* Give the background thread time to catch up. */
+	size_t retained;
+	nstime_t start, now;
+	nstime_init_update(&start);
+	while ((retained = do_get_retained(ind)) < 4 * HUGEPAGE) {
+		nstime_init_update(&now);
+		nstime_subtract(&now, &start);
+		if (nstime_msec(&now) > (lookahead_ms == 0 ? 500 : 30 * 1000)) {
+			break;
+		}
+		sleep_ns(10 * 1000 * 1000);
+	}
+
+	for (unsigned i = 0; i < LOOKAHEAD_NBATCHES * LOOKAHEAD_BATCH; i++) {
+		dallocx(lookahead_ptrs[i], MALLOCX_TCACHE_NONE);
+	}
+	do_arena_destroy(ind);
+	return retained;
+}
+
+TEST_BEGIN(test_retained_lookahead) {
+	test_skip_if(!config_stats);
+	test_skip_if(opt_hpa);
+	test_skip_if(!opt_retain);
+	test_skip_if(!have_background_thread);
+
+	bool enable = true;
+	expect_d_eq(mallctl("background_thread", NULL, NULL, (void *)&enable,
+	    sizeof(enable)), 0, "Unexpected mallctl() failure");
+
+	expect_zu_lt(do_lookahead_workload(0), 4 * HUGEPAGE,
+	    "Retained memory should only grow on demand");
+	expect_zu_ge(do_lookahead_workload(1000), 4 * HUGEPAGE,
+	    "Retained memory should grow ahead of demand");
+
+	enable = false;
+	expect_d_eq(mallctl("background_thread", NULL, NULL, (void *)&enable,
+	    sizeof(enable)), 0, "Unexpected mallctl() failure");
+}
+TEST_END
+
 int
 main(void) {
 	return test(
-	    test_retained);
+	    test_retained,
+	    test_retained_lookahead);
 }
@@ -32,8 +32,58 @@ TEST_BEGIN(test_arena_slab_regind) {
 }
 TEST_END
 
+static void
+expect_zeroed(const unsigned char *p, size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		expect_u_eq(p[i], 0, "Byte %zu/%zu isn't zero-filled", i, size);
+	}
+}
+
+TEST_BEGIN(test_arena_slab_zeroed) {
+	unsigned arena_ind;
+	size_t sz = sizeof(arena_ind);
+	expect_d_eq(mallctl("arenas.create", (void *)&arena_ind, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	int flags = MALLOCX_ARENA(arena_ind) | MALLOCX_TCACHE_NONE;
+
+	for (szind_t binind = 0; binind < SC_NBINS; binind++) {
+		const bin_info_t *bin_info = &bin_infos[binind];
+		size_t size = bin_info->reg_size;
+		/* Spill over into a second slab. */
+		unsigned nptrs = bin_info->nregs + 1;
+		void **ptrs = (void **)mallocx(nptrs * sizeof(void *), 0);
+		expect_ptr_not_null(ptrs, "Unexpected mallocx() failure");
+
+		/*
+		 * Fresh regions may skip zeroing; recycled ones, which sit
+		 * below them in the slab, must still be cleared.
+		 */
+		for (unsigned i = 0; i < nptrs; i++) {
+			ptrs[i] = mallocx(size, flags | MALLOCX_ZERO);
+			expect_ptr_not_null(ptrs[i], "Unexpected mallocx() failure");
+			expect_zeroed(ptrs[i], size);
+			memset(ptrs[i], 0xa5, size);
+		}
+		for (unsigned i = 0; i < nptrs; i += 2) {
+			dallocx(ptrs[i], flags);
+		}
+		for (unsigned i = 0; i < nptrs; i += 2) {
+			ptrs[i] = mallocx(size, flags | MALLOCX_ZERO);
+			expect_ptr_not_null(ptrs[i], "Unexpected mallocx() failure");
+			expect_zeroed(ptrs[i], size);
+			memset(ptrs[i], 0xa5, size);
+		}
+		for (unsigned i = 0; i < nptrs; i++) {
+			dallocx(ptrs[i], flags);
+		}
+		dallocx(ptrs, 0);
+	}
+}
+TEST_END
+
 int
 main(void) {
 	return test(
-	    test_arena_slab_regind);
+	    test_arena_slab_regind,
+	    test_arena_slab_zeroed);
 }
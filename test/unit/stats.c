@@ -427,6 +427,123 @@ TEST_BEGIN(test_stats_tcache_bytes_large) {
 }
 TEST_END
 
+static uint64_t
+arena_stat_u64(unsigned arena_ind, const char *name) {
+	char cmd[128];
+	malloc_snprintf(cmd, sizeof(cmd), "stats.arenas.%u.%s", arena_ind,
+	    name);
+	uint64_t val;
+	size_t sz = sizeof(val);
+	expect_d_eq(mallctl(cmd, (void *)&val, &sz, NULL, 0), 0,
+	    "Unexpected mallctl(\"%s\") failure", cmd);
+	return val;
+}
+
+static size_t
+arena_stat_zu(unsigned arena_ind, const char *name) {
+	char cmd[128];
+	malloc_snprintf(cmd, sizeof(cmd), "stats.arenas.%u.%s", arena_ind,
+	    name);
+	size_t val;
+	size_t sz = sizeof(val);
+	expect_d_eq(mallctl(cmd, (void *)&val, &sz, NULL, 0), 0,
+	    "Unexpected mallctl(\"%s\") failure", cmd);
+	return val;
+}
+
+TEST_BEGIN(test_stats_refresh_incremental) {
+	test_skip_if(!config_stats);
+
+	unsigned arena_ind;
+	size_t sz = sizeof(arena_ind);
+	expect_d_eq(mallctl("arenas.create", (void *)&arena_ind, &sz, NULL, 0),
+	    0, "Arena creation failure");
+
+	/* Merging an arena reads its large_mtx profiling data under the lock. */
+	uint64_t epoch = 1;
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch,
+	    sizeof(epoch)), 0, "Unexpected mallctl() failure");
+	uint64_t nops = arena_stat_u64(arena_ind, "mutexes.large.num_ops");
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch,
+	    sizeof(epoch)), 0, "Unexpected mallctl() failure");
+	expect_u64_eq(arena_stat_u64(arena_ind, "mutexes.large.num_ops"), nops,
+	    "An idle arena should not be merged again");
+
+	int flags = MALLOCX_ARENA(arena_ind) | MALLOCX_TCACHE_NONE;
+	void *large = mallocx(SC_LARGE_MINCLASS, flags);
+	expect_ptr_not_null(large, "Unexpected mallocx() failure");
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch,
+	    sizeof(epoch)), 0, "Unexpected mallctl() failure");
+	expect_u64_gt(arena_stat_u64(arena_ind, "mutexes.large.num_ops"), nops,
+	    "An active arena should be merged again");
+	expect_zu_eq(arena_stat_zu(arena_ind, "large.allocated"),
+	    SC_LARGE_MINCLASS, "Large allocation missing from stats");
+
+	void *small = mallocx(1, flags);
+	expect_ptr_not_null(small, "Unexpected mallocx() failure");
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch,
+	    sizeof(epoch)), 0, "Unexpected mallctl() failure");
+	expect_zu_gt(arena_stat_zu(arena_ind, "small.allocated"), 0,
+	    "Small allocation missing from stats");
+
+	dallocx(small, flags);
+	dallocx(large, flags);
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch,
+	    sizeof(epoch)), 0, "Unexpected mallctl() failure");
+	expect_zu_eq(arena_stat_zu(arena_ind, "small.allocated"), 0,
+	    "Stale small stats");
+	expect_zu_eq(arena_stat_zu(arena_ind, "large.allocated"), 0,
+	    "Stale large stats");
+}
+TEST_END
+
+TEST_BEGIN(test_stats_refresh_summary) {
+	test_skip_if(!config_stats);
+
+	unsigned arena_ind;
+	size_t sz = sizeof(arena_ind);
+	expect_d_eq(mallctl("arenas.create", (void *)&arena_ind, &sz, NULL, 0),
+	    0, "Arena creation failure");
+
+	uint64_t epoch = 1;
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch,
+	    sizeof(epoch)), 0, "Unexpected mallctl() failure");
+	size_t allocated0;
+	sz = sizeof(allocated0);
+	expect_d_eq(mallctl("stats.allocated", (void *)&allocated0, &sz, NULL,
+	    0), 0, "Unexpected mallctl() failure");
+
+	int flags = MALLOCX_ARENA(arena_ind) | MALLOCX_TCACHE_NONE;
+	void *p = mallocx(SC_LARGE_MINCLASS, flags);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+
+	uint64_t epoch0, epoch1;
+	sz = sizeof(epoch0);
+	expect_d_eq(mallctl("epoch", (void *)&epoch0, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_d_eq(mallctl("epoch_summary", (void *)&epoch1, &sz,
+	    (void *)&epoch, sizeof(epoch)), 0, "Unexpected mallctl() failure");
+	expect_u64_eq(epoch1, epoch0 + 1,
+	    "A summary refresh should increment the epoch");
+
+	size_t allocated1;
+	sz = sizeof(allocated1);
+	expect_d_eq(mallctl("stats.allocated", (void *)&allocated1, &sz, NULL,
+	    0), 0, "Unexpected mallctl() failure");
+	expect_zu_ge(allocated1, allocated0 + SC_LARGE_MINCLASS,
+	    "stats.allocated should include the new allocation");
+	expect_zu_eq(arena_stat_zu(arena_ind, "large.allocated"), 0,
+	    "Per arena stats should be left alone");
+
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch,
+	    sizeof(epoch)), 0, "Unexpected mallctl() failure");
+	expect_zu_eq(arena_stat_zu(arena_ind, "large.allocated"),
+	    SC_LARGE_MINCLASS, "Large allocation missing from stats");
+
+	dallocx(p, flags);
+}
+TEST_END
+
 int
 main(void) {
 	return test_no_reentrancy(
@@ -438,5 +555,7 @@ main(void) {
 	    test_stats_arenas_bins,
 	    test_stats_arenas_lextents,
 	    test_stats_tcache_bytes_small,
-	    test_stats_tcache_bytes_large);
+	    test_stats_tcache_bytes_large,
+	    test_stats_refresh_incremental,
+	    test_stats_refresh_summary);
 }
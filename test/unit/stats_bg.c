@@ -0,0 +1,142 @@
+#include "test/jemalloc_test.h"
+
+const char *malloc_conf = "stats_bg_interval_ms:100,stats_bg_delta:true";
+
+#define REPORT_END "--- End jemalloc statistics delta ---\n"
+#define REPORT_BUF_SIZE (1U << 20)
+
+static mtx_t report_mtx;
+static char report_buf[REPORT_BUF_SIZE];
+static size_t report_len;
+static tsd_t *report_tsd;
+static void *report_cbopaque;
+
+static void
+stats_bg_hook(void *cbopaque, const char *s) {
+	mtx_lock(&report_mtx);
+	report_tsd = tsd_fetch();
+	report_cbopaque = cbopaque;
+	size_t len = strlen(s);
+	if (report_len + len < REPORT_BUF_SIZE) {
+		memcpy(&report_buf[report_len], s, len + 1);
+		report_len += len;
+	}
+	mtx_unlock(&report_mtx);
+}
+
+static void
+report_reset(void) {
+	mtx_lock(&report_mtx);
+	report_len = 0;
+	report_buf[0] = '\0';
+	mtx_unlock(&report_mtx);
+}
+
+/* Waits up to 10 seconds for the reports to contain s. */
+static bool
+report_wait_for(const char *s) {
+	for (unsigned i = 0; i < 1000; i++) {
+		mtx_lock(&report_mtx);
+		bool found = (strstr(report_buf, s) != NULL);
+		mtx_unlock(&report_mtx);
+		if (found) {
+			return true;
+		}
+		sleep_ns(10 * 1000 * 1000);
+	}
+	return false;
+}
+
+static void
+background_thread_set(bool enable) {
+	expect_d_eq(mallctl("background_thread", NULL, NULL, (void *)&enable,
+	    sizeof(enable)), 0, "Unexpected mallctl() failure");
+}
+
+TEST_BEGIN(test_stats_bg_delta) {
+	test_skip_if(!have_background_thread);
+	test_skip_if(!config_stats);
+
+	assert_false(mtx_init(&report_mtx), "Unexpected mtx_init() failure");
+	stats_bg_hook_t hook = {stats_bg_hook, (void *)&report_mtx};
+	expect_d_eq(mallctl("experimental.hooks.stats_bg", NULL, NULL,
+	    (void *)&hook, sizeof(hook)), 0, "Unexpected mallctl() failure");
+	background_thread_set(true);
+
+	expect_true(report_wait_for(REPORT_END),
+	    "Background thread should have written a report");
+	mtx_lock(&report_mtx);
+	expect_ptr_not_null(strstr(report_buf, "\nstats.allocated "),
+	    "First report should contain the (nonzero) allocated bytes");
+	expect_ptr_ne(report_tsd, tsd_fetch(),
+	    "Reports should be written by the background thread");
+	expect_ptr_eq(report_cbopaque, (void *)&report_mtx,
+	    "The hook should get its cbopaque");
+	mtx_unlock(&report_mtx);
+	report_reset();
+
+	unsigned arena_ind;
+	size_t sz = sizeof(arena_ind);
+	expect_d_eq(mallctl("arenas.create", (void *)&arena_ind, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	int flags = MALLOCX_ARENA(arena_ind) | MALLOCX_TCACHE_NONE;
+	const unsigned nptrs = 10;
+	void *ptrs[10];
+	for (unsigned i = 0; i < nptrs; i++) {
+		ptrs[i] = mallocx(1, flags);
+		expect_ptr_not_null(ptrs[i], "Unexpected mallocx() failure");
+	}
+
+	char expected[128];
+	malloc_snprintf(expected, sizeof(expected),
+	    "\nstats.arenas.%u.bins.%u.nmalloc %u +%u\n", arena_ind,
+	    sz_size2index(1), nptrs, nptrs);
+	expect_true(report_wait_for(expected),
+	    "Report should contain the new allocations (\"%s\")", expected + 1);
+
+	for (unsigned i = 0; i < nptrs; i++) {
+		dallocx(ptrs[i], flags);
+	}
+	background_thread_set(false);
+	hook.write_cb = NULL;
+	expect_d_eq(mallctl("experimental.hooks.stats_bg", NULL, NULL,
+	    (void *)&hook, sizeof(hook)), 0, "Unexpected mallctl() failure");
+	mtx_fini(&report_mtx);
+}
+TEST_END
+
+TEST_BEGIN(test_stats_bg_hook) {
+	test_skip_if(!config_stats);
+
+	int opaque;
+	stats_bg_hook_t hook = {stats_bg_hook, (void *)&opaque};
+	stats_bg_hook_t old_hook;
+	size_t sz = sizeof(old_hook);
+	expect_d_eq(mallctl("experimental.hooks.stats_bg", (void *)&old_hook,
+	    &sz, (void *)&hook, sizeof(hook)), 0,
+	    "Unexpected mallctl() failure");
+	expect_ptr_null(old_hook.write_cb,
+	    "No hook should be installed by default");
+	expect_d_eq(mallctl("experimental.hooks.stats_bg", (void *)&old_hook,
+	    &sz, NULL, 0), 0, "Unexpected mallctl() failure");
+	expect_ptr_eq(old_hook.write_cb, hook.write_cb,
+	    "Hook should have been installed");
+	expect_ptr_eq(old_hook.cbopaque, hook.cbopaque,
+	    "Hook cbopaque should have been installed");
+	expect_d_eq(mallctl("experimental.hooks.stats_bg", NULL, NULL,
+	    (void *)&hook.write_cb, sizeof(hook.write_cb)), EINVAL,
+	    "A bare write_cb_t should be rejected");
+	expect_d_eq(mallctl("experimental.hooks.stats_bg", NULL, NULL, NULL, 0),
+	    EINVAL, "Neither reading nor writing should be an error");
+	hook.write_cb = NULL;
+	expect_d_eq(mallctl("experimental.hooks.stats_bg", NULL, NULL,
+	    (void *)&hook, sizeof(hook)), 0, "Unexpected mallctl() failure");
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(
+	    test_stats_bg_hook,
+	    test_stats_bg_delta);
+}
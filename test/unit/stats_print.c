@@ -991,9 +991,208 @@ TEST_BEGIN(test_stats_print_json) {
 }
 TEST_END
 
+static bool
+openmetrics_name_char(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+	    (c >= '0' && c <= '9') || c == '_';
+}
+
+/* Returns true if [s, s + len) is among the n strings of starts and lens. */
+static bool
+openmetrics_seen(const char **starts, const size_t *lens, size_t n,
+    const char *s, size_t len) {
+	for (size_t i = 0; i < n; i++) {
+		if (lens[i] == len && strncmp(starts[i], s, len) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Returns true unless the output is a sequence of metric families followed by
+ * "# EOF".  A family is a "# TYPE <family> counter|gauge" line followed by its
+ * samples, i.e. "<name> value" or "<name>{labels} value" with an integer value,
+ * where <name> is the family name, with _total appended for counters.  Each
+ * family must appear once, i.e. be contiguous, and each series (name and
+ * labels) be unique.
+ */
+static bool
+openmetrics_malformed(const char *buf) {
+	const char *eof = "# EOF\n";
+	const char *type = "# TYPE ";
+	const char *total = "_total";
+	size_t len = strlen(buf);
+	if (len < strlen(eof) || strcmp(&buf[len - strlen(eof)], eof) != 0) {
+		return true;
+	}
+	const char *end = &buf[len - strlen(eof)];
+
+	size_t nlines = 1;
+	for (const char *p = buf; p != end; p++) {
+		nlines += (*p == '\n');
+	}
+	const char **families = malloc(nlines * sizeof(const char *));
+	size_t *family_lens = malloc(nlines * sizeof(size_t));
+	const char **series = malloc(nlines * sizeof(const char *));
+	size_t *series_lens = malloc(nlines * sizeof(size_t));
+	assert_ptr_not_null(families, "Unexpected malloc() failure");
+	assert_ptr_not_null(family_lens, "Unexpected malloc() failure");
+	assert_ptr_not_null(series, "Unexpected malloc() failure");
+	assert_ptr_not_null(series_lens, "Unexpected malloc() failure");
+	size_t nfamilies = 0;
+	size_t nseries = 0;
+
+	bool malformed = false;
+	bool counter = false;
+	for (const char *p = buf; p != end && !malformed; p++) {
+		if (strncmp(p, type, strlen(type)) == 0) {
+			p += strlen(type);
+			const char *family = p;
+			while (openmetrics_name_char(*p)) {
+				p++;
+			}
+			size_t family_len = p - family;
+			if (strncmp(p, " counter\n", strlen(" counter\n")) == 0) {
+				counter = true;
+			} else if (strncmp(p, " gauge\n", strlen(" gauge\n")) ==
+			    0) {
+				counter = false;
+			} else {
+				malformed = true;
+				break;
+			}
+			if (family_len == 0 || openmetrics_seen(families,
+			    family_lens, nfamilies, family, family_len)) {
+				malformed = true;
+				break;
+			}
+			families[nfamilies] = family;
+			family_lens[nfamilies++] = family_len;
+			p = strchr(p, '\n');
+			continue;
+		}
+
+		/* A sample, of the family of the last TYPE line. */
+		const char *name = p;
+		while (openmetrics_name_char(*p)) {
+			p++;
+		}
+		size_t name_len = p - name;
+		if (nfamilies == 0) {
+			malformed = true;
+			break;
+		}
+		const char *family = families[nfamilies - 1];
+		size_t family_len = family_lens[nfamilies - 1];
+		if (name_len != family_len + (counter ? strlen(total) : 0) ||
+		    strncmp(name, family, family_len) != 0 || (counter &&
+		    strncmp(&name[family_len], total, strlen(total)) != 0)) {
+			malformed = true;
+			break;
+		}
+		if (*p == '{') {
+			while (*p != '}' && *p != '\n') {
+				p++;
+			}
+			if (*p != '}') {
+				malformed = true;
+				break;
+			}
+			p++;
+		}
+		if (openmetrics_seen(series, series_lens, nseries, name,
+		    p - name)) {
+			malformed = true;
+			break;
+		}
+		series[nseries] = name;
+		series_lens[nseries++] = p - name;
+
+		if (*p != ' ') {
+			malformed = true;
+			break;
+		}
+		p++;
+		if (*p == '-') {
+			p++;
+		}
+		if (!(*p >= '0' && *p <= '9')) {
+			malformed = true;
+			break;
+		}
+		while (*p >= '0' && *p <= '9') {
+			p++;
+		}
+		if (*p != '\n') {
+			malformed = true;
+		}
+	}
+
+	free(families);
+	free(family_lens);
+	free(series);
+	free(series_lens);
+	return malformed;
+}
+
+TEST_BEGIN(test_stats_print_openmetrics) {
+	const char *opts[] = {
+		"O",
+		"Og",
+		"Oa",
+		"Ob",
+		"Ol",
+		"Ox",
+		"Oe",
+		"Oh",
+		"Ogmdablxeh",
+	};
+
+	void *p = mallocx(1, 0);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	for (unsigned i = 0; i < sizeof(opts)/sizeof(const char *); i++) {
+		parser_t parser;
+
+		parser_init(&parser, true);
+		malloc_stats_print(write_cb, (void *)&parser, opts[i]);
+		expect_false(openmetrics_malformed(parser.buf),
+		    "Malformed OpenMetrics output, opts=\"%s\"", opts[i]);
+		bool per_arena = config_stats && strchr(opts[i], 'a') == NULL;
+		if (per_arena) {
+			expect_ptr_not_null(strstr(parser.buf,
+			    "\njemalloc_stats_arenas_nthreads{arena=\"0\"} "),
+			    "Missing arena label, opts=\"%s\"", opts[i]);
+		}
+		if (per_arena) {
+			expect_ptr_not_null(strstr(parser.buf,
+			    "\n# TYPE jemalloc_stats_arenas_small_nmalloc "
+			    "counter\n"), "Missing counter family, opts=\"%s\"",
+			    opts[i]);
+			expect_ptr_not_null(strstr(parser.buf,
+			    "\njemalloc_stats_arenas_small_nmalloc_total"
+			    "{arena=\"0\"} "),
+			    "Missing counter series, opts=\"%s\"", opts[i]);
+		}
+		if (strchr(opts[i], 'b') != NULL) {
+			expect_ptr_null(strstr(parser.buf, "_bins_"),
+			    "Unexpected bin series, opts=\"%s\"", opts[i]);
+		} else if (per_arena) {
+			expect_ptr_not_null(strstr(parser.buf,
+			    "\njemalloc_stats_arenas_bins_curregs{arena=\"0\","
+			    "bin=\"0\",size=\"8\"} "),
+			    "Missing bin series, opts=\"%s\"", opts[i]);
+		}
+		parser_fini(&parser);
+	}
+	dallocx(p, 0);
+}
+TEST_END
+
 int
 main(void) {
 	return test(
 	    test_json_parser,
-	    test_stats_print_json);
+	    test_stats_print_json,
+	    test_stats_print_openmetrics);
 }
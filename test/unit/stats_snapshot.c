@@ -0,0 +1,252 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/ctl.h"
+
+enum {
+#define OP(name) header_##name,
+	CTL_SNAPSHOT_HEADER_FIELDS
+#undef OP
+	nheader_fields
+};
+
+enum {
+#define OP(name, expr) global_##name,
+	CTL_SNAPSHOT_GLOBAL_FIELDS
+#undef OP
+	nglobal_fields
+};
+
+enum {
+#define OP(name, expr) mutex_##name,
+	CTL_SNAPSHOT_MUTEX_FIELDS
+#undef OP
+	nmutex_fields
+};
+
+enum {
+#define OP(name, expr) arena_##name,
+	CTL_SNAPSHOT_ARENA_FIELDS
+#undef OP
+	narena_fields
+};
+
+enum {
+#define OP(name, expr) bin_##name,
+	CTL_SNAPSHOT_BIN_FIELDS
+#undef OP
+	nbin_fields
+};
+
+enum {
+#define OP(name, expr) lextent_##name,
+	CTL_SNAPSHOT_LEXTENT_FIELDS
+#undef OP
+	nlextent_fields
+};
+
+static size_t
+arena_record_len(const uint64_t *snap) {
+	return snap[header_narena_fields]
+	    + snap[header_narena_mutexes] * snap[header_nmutex_fields]
+	    + snap[header_nbins] * (snap[header_nbin_fields]
+	    + snap[header_nmutex_fields])
+	    + snap[header_nlextents] * snap[header_nlextent_fields];
+}
+
+static const uint64_t *
+arena_record(const uint64_t *snap, unsigned arena_ind) {
+	const uint64_t *rec = snap + nheader_fields
+	    + snap[header_nglobal_fields]
+	    + snap[header_nglobal_mutexes] * snap[header_nmutex_fields];
+	for (uint64_t i = 0; i < snap[header_narenas]; i++) {
+		if (rec[arena_arena_ind] == arena_ind) {
+			return rec;
+		}
+		rec += arena_record_len(snap);
+	}
+	return NULL;
+}
+
+static const uint64_t *
+bin_record(const uint64_t *snap, const uint64_t *rec, szind_t binind) {
+	return rec + snap[header_narena_fields] + snap[header_narena_mutexes]
+	    * snap[header_nmutex_fields] + binind * (snap[header_nbin_fields]
+	    + snap[header_nmutex_fields]);
+}
+
+static const uint64_t *
+lextent_record(const uint64_t *snap, const uint64_t *rec, szind_t szind) {
+	return bin_record(snap, rec, snap[header_nbins])
+	    + (szind - SC_NBINS) * snap[header_nlextent_fields];
+}
+
+/* Returns a refreshed snapshot, to be freed by the caller. */
+static uint64_t *
+snapshot_get(void) {
+	bool refresh = true;
+	size_t sz;
+	expect_d_eq(mallctl("experimental.stats_snapshot", NULL, &sz,
+	    (void *)&refresh, sizeof(refresh)), 0,
+	    "Unexpected mallctl() failure");
+	/* Leave room for arenas created by the refresh below. */
+	sz *= 2;
+	uint64_t *snap = (uint64_t *)malloc(sz);
+	assert_ptr_not_null(snap, "Unexpected malloc() failure");
+	assert_d_eq(mallctl("experimental.stats_snapshot", (void *)snap, &sz,
+	    (void *)&refresh, sizeof(refresh)), 0,
+	    "Unexpected mallctl() failure");
+	expect_zu_eq(sz, snap[header_size], "Size mismatch");
+	return snap;
+}
+
+TEST_BEGIN(test_stats_snapshot_header) {
+	test_skip_if(!config_stats);
+
+	size_t sz;
+	expect_d_eq(mallctl("experimental.stats_snapshot", NULL, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	expect_zu_gt(sz, nheader_fields * sizeof(uint64_t),
+	    "Snapshot should contain more than the header");
+	expect_zu_eq(sz % sizeof(uint64_t), 0, "Snapshot should be an array "
+	    "of uint64_t");
+
+	uint64_t *snap = (uint64_t *)malloc(sz);
+	size_t short_sz = sz - 1;
+	expect_d_eq(mallctl("experimental.stats_snapshot", (void *)snap,
+	    &short_sz, NULL, 0), EINVAL, "Short buffer should be rejected");
+	expect_zu_eq(short_sz, sz, "Required size should be returned");
+	free(snap);
+
+	int bad = 1;
+	expect_d_eq(mallctl("experimental.stats_snapshot", NULL, &sz,
+	    (void *)&bad, sizeof(bad)), EINVAL, "Bad newlen should be rejected");
+
+	snap = snapshot_get();
+	uint64_t epoch;
+	sz = sizeof(epoch);
+	expect_d_eq(mallctl("epoch", (void *)&epoch, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_u64_eq(snap[header_magic], CTL_SNAPSHOT_MAGIC, "Wrong magic");
+	expect_u64_eq(snap[header_version], CTL_SNAPSHOT_VERSION,
+	    "Wrong version");
+	expect_u64_eq(snap[header_epoch], epoch, "Wrong epoch");
+	expect_u64_eq(snap[header_nglobal_fields], nglobal_fields, "");
+	expect_u64_eq(snap[header_nmutex_fields], nmutex_fields, "");
+	expect_u64_eq(snap[header_nglobal_mutexes],
+	    mutex_prof_num_global_mutexes, "");
+	expect_u64_eq(snap[header_narena_fields], narena_fields, "");
+	expect_u64_eq(snap[header_narena_mutexes],
+	    mutex_prof_num_arena_mutexes, "");
+	expect_u64_eq(snap[header_nbins], SC_NBINS, "");
+	expect_u64_eq(snap[header_nbin_fields], nbin_fields, "");
+	expect_u64_eq(snap[header_nlextents], SC_NSIZES - SC_NBINS, "");
+	expect_u64_eq(snap[header_nlextent_fields], nlextent_fields, "");
+	expect_u64_ge(snap[header_narenas], 1, "Arena 0 should be present");
+
+	size_t len = nheader_fields + nglobal_fields
+	    + mutex_prof_num_global_mutexes * nmutex_fields
+	    + snap[header_narenas] * arena_record_len(snap);
+	expect_u64_eq(snap[header_size], len * sizeof(uint64_t),
+	    "Size should match the layout described by the header");
+
+	size_t allocated;
+	sz = sizeof(allocated);
+	expect_d_eq(mallctl("stats.allocated", (void *)&allocated, &sz, NULL,
+	    0), 0, "Unexpected mallctl() failure");
+	expect_u64_eq(snap[nheader_fields + global_allocated], allocated,
+	    "Snapshot should match stats.allocated");
+	expect_ptr_not_null(arena_record(snap, 0), "Arena 0 should be present");
+	free(snap);
+}
+TEST_END
+
+TEST_BEGIN(test_stats_snapshot_deltas) {
+	test_skip_if(!config_stats);
+
+	unsigned arena_ind;
+	size_t sz = sizeof(arena_ind);
+	expect_d_eq(mallctl("arenas.create", (void *)&arena_ind, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	int flags = MALLOCX_ARENA(arena_ind) | MALLOCX_TCACHE_NONE;
+	szind_t binind = sz_size2index(1);
+	szind_t lind = sz_size2index(SC_LARGE_MINCLASS);
+
+	uint64_t *snap0 = snapshot_get();
+	const uint64_t *rec0 = arena_record(snap0, arena_ind);
+	assert_ptr_not_null(rec0, "New arena should be present");
+
+	const unsigned nsmall = 10;
+	void *ptrs[10];
+	for (unsigned i = 0; i < nsmall; i++) {
+		ptrs[i] = mallocx(1, flags);
+		expect_ptr_not_null(ptrs[i], "Unexpected mallocx() failure");
+	}
+	void *large = mallocx(SC_LARGE_MINCLASS, flags);
+	expect_ptr_not_null(large, "Unexpected mallocx() failure");
+
+	uint64_t *snap1 = snapshot_get();
+	const uint64_t *rec1 = arena_record(snap1, arena_ind);
+	assert_ptr_not_null(rec1, "New arena should be present");
+	expect_u64_gt(snap1[header_epoch], snap0[header_epoch],
+	    "Refresh should advance the epoch");
+
+	expect_u64_eq(bin_record(snap1, rec1, binind)[bin_nmalloc]
+	    - bin_record(snap0, rec0, binind)[bin_nmalloc], nsmall,
+	    "Unexpected bin nmalloc delta");
+	expect_u64_eq(bin_record(snap1, rec1, binind)[bin_curregs], nsmall,
+	    "Unexpected bin curregs");
+	expect_u64_eq(rec1[arena_small_nmalloc] - rec0[arena_small_nmalloc],
+	    nsmall, "Unexpected small nmalloc delta");
+	expect_u64_eq(lextent_record(snap1, rec1, lind)[lextent_nmalloc]
+	    - lextent_record(snap0, rec0, lind)[lextent_nmalloc], 1,
+	    "Unexpected lextent nmalloc delta");
+	expect_u64_eq(rec1[arena_large_allocated], SC_LARGE_MINCLASS,
+	    "Unexpected large allocated");
+
+	/* The values should agree with the equivalent mallctls. */
+	char cmd[128];
+	uint64_t nmalloc;
+	sz = sizeof(nmalloc);
+	malloc_snprintf(cmd, sizeof(cmd), "stats.arenas.%u.bins.%u.nmalloc",
+	    arena_ind, binind);
+	expect_d_eq(mallctl(cmd, (void *)&nmalloc, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_u64_eq(bin_record(snap1, rec1, binind)[bin_nmalloc], nmalloc,
+	    "Snapshot should match %s", cmd);
+	size_t pactive;
+	sz = sizeof(pactive);
+	malloc_snprintf(cmd, sizeof(cmd), "stats.arenas.%u.pactive",
+	    arena_ind);
+	expect_d_eq(mallctl(cmd, (void *)&pactive, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_u64_eq(rec1[arena_pactive], pactive,
+	    "Snapshot should match %s", cmd);
+
+	for (unsigned i = 0; i < nsmall; i++) {
+		dallocx(ptrs[i], flags);
+	}
+	dallocx(large, flags);
+	free(snap0);
+	free(snap1);
+
+	/* Destroyed arenas get a record of their own. */
+	malloc_snprintf(cmd, sizeof(cmd), "arena.%u.destroy", arena_ind);
+	expect_d_eq(mallctl(cmd, NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	uint64_t *snap2 = snapshot_get();
+	expect_ptr_null(arena_record(snap2, arena_ind),
+	    "Destroyed arena should not have a record");
+	const uint64_t *drec = arena_record(snap2, MALLCTL_ARENAS_DESTROYED);
+	assert_ptr_not_null(drec, "Destroyed arenas should have a record");
+	expect_u64_ge(bin_record(snap2, drec, binind)[bin_nmalloc], nsmall,
+	    "Destroyed arena stats should be merged");
+	free(snap2);
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(
+	    test_stats_snapshot_header,
+	    test_stats_snapshot_deltas);
+}
@@ -0,0 +1,141 @@
+#include "test/jemalloc_test.h"
+
+const char *malloc_conf = "stats_ts_interval_ms:100,stats_ts_nsamples:4";
+
+#define NSAMPLES 4
+
+static void
+background_thread_set(bool enable) {
+	expect_d_eq(mallctl("background_thread", NULL, NULL, (void *)&enable,
+	    sizeof(enable)), 0, "Unexpected mallctl() failure");
+}
+
+static size_t
+stats_ts_nsamples_get(void) {
+	size_t sz;
+	expect_d_eq(mallctl("experimental.stats_ts", NULL, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_zu_eq(sz % sizeof(stats_ts_sample_t), 0,
+	    "Size should be a multiple of the sample size");
+	return sz / sizeof(stats_ts_sample_t);
+}
+
+/* Waits up to 10 seconds for a sample taken after time_ns. */
+static bool
+stats_ts_wait_for(uint64_t time_ns) {
+	stats_ts_sample_t samples[NSAMPLES];
+	for (unsigned i = 0; i < 1000; i++) {
+		size_t sz = sizeof(samples);
+		expect_d_eq(mallctl("experimental.stats_ts", (void *)samples,
+		    &sz, NULL, 0), 0, "Unexpected mallctl() failure");
+		size_t n = sz / sizeof(stats_ts_sample_t);
+		if (n > 0 && samples[n - 1].time_ns > time_ns) {
+			return true;
+		}
+		sleep_ns(10 * 1000 * 1000);
+	}
+	return false;
+}
+
+TEST_BEGIN(test_stats_ts_errors) {
+	test_skip_if(!config_stats);
+
+	stats_ts_sample_t sample;
+	size_t sz = sizeof(sample);
+	expect_d_eq(mallctl("experimental.stats_ts", (void *)&sample, &sz,
+	    (void *)&sample, sizeof(sample)), EPERM,
+	    "experimental.stats_ts should be read-only");
+	expect_d_eq(mallctl("experimental.stats_ts", NULL, NULL, NULL, 0),
+	    EINVAL, "Missing oldlenp should be rejected");
+	sz = sizeof(sample) - 1;
+	expect_d_eq(mallctl("experimental.stats_ts", (void *)&sample, &sz,
+	    NULL, 0), 0, "Unexpected mallctl() failure");
+	expect_zu_eq(sz, 0, "No sample fits in a short buffer");
+}
+TEST_END
+
+TEST_BEGIN(test_stats_ts_samples) {
+	test_skip_if(!have_background_thread);
+	test_skip_if(!config_stats);
+
+	expect_zu_eq(stats_ts_nsamples_get(), 0,
+	    "No samples should be taken before background threads start");
+	uint64_t epoch_0, epoch_1;
+	size_t allocated_0, allocated_1;
+	size_t sz = sizeof(epoch_0);
+	expect_d_eq(mallctl("epoch", (void *)&epoch_0, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	sz = sizeof(allocated_0);
+	expect_d_eq(mallctl("stats.allocated", (void *)&allocated_0, &sz, NULL,
+	    0), 0, "Unexpected mallctl() failure");
+	background_thread_set(true);
+	expect_true(stats_ts_wait_for(0),
+	    "Background thread should have taken a sample");
+
+	/* Wait for the ring to wrap around. */
+	stats_ts_sample_t samples[NSAMPLES + 1];
+	sz = sizeof(samples);
+	expect_d_eq(mallctl("experimental.stats_ts", (void *)samples, &sz,
+	    NULL, 0), 0, "Unexpected mallctl() failure");
+	uint64_t first_ns = samples[0].time_ns;
+	for (unsigned i = 0; i < NSAMPLES; i++) {
+		uint64_t last_ns = samples[sz / sizeof(stats_ts_sample_t) - 1]
+		    .time_ns;
+		expect_true(stats_ts_wait_for(last_ns),
+		    "Background thread should keep sampling");
+		sz = sizeof(samples);
+		expect_d_eq(mallctl("experimental.stats_ts", (void *)samples,
+		    &sz, NULL, 0), 0, "Unexpected mallctl() failure");
+	}
+	background_thread_set(false);
+	size_t n = sz / sizeof(stats_ts_sample_t);
+
+	/* Sampling reads the arenas directly, leaving stats.* as they are. */
+	sz = sizeof(epoch_1);
+	expect_d_eq(mallctl("epoch", (void *)&epoch_1, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_u64_eq(epoch_1, epoch_0,
+	    "Sampling should not advance the epoch");
+	sz = sizeof(allocated_1);
+	expect_d_eq(mallctl("stats.allocated", (void *)&allocated_1, &sz, NULL,
+	    0), 0, "Unexpected mallctl() failure");
+	expect_zu_eq(allocated_1, allocated_0,
+	    "Sampling should not refresh stats.allocated");
+
+	expect_zu_eq(n, NSAMPLES, "Only the last samples should be kept");
+	expect_zu_eq(stats_ts_nsamples_get(), NSAMPLES,
+	    "Only the last samples should be kept");
+	expect_u64_gt(samples[0].time_ns, first_ns,
+	    "Oldest samples should have been overwritten");
+	for (size_t i = 0; i < n; i++) {
+		expect_u64_gt(samples[i].allocated, 0,
+		    "Sampled allocated bytes should be nonzero");
+		expect_u64_ge(samples[i].active, samples[i].allocated,
+		    "Active bytes should cover allocated bytes");
+		if (i > 0) {
+			expect_u64_gt(samples[i].time_ns,
+			    samples[i - 1].time_ns,
+			    "Samples should be ordered oldest first");
+			expect_u64_ge(samples[i].dirty_npurge,
+			    samples[i - 1].dirty_npurge,
+			    "Counters should not decrease");
+		}
+	}
+
+	/* Reads are truncated to the most recent samples. */
+	stats_ts_sample_t last;
+	sz = sizeof(last);
+	expect_d_eq(mallctl("experimental.stats_ts", (void *)&last, &sz, NULL,
+	    0), 0, "Unexpected mallctl() failure");
+	expect_zu_eq(sz, sizeof(last), "Exactly one sample should be read");
+	expect_u64_eq(last.time_ns, samples[n - 1].time_ns,
+	    "The most recent sample should be read");
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(
+	    test_stats_ts_errors,
+	    test_stats_ts_samples);
+}